@@ -0,0 +1,103 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__CELL_MASKS_HPP_
+#define NAV2_COSTMAP_2D__CELL_MASKS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "nav2_costmap_2d/thread_pool.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class CellMasks
+ * @brief One bit per cell of a grid for each of several threads, set independently and
+ *        then applied to the grid together
+ *
+ * Threads that raytrace into their own mask don't share any memory, and since applying
+ * the masks only depends on which bits are set, the grid ends up the same whatever the
+ * order the rays were traced in.
+ */
+class CellMasks
+{
+public:
+  /**
+   * @class SetCell
+   * @brief An action for Costmap2D::raytraceLine() setting the bit of each cell in a mask
+   */
+  class SetCell
+  {
+  public:
+    explicit SetCell(uint64_t * bits)
+    : bits_(bits)
+    {
+    }
+    inline void operator()(unsigned int offset)
+    {
+      bits_[offset >> 6] |= static_cast<uint64_t>(1) << (offset & 63);
+    }
+
+  private:
+    uint64_t * bits_;
+  };
+
+  CellMasks()
+  : cells_(0) {}
+
+  /**
+   * @brief  Sets the number of masks and their size, clearing them if either changes
+   * @param num_masks The number of masks, one per thread setting bits at the same time
+   * @param cells The number of cells of the grid
+   */
+  void resize(unsigned int num_masks, size_t cells);
+
+  unsigned int size() const
+  {
+    return masks_.size();
+  }
+
+  /** @brief An action setting bits in one of the masks */
+  SetCell setCell(unsigned int mask)
+  {
+    return SetCell(masks_[mask].data());
+  }
+
+  /** @brief Whether a cell is set in any of the masks */
+  bool isSet(size_t offset) const;
+
+  /**
+   * @brief  Writes a value to every cell set in any of the masks, then clears the masks
+   * @param grid The grid the masks are for
+   * @param value The value to write
+   * @param pool If not null, the masks are applied in parallel on this pool
+   * @param overwritten If not null, the offsets and previous values of the cells that didn't
+   *        have the value already are appended to it, in no particular order
+   */
+  void apply(
+    unsigned char * grid, unsigned char value, ThreadPool * pool,
+    std::vector<std::pair<size_t, unsigned char>> * overwritten = nullptr);
+
+private:
+  size_t cells_;
+  std::vector<std::vector<uint64_t>> masks_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__CELL_MASKS_HPP_
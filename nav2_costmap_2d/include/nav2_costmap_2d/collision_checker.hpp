@@ -60,7 +60,9 @@ protected:
   Footprint getFootprint(const geometry_msgs::msg::Pose2D & pose);
   double footprintCost(const Footprint footprint);
 
-  std::shared_ptr<Costmap2D> costmap_;
+  std::shared_ptr<const Costmap2D> costmap_;
+  // the version of costmap_, only fetched again when the subscriber has a newer one
+  uint64_t costmap_version_;
 
   // Name used for logging
   std::string name_;
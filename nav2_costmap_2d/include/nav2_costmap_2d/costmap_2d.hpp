@@ -48,6 +48,7 @@
 #include <queue>
 #include <mutex>
 #include "geometry_msgs/msg/point.hpp"
+#include "nav2_costmap_2d/timed_mutex.hpp"
 
 namespace nav2_costmap_2d
 {
@@ -180,6 +181,9 @@ public:
    */
   inline unsigned int getIndex(unsigned int mx, unsigned int my) const
   {
+    if (toroidal_) {
+      return wrapY(my) * size_x_ + wrapX(mx);
+    }
     return my * size_x_ + mx;
   }
 
@@ -193,6 +197,30 @@ public:
   {
     my = index / size_x_;
     mx = index - (my * size_x_);
+    if (toroidal_) {
+      mx = mx >= wrap_x_ ? mx - wrap_x_ : mx + size_x_ - wrap_x_;
+      my = my >= wrap_y_ ? my - wrap_y_ : my + size_y_ - wrap_y_;
+    }
+  }
+
+  /**
+   * @brief  Switch the storage of the costmap between row-major and toroidal (wrap-around) order
+   *
+   * In toroidal mode, updateOrigin() only moves the storage offset and clears the newly
+   * exposed cells instead of copying the overlapping window. The char map is then no longer
+   * laid out row by row from the origin, so it must only be addressed through getIndex().
+   * Switching modes resets the costmap.
+   * @param toroidal Whether to use toroidal storage
+   */
+  void setToroidal(bool toroidal);
+
+  /**
+   * @brief  Whether the costmap uses toroidal storage
+   * @return True if the char map must be addressed through getIndex()
+   */
+  bool isToroidal() const
+  {
+    return toroidal_;
   }
 
   /**
@@ -201,6 +229,41 @@ public:
    */
   unsigned char * getCharMap() const;
 
+  /**
+   * @brief  Apply an action to each contiguous run of the char map covering a window of cells
+   *
+   * Row-major costmaps store each row of the window as one run. Toroidal costmaps split
+   * a row in two where it crosses the storage seam.
+   * @param  at The action to take, called as at(index, mx, my, length) where index is the
+   *            char map index of cell (mx, my) and the run covers length cells of row my
+   * @param  x0 The starting x coordinate of the window
+   * @param  y0 The starting y coordinate of the window
+   * @param  xn The x coordinate one past the end of the window
+   * @param  yn The y coordinate one past the end of the window
+   */
+  template<class ActionType>
+  inline void forEachRun(
+    ActionType at, unsigned int x0, unsigned int y0, unsigned int xn,
+    unsigned int yn) const
+  {
+    if (xn <= x0) {
+      return;
+    }
+    unsigned int length = xn - x0;
+    for (unsigned int my = y0; my < yn; ++my) {
+      unsigned int index = getIndex(x0, my);
+      if (toroidal_) {
+        unsigned int to_seam = size_x_ - wrapX(x0);
+        if (length > to_seam) {
+          at(index, x0, my, to_seam);
+          at(index + to_seam - size_x_, x0 + to_seam, my, length - to_seam);
+          continue;
+        }
+      }
+      at(index, x0, my, length);
+    }
+  }
+
   /**
    * @brief  Accessor for the x size of the costmap in cells
    * @return The x size of the costmap
@@ -294,6 +357,32 @@ public:
    */
   bool saveMap(std::string file_name);
 
+  /**
+   * @brief  Save the costmap to a binary snapshot, which loadSnapshot() maps back in
+   * @param file_name The name of the file to save
+   * @param name The name of the costmap stored in the snapshot, e.g. that of its layer
+   * @param frame The frame of the costs stored in the snapshot
+   * @return False if the snapshot couldn't be written
+   */
+  bool saveSnapshot(
+    const std::string & file_name, const std::string & name,
+    const std::string & frame) const;
+
+  /**
+   * @brief  Save the costmap to a binary snapshot in the frame it knows for its costs,
+   *         none for a bare costmap
+   */
+  virtual bool saveSnapshot(const std::string & file_name, const std::string & name) const;
+
+  /**
+   * @brief  Load a snapshot saved by saveSnapshot(), taking its size, resolution and origin
+   * @param file_name The name of the snapshot
+   * @param name The name the snapshot must have, empty to load any
+   * @return False, leaving the costmap unchanged and logging why, if the file isn't a snapshot
+   *         of that name
+   */
+  virtual bool loadSnapshot(const std::string & file_name, const std::string & name);
+
   void resizeMap(
     unsigned int size_x, unsigned int size_y, double resolution, double origin_x,
     double origin_y);
@@ -310,8 +399,9 @@ public:
    */
   unsigned int cellDistance(double world_dist);
 
-  // Provide a typedef to ease future code maintenance
-  typedef std::recursive_mutex mutex_t;
+  // Provide a typedef to ease future code maintenance,
+  // the mutex can time its users for the statistics of the costmap
+  typedef TimedRecursiveMutex mutex_t;
   mutex_t * getMutex()
   {
     return access_;
@@ -351,6 +441,13 @@ protected:
     }
   }
 
+  /**
+   * @brief  Move the storage offset of a toroidal costmap and clear the cells that scrolled into view
+   * @param  cell_ox The number of cells the origin moves along x
+   * @param  cell_oy The number of cells the origin moves along y
+   */
+  void shiftToroidalOrigin(int cell_ox, int cell_oy);
+
   /**
    * @brief  Deletes the costmap, static_map, and markers data structures
    */
@@ -399,6 +496,23 @@ protected:
     double dist = std::hypot(dx, dy);
     double scale = (dist == 0.0) ? 1.0 : std::min(1.0, max_length / dist);
 
+    // with toroidal storage, rows and columns can wrap along the line,
+    // so we step through map coordinates instead of char map offsets
+    if (toroidal_) {
+      if (abs_dx >= abs_dy) {
+        int error_y = abs_dx / 2;
+        bresenham2DToroidal(
+          at, abs_dx, abs_dy, error_y, offset_dx, 0, 0, sign(dy), x0, y0,
+          (unsigned int)(scale * abs_dx));
+        return;
+      }
+      int error_x = abs_dy / 2;
+      bresenham2DToroidal(
+        at, abs_dy, abs_dx, error_x, 0, sign(dy), offset_dx, 0, x0, y0,
+        (unsigned int)(scale * abs_dy));
+      return;
+    }
+
     // if x is dominant
     if (abs_dx >= abs_dy) {
       int error_y = abs_dx / 2;
@@ -439,11 +553,48 @@ private:
     at(offset);
   }
 
+  /**
+   * @brief  Bresenham's raytracing over map coordinates, used for toroidal storage
+   */
+  template<class ActionType>
+  inline void bresenham2DToroidal(
+    ActionType at, unsigned int abs_da, unsigned int abs_db, int error_b,
+    int step_ax, int step_ay, int step_bx, int step_by,
+    unsigned int mx, unsigned int my, unsigned int max_length)
+  {
+    unsigned int end = std::min(max_length, abs_da);
+    for (unsigned int i = 0; i < end; ++i) {
+      at(getIndex(mx, my));
+      mx += step_ax;
+      my += step_ay;
+      error_b += abs_db;
+      if ((unsigned int)error_b >= abs_da) {
+        mx += step_bx;
+        my += step_by;
+        error_b -= abs_da;
+      }
+    }
+    at(getIndex(mx, my));
+  }
+
   inline int sign(int x)
   {
     return x > 0 ? 1.0 : -1.0;
   }
 
+  // map coordinates to their column/row in toroidal storage
+  inline unsigned int wrapX(unsigned int mx) const
+  {
+    unsigned int sx = mx + wrap_x_;
+    return sx >= size_x_ ? sx - size_x_ : sx;
+  }
+
+  inline unsigned int wrapY(unsigned int my) const
+  {
+    unsigned int sy = my + wrap_y_;
+    return sy >= size_y_ ? sy - size_y_ : sy;
+  }
+
   mutex_t * access_;
 
 protected:
@@ -455,6 +606,11 @@ protected:
   unsigned char * costmap_;
   unsigned char default_value_;
 
+  // toroidal storage: the column and row of the char map holding map cell (0, 0)
+  bool toroidal_;
+  unsigned int wrap_x_;
+  unsigned int wrap_y_;
+
   // *INDENT-OFF* Uncrustify doesn't handle indented public/private labels
   class MarkCell
   {
@@ -40,14 +40,17 @@
 #define NAV2_COSTMAP_2D__COSTMAP_2D_PUBLISHER_HPP_
 
 #include <algorithm>
+#include <functional>
 #include <string>
 #include <memory>
 
 #include "rclcpp_lifecycle/lifecycle_node.hpp"
 #include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/dirty_region.hpp"
 #include "nav_msgs/msg/occupancy_grid.hpp"
 #include "map_msgs/msg/occupancy_grid_update.hpp"
 #include "nav2_msgs/msg/costmap.hpp"
+#include "nav2_msgs/msg/costmap_update.hpp"
 #include "nav2_msgs/srv/get_costmap.hpp"
 #include "tf2/transform_datatypes.h"
 #include "nav2_util/lifecycle_node.hpp"
@@ -84,22 +87,29 @@ public:
     costmap_pub_->on_activate();
     costmap_update_pub_->on_activate();
     costmap_raw_pub_->on_activate();
+    costmap_raw_update_pub_->on_activate();
   }
   void on_deactivate()
   {
     costmap_pub_->on_deactivate();
     costmap_update_pub_->on_deactivate();
     costmap_raw_pub_->on_deactivate();
+    costmap_raw_update_pub_->on_deactivate();
   }
   void on_cleanup() {}
 
-  /** @brief Include the given bounds in the changed-rectangle. */
+  /** @brief Include the given bounds in the changed region. */
   void updateBounds(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn)
   {
-    x0_ = std::min(x0, x0_);
-    xn_ = std::max(xn, xn_);
-    y0_ = std::min(y0, y0_);
-    yn_ = std::max(yn, yn_);
+    if (x0 < xn && y0 < yn) {
+      changed_cells_.add(x0, y0, xn, yn);
+    }
+  }
+
+  /** @brief Include every window of the given cells in the changed region. */
+  void updateBounds(const CellRegion & cells)
+  {
+    changed_cells_.add(cells);
   }
 
   /**
@@ -107,6 +117,32 @@ public:
    */
   void publishCostmap();
 
+  /**
+   * @brief Whether publishCostmap() has anything new to send. The topics are latched, so
+   *        a costmap that didn't change, move or get new raw update subscribers isn't sent again.
+   */
+  bool hasUpdates();
+
+  /**
+   * @brief Read from immutable costmap snapshots instead of locking the live costmap
+   * @param snapshot_source Returns the latest snapshot, or nullptr if none is available yet
+   */
+  void setSnapshotSource(std::function<std::shared_ptr<const Costmap2D>()> snapshot_source)
+  {
+    snapshot_source_ = snapshot_source;
+  }
+
+  /**
+   * @brief Configure the raw costmap update topic
+   * @param keyframe_period Updates between two keyframes, 0 to send keyframes only
+   * @param run_length_encoding Whether to run-length encode windows that get smaller from it
+   */
+  void setRawUpdateOptions(unsigned int keyframe_period, bool run_length_encoding)
+  {
+    raw_keyframe_period_ = keyframe_period;
+    raw_run_length_encoding_ = run_length_encoding;
+  }
+
   /**
    * @brief Check if the publisher is active
    * @return True if the frequency for the publisher is non-zero, false otherwise
@@ -120,6 +156,25 @@ private:
   /** @brief Prepare grid_ message for publication. */
   void prepareGrid();
   void prepareCostmap();
+  void prepareMetaData(const Costmap2D & costmap, nav2_msgs::msg::CostmapMetaData & metadata);
+
+  /** @brief Publish the changed windows, or the whole costmap when a keyframe is due */
+  void publishRawUpdate();
+
+  /** @brief Add the window [x0, xn) x [y0, yn) of the costmap to the update */
+  void addRawPatch(
+    const Costmap2D & costmap, unsigned int x0, unsigned int y0,
+    unsigned int xn, unsigned int yn, nav2_msgs::msg::CostmapUpdate & update);
+
+  /**
+   * @brief Get the costmap to read from for one publication
+   * @param snapshot Will hold the snapshot being read, if a snapshot source is set
+   * @param lock Will hold the live costmap's mutex, if no snapshot is available
+   * @return The costmap to read from, valid while snapshot and lock are held
+   */
+  const Costmap2D * acquireCostmap(
+    std::shared_ptr<const Costmap2D> & snapshot,
+    std::unique_lock<Costmap2D::mutex_t> & lock);
 
   /** @brief Publish the latest full costmap to the new subscriber. */
   // void onNewSubscription(const ros::SingleSubscriberPublisher& pub);
@@ -134,11 +189,13 @@ private:
   Costmap2D * costmap_;
   std::string global_frame_;
   std::string topic_name_;
-  unsigned int x0_, xn_, y0_, yn_;
+  // published as one partial update per rectangle
+  CellRegion changed_cells_;
   double saved_origin_x_;
   double saved_origin_y_;
   bool active_;
   bool always_send_full_costmap_;
+  std::function<std::shared_ptr<const Costmap2D>()> snapshot_source_;
 
   // Publisher for translated costmap values as msg::OccupancyGrid used in visualization
   rclcpp_lifecycle::LifecyclePublisher<nav_msgs::msg::OccupancyGrid>::SharedPtr costmap_pub_;
@@ -148,6 +205,19 @@ private:
   // Publisher for raw costmap values as msg::Costmap from layered costmap
   rclcpp_lifecycle::LifecyclePublisher<nav2_msgs::msg::Costmap>::SharedPtr costmap_raw_pub_;
 
+  // Publisher for the changes to the raw costmap, as msg::CostmapUpdate
+  rclcpp_lifecycle::LifecyclePublisher<nav2_msgs::msg::CostmapUpdate>::SharedPtr
+    costmap_raw_update_pub_;
+  unsigned int raw_keyframe_period_{10};
+  bool raw_run_length_encoding_{false};
+  uint64_t raw_update_sequence_{0};
+  unsigned int raw_updates_since_keyframe_{0};
+  size_t raw_update_subscribers_{0};
+  bool published_{false};
+  double published_origin_x_{0}, published_origin_y_{0};
+  unsigned int published_size_x_{0}, published_size_y_{0};
+  nav2_msgs::msg::CostmapMetaData raw_update_metadata_;
+
   // Service for getting the costmaps
   rclcpp::Service<nav2_msgs::srv::GetCostmap>::SharedPtr costmap_service_;
 
@@ -38,10 +38,13 @@
 #ifndef NAV2_COSTMAP_2D__COSTMAP_2D_ROS_HPP_
 #define NAV2_COSTMAP_2D__COSTMAP_2D_ROS_HPP_
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "diagnostic_msgs/msg/diagnostic_array.hpp"
 #include "geometry_msgs/msg/polygon.h"
 #include "geometry_msgs/msg/polygon_stamped.h"
 #include "nav2_costmap_2d/costmap_2d_publisher.hpp"
@@ -49,6 +52,7 @@
 #include "nav2_costmap_2d/clear_costmap_service.hpp"
 #include "nav2_costmap_2d/layered_costmap.hpp"
 #include "nav2_costmap_2d/layer.hpp"
+#include "nav2_costmap_2d/sensor_log.hpp"
 #include "nav2_util/lifecycle_node.hpp"
 #include "pluginlib/class_loader.hpp"
 #include "tf2/convert.h"
@@ -186,6 +190,19 @@ public:
     return layered_costmap_;
   }
 
+  /**
+   * @brief Return an immutable copy of the master costmap as of the last completed update.
+   *
+   * Only available when the "use_snapshots" parameter is set. The returned handle stays
+   * valid and consistent for as long as the caller holds it, without taking the costmap's
+   * mutex, so it is safe to read while the update thread is working on the next cycle.
+   * @return The latest snapshot, or nullptr if snapshots are disabled or no update has run yet
+   */
+  std::shared_ptr<const Costmap2D> getCostmapSnapshot() const
+  {
+    return std::atomic_load(&snapshot_);
+  }
+
   /** @brief Returns the current padded footprint as a geometry_msgs::msg::Polygon. */
   geometry_msgs::msg::Polygon getRobotFootprintPolygon()
   {
@@ -256,6 +273,8 @@ protected:
   rclcpp_lifecycle::LifecyclePublisher<geometry_msgs::msg::PolygonStamped>::SharedPtr
     footprint_pub_;
   Costmap2DPublisher * costmap_publisher_{nullptr};
+  rclcpp_lifecycle::LifecyclePublisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr
+    diagnostics_pub_;
 
   rclcpp::Subscription<geometry_msgs::msg::Polygon>::SharedPtr footprint_sub_;
   rclcpp::Subscription<rcl_interfaces::msg::ParameterEvent>::SharedPtr parameter_sub_;
@@ -268,35 +287,76 @@ protected:
   std::string name_;
   std::string parent_namespace_;
   void mapUpdateLoop(double frequency);
-  bool map_update_thread_shutdown_{false};
+
+  /**
+   * @brief Copy the master costmap into the back buffer and publish it as the latest snapshot
+   */
+  void updateSnapshot();
+
+  /**
+   * @brief Publish the statistics of the updates since the last call, one status for the
+   *        costmap and one for each layer
+   */
+  void publishDiagnostics();
+
+  /**
+   * @brief The snapshot file of the costmap, or of one of its layers
+   * @param layer_name The name of the layer, empty for the master costmap
+   */
+  std::string getSnapshotFileName(const std::string & layer_name) const;
+
+  /**
+   * @brief Restore the master costmap and the layers in snapshot_layers from the snapshots
+   *        found in the snapshot directory, warning about those that can't be restored
+   */
+  void loadSnapshots();
+
+  /**
+   * @brief Save the master costmap and the layers in snapshot_layers to the snapshot directory
+   */
+  void saveSnapshots();
+  std::atomic<bool> map_update_thread_shutdown_{false};
   bool stop_updates_{false};
   bool initialized_{false};
   bool stopped_{true};
   std::thread * map_update_thread_{nullptr};  ///< @brief A thread for updating the map
   rclcpp::Time last_publish_{0, 0, RCL_ROS_TIME};
   rclcpp::Duration publish_cycle_{1, 0};
+  std::chrono::steady_clock::time_point last_diagnostics_;
+  std::unique_ptr<SensorLogWriter> sensor_log_;  ///< @brief Null when not recording
   pluginlib::ClassLoader<Layer> plugin_loader_{"nav2_costmap_2d", "nav2_costmap_2d::Layer"};
 
   // Parameters
   void getParameters();
   bool always_send_full_costmap_{false};
+  double diagnostics_frequency_{0};  ///< Rate of the update statistics, 0 to not collect them
+  bool event_driven_updates_{false};  ///< Whether to update when layers receive data
   std::string footprint_;
   float footprint_padding_{0};
   std::string global_frame_;       ///< The global frame for the costmap
   int map_height_meters_{0};
   double map_publish_frequency_{0};
   double map_update_frequency_{0};
+  double min_update_period_{0.05};   ///< Minimum time between event driven updates
   int map_width_meters_{0};
   double origin_x_{0};
   double origin_y_{0};
   std::vector<std::string> plugin_names_;
   std::vector<std::string> plugin_types_;
+  int pyramid_levels_{0};          ///< Max-pooled levels kept over the costmap, 0 for none
+  int raw_updates_keyframe_period_{10};   ///< Raw costmap updates between two keyframes
+  bool raw_updates_run_length_encoding_{false};
   double resolution_{0};
   std::string robot_base_frame_;   ///< The frame_id of the robot base
   double robot_radius_;
   bool rolling_window_{false};     ///< Whether to use a rolling window version of the costmap
+  std::string sensor_log_path_;    ///< Where to record the updates for replay, empty for nowhere
+  std::string snapshot_directory_;  ///< Where to keep snapshots across restarts, empty for nowhere
+  std::vector<std::string> snapshot_layers_;  ///< The layers saved along with the costmap
   bool track_unknown_space_{false};
   double transform_tolerance_{0};  ///< The timeout before transform errors
+  int update_threads_{1};          ///< Threads running the bounds updates of the layers
+  bool use_snapshots_{false};      ///< Whether to publish immutable snapshots after each update
 
   // Derived parameters
   bool use_radius_{false};
@@ -304,6 +364,12 @@ protected:
   std::vector<geometry_msgs::msg::Point> padded_footprint_;
 
   std::unique_ptr<ClearCostmapService> clear_costmap_service_;
+
+  // Snapshots of the master costmap, double-buffered so that the copy made on
+  // each update can reuse the buffer no reader is holding anymore
+  std::shared_ptr<const Costmap2D> snapshot_;  ///< Latest snapshot, accessed atomically
+  std::shared_ptr<Costmap2D> front_snapshot_;  ///< Writer's handle on snapshot_
+  std::shared_ptr<Costmap2D> back_snapshot_;   ///< Buffer to write the next snapshot into
 };
 
 }  // namespace nav2_costmap_2d
@@ -38,6 +38,8 @@
 #ifndef NAV2_COSTMAP_2D__COSTMAP_LAYER_HPP_
 #define NAV2_COSTMAP_2D__COSTMAP_LAYER_HPP_
 
+#include <string>
+
 #include <rclcpp/rclcpp.hpp>
 #include <nav2_costmap_2d/layer.hpp>
 #include <nav2_costmap_2d/layered_costmap.hpp>
@@ -73,6 +75,19 @@ public:
    */
   void addExtraBounds(double mx0, double my0, double mx1, double my1);
 
+  /**
+   * @brief  Save the layer to a snapshot in the global frame
+   */
+  virtual bool saveSnapshot(const std::string & file_name, const std::string & name) const;
+
+  /**
+   * @brief  Restore the layer from a snapshot saved in the global frame, which the next
+   *         update draws in whole into the master grid
+   * @return False, leaving the layer unchanged and logging why, if the file isn't a snapshot
+   *         of that name and frame
+   */
+  virtual bool loadSnapshot(const std::string & file_name, const std::string & name);
+
 protected:
   /*
    * Updates the master_grid within the specified
@@ -154,6 +169,17 @@ protected:
   bool has_extra_bounds_;
 
 private:
+  typedef void (* RowKernel)(unsigned char *, const unsigned char *, unsigned int);
+
+  /*
+   * Applies a row kernel from merge_kernels.hpp to every row of the
+   * bounding box, splitting large boxes into row tiles on the
+   * LayeredCostmap's thread pool.
+   */
+  void updateWithKernel(
+    nav2_costmap_2d::Costmap2D & master_grid, int min_i, int min_j, int max_i,
+    int max_j, RowKernel kernel);
+
   double extra_min_x_, extra_max_x_, extra_min_y_, extra_max_y_;
 };
 
@@ -0,0 +1,176 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef NAV2_COSTMAP_2D__COSTMAP_PYRAMID_HPP_
+#define NAV2_COSTMAP_2D__COSTMAP_PYRAMID_HPP_
+
+#include <vector>
+
+#include "nav2_costmap_2d/costmap_2d.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class CostmapPyramid
+ * @brief Max-pooled copies of a costmap at 2, 4, 8... times its resolution, to tell quickly
+ *        whether a region or a line holds a cost
+ *
+ * Level l has a cell for each block of 2^l x 2^l cells of the costmap, holding their highest
+ * cost, and level 0 is the costmap itself. Queries start from the coarsest level and only
+ * descend into the blocks that may hold the cost they look for, so free space is skipped
+ * in large blocks and a hit returns as soon as a block entirely within the query holds it.
+ */
+class CostmapPyramid
+{
+public:
+  /**
+   * @brief  Constructor for a pyramid without any level above the costmap
+   * @param costmap The costmap pooled by the pyramid, which must outlive it
+   */
+  explicit CostmapPyramid(const Costmap2D & costmap);
+
+  /**
+   * @brief  Set the number of pooled levels and rebuild them
+   * @param levels The number of levels above the costmap, 0 for none
+   */
+  void setLevels(unsigned int levels);
+
+  /** @brief The number of pooled levels above the costmap */
+  unsigned int getLevels() const
+  {
+    return levels_.size();
+  }
+
+  /**
+   * @brief  Rebuild every level from the whole costmap, following its size if it changed
+   */
+  void update();
+
+  /**
+   * @brief  Update the levels over a window of the costmap whose costs changed
+   * @param x0 The starting x coordinate of the window
+   * @param y0 The starting y coordinate of the window
+   * @param xn The x coordinate one past the end of the window
+   * @param yn The y coordinate one past the end of the window
+   */
+  void update(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn);
+
+  /**
+   * @brief  Get the highest cost of a block of the costmap
+   * @param level The level, 0 for the costmap itself
+   * @param x The x coordinate of the block, in cells of the level
+   * @param y The y coordinate of the block, in cells of the level
+   * @return The highest cost of the 2^level x 2^level cells of the block
+   */
+  unsigned char getCost(unsigned int level, unsigned int x, unsigned int y) const;
+
+  /** @brief The x size of a level in cells */
+  unsigned int getSizeInCellsX(unsigned int level) const;
+
+  /** @brief The y size of a level in cells */
+  unsigned int getSizeInCellsY(unsigned int level) const;
+
+  /**
+   * @brief  Get the highest cost of a window of the costmap
+   * @param x0 The starting x coordinate of the window
+   * @param y0 The starting y coordinate of the window
+   * @param xn The x coordinate one past the end of the window
+   * @param yn The y coordinate one past the end of the window
+   * @return The highest cost, 0 for an empty window
+   */
+  unsigned char getMaxCost(
+    unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn) const;
+
+  /**
+   * @brief  Check whether a cell of a window of the costmap has at least a cost
+   * @param x0 The starting x coordinate of the window
+   * @param y0 The starting y coordinate of the window
+   * @param xn The x coordinate one past the end of the window
+   * @param yn The y coordinate one past the end of the window
+   * @param cost The cost, LETHAL_OBSTACLE to look for obstacles
+   * @return True if a cell has the cost or a higher one
+   */
+  bool hasCostInRegion(
+    unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+    unsigned char cost) const;
+
+  /**
+   * @brief  Check whether a cell of a line has at least a cost, for the cells that
+   *         Costmap2D::raytraceLine() visits between the two end points, which must be
+   *         within the costmap
+   * @param x0 The x coordinate of the start of the line
+   * @param y0 The y coordinate of the start of the line
+   * @param x1 The x coordinate of the end of the line
+   * @param y1 The y coordinate of the end of the line
+   * @param cost The cost, LETHAL_OBSTACLE to look for obstacles
+   * @return True if a cell has the cost or a higher one
+   */
+  bool hasCostOnLine(
+    unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+    unsigned char cost) const;
+
+private:
+  struct Level
+  {
+    unsigned int size_x, size_y;
+    std::vector<unsigned char> cells;
+  };
+
+  /** @brief The cells of a line, in the order raytraceLine() visits them */
+  struct Line
+  {
+    unsigned int a0, b0;  ///< @brief Start along the major and the minor axis
+    int step_a, step_b;
+    unsigned int abs_da, abs_db;
+    bool x_major;
+
+    void getCell(unsigned int i, unsigned int & x, unsigned int & y) const;
+  };
+
+  /**
+   * @brief  Recompute a window of a level from the level below
+   */
+  void updateLevel(
+    unsigned int level, unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn);
+
+  /**
+   * @brief  Whether a block or its children within the window hold the cost
+   */
+  bool searchBlock(
+    unsigned int level, unsigned int bx, unsigned int by,
+    unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+    unsigned char cost) const;
+
+  /**
+   * @brief  Raise max_cost to the highest cost of a block within the window, if higher
+   */
+  void maxBlock(
+    unsigned int level, unsigned int bx, unsigned int by,
+    unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+    unsigned char & max_cost) const;
+
+  /**
+   * @brief  Whether the cells [i0, i1) of a line hold the cost
+   */
+  bool searchLine(const Line & line, unsigned int i0, unsigned int i1, unsigned char cost) const;
+
+  const Costmap2D & costmap_;
+  std::vector<Level> levels_;  ///< @brief Level l is levels_[l - 1]
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__COSTMAP_PYRAMID_HPP_
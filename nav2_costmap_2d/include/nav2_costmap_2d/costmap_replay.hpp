@@ -0,0 +1,99 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef NAV2_COSTMAP_2D__COSTMAP_REPLAY_HPP_
+#define NAV2_COSTMAP_2D__COSTMAP_REPLAY_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "pluginlib/class_loader.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "tf2_ros/buffer.h"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/layer.hpp"
+#include "nav2_costmap_2d/layered_costmap.hpp"
+#include "nav2_costmap_2d/sensor_log.hpp"
+#include "nav2_util/lifecycle_node.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class CostmapReplay
+ * @brief Replays a sensor log through a LayeredCostmap with the plugins it was recorded
+ *        with, to benchmark the updates and check that they give the same costs
+ *
+ * The plugins get a node with the recorded parameters, except for the observation sources
+ * of the layers which are emptied, so that the layers only see the replayed observations.
+ * The clock of the node is set to the recorded time of each update, and nothing is spun.
+ * Layers fed by other topics, such as the map of a static layer, get no data.
+ */
+class CostmapReplay
+{
+public:
+  /**
+   * @brief  The outcome of one replayed update
+   */
+  struct Result
+  {
+    int64_t stamp;  ///< @brief The recorded time of the update, in nanoseconds
+    uint64_t update_time;  ///< @brief The time updateMap() took, in nanoseconds
+    uint64_t checksum;  ///< @brief The checksum of the master grid after the update
+  };
+
+  /**
+   * @brief  Opens a sensor log and creates the costmap it was recorded from, throwing
+   *         std::runtime_error if the log can't be read. rclcpp must be initialized.
+   * @param path The path of the log
+   * @param update_threads The number of update threads, 0 for the recorded number
+   */
+  explicit CostmapReplay(const std::string & path, int update_threads = 0);
+
+  ~CostmapReplay();
+
+  /**
+   * @brief  Replay the next update of the log
+   * @param result Set to the outcome of the update
+   * @return False at the end of the log
+   */
+  bool replayCycle(Result & result);
+
+  LayeredCostmap * getLayeredCostmap()
+  {
+    return layered_costmap_.get();
+  }
+
+private:
+  /** @brief Set the time of the clock of the node, in nanoseconds */
+  void setTime(int64_t stamp);
+
+  SensorLogReader reader_;
+  nav2_util::LifecycleNode::SharedPtr node_;
+  rclcpp::Node::SharedPtr client_node_;
+  std::shared_ptr<tf2_ros::Buffer> tf_buffer_;
+  pluginlib::ClassLoader<Layer> plugin_loader_{"nav2_costmap_2d", "nav2_costmap_2d::Layer"};
+  std::unique_ptr<LayeredCostmap> layered_costmap_;
+};
+
+/**
+ * @brief  A 64-bit FNV-1a hash of the size and the costs of a costmap, in map order
+ */
+uint64_t getCostmapChecksum(const Costmap2D & costmap);
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__COSTMAP_REPLAY_HPP_
@@ -0,0 +1,117 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef NAV2_COSTMAP_2D__COSTMAP_SNAPSHOT_HPP_
+#define NAV2_COSTMAP_2D__COSTMAP_SNAPSHOT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "nav2_costmap_2d/costmap_2d.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @brief The header at the start of a costmap snapshot file
+ *
+ * Planes of size_x * size_y cells follow header_size bytes from the start of the file, in
+ * map order, row after row. The first plane holds the costs. The header is written in the
+ * byte order of the host.
+ */
+struct CostmapSnapshotHeader
+{
+  static constexpr uint32_t VERSION = 2;
+  static constexpr size_t NAME_SIZE = 40;
+  static constexpr size_t FRAME_SIZE = 32;
+
+  char magic[8];  ///< @brief "NAV2CMAP"
+  uint32_t version;
+  uint32_t header_size;  ///< @brief The offset of the first plane
+  uint32_t size_x, size_y;
+  double resolution;
+  double origin_x, origin_y;
+  uint32_t num_planes;
+  uint32_t reserved;
+  char name[NAME_SIZE];  ///< @brief The name of the costmap or layer, nul terminated
+  char frame[FRAME_SIZE];  ///< @brief The frame of the costs, nul terminated, empty if unknown
+};
+
+static_assert(
+  sizeof(CostmapSnapshotHeader) == 128 && offsetof(CostmapSnapshotHeader, resolution) == 24,
+  "The costmap snapshot header must not be padded");
+
+/**
+ * @class CostmapSnapshot
+ * @brief A costmap snapshot file mapped into memory, read only
+ */
+class CostmapSnapshot
+{
+public:
+  /**
+   * @brief  Maps a snapshot, throwing std::runtime_error if the file can't be read or isn't
+   *         a snapshot of a version this can read
+   * @param file_name The name of the snapshot file
+   */
+  explicit CostmapSnapshot(const std::string & file_name);
+
+  ~CostmapSnapshot();
+
+  CostmapSnapshot(const CostmapSnapshot &) = delete;
+  CostmapSnapshot & operator=(const CostmapSnapshot &) = delete;
+
+  const CostmapSnapshotHeader & getHeader() const
+  {
+    return *static_cast<const CostmapSnapshotHeader *>(data_);
+  }
+
+  /**
+   * @brief  The name stored in the snapshot
+   */
+  std::string getName() const;
+
+  /**
+   * @brief  The frame of the costs stored in the snapshot, empty if unknown
+   */
+  std::string getFrame() const;
+
+  /**
+   * @brief  The cells of a plane, size_x * size_y of them in map order
+   * @param plane The plane, 0 for the costs
+   */
+  const unsigned char * getPlane(unsigned int plane) const;
+
+  /**
+   * @brief  Writes a snapshot of the costs of a costmap, throwing std::runtime_error on failure.
+   *         The snapshot is written next to the file and renamed over it, so an interrupted
+   *         write leaves the previous snapshot whole.
+   * @param file_name The name of the snapshot file
+   * @param costmap The costmap, which the caller keeps locked
+   * @param name The name to store, shorter than CostmapSnapshotHeader::NAME_SIZE
+   * @param frame The frame to store, shorter than CostmapSnapshotHeader::FRAME_SIZE
+   */
+  static void write(
+    const std::string & file_name, const Costmap2D & costmap,
+    const std::string & name, const std::string & frame);
+
+private:
+  void * data_;
+  size_t size_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__COSTMAP_SNAPSHOT_HPP_
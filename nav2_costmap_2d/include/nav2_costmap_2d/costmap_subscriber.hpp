@@ -15,17 +15,34 @@
 #ifndef NAV2_COSTMAP_2D__COSTMAP_SUBSCRIBER_HPP_
 #define NAV2_COSTMAP_2D__COSTMAP_SUBSCRIBER_HPP_
 
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "rclcpp/rclcpp.hpp"
 #include "nav2_costmap_2d/costmap_2d.hpp"
 #include "nav2_msgs/msg/costmap.hpp"
+#include "nav2_msgs/msg/costmap_update.hpp"
 #include "nav2_util/lifecycle_node.hpp"
 
 namespace nav2_costmap_2d
 {
 
+/**
+ * @class CostmapSubscriber
+ * @brief Keeps a copy of a remote costmap from its raw update topic
+ *
+ * The costmap is published by Costmap2DPublisher as a stream of changed windows
+ * with periodic keyframes, on topic_name + "_updates". Updates are applied as they
+ * arrive. After a lost update the costmap is kept as it was until the next keyframe.
+ *
+ * Until the first update is applied, the whole costmaps published on topic_name are
+ * applied as keyframes too, so sources without the update stream (bags, older
+ * publishers) still work. That subscription is dropped once the update stream works,
+ * so the publisher doesn't keep sending whole costmaps.
+ */
 class CostmapSubscriber
 {
 public:
@@ -45,7 +62,36 @@ public:
 
   ~CostmapSubscriber() {}
 
-  std::shared_ptr<Costmap2D> getCostmap();
+  /**
+   * @brief  The costmap as of the last applied update
+   *
+   * Updates are applied in place to a private grid when they arrive. The costmap handed
+   * out is a copy of that grid, made when it is first asked for after an update, so at
+   * most once per version. Every caller shares it and it is never modified once handed
+   * out, so it stays valid and unchanged while newer updates arrive. The copy reuses
+   * the memory of the previous one when nobody holds that anymore.
+   * @throws std::runtime_error if no costmap was received yet
+   */
+  std::shared_ptr<const Costmap2D> getCostmap();
+
+  /**
+   * @brief  Same as getCostmap(), also returning the version of the costmap
+   * @param version Set to the version matching the returned costmap
+   */
+  std::shared_ptr<const Costmap2D> getCostmap(uint64_t & version);
+
+  /**
+   * @brief  The version of the costmap, counting applied updates from 1. Zero until one arrives.
+   */
+  uint64_t getVersion();
+
+  /**
+   * @brief  Whether an update was applied after the given version
+   */
+  bool hasChangedSince(uint64_t version)
+  {
+    return getVersion() != version;
+  }
 
 protected:
   // Interfaces used for logging and creating publishers and subscribers
@@ -53,14 +99,42 @@ protected:
   rclcpp::node_interfaces::NodeTopicsInterface::SharedPtr node_topics_;
   rclcpp::node_interfaces::NodeLoggingInterface::SharedPtr node_logging_;
 
-  void toCostmap2D();
+  void costmapUpdateCallback(const nav2_msgs::msg::CostmapUpdate::SharedPtr update);
+
+  /**
+   * @brief  Apply a whole costmap as a keyframe, for sources without the update stream
+   */
   void costmapCallback(const nav2_msgs::msg::Costmap::SharedPtr msg);
 
+  /**
+   * @brief  Whether the private grid has the geometry of the metadata
+   */
+  bool matchesGrid(const nav2_msgs::msg::CostmapMetaData & metadata) const;
+
+  /**
+   * @brief  Check that every patch fits the costmap and decode the run-length encoded ones
+   * @param decoded Set to the decoded data of each patch, empty for raw ones
+   * @return False if a patch is malformed
+   */
+  bool decodePatches(
+    const nav2_msgs::msg::CostmapUpdate & update,
+    std::vector<std::vector<uint8_t>> & decoded) const;
+
+  // guards the grid and the copies of it, never held while decoding
+  std::mutex costmap_mutex_;
+  // patched in place by the callbacks
+  std::unique_ptr<Costmap2D> grid_;
+  uint64_t version_{0};
+  // the copy of the grid last handed out, and its version
   std::shared_ptr<Costmap2D> costmap_;
-  nav2_msgs::msg::Costmap::SharedPtr costmap_msg_;
+  uint64_t costmap_version_{0};
+  // only used by the callback
+  uint64_t sequence_{0};
+  bool synchronized_{false};
   std::string topic_name_;
-  bool costmap_received_{false};
-  rclcpp::Subscription<nav2_msgs::msg::Costmap>::SharedPtr costmap_sub_;
+  rclcpp::Subscription<nav2_msgs::msg::CostmapUpdate>::SharedPtr costmap_sub_;
+  // null once the update stream works
+  rclcpp::Subscription<nav2_msgs::msg::Costmap>::SharedPtr full_costmap_sub_;
 };
 
 }  // namespace nav2_costmap_2d
@@ -0,0 +1,176 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__DECAYING_VOXEL_GRID_HPP_
+#define NAV2_COSTMAP_2D__DECAYING_VOXEL_GRID_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry_msgs/msg/point.hpp"
+#include "geometry_msgs/msg/quaternion.hpp"
+#include "nav2_voxel_grid/hashed_columns.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class Frustum
+ * @brief The volume a sensor sees, as a range and horizontal and vertical fields of view
+ *        around the x axis of the sensor frame
+ */
+class Frustum
+{
+public:
+  /**
+   * @brief  Constructor for a frustum
+   * @param origin The position of the sensor
+   * @param orientation The orientation of the sensor, looking along its x axis
+   * @param horizontal_fov The horizontal field of view in radians, 2 pi or more for all around
+   * @param vertical_fov The vertical field of view in radians, pi or more for all heights
+   * @param range How far the sensor sees
+   */
+  Frustum(
+    const geometry_msgs::msg::Point & origin, const geometry_msgs::msg::Quaternion & orientation,
+    double horizontal_fov, double vertical_fov, double range);
+
+  /** @brief Whether a point is in the frustum */
+  bool contains(double x, double y, double z) const;
+
+private:
+  double ox_, oy_, oz_;
+  double rotation_[3][3];  ///< @brief From the sensor frame to the global frame
+  double horizontal_fov_, vertical_fov_;
+  double sq_tan_horizontal_, sq_tan_vertical_;
+  double sq_range_;
+};
+
+/**
+ * @class DecayingVoxelGrid
+ * @brief Sparse voxels that each expire at some time, counted per column
+ *
+ * Only voxels that were marked are stored, hashed by their integer coordinates with
+ * nav2_voxel_grid::VoxelKey like nav2_voxel_grid::SparseVoxelGrid, so there is no bound on
+ * the height of the grid or on how far it extends. The columns are counted in the same
+ * nav2_voxel_grid::ColumnCounts, so those whose count changed are remembered until they are
+ * taken with takeChangedColumns() and a 2D projection of the grid can be kept up to date
+ * without going over every column.
+ */
+class DecayingVoxelGrid
+{
+public:
+  /** @brief The x, y and z coordinates are limited to this many bits, x and y being signed */
+  static const unsigned int XY_BITS = nav2_voxel_grid::VoxelKey::XY_BITS;
+  static const unsigned int Z_BITS = nav2_voxel_grid::VoxelKey::Z_BITS;
+
+  /** @brief A column with voxels */
+  struct Column
+  {
+    int x, y;
+    unsigned int count;
+  };
+
+  /**
+   * @brief  Mark a voxel, keeping its expiry time if that is later
+   * @param x, y, z The coordinates of the voxel, with z below 2^Z_BITS
+   * @param expiry The time at which the voxel expires
+   */
+  void mark(int x, int y, unsigned int z, double expiry)
+  {
+    auto inserted = voxels_.insert({nav2_voxel_grid::VoxelKey::key(x, y, z), expiry});
+    if (inserted.second) {
+      ++columns_.change(inserted.first->first >> Z_BITS);
+    } else if (inserted.first->second < expiry) {
+      inserted.first->second = expiry;
+    }
+  }
+
+  /**
+   * @brief  Bring forward the expiry time of the voxels passing a test
+   * @param test Called with the x, y and z coordinates of each voxel
+   * @param expiry The time by which the voxels passing the test expire
+   */
+  template<class Test>
+  void decay(Test test, double expiry)
+  {
+    for (auto & voxel : voxels_) {
+      if (voxel.second > expiry) {
+        int x, y;
+        unsigned int z;
+        nav2_voxel_grid::VoxelKey::coordinates(voxel.first, x, y, z);
+        if (test(x, y, z)) {
+          voxel.second = expiry;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief  Remove the voxels passing a test
+   * @param test Called with the x, y and z coordinates of each voxel
+   */
+  template<class Test>
+  void remove(Test test)
+  {
+    for (auto it = voxels_.begin(); it != voxels_.end(); ) {
+      int x, y;
+      unsigned int z;
+      nav2_voxel_grid::VoxelKey::coordinates(it->first, x, y, z);
+      if (test(x, y, z)) {
+        it = erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  /** @brief Remove the voxels that expired by a given time */
+  void removeExpired(double now);
+
+  /** @brief Remove every voxel */
+  void clear();
+
+  /** @brief The number of voxels of a column */
+  unsigned int getCount(int x, int y) const;
+
+  /** @brief Number of voxels */
+  size_t size() const
+  {
+    return voxels_.size();
+  }
+
+  /**
+   * @brief  Get the columns whose count changed since the last call, and forget them
+   * @param columns Set to the columns, with a count of 0 for those that are now empty
+   */
+  void takeChangedColumns(std::vector<Column> & columns);
+
+  /** @brief Get every column with voxels */
+  void getColumns(std::vector<Column> & columns) const;
+
+private:
+  typedef std::unordered_map<uint64_t, double> VoxelMap;
+
+  /** @brief Erase a voxel, updating the count of its column */
+  VoxelMap::iterator erase(VoxelMap::iterator voxel);
+
+  VoxelMap voxels_;  ///< @brief The expiry time of each voxel
+  nav2_voxel_grid::ColumnCounts<unsigned int> columns_;  ///< @brief Voxels per non empty column
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__DECAYING_VOXEL_GRID_HPP_
@@ -0,0 +1,99 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__DECAYING_VOXEL_LAYER_HPP_
+#define NAV2_COSTMAP_2D__DECAYING_VOXEL_LAYER_HPP_
+
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "nav2_costmap_2d/decaying_voxel_grid.hpp"
+#include "nav2_costmap_2d/obstacle_layer.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class DecayingVoxelLayer
+ * @brief A voxel layer whose voxels expire some time after they were last seen
+ *
+ * Instead of raytracing to every point of the clearing observations, the voxels in the
+ * field of view of a clearing sensor only have their expiry brought forward, which takes
+ * one cheap test per voxel rather than one ray per point. Points seen again keep their
+ * voxels alive. Voxels hidden behind an obstacle but in the field of view decay too, as
+ * the sensor can't tell them apart from voxels that are gone.
+ */
+class DecayingVoxelLayer : public ObstacleLayer
+{
+public:
+  DecayingVoxelLayer()
+  {
+    costmap_ = NULL;  // this is the unsigned char* member of parent class's parent class Costmap2D
+  }
+
+  virtual ~DecayingVoxelLayer();
+
+  virtual void onInitialize();
+  virtual void updateRegion(
+    double robot_x, double robot_y, double robot_yaw, WorldRegion & region);
+
+  bool isDiscretized()
+  {
+    return true;
+  }
+  virtual void matchSize();
+  virtual void reset();
+  virtual void clearArea(int start_x, int start_y, int end_x, int end_y);
+
+protected:
+  // voxels are only marked from clouds
+  virtual bool supportsPlanarScans() const {return false;}
+
+private:
+  /**
+   * @brief  Bring forward the expiry of the voxels in the field of view of an observation
+   * @param clearing_observation The observation, with the pose and fields of view of its sensor
+   */
+  void decayFrustum(const Observation & clearing_observation);
+
+  /**
+   * @brief  Mark the voxels of the points of an observation
+   * @param marking_observation The observation
+   */
+  void markVoxels(const Observation & marking_observation);
+
+  /**
+   * @brief  Update the cells of the columns whose count of voxels changed
+   * @param min_x, min_y, max_x, max_y Expanded to the cells updated
+   */
+  void projectColumns(double * min_x, double * min_y, double * max_x, double * max_y);
+
+  /** @brief The offset in cells from the voxel lattice to the costmap */
+  void getCellOffset(int & offset_x, int & offset_y) const;
+
+  DecayingVoxelGrid voxel_grid_;
+  double voxel_decay_;  ///< @brief Seconds a voxel lasts after it was last seen
+  double frustum_decay_;  ///< @brief Seconds a voxel lasts once in the field of view of a sensor
+  double z_resolution_, origin_z_;
+  int size_z_, mark_threshold_;
+  /// @brief World coordinates of the corner of voxel (0, 0), the origin of the map when sized
+  double lattice_x_, lattice_y_;
+  /// @brief The cell offset of the map the last time the columns were projected
+  int projected_offset_x_, projected_offset_y_;
+  std::vector<DecayingVoxelGrid::Column> columns_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__DECAYING_VOXEL_LAYER_HPP_
@@ -0,0 +1,195 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__DIRTY_REGION_HPP_
+#define NAV2_COSTMAP_2D__DIRTY_REGION_HPP_
+
+#include <algorithm>
+#include <vector>
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @struct Rectangle
+ * @brief An axis-aligned box from (min_x, min_y) to (max_x, max_y)
+ *
+ * Boxes are compared as closed intervals, so a single touched point is a valid box
+ * and boxes that share an edge count as overlapping.
+ */
+template<typename T>
+struct Rectangle
+{
+  T min_x, min_y, max_x, max_y;
+
+  bool empty() const
+  {
+    return min_x > max_x || min_y > max_y;
+  }
+
+  double area() const
+  {
+    return empty() ? 0.0 :
+           static_cast<double>(max_x - min_x) * static_cast<double>(max_y - min_y);
+  }
+
+  bool overlaps(const Rectangle & other) const
+  {
+    return min_x <= other.max_x && other.min_x <= max_x &&
+           min_y <= other.max_y && other.min_y <= max_y;
+  }
+
+  Rectangle merged(const Rectangle & other) const
+  {
+    return Rectangle{
+      std::min(min_x, other.min_x), std::min(min_y, other.min_y),
+      std::max(max_x, other.max_x), std::max(max_y, other.max_y)};
+  }
+};
+
+/**
+ * @class DirtyRegion
+ * @brief A small set of disjoint rectangles covering the parts of a costmap that changed
+ *
+ * Rectangles that overlap are merged as they are added. Past the maximum count,
+ * the two rectangles whose merge adds the least area are merged, so the set always
+ * covers everything that was added, possibly with some extra.
+ */
+template<typename T>
+class DirtyRegion
+{
+public:
+  typedef Rectangle<T> Rect;
+
+  explicit DirtyRegion(size_t max_rects = 8)
+  : max_rects_(std::max<size_t>(max_rects, 1)) {}
+
+  /** @brief Include a rectangle in the region, empty ones are ignored */
+  void add(const Rect & rect)
+  {
+    if (rect.empty()) {
+      return;
+    }
+
+    // absorb everything the new rectangle overlaps, and again
+    // for whatever the grown rectangle overlaps in turn
+    Rect grown = rect;
+    bool merged = true;
+    while (merged) {
+      merged = false;
+      for (size_t i = 0; i < rects_.size(); ++i) {
+        if (grown.overlaps(rects_[i])) {
+          grown = grown.merged(rects_[i]);
+          rects_[i] = rects_.back();
+          rects_.pop_back();
+          merged = true;
+          break;
+        }
+      }
+    }
+    rects_.push_back(grown);
+
+    if (rects_.size() > max_rects_) {
+      mergeCheapestPair();
+    }
+  }
+
+  void add(T min_x, T min_y, T max_x, T max_y)
+  {
+    add(Rect{min_x, min_y, max_x, max_y});
+  }
+
+  /** @brief Include every rectangle of another region */
+  void add(const DirtyRegion & other)
+  {
+    for (const Rect & rect : other.rects_) {
+      add(rect);
+    }
+  }
+
+  void clear()
+  {
+    rects_.clear();
+  }
+
+  bool empty() const
+  {
+    return rects_.empty();
+  }
+
+  const std::vector<Rect> & getRectangles() const
+  {
+    return rects_;
+  }
+
+  /**
+   * @brief  The box around every rectangle of the region
+   * @return False, leaving the arguments unchanged, if the region is empty
+   */
+  bool getBounds(T & min_x, T & min_y, T & max_x, T & max_y) const
+  {
+    if (rects_.empty()) {
+      return false;
+    }
+    Rect bounds = rects_.front();
+    for (const Rect & rect : rects_) {
+      bounds = bounds.merged(rect);
+    }
+    min_x = bounds.min_x;
+    min_y = bounds.min_y;
+    max_x = bounds.max_x;
+    max_y = bounds.max_y;
+    return true;
+  }
+
+private:
+  void mergeCheapestPair()
+  {
+    size_t best_i = 0, best_j = 1;
+    double best_cost = -1.0;
+    for (size_t i = 0; i < rects_.size(); ++i) {
+      for (size_t j = i + 1; j < rects_.size(); ++j) {
+        double cost = rects_[i].merged(rects_[j]).area() - rects_[i].area() - rects_[j].area();
+        if (best_cost < 0.0 || cost < best_cost) {
+          best_cost = cost;
+          best_i = i;
+          best_j = j;
+        }
+      }
+    }
+    Rect merged = rects_[best_i].merged(rects_[best_j]);
+    rects_[best_j] = rects_.back();
+    rects_.pop_back();
+    rects_[best_i] = rects_.back();
+    rects_.pop_back();
+    // the merged box may now overlap others
+    add(merged);
+  }
+
+  size_t max_rects_;
+  std::vector<Rect> rects_;
+};
+
+/** @brief Changed areas in world coordinates, as reported by the layers */
+typedef DirtyRegion<double> WorldRegion;
+
+/**
+ * @brief Changed areas in map cells, max_x and max_y are one past the last cell.
+ *        Windows with no cells must not be added.
+ */
+typedef DirtyRegion<unsigned int> CellRegion;
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__DIRTY_REGION_HPP_
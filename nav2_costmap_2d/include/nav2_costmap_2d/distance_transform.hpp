@@ -0,0 +1,81 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__DISTANCE_TRANSFORM_HPP_
+#define NAV2_COSTMAP_2D__DISTANCE_TRANSFORM_HPP_
+
+#include <vector>
+
+#include "nav2_costmap_2d/thread_pool.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class DistanceTransform
+ * @brief Exact squared Euclidean distance from every cell of a window to its nearest
+ *        LETHAL_OBSTACLE cell, in time linear in the number of cells
+ *
+ * The transform is separable (Meijster et al.): a pass down each column finds the
+ * vertical distance to the nearest obstacle, run across whole rows at once so it
+ * vectorizes, then the lower envelope of parabolas along each row combines the columns.
+ * Both passes split the window between the threads of a pool. The time taken depends
+ * neither on the number of obstacles nor on the maximum distance.
+ */
+class DistanceTransform
+{
+public:
+  DistanceTransform();
+
+  /**
+   * @brief  Compute the distances of a window, only obstacles inside it are considered
+   * @param grid A row-major grid size_x cells wide
+   * @param x0, y0 The first cell of the window
+   * @param xn, yn One past the last cell of the window
+   * @param max_distance Distances beyond this many cells aren't needed, which keeps the
+   *        stored distances in 32 bits. Cells further than that from every obstacle get a
+   *        squared distance larger than max_distance * max_distance.
+   * @param pool The thread pool to split the passes on, may be null
+   */
+  void compute(
+    const unsigned char * grid, unsigned int size_x,
+    unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+    unsigned int max_distance, ThreadPool * pool);
+
+  /** @brief The squared distance of a cell of the last window, in map coordinates */
+  unsigned int getSquaredDistance(unsigned int mx, unsigned int my) const
+  {
+    return squared_[(my - y0_) * width_ + (mx - x0_)];
+  }
+
+private:
+  /** @brief Vertical distances of columns [c0, cn) of the window, capped at cap_ */
+  void columnPass(
+    const unsigned char * grid, unsigned int size_x, unsigned int c0, unsigned int cn);
+
+  /** @brief Squared distances of rows [r0, rn) of the window from the vertical ones */
+  void rowPass(unsigned int r0, unsigned int rn);
+
+  unsigned int x0_, y0_;
+  unsigned int width_, height_;
+  unsigned int cap_;
+
+  // per cell of the window, reused across calls
+  std::vector<unsigned int> vertical_;
+  std::vector<unsigned int> squared_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__DISTANCE_TRANSFORM_HPP_
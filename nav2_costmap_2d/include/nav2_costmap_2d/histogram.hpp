@@ -0,0 +1,88 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef NAV2_COSTMAP_2D__HISTOGRAM_HPP_
+#define NAV2_COSTMAP_2D__HISTOGRAM_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class Histogram
+ * @brief A histogram of integer samples that threads record into without locking
+ *
+ * Samples fall into buckets four per power of two, so the percentiles are within 25% of
+ * the samples. Recording only takes relaxed atomic increments, so a summary taken while
+ * samples are being recorded may miss the ones in flight.
+ */
+class Histogram
+{
+public:
+  /**
+   * @brief  The summary of the samples of a histogram
+   */
+  struct Summary
+  {
+    uint64_t count;
+    double mean;
+    uint64_t p50, p90, p99;  ///< @brief Upper bounds of the buckets of the percentiles
+    uint64_t max;
+  };
+
+  Histogram();
+
+  Histogram(const Histogram &) = delete;
+  Histogram & operator=(const Histogram &) = delete;
+
+  /**
+   * @brief  Record a sample, safe to call from any thread
+   */
+  void record(uint64_t value);
+
+  /**
+   * @brief  Summarize the samples recorded so far
+   */
+  Summary summarize() const;
+
+  /**
+   * @brief  Summarize the samples recorded so far and remove them, so that the next summary
+   *         only covers the samples recorded from now on
+   */
+  Summary summarizeAndReset();
+
+  /** @brief The bucket of a value */
+  static unsigned int getBucket(uint64_t value);
+
+  /** @brief The highest value of a bucket */
+  static uint64_t getBucketMax(unsigned int bucket);
+
+  static const unsigned int num_buckets = 252;
+
+private:
+  static Summary summarizeCounts(
+    const std::array<uint64_t, num_buckets> & counts, uint64_t sum, uint64_t max);
+
+  std::array<std::atomic<uint64_t>, num_buckets> buckets_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__HISTOGRAM_HPP_
@@ -38,12 +38,13 @@
 #ifndef NAV2_COSTMAP_2D__INFLATION_LAYER_HPP_
 #define NAV2_COSTMAP_2D__INFLATION_LAYER_HPP_
 
-#include <map>
 #include <vector>
 
 #include "rclcpp/rclcpp.hpp"
 #include "nav2_costmap_2d/layer.hpp"
+#include "nav2_costmap_2d/distance_transform.hpp"
 #include "nav2_costmap_2d/layered_costmap.hpp"
+#include "nav2_costmap_2d/nearest_obstacle_field.hpp"
 
 namespace nav2_costmap_2d
 {
@@ -77,10 +78,7 @@ class InflationLayer : public Layer
 public:
   InflationLayer();
 
-  virtual ~InflationLayer()
-  {
-    deleteKernels();
-  }
+  virtual ~InflationLayer() {}
 
   virtual void onInitialize();
   virtual void updateBounds(
@@ -88,6 +86,8 @@ public:
     double * min_y,
     double * max_x,
     double * max_y);
+  virtual void updateRegion(
+    double robot_x, double robot_y, double robot_yaw, WorldRegion & region);
   virtual void updateCosts(
     nav2_costmap_2d::Costmap2D & master_grid,
     int min_i, int min_j, int max_i, int max_j);
@@ -137,7 +137,7 @@ private:
   {
     unsigned int dx = abs(mx - src_x);
     unsigned int dy = abs(my - src_y);
-    return cached_distances_[dx][dy];
+    return cached_distances_[dx * cache_length_ + dy];
   }
 
   /**
@@ -152,11 +152,48 @@ private:
   {
     unsigned int dx = abs(mx - src_x);
     unsigned int dy = abs(my - src_y);
-    return cached_costs_[dx][dy];
+    return cached_costs_[dx * cache_length_ + dy];
+  }
+
+  /**
+   * @brief  Lookup the distance level of a cell, the bucket of inflation_cells_ it goes into
+   * @param mx The x coordinate of the current cell
+   * @param my The y coordinate of the current cell
+   * @param src_x The x coordinate of the source cell
+   * @param src_y The y coordinate of the source cell
+   * @return The level, inflation_cells_.size() if the cell is beyond the inflation radius
+   */
+  inline unsigned int levelLookup(int mx, int my, int src_x, int src_y)
+  {
+    unsigned int dx = abs(mx - src_x);
+    unsigned int dy = abs(my - src_y);
+    return cached_levels_[dx * cache_length_ + dy];
   }
 
   void computeCaches();
-  void deleteKernels();
+
+  /**
+   * @brief  Set the costs of a window from the nearest obstacle field, bringing the field
+   *         up to date with the obstacles of this cycle first
+   *
+   * The windows of the cycle are taken from LayeredCostmap::getUpdatedCells(), so that the
+   * field catches up with all of them at the first one. A window that isn't one of them,
+   * as when updateCosts() is called outside of LayeredCostmap::updateMap(), only syncs the
+   * field within itself. Every move of a rolling window rebuilds the field from the whole
+   * grid, which costs more than a wavefront pass, so this is meant for static costmaps.
+   */
+  void updateCostsIncremental(
+    nav2_costmap_2d::Costmap2D & master_grid,
+    int min_i, int min_j, int max_i, int max_j);
+
+  /**
+   * @brief  Set the costs of a window from an exact distance transform of the window
+   *         grown by the inflation radius
+   */
+  void updateCostsDistanceTransform(
+    nav2_costmap_2d::Costmap2D & master_grid,
+    int min_i, int min_j, int max_i, int max_j);
+
   void inflate_area(int min_i, int min_j, int max_i, int max_j, unsigned char * master_grid);
 
   unsigned int cellDistance(double world_dist)
@@ -172,18 +209,44 @@ private:
   bool inflate_unknown_;
   unsigned int cell_inflation_radius_;
   unsigned int cached_cell_inflation_radius_;
-  std::map<double, std::vector<CellData>> inflation_cells_;
+
+  // One bucket per distinct distance within the inflation radius, in increasing order.
+  // They keep their capacity across updates.
+  std::vector<std::vector<CellData>> inflation_cells_;
 
   double resolution_;
 
   std::vector<bool> seen_;
 
-  unsigned char ** cached_costs_;
-  double ** cached_distances_;
-  double last_min_x_, last_min_y_, last_max_x_, last_max_y_;
+  // Tables indexed by dx * cache_length_ + dy, for dx and dy up to the inflation radius + 1
+  unsigned int cache_length_;
+  std::vector<unsigned char> cached_costs_;
+  std::vector<double> cached_distances_;
+  std::vector<unsigned int> cached_levels_;
+  // Costs by squared distance in cells, up to the squared inflation radius
+  std::vector<unsigned char> cached_square_costs_;
+  WorldRegion last_region_;
 
   // Indicates that the entire costmap should be reinflated next time around.
   bool need_reinflation_;
+
+  // How costs are propagated from the obstacles, from the inflation_algorithm parameter
+  enum InflationAlgorithm
+  {
+    WAVEFRONT,    // brushfire from every obstacle around each window, each cycle
+    INCREMENTAL,  // persistent nearest obstacle field, updated where obstacles changed
+    DISTANCE_TRANSFORM  // exact Euclidean distance transform of each window
+  };
+  InflationAlgorithm algorithm_;
+
+  // Used by the incremental algorithm. It is rebuilt from the whole grid when out of sync,
+  // after a resize, a reset, a change of radius or any move of the rolling window
+  NearestObstacleField field_;
+  bool field_synced_;
+  double field_origin_x_, field_origin_y_;
+
+  // Used by the distance transform algorithm, keeps its buffers between updates
+  DistanceTransform distance_transform_;
 };
 
 }  // namespace nav2_costmap_2d
@@ -44,7 +44,9 @@
 #include "tf2_ros/buffer.h"
 #include "rclcpp/rclcpp.hpp"
 #include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/dirty_region.hpp"
 #include "nav2_costmap_2d/layered_costmap.hpp"
+#include "nav2_costmap_2d/observation.hpp"
 #include "nav2_util/lifecycle_node.hpp"
 
 namespace nav2_costmap_2d
@@ -83,6 +85,34 @@ public:
     double * max_x,
     double * max_y) = 0;
 
+  /**
+   * @brief This is called by the LayeredCostmap to collect the areas of the
+   *        costmap that changed, as a set of rectangles. Each layer can add
+   *        to the region. updateCosts() is then called once per rectangle.
+   *
+   * The default implementation adds the result of updateBounds() as one box, so
+   * layers whose changes come in separate patches, e.g. from sensors at both ends of
+   * the robot, override this to add each patch on its own. updateBounds() is given the
+   * box around the region so far, or nothing if isUpdateBoundsConcurrent() says the
+   * layer doesn't read it.
+   */
+  virtual void updateRegion(
+    double robot_x, double robot_y, double robot_yaw, WorldRegion & region);
+
+  /**
+   * @brief Whether updateBounds() may run concurrently with the updateBounds() of other layers.
+   *
+   * Return true only if updateBounds() and updateRegion() touch nothing but this layer's
+   * own state and only grow the bounds they are given, without reading what earlier
+   * layers put in them. The LayeredCostmap then runs them on its thread pool alongside
+   * neighbouring layers that opted in as well. updateCosts() is always called in order
+   * on a single thread.
+   */
+  virtual bool isUpdateBoundsConcurrent() const
+  {
+    return false;
+  }
+
   /**
    * @brief Actually update the underlying costmap, only within the bounds
    *        calculated during UpdateBounds().
@@ -119,6 +149,40 @@ public:
     return current_;
   }
 
+  /**
+   * @brief Whether the last updateBounds() or updateRegion() changed what the layer
+   *        writes in updateCosts(). When no layer changed and the costmap didn't move,
+   *        the LayeredCostmap keeps the master grid as it is instead of rebuilding it.
+   *
+   *        The state is managed by the protected variable changed_, which stays true
+   *        for layers that don't track their changes.
+   * @return Whether the costs of the layer may have changed
+   */
+  bool hasChanged() const
+  {
+    return changed_;
+  }
+
+  /**
+   * @brief Number of observations the last update used, for the statistics of the costmap.
+   *        Managed by the layers that use observations in the protected variable
+   *        observation_count_.
+   */
+  unsigned int getObservationCount() const
+  {
+    return observation_count_;
+  }
+
+  /**
+   * @brief Replace the observations of the layer by ones recorded in a sensor log, for the
+   *        updates until the next call. Layers that record their observations into
+   *        layered_costmap_->getSensorLog() override this to replay them, layers that don't
+   *        use observations ignore them.
+   */
+  virtual void setReplayedObservations(
+    const std::vector<Observation> & /*marking*/,
+    const std::vector<Observation> & /*clearing*/) {}
+
   /** @brief Convenience function for layered_costmap_->getFootprint(). */
   const std::vector<geometry_msgs::msg::Point> & getFootprint() const;
 
@@ -144,6 +208,8 @@ protected:
   virtual void onInitialize() {}
 
   bool current_;
+  bool changed_;
+  unsigned int observation_count_;
   // Currently this var is managed by subclasses.
   // TODO(bpwilcox): make this managed by this class and/or container class.
   bool enabled_;
@@ -38,13 +38,21 @@
 #ifndef NAV2_COSTMAP_2D__LAYERED_COSTMAP_HPP_
 #define NAV2_COSTMAP_2D__LAYERED_COSTMAP_HPP_
 
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "nav2_costmap_2d/cost_values.hpp"
 #include "nav2_costmap_2d/layer.hpp"
 #include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/costmap_pyramid.hpp"
+#include "nav2_costmap_2d/dirty_region.hpp"
+#include "nav2_costmap_2d/sensor_log.hpp"
+#include "nav2_costmap_2d/thread_pool.hpp"
+#include "nav2_costmap_2d/update_statistics.hpp"
 
 namespace nav2_costmap_2d
 {
@@ -83,6 +91,85 @@ public:
     double origin_y,
     bool size_locked = false);
 
+  /**
+   * @brief  Save the master grid to a snapshot in the global frame
+   * @param file_name The name of the snapshot
+   * @param name The name of the costmap stored in the snapshot
+   * @return False if the snapshot couldn't be written
+   */
+  bool saveSnapshot(const std::string & file_name, const std::string & name) const;
+
+  /**
+   * @brief  Restore the master grid from a snapshot, resizing the layers to it.
+   *         The next update still rebuilds the master grid from the layers.
+   * @param file_name The name of the snapshot
+   * @param name The name the snapshot must have, empty to load any
+   * @return False, leaving the costmap unchanged and logging why, if the file isn't a snapshot
+   *         of that name in the global frame
+   */
+  bool loadSnapshot(const std::string & file_name, const std::string & name);
+
+  /**
+   * @brief  Set the number of threads used to run updateBounds() of the layers that allow it
+   * @param threads The number of threads, including the one calling updateMap().
+   *        One or less runs every layer in order on the calling thread.
+   */
+  void setUpdateThreads(unsigned int threads);
+
+  /**
+   * @brief  Set the number of max-pooled levels kept over the master grid, updated with it
+   * @param levels The number of levels, 0 for none
+   */
+  void setPyramidLevels(unsigned int levels);
+
+  /**
+   * @brief  The max-pooled levels over the master grid, to be read under its mutex
+   */
+  const CostmapPyramid & getPyramid() const
+  {
+    return pyramid_;
+  }
+
+  /**
+   * @brief  Start or stop collecting the statistics of the updates, which include the time
+   *         other threads wait for the master grid and hold it
+   */
+  void setStatisticsEnabled(bool enabled);
+
+  /**
+   * @brief  The statistics of the updates, null unless enabled. The layers are only added
+   *         by updateMap(), so the list must be read from the thread calling it.
+   */
+  UpdateStatistics * getStatistics()
+  {
+    return statistics_.get();
+  }
+
+  /**
+   * @brief  Set the log the layers record the observations of each update into
+   * @param sensor_log The log, which must outlive its use here, or null to stop recording
+   */
+  void setSensorLog(SensorLogWriter * sensor_log)
+  {
+    sensor_log_ = sensor_log;
+  }
+
+  /**
+   * @brief  The log the layers record their observations into, null when not recording
+   */
+  SensorLogWriter * getSensorLog()
+  {
+    return sensor_log_;
+  }
+
+  /**
+   * @brief  The thread pool used during updateMap(), null when updates are single threaded
+   */
+  ThreadPool * getThreadPool()
+  {
+    return thread_pool_.get();
+  }
+
   void getUpdatedBounds(double & minx, double & miny, double & maxx, double & maxy)
   {
     minx = minx_;
@@ -93,6 +180,19 @@ public:
 
   bool isCurrent();
 
+  /**
+   * @brief  Wake the thread waiting in waitForNewData(), called by the layers when they
+   *         receive data. Safe to call from any thread.
+   */
+  void notifyNewData();
+
+  /**
+   * @brief  Wait until a layer receives data, unless one has since the last call
+   * @param deadline The time to stop waiting at
+   * @return True if a layer received data, false if the deadline passed
+   */
+  bool waitForNewData(std::chrono::steady_clock::time_point deadline);
+
   Costmap2D * getCostmap()
   {
     return &costmap_;
@@ -131,11 +231,37 @@ public:
     *yn = byn_;
   }
 
+  /**
+   * @brief  The disjoint cell windows updated by the last updateMap(), getBounds() is the box around them
+   */
+  const CellRegion & getUpdatedCells()
+  {
+    return updated_cells_;
+  }
+
   bool isInitialized()
   {
     return initialized_;
   }
 
+  /**
+   * @brief  Whether the last updateMap() kept the master grid as it was, because no layer
+   *         changed and the costmap didn't move
+   */
+  bool isUnchanged() const
+  {
+    return unchanged_;
+  }
+
+  /**
+   * @brief  Make the next updateMap() rebuild the master grid even if no layer changed,
+   *         after it or the layers were modified outside of updateMap()
+   */
+  void invalidate()
+  {
+    invalidated_ = true;
+  }
+
   /** @brief Updates the stored footprint, updates the circumscribed
    * and inscribed radii, and calls onFootprintChanged() in all
    * layers. */
@@ -163,7 +289,29 @@ public:
   bool isOutofBounds(double robot_x, double robot_y);
 
 private:
+  /**
+   * @brief  Run updateRegion() of plugins_[first, last) on the thread pool and add each
+   *         of their results to the region
+   */
+  void updateRegionConcurrently(
+    size_t first, size_t last, double robot_x, double robot_y, double robot_yaw,
+    WorldRegion & region);
+
+  /**
+   * @brief  Run updateRegion() of plugins_[i], recording its statistics if enabled
+   */
+  void updateLayerRegion(
+    size_t i, double robot_x, double robot_y, double robot_yaw, WorldRegion & region);
+
+  /**
+   * @brief  Warn if a layer shrank the bounds it was given
+   */
+  void checkBounds(
+    const Layer & plugin, double prev_minx, double prev_miny, double prev_maxx,
+    double prev_maxy, double minx, double miny, double maxx, double maxy);
+
   Costmap2D costmap_;
+  CostmapPyramid pyramid_;
   std::string global_frame_;
 
   bool rolling_window_;  /// < @brief Whether or not the costmap should roll with the robot
@@ -171,10 +319,21 @@ private:
   bool current_;
   double minx_, miny_, maxx_, maxy_;
   unsigned int bx0_, bxn_, by0_, byn_;
+  CellRegion updated_cells_;
 
   std::vector<std::shared_ptr<Layer>> plugins_;
 
+  std::unique_ptr<ThreadPool> thread_pool_;
+  std::unique_ptr<UpdateStatistics> statistics_;
+  SensorLogWriter * sensor_log_;
+
+  std::mutex new_data_mutex_;
+  std::condition_variable new_data_condition_;
+  bool new_data_;  ///< @brief Whether a layer received data since the last waitForNewData()
+
   bool initialized_;
+  bool invalidated_;  ///< @brief Whether the next update has to rebuild the master grid
+  bool unchanged_;
   bool size_locked_;
   double circumscribed_radius_, inscribed_radius_;
   std::vector<geometry_msgs::msg::Point> footprint_;
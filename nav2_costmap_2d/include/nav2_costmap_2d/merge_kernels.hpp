@@ -0,0 +1,64 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__MERGE_KERNELS_HPP_
+#define NAV2_COSTMAP_2D__MERGE_KERNELS_HPP_
+
+#include <functional>
+
+#include "nav2_costmap_2d/thread_pool.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * Row kernels used by CostmapLayer to combine a layer into the master grid.
+ * Each one updates master[i] from layer[i] for i in [0, length), with the same
+ * result as the per-cell rules documented on the matching CostmapLayer::updateWith*.
+ * The implementation is picked once at runtime: AVX2 or SSE2 where the CPU
+ * supports it, portable C++ otherwise.
+ */
+
+/** @brief Keep the larger cost, NO_INFORMATION in either grid loses */
+void mergeRowMax(unsigned char * master, const unsigned char * layer, unsigned int length);
+
+/** @brief Copy every cell of the layer that isn't NO_INFORMATION */
+void mergeRowOverwrite(unsigned char * master, const unsigned char * layer, unsigned int length);
+
+/**
+ * @brief Add the costs, capped below INSCRIBED_INFLATED_OBSTACLE.
+ *        NO_INFORMATION in either grid takes the other one's value.
+ */
+void mergeRowAddition(unsigned char * master, const unsigned char * layer, unsigned int length);
+
+/** @brief The name of the instruction set the row kernels use, e.g. for logging */
+const char * mergeKernelsName();
+
+/**
+ * @brief Split rows [y0, yn) of a window into tiles run on the thread pool
+ *
+ * Windows smaller than a few tens of thousands of cells, or a null pool, run in
+ * one piece on the calling thread. The tiles must not take the costmap's mutex,
+ * since the caller usually holds it while the workers run.
+ * @param pool The thread pool, may be null
+ * @param width The number of cells per row, used to size the tiles
+ * @param work Called as work(tile_y0, tile_yn) once per tile
+ */
+void forEachRowTile(
+  ThreadPool * pool, int y0, int yn, unsigned int width,
+  const std::function<void(int, int)> & work);
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__MERGE_KERNELS_HPP_
@@ -0,0 +1,189 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__NEAREST_OBSTACLE_FIELD_HPP_
+#define NAV2_COSTMAP_2D__NEAREST_OBSTACLE_FIELD_HPP_
+
+#include <cstdint>
+#include <vector>
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class NearestObstacleField
+ * @brief The obstacle each cell of a grid is inflated from, kept up to date as obstacles change
+ *
+ * Cells get their obstacle the way InflationLayer's wavefront assigns them: from one of
+ * their four neighbors, by increasing distance, up to the inflation radius. The field
+ * persists between updates, and update() only revisits cells around obstacles that
+ * appeared or disappeared, lowering costs around new ones and raising costs around
+ * removed ones, as a dynamic brushfire does.
+ *
+ * Where a cell is equally far from two obstacles, or reached from two neighbors, it keeps
+ * the obstacle the wavefront reaches it with first, so the field gives exactly the costs of
+ * a wavefront over the whole grid. The field doesn't depend on the order obstacles were
+ * added in.
+ */
+class NearestObstacleField
+{
+public:
+  NearestObstacleField();
+
+  /**
+   * @brief  Number the distinct distances within a radius, in increasing order
+   * @param cell_radius The radius in cells
+   * @param levels Set to the level of each offset, indexed by dx * (cell_radius + 2) + dy,
+   *        or to the number of levels for offsets beyond the radius
+   * @return The number of levels
+   */
+  static unsigned int computeLevels(unsigned int cell_radius, std::vector<unsigned int> & levels);
+
+  /**
+   * @brief  Set the inflation radius in cells, clearing the field if it changed
+   */
+  void setRadius(unsigned int cell_radius);
+
+  /**
+   * @brief  Set the size of the grid, clearing the field
+   */
+  void resize(unsigned int size_x, unsigned int size_y);
+
+  /**
+   * @brief  Remove every obstacle
+   */
+  void clear();
+
+  /**
+   * @brief  Take the obstacles within a window from the LETHAL_OBSTACLE cells of a grid
+   * @param grid A row-major grid of the field's size
+   * @param x0, y0 The first cell of the window
+   * @param xn, yn One past the last cell of the window
+   */
+  void update(
+    const unsigned char * grid, unsigned int x0, unsigned int y0,
+    unsigned int xn, unsigned int yn);
+
+  /**
+   * @brief  The obstacle a cell is inflated from
+   * @return False if no obstacle is within the radius of the cell
+   */
+  bool getNearest(
+    unsigned int mx, unsigned int my, unsigned int & src_x, unsigned int & src_y) const
+  {
+    unsigned int source = sources_[my * size_x_ + mx];
+    if (source == NONE) {
+      return false;
+    }
+    src_x = source % size_x_;
+    src_y = source / size_x_;
+    return true;
+  }
+
+  unsigned int getCellRadius() const
+  {
+    return cell_radius_;
+  }
+
+  unsigned int getSizeInCellsX() const
+  {
+    return size_x_;
+  }
+
+  unsigned int getSizeInCellsY() const
+  {
+    return size_y_;
+  }
+
+private:
+  static const unsigned int NONE = UINT32_MAX;
+  /** @brief The push of obstacles, which no neighbor passes their obstacle to */
+  static const unsigned char NO_PUSH = 4;
+
+  /**
+   * @brief  An obstacle a neighbor passes on to a cell
+   *
+   * The push is the direction from the neighbor to the cell, numbered in the order the
+   * wavefront queues the neighbors of a cell: -x, -y, +x, +y.
+   */
+  struct Offer
+  {
+    unsigned int level;
+    unsigned int source;
+    unsigned char push;
+  };
+
+  /** @brief The level of cell index when inflated from source, num_levels_ if out of range */
+  unsigned int level(unsigned int index, unsigned int source) const;
+
+  /** @brief The level of a cell from its own obstacle, num_levels_ if it has none */
+  unsigned int levelOf(unsigned int index) const
+  {
+    unsigned int source = sources_[index];
+    return source == NONE ? num_levels_ : level(index, source);
+  }
+
+  /** @brief The neighbor that pushed a cell in a direction */
+  unsigned int pusher(unsigned int index, unsigned char push) const;
+
+  /** @brief The obstacle a cell has now, as an offer */
+  Offer current(unsigned int index) const
+  {
+    return Offer{levelOf(index), sources_[index], pushes_[index]};
+  }
+
+  /**
+   * @brief  Whether the wavefront takes a cell from offer a before offer b
+   *
+   * The wavefront takes the cells of a level in the order they were queued, which is the
+   * order their pushers were taken in, then the direction of the push. Comparing two
+   * offers of the same level walks up both chains of pushers until they differ.
+   */
+  bool precedes(unsigned int index, const Offer & a, const Offer & b) const;
+
+  /** @brief The offer the wavefront would give a cell, given its neighbors */
+  Offer bestOffer(unsigned int index) const;
+
+  /** @brief Queue the cell if its obstacle doesn't match what its neighbors offer */
+  void updateCell(unsigned int index);
+
+  /**
+   * @brief  Update the neighbors of a cell whose obstacle or order changed. The cells it
+   *         pushed change their order too, so they are queued again even if they are settled.
+   */
+  void updateNeighbors(unsigned int index);
+
+  void push(unsigned int index, unsigned int key);
+
+  /** @brief Settle every queued cell in order of level */
+  void propagate();
+
+  unsigned int size_x_, size_y_;
+  unsigned int cell_radius_;
+  unsigned int length_;
+  unsigned int num_levels_;
+  std::vector<unsigned int> levels_;
+
+  std::vector<unsigned int> sources_;
+  std::vector<unsigned char> pushes_;  ///< @brief How each cell got its obstacle
+  std::vector<bool> obstacles_;
+  std::vector<bool> reordered_;  ///< @brief Settled cells queued because their pusher changed
+
+  // One bucket of cells per level, reused across updates
+  std::vector<std::vector<unsigned int>> queue_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__NEAREST_OBSTACLE_FIELD_HPP_
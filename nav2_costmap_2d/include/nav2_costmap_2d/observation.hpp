@@ -32,72 +32,118 @@
 #ifndef NAV2_COSTMAP_2D__OBSERVATION_HPP_
 #define NAV2_COSTMAP_2D__OBSERVATION_HPP_
 
+#include <memory>
+
 #include <geometry_msgs/msg/point.hpp>
+#include <geometry_msgs/msg/quaternion.hpp>
 #include <sensor_msgs/msg/point_cloud2.hpp>
 
+#include "nav2_costmap_2d/planar_scan.hpp"
+
 namespace nav2_costmap_2d
 {
 
 /**
  * @brief Stores an observation in terms of a point cloud and the origin of the source
- * @note Tried to make members and constructor arguments const but the compiler would not accept the default
- * assignment operator for vector insertion!
+ *
+ * The cloud is immutable and shared, so copying an observation is cheap: buffers and
+ * layers pass observations around without copying the points. Observations of a level
+ * laser scan keep the scan instead, and their cloud is empty.
  */
 class Observation
 {
 public:
+  typedef std::shared_ptr<const sensor_msgs::msg::PointCloud2> CloudConstPtr;
+  typedef std::shared_ptr<const PlanarScan> ScanConstPtr;
+
+  /**
+   * @brief How the points of a clearing observation are raytraced
+   */
+  enum RaytraceMode
+  {
+    RAYTRACE_ALL,          ///< @brief One ray per point
+    RAYTRACE_UNIQUE,       ///< @brief One ray per endpoint cell, or voxel
+    RAYTRACE_ANGULAR_BINS  ///< @brief One ray to the farthest endpoint of each angular bin
+  };
+
   /**
    * @brief  Creates an empty observation
    */
   Observation()
-  : cloud_(new sensor_msgs::msg::PointCloud2()), obstacle_range_(0.0), raytrace_range_(0.0)
+  : cloud_(std::make_shared<const sensor_msgs::msg::PointCloud2>()), obstacle_range_(0.0),
+    raytrace_range_(0.0), raytrace_mode_(RAYTRACE_ALL), raytrace_angular_resolution_(0.0),
+    horizontal_fov_(0.0), vertical_fov_(0.0)
   {
   }
 
   virtual ~Observation()
   {
-    delete cloud_;
   }
 
   /**
    * @brief  Creates an observation from an origin point and a point cloud
    * @param origin The origin point of the observation
-   * @param cloud The point cloud of the observation
+   * @param cloud The point cloud of the observation, copied once
    * @param obstacle_range The range out to which an observation should be able to insert obstacles
    * @param raytrace_range The range out to which an observation should be able to clear via raytracing
    */
   Observation(
     geometry_msgs::msg::Point & origin, const sensor_msgs::msg::PointCloud2 & cloud,
     double obstacle_range, double raytrace_range)
-  : origin_(origin), cloud_(new sensor_msgs::msg::PointCloud2(cloud)),
-    obstacle_range_(obstacle_range), raytrace_range_(raytrace_range)
+  : origin_(origin), cloud_(std::make_shared<const sensor_msgs::msg::PointCloud2>(cloud)),
+    obstacle_range_(obstacle_range), raytrace_range_(raytrace_range),
+    raytrace_mode_(RAYTRACE_ALL), raytrace_angular_resolution_(0.0),
+    horizontal_fov_(0.0), vertical_fov_(0.0)
   {
   }
 
   /**
-   * @brief  Copy constructor
-   * @param obs The observation to copy
+   * @brief  Creates an observation sharing a point cloud
+   * @param origin The origin point of the observation
+   * @param cloud The point cloud of the observation, which must not change afterwards
+   * @param obstacle_range The range out to which an observation should be able to insert obstacles
+   * @param raytrace_range The range out to which an observation should be able to clear via raytracing
    */
-  Observation(const Observation & obs)
-  : origin_(obs.origin_), cloud_(new sensor_msgs::msg::PointCloud2(*(obs.cloud_))),
-    obstacle_range_(obs.obstacle_range_), raytrace_range_(obs.raytrace_range_)
+  Observation(
+    const geometry_msgs::msg::Point & origin, CloudConstPtr cloud,
+    double obstacle_range, double raytrace_range)
+  : origin_(origin), cloud_(cloud),
+    obstacle_range_(obstacle_range), raytrace_range_(raytrace_range),
+    raytrace_mode_(RAYTRACE_ALL), raytrace_angular_resolution_(0.0),
+    horizontal_fov_(0.0), vertical_fov_(0.0)
   {
   }
 
   /**
    * @brief  Creates an observation from a point cloud
-   * @param cloud The point cloud of the observation
+   * @param cloud The point cloud of the observation, copied once
    * @param obstacle_range The range out to which an observation should be able to insert obstacles
    */
   Observation(const sensor_msgs::msg::PointCloud2 & cloud, double obstacle_range)
-  : cloud_(new sensor_msgs::msg::PointCloud2(cloud)), obstacle_range_(obstacle_range),
-    raytrace_range_(0.0)
+  : cloud_(std::make_shared<const sensor_msgs::msg::PointCloud2>(cloud)),
+    obstacle_range_(obstacle_range), raytrace_range_(0.0), raytrace_mode_(RAYTRACE_ALL),
+    raytrace_angular_resolution_(0.0), horizontal_fov_(0.0), vertical_fov_(0.0)
+  {
+  }
+
+  /**
+   * @brief  The time the points were measured
+   */
+  const builtin_interfaces::msg::Time & stamp() const
   {
+    return scan_ ? scan_->stamp_ : cloud_->header.stamp;
   }
 
   geometry_msgs::msg::Point origin_;
-  sensor_msgs::msg::PointCloud2 * cloud_;
+  geometry_msgs::msg::Quaternion orientation_;  ///< @brief Of the sensor, which looks along x
+  CloudConstPtr cloud_;
+  ScanConstPtr scan_;  ///< @brief Null unless the points are in a scan
   double obstacle_range_, raytrace_range_;
+  RaytraceMode raytrace_mode_;
+  /// @brief Size of the bins in radians, for RAYTRACE_ANGULAR_BINS
+  double raytrace_angular_resolution_;
+  /// @brief Fields of view of the sensor in radians, 0 when unknown
+  double horizontal_fov_, vertical_fov_;
 };
 
 }  // namespace nav2_costmap_2d
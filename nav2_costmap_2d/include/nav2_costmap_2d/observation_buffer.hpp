@@ -39,14 +39,19 @@
 
 #include <vector>
 #include <list>
+#include <memory>
 #include <string>
+#include <unordered_map>
 
+#include "tf2/LinearMath/Transform.h"
 #include "tf2_geometry_msgs/tf2_geometry_msgs.h"
 #include "rclcpp/time.hpp"
 #include "tf2_ros/buffer.h"
 #include "tf2_sensor_msgs/tf2_sensor_msgs.h"
+#include "sensor_msgs/msg/laser_scan.hpp"
 #include "sensor_msgs/msg/point_cloud2.hpp"
 #include "nav2_costmap_2d/observation.hpp"
+#include "nav2_costmap_2d/point_cloud_filter.hpp"
 #include "nav2_util/lifecycle_node.hpp"
 
 namespace nav2_costmap_2d
@@ -71,6 +76,7 @@ public:
    * @param  global_frame The frame to transform PointClouds into
    * @param  sensor_frame The frame of the origin of the sensor, can be left blank to be read from the messages
    * @param  tf_tolerance The amount of time to wait for a transform to be available when setting a new global frame
+   * @param  voxel_size If positive, only the first point of each cube of this size is kept from a cloud
    */
   ObservationBuffer(
     nav2_util::LifecycleNode::SharedPtr nh,
@@ -80,7 +86,8 @@ public:
     double min_obstacle_height, double max_obstacle_height, double obstacle_range,
     double raytrace_range, tf2_ros::Buffer & tf2_buffer, std::string global_frame,
     std::string sensor_frame,
-    double tf_tolerance);
+    double tf_tolerance,
+    double voxel_size = 0.0);
 
   /**
    * @brief  Destructor... cleans up
@@ -104,11 +111,43 @@ public:
   void bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud);
 
   /**
-   * @brief  Pushes copies of all current observations onto the end of the vector passed in
+   * @brief  Buffers a laser scan as its ranges and the pose of the sensor, using one transform
+   *         for the whole scan. Scans that aren't level in the global frame, or that are
+   *         downsampled, are buffered as clouds instead.
+   * <b>Note: The burden is on the user to make sure the transform is available... ie they should use a MessageNotifier</b>
+   * @param  scan The scan to be buffered
+   * @param  inf_is_valid Whether Inf ranges are taken as beams that hit nothing up to range_max
+   */
+  void bufferScan(const sensor_msgs::msg::LaserScan & scan, bool inf_is_valid);
+
+  /**
+   * @brief  Pushes copies of all current observations onto the end of the vector passed in.
+   *         The copies share the buffer's clouds, which are never modified once buffered.
    * @param  observations The vector to be filled
    */
   void getObservations(std::vector<Observation> & observations);
 
+  /**
+   * @brief  Set how the observations buffered from now on are raytraced when clearing
+   * @param  mode The raytrace mode
+   * @param  angular_resolution The size of the bins in radians, for RAYTRACE_ANGULAR_BINS
+   */
+  void setRaytraceMode(Observation::RaytraceMode mode, double angular_resolution);
+
+  /**
+   * @brief  Set the fields of view of the sensor for the observations buffered from now on
+   * @param  horizontal_fov The horizontal field of view in radians, 0 when unknown
+   * @param  vertical_fov The vertical field of view in radians, 0 when unknown
+   */
+  void setFieldOfView(double horizontal_fov, double vertical_fov);
+
+  /**
+   * @brief  Set the frame of the robot, so that the transforms of the sensors mounted on it
+   *         with static transforms are cached and only the robot's is looked up for each cloud
+   * @param  robot_base_frame The frame of the robot, empty to look up every frame in full
+   */
+  void setRobotBaseFrame(const std::string & robot_base_frame);
+
   /**
    * @brief  Check if the observation buffer is being update at its expected rate
    * @return True if it is being updated at the expected rate, false otherwise
@@ -142,6 +181,51 @@ private:
    */
   void purgeStaleObservations();
 
+  /**
+   * @brief  Set the origin and orientation of an observation to the pose of its sensor
+   * @param  observation The observation
+   * @param  sensor_transform The transform from the frame of the sensor to the global frame
+   */
+  void setSensorPose(
+    Observation & observation, const geometry_msgs::msg::Transform & sensor_transform);
+
+  /**
+   * @brief  The static transforms from a frame to the robot base frame
+   */
+  struct StaticChain
+  {
+    std::string root;  ///< @brief The robot base frame, or the frame itself if not static to it
+    tf2::Transform transform;  ///< @brief From the frame to the root
+    tf2::TimePoint walked;  ///< @brief The time of the data the tree was last walked for
+  };
+
+  /**
+   * @brief  Get the chain of static transforms from a frame to the robot base frame, caching it
+   *         and looking it up again once the data is a second away from the last lookup, so that
+   *         a static transform republished with a new value is picked up
+   * @param  frame The frame
+   * @param  time The time of the data
+   * @return The chain, whose root is the frame itself when a transform between it and the robot
+   *         base frame is time-varying, or when they aren't connected
+   */
+  const StaticChain & getStaticChain(const std::string & frame, const tf2::TimePoint & time);
+
+  /**
+   * @brief  Look up the transforms from the frames of a sensor and of its data to the global frame
+   *         at a time, composing their cached static chains with a single lookup of the
+   *         time-varying rest of the tree when they share a root
+   * @param  sensor_frame The frame of the sensor
+   * @param  data_frame The frame of the points
+   * @param  stamp The time of the data
+   * @param  sensor_transform Set to the transform of the sensor frame
+   * @param  data_transform Set to the transform of the data frame
+   */
+  void lookupTransforms(
+    const std::string & sensor_frame, const std::string & data_frame,
+    const builtin_interfaces::msg::Time & stamp,
+    geometry_msgs::msg::Transform & sensor_transform,
+    geometry_msgs::msg::Transform & data_transform);
+
   tf2_ros::Buffer & tf2_buffer_;
   const rclcpp::Duration observation_keep_time_;
   const rclcpp::Duration expected_update_rate_;
@@ -149,12 +233,19 @@ private:
   rclcpp::Time last_updated_;
   std::string global_frame_;
   std::string sensor_frame_;
+  std::string robot_base_frame_;
   std::list<Observation> observation_list_;
   std::string topic_name_;
   double min_obstacle_height_, max_obstacle_height_;
   std::recursive_mutex lock_;  ///< @brief A lock for accessing data in callbacks safely
   double obstacle_range_, raytrace_range_;
   double tf_tolerance_;
+  Observation::RaytraceMode raytrace_mode_;
+  double raytrace_angular_resolution_;
+  double horizontal_fov_, vertical_fov_;
+  PointCloudFilter point_filter_;
+  std::shared_ptr<const BeamTable> beams_;  ///< @brief The beam angles of the last scan
+  std::unordered_map<std::string, StaticChain> static_chains_;  ///< @brief By frame
 };
 }  // namespace nav2_costmap_2d
 #endif  // NAV2_COSTMAP_2D__OBSERVATION_BUFFER_HPP_
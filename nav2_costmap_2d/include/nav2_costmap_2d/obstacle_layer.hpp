@@ -40,6 +40,9 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "rclcpp/rclcpp.hpp"
@@ -53,6 +56,7 @@
 #include "sensor_msgs/msg/laser_scan.hpp"
 #include "sensor_msgs/msg/point_cloud.hpp"
 #include "sensor_msgs/msg/point_cloud2.hpp"
+#include "nav2_costmap_2d/cell_masks.hpp"
 #include "nav2_costmap_2d/costmap_layer.hpp"
 #include "nav2_costmap_2d/layered_costmap.hpp"
 #include "nav2_costmap_2d/observation_buffer.hpp"
@@ -76,6 +80,11 @@ public:
     double * min_y,
     double * max_x,
     double * max_y);
+  /** @brief Adds one rectangle per observation, plus the footprint and any extra bounds */
+  virtual void updateRegion(
+    double robot_x, double robot_y, double robot_yaw, WorldRegion & region);
+  // observations and raytracing only touch this layer's grid
+  virtual bool isUpdateBoundsConcurrent() const {return true;}
   virtual void updateCosts(
     nav2_costmap_2d::Costmap2D & master_grid,
     int min_i, int min_j, int max_i, int max_j);
@@ -106,6 +115,17 @@ public:
     sensor_msgs::msg::LaserScan::ConstSharedPtr message,
     const std::shared_ptr<nav2_costmap_2d::ObservationBuffer> & buffer);
 
+  /**
+   * @brief  A callback to handle buffering LaserScan messages without projecting them
+   * @param message The message returned from a message notifier
+   * @param buffer A pointer to the observation buffer to update
+   * @param inf_is_valid Whether Inf ranges are taken as beams that hit nothing up to range_max
+   */
+  void planarScanCallback(
+    sensor_msgs::msg::LaserScan::ConstSharedPtr message,
+    const std::shared_ptr<nav2_costmap_2d::ObservationBuffer> & buffer,
+    bool inf_is_valid);
+
   /**
    * @brief  A callback to handle buffering PointCloud2 messages
    * @param message The message returned from a message notifier
@@ -115,6 +135,11 @@ public:
     sensor_msgs::msg::PointCloud2::ConstSharedPtr message,
     const std::shared_ptr<nav2_costmap_2d::ObservationBuffer> & buffer);
 
+  /** @brief Replaces the static observations, which are the only ones without sources */
+  virtual void setReplayedObservations(
+    const std::vector<nav2_costmap_2d::Observation> & marking,
+    const std::vector<nav2_costmap_2d::Observation> & clearing);
+
   // for testing purposes
   void addStaticObservation(nav2_costmap_2d::Observation & obs, bool marking, bool clearing);
   void clearStaticObservations(bool marking, bool clearing);
@@ -136,6 +161,15 @@ protected:
   bool getClearingObservations(
     std::vector<nav2_costmap_2d::Observation> & clearing_observations) const;
 
+  /**
+   * @brief  Record the observations of the current update into the sensor log, if any
+   * @param marking_observations The observations used to mark space
+   * @param clearing_observations The observations used to clear space
+   */
+  void recordObservations(
+    const std::vector<nav2_costmap_2d::Observation> & marking_observations,
+    const std::vector<nav2_costmap_2d::Observation> & clearing_observations);
+
   /**
    * @brief  Clear freespace based on one observation
    * @param clearing_observation The observation used to raytrace
@@ -150,6 +184,24 @@ protected:
     double * max_x,
     double * max_y);
 
+  /**
+   * @brief  Clear freespace based on several observations, with the rays split between the
+   *         threads of a pool. The cells cleared are the same as with raytraceFreespace()
+   *         on each observation in turn.
+   * @param clearing_observations The observations used to raytrace
+   * @param pool The thread pool
+   * @param region Gets the bounds of each observation, in order
+   */
+  void raytraceFreespaceParallel(
+    const std::vector<nav2_costmap_2d::Observation> & clearing_observations,
+    ThreadPool & pool, WorldRegion & region);
+
+  /**
+   * @brief  Whether the layer handles observations that keep a laser scan instead of a cloud.
+   *         Laser scan sources of layers that don't are projected into clouds.
+   */
+  virtual bool supportsPlanarScans() const {return true;}
+
   void updateRaytraceBounds(
     double ox, double oy, double wx, double wy, double range,
     double * min_x, double * min_y,
@@ -158,6 +210,7 @@ protected:
 
   std::vector<geometry_msgs::msg::Point> transformed_footprint_;
   bool footprint_clearing_enabled_;
+  /** @brief Clears the cells under the footprint, if footprint clearing is enabled */
   void updateFootprint(
     double robot_x, double robot_y, double robot_yaw, double * min_x,
     double * min_y,
@@ -186,6 +239,87 @@ protected:
 
   bool rolling_window_;
   int combination_method_;
+
+  /// @brief An endpoint cell of a clearing observation and its squared distance to the sensor
+  struct RaytraceEndpoint
+  {
+    unsigned int x, y;
+    double distance;
+  };
+  /// @brief The endpoints seen so far while raytracing an observation
+  struct RaytraceScratch
+  {
+    /// @brief Endpoint cells already traced, in RAYTRACE_UNIQUE mode
+    std::unordered_set<unsigned int> endpoints;
+    /// @brief Farthest endpoint of each angular bin, in RAYTRACE_ANGULAR_BINS mode
+    std::unordered_map<int, RaytraceEndpoint> bins;
+  };
+
+  /**
+   * @brief  Raytrace to a range of the points of a clearing observation
+   * @param clearing_observation The observation used to raytrace, with its origin on the map
+   * @param begin The first point to raytrace to
+   * @param end One past the last point to raytrace to
+   * @param action Applied to every cell along the rays
+   * @param scratch Cleared, then used to reduce the rays
+   */
+  template<class ActionType>
+  void raytraceRays(
+    const nav2_costmap_2d::Observation & clearing_observation, size_t begin, size_t end,
+    ActionType action, RaytraceScratch & scratch,
+    double * min_x, double * min_y, double * max_x, double * max_y);
+
+  /**
+   * @brief  Write a cell, remembering its value before the update if it changes
+   * @param index The index of the cell
+   * @param value The value to write
+   */
+  inline void overwriteCell(unsigned int index, unsigned char value)
+  {
+    if (costmap_[index] != value) {
+      overwritten_cells_.emplace(index, costmap_[index]);
+      costmap_[index] = value;
+    }
+  }
+
+  /**
+   * @brief  Set changed_ if a cell written since the last call ended up with a new value.
+   *         A point marked again in a cell cleared by a ray, or under the footprint, is
+   *         then not a change.
+   */
+  void updateChanged();
+
+  /**
+   * @class ClearCell
+   * @brief An action for raytraceLine() freeing each cell through overwriteCell()
+   */
+  class ClearCell
+  {
+  public:
+    explicit ClearCell(ObstacleLayer & layer)
+    : layer_(layer)
+    {
+    }
+    inline void operator()(unsigned int offset)
+    {
+      layer_.overwriteCell(offset, FREE_SPACE);
+    }
+
+  private:
+    ObstacleLayer & layer_;
+  };
+
+  /// @brief Value of each cell written in the current update before it was first written
+  std::unordered_map<unsigned int, unsigned char> overwritten_cells_;
+  /// @brief Scratch space for the parallel clearing and the footprint
+  std::vector<std::pair<size_t, unsigned char>> overwritten_scratch_;
+  std::vector<MapLocation> footprint_cells_;
+
+  RaytraceScratch raytrace_scratch_;
+  /// @brief One per thread, for raytraceFreespaceParallel()
+  std::vector<RaytraceScratch> parallel_scratch_;
+  /// @brief The cells cleared by each thread, for raytraceFreespaceParallel()
+  CellMasks clearing_masks_;
 };
 
 }  // namespace nav2_costmap_2d
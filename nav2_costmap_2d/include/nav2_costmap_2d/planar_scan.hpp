@@ -0,0 +1,116 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__PLANAR_SCAN_HPP_
+#define NAV2_COSTMAP_2D__PLANAR_SCAN_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "builtin_interfaces/msg/time.hpp"
+#include "sensor_msgs/msg/point_cloud2.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class BeamTable
+ * @brief The cosine and sine of every beam angle of a laser scan
+ *
+ * A sensor keeps the same angles from scan to scan, so one table is computed
+ * and shared by all its scans.
+ */
+class BeamTable
+{
+public:
+  /**
+   * @brief  Computes the table
+   * @param angle_min The angle of the first beam, in radians
+   * @param angle_increment The angle between two beams, in radians
+   * @param count The number of beams
+   */
+  BeamTable(float angle_min, float angle_increment, size_t count);
+
+  /** @brief Whether the table is the one for these beams */
+  bool matches(float angle_min, float angle_increment, size_t count) const
+  {
+    return angle_min == angle_min_ && angle_increment == angle_increment_ && count == cos_.size();
+  }
+
+  float angle_min_, angle_increment_;
+  std::vector<double> cos_, sin_;
+};
+
+/**
+ * @class PlanarScan
+ * @brief The ranges of a laser scan, with the pose of the scan in the global frame
+ *
+ * The scan plane is taken as level, so the pose is a position and a yaw and every
+ * point of the scan has the height of the sensor. Points are computed when they are
+ * used, from the ranges and the beam table, instead of being stored.
+ */
+class PlanarScan
+{
+public:
+  PlanarScan()
+  : x_(0.0), y_(0.0), z_(0.0), cos_yaw_(1.0), sin_yaw_(0.0), range_min_(0.0f), range_max_(0.0f)
+  {
+  }
+
+  /** @brief Number of beams, including those without a valid range */
+  size_t size() const
+  {
+    return ranges_.size();
+  }
+
+  /**
+   * @brief  The point hit by a beam, in the global frame
+   * @param i The index of the beam
+   * @param wx Set to the x coordinate of the point
+   * @param wy Set to the y coordinate of the point
+   * @return False, leaving the coordinates unchanged, if the range of the beam is out of
+   *         [range_min, range_max) or not a number
+   */
+  bool getPoint(size_t i, double & wx, double & wy) const
+  {
+    float r = ranges_[i];
+    if (!(r >= range_min_ && r < range_max_)) {
+      return false;
+    }
+    double bx = beams_->cos_[i], by = beams_->sin_[i];
+    wx = x_ + r * (cos_yaw_ * bx - sin_yaw_ * by);
+    wy = y_ + r * (sin_yaw_ * bx + cos_yaw_ * by);
+    return true;
+  }
+
+  /**
+   * @brief  Writes the valid points of the scan as a packed cloud of x, y and z floats
+   * @param frame_id The frame id of the cloud, the one the pose of the scan is given in
+   * @param cloud The cloud to fill, stamped with the time of the scan
+   */
+  void toCloud(const std::string & frame_id, sensor_msgs::msg::PointCloud2 & cloud) const;
+
+  builtin_interfaces::msg::Time stamp_;
+  double x_, y_, z_;  ///< @brief Position of the sensor in the global frame
+  double cos_yaw_, sin_yaw_;  ///< @brief Heading of the sensor in the global frame
+  float range_min_, range_max_;
+  std::vector<float> ranges_;
+  std::shared_ptr<const BeamTable> beams_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__PLANAR_SCAN_HPP_
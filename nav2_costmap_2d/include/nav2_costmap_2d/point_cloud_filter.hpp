@@ -0,0 +1,80 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__POINT_CLOUD_FILTER_HPP_
+#define NAV2_COSTMAP_2D__POINT_CLOUD_FILTER_HPP_
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+
+#include "geometry_msgs/msg/transform.hpp"
+#include "sensor_msgs/msg/point_cloud2.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class PointCloudFilter
+ * @brief Turns a sensor cloud into the xyz points an observation keeps, in one pass
+ *
+ * Each point is transformed to the global frame, dropped if its height is out of
+ * bounds, and optionally dropped if an earlier point of the cloud fell in the same
+ * voxel. Only x, y and z are read, and the output is a packed cloud of three floats
+ * per point, so fields such as rgb or intensity are never copied. Four points are
+ * transformed at a time with SSE2 where available.
+ */
+class PointCloudFilter
+{
+public:
+  /**
+   * @brief  Constructor for the filter
+   * @param min_z The minimum height of a point to keep, in the global frame
+   * @param max_z The maximum height of a point to keep, in the global frame
+   * @param voxel_size The size of the cubes to keep one point of, 0 keeps every point
+   */
+  PointCloudFilter(double min_z, double max_z, double voxel_size);
+
+  /**
+   * @brief  Filter a cloud
+   * @param cloud The cloud in its sensor frame, with float32 x, y and z fields
+   * @param transform The transform from the cloud's frame to the global frame
+   * @param global_frame The frame id of the output
+   * @param output Set to the packed points, with the stamp of the input
+   * @return False, leaving the output empty, if the cloud lacks float32 x, y or z
+   */
+  bool filter(
+    const sensor_msgs::msg::PointCloud2 & cloud, const geometry_msgs::msg::Transform & transform,
+    const std::string & global_frame, sensor_msgs::msg::PointCloud2 & output);
+
+  /** @brief Whether the filter keeps only one point per voxel */
+  bool downsamples() const
+  {
+    return voxel_size_ > 0.0;
+  }
+
+private:
+  /** @brief Whether a point is the first of its voxel since the start of the cloud */
+  bool firstInVoxel(float x, float y, float z);
+
+  float min_z_, max_z_;
+  double voxel_size_;
+
+  // voxels taken by the current cloud, reused across clouds
+  std::unordered_set<uint64_t> voxels_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__POINT_CLOUD_FILTER_HPP_
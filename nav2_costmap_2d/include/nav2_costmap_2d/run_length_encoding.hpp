@@ -0,0 +1,45 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__RUN_LENGTH_ENCODING_HPP_
+#define NAV2_COSTMAP_2D__RUN_LENGTH_ENCODING_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * Run-length coding of costmap cells, as (run length, cost) byte pairs with run
+ * lengths from 1 to 255. Costmaps are mostly long runs of FREE_SPACE or
+ * NO_INFORMATION, which this shrinks well at little cost.
+ */
+
+/**
+ * @brief  Encode length bytes of data, replacing the contents of encoded
+ */
+void encodeRunLength(const uint8_t * data, size_t length, std::vector<uint8_t> & encoded);
+
+/**
+ * @brief  Decode exactly length bytes into data
+ * @return False if encoded is malformed or doesn't hold exactly length bytes,
+ *         data may then be partially written
+ */
+bool decodeRunLength(const std::vector<uint8_t> & encoded, uint8_t * data, size_t length);
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__RUN_LENGTH_ENCODING_HPP_
@@ -0,0 +1,198 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef NAV2_COSTMAP_2D__SENSOR_LOG_HPP_
+#define NAV2_COSTMAP_2D__SENSOR_LOG_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "geometry_msgs/msg/point.hpp"
+#include "rclcpp/parameter.hpp"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/observation.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @brief The observations a layer used in one update
+ */
+struct SensorLogObservations
+{
+  std::vector<Observation> marking;
+  std::vector<Observation> clearing;
+};
+
+/**
+ * @brief One update of a costmap, as recorded in a sensor log
+ */
+struct SensorLogCycle
+{
+  int64_t stamp;  ///< @brief The time of the update, in nanoseconds
+  double robot_x, robot_y, robot_yaw;
+  /// @brief Whether the footprint is set, which it is when it changed since the last cycle
+  bool has_footprint;
+  std::vector<geometry_msgs::msg::Point> footprint;
+  /// @brief Whether the geometry is set, which it is when the size of the master grid changed
+  bool has_geometry;
+  unsigned int size_x, size_y;
+  double resolution, origin_x, origin_y;
+  /// @brief The observations of the layers which used any, by name
+  std::map<std::string, SensorLogObservations> layers;
+};
+
+/**
+ * @class SensorLogWriter
+ * @brief Records the parameters of a costmap and the robot poses and observations of its
+ *        updates into a binary log, to replay them offline
+ *
+ * Observations kept by a layer over several updates are only written the first time. The
+ * log is written in the byte order of the host, by a thread of its own, so that the updates
+ * only pay for copying the handles of their observations.
+ */
+class SensorLogWriter
+{
+public:
+  /**
+   * @brief  Creates the log, throwing std::runtime_error if the file can't be opened
+   * @param path The path of the log
+   * @param parameters The parameters of the costmap and its layers
+   */
+  SensorLogWriter(const std::string & path, const std::vector<rclcpp::Parameter> & parameters);
+
+  ~SensorLogWriter();
+
+  SensorLogWriter(const SensorLogWriter &) = delete;
+  SensorLogWriter & operator=(const SensorLogWriter &) = delete;
+
+  /**
+   * @brief  Start recording an update of the costmap, before the update
+   * @param stamp The time of the update, in nanoseconds
+   * @param robot_x The pose of the robot given to the update
+   * @param robot_y The pose of the robot given to the update
+   * @param robot_yaw The pose of the robot given to the update
+   * @param footprint The padded footprint of the robot
+   * @param master_grid The master grid, locked while its size is read
+   */
+  void beginCycle(
+    int64_t stamp, double robot_x, double robot_y, double robot_yaw,
+    const std::vector<geometry_msgs::msg::Point> & footprint, Costmap2D & master_grid);
+
+  /**
+   * @brief  Record the observations a layer uses in the current update. Safe to call from
+   *         the layers updating concurrently.
+   * @param layer The name of the layer
+   * @param marking The observations used to mark
+   * @param clearing The observations used to clear
+   */
+  void addObservations(
+    const std::string & layer, const std::vector<Observation> & marking,
+    const std::vector<Observation> & clearing);
+
+  /**
+   * @brief  Hand the current update over to be written to the log. Only blocks while the
+   *         writing thread is many updates behind.
+   * @throw std::runtime_error If writing an earlier update failed, after which nothing more
+   *        is written
+   */
+  void endCycle();
+
+private:
+  /** @brief Write the updates handed over by endCycle(), until the log is closed */
+  void writeCycles();
+
+  /** @brief Encode an update and write it to the log */
+  void writeCycle(const SensorLogCycle & cycle);
+
+  /** @brief Write a record of the log */
+  void writeRecord(uint8_t type, const std::string & payload);
+
+  FILE * file_;
+  std::mutex mutex_;  ///< @brief Guards the current update
+  bool in_cycle_;
+  SensorLogCycle cycle_;
+  bool first_cycle_;
+  std::vector<geometry_msgs::msg::Point> last_footprint_;
+
+  std::mutex queue_mutex_;  ///< @brief Guards the updates waiting to be written
+  std::condition_variable queue_cv_;
+  std::deque<SensorLogCycle> queue_;
+  bool closing_;
+  std::string error_;  ///< @brief Why writing failed, empty while it hasn't
+
+  /// @brief The observations written in the last cycle of each layer, kept alive so that
+  ///        the clouds they share can't be reused by new observations. Only used by writer_.
+  std::map<std::string, std::vector<Observation>> previous_;
+  std::thread writer_;
+};
+
+/**
+ * @class SensorLogReader
+ * @brief Reads back a log written by SensorLogWriter
+ */
+class SensorLogReader
+{
+public:
+  /**
+   * @brief  Opens a log and reads its parameters, throwing std::runtime_error if it can't be
+   *         opened or isn't a sensor log of a known version
+   * @param path The path of the log
+   */
+  explicit SensorLogReader(const std::string & path);
+
+  ~SensorLogReader();
+
+  SensorLogReader(const SensorLogReader &) = delete;
+  SensorLogReader & operator=(const SensorLogReader &) = delete;
+
+  /**
+   * @brief  The parameters of the costmap and its layers
+   */
+  const std::vector<rclcpp::Parameter> & getParameters() const
+  {
+    return parameters_;
+  }
+
+  /**
+   * @brief  Read the next update, throwing std::runtime_error if its record is corrupt
+   * @param cycle Set to the update
+   * @return False at the end of the log, including a last record cut short by the recording
+   *         being stopped
+   */
+  bool readCycle(SensorLogCycle & cycle);
+
+private:
+  /** @brief Read a record of the log, returning false if there is no complete record left */
+  bool readRecord(uint8_t & type, std::string & payload);
+
+  FILE * file_;
+  std::vector<rclcpp::Parameter> parameters_;
+  /// @brief The observations read in the last cycle of each layer
+  std::map<std::string, std::vector<Observation>> previous_;
+  std::shared_ptr<const BeamTable> beams_;  ///< @brief The beam angles of the last scan read
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__SENSOR_LOG_HPP_
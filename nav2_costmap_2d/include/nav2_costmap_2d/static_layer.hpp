@@ -65,6 +65,7 @@ public:
   virtual void updateBounds(
     double robot_x, double robot_y, double robot_yaw, double * min_x,
     double * min_y, double * max_x, double * max_y);
+  virtual bool isUpdateBoundsConcurrent() const {return true;}
 
   virtual void updateCosts(
     nav2_costmap_2d::Costmap2D & master_grid,
@@ -72,6 +73,18 @@ public:
 
   virtual void matchSize();
 
+  /**
+   * @brief  Save the static map to a snapshot in the frame of the map
+   */
+  virtual bool saveSnapshot(const std::string & file_name, const std::string & name) const;
+
+  /**
+   * @brief  Restore the static map and its frame from a snapshot of this layer, as if it had
+   *         been received from the map server. A map received later replaces it.
+   * @return False, logging why, if the file isn't a snapshot of that name, or has no frame
+   */
+  virtual bool loadSnapshot(const std::string & file_name, const std::string & name);
+
 private:
   void getParameters();
   void processMap(const nav_msgs::msg::OccupancyGrid & new_map);
@@ -0,0 +1,86 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_COSTMAP_2D__THREAD_POOL_HPP_
+#define NAV2_COSTMAP_2D__THREAD_POOL_HPP_
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class ThreadPool
+ * @brief A fixed set of worker threads for splitting costmap updates into independent tasks
+ */
+class ThreadPool
+{
+public:
+  using Task = std::function<void (unsigned int)>;
+
+  /**
+   * @brief  Constructor for the thread pool
+   * @param num_threads The number of threads working on a parallelFor() call, including the
+   *        calling thread. With one thread or less, tasks run on the calling thread only.
+   */
+  explicit ThreadPool(unsigned int num_threads);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /**
+   * @brief  Run task(i) for every i in [0, n) and wait for all of them to finish
+   *
+   * The calling thread works on the tasks as well. Calls made from inside a task run
+   * serially on that thread. If tasks throw, the first exception is rethrown once
+   * all tasks are done.
+   */
+  void parallelFor(unsigned int n, const Task & task);
+
+  /**
+   * @brief  The number of threads working on a parallelFor() call, including the calling thread
+   */
+  unsigned int size() const
+  {
+    return workers_.size() + 1;
+  }
+
+private:
+  struct Job;
+
+  void workerLoop();
+  void runJob(Job & job);
+
+  std::vector<std::thread> workers_;
+
+  // only one parallelFor() call hands out work at a time
+  std::mutex call_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::shared_ptr<Job> job_;
+  bool stop_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__THREAD_POOL_HPP_
@@ -0,0 +1,83 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef NAV2_COSTMAP_2D__TIMED_MUTEX_HPP_
+#define NAV2_COSTMAP_2D__TIMED_MUTEX_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "nav2_costmap_2d/histogram.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @class TimedRecursiveMutex
+ * @brief A recursive mutex that can record how long threads wait for it and hold it
+ *
+ * Nothing is measured until histograms are set, and then only the outermost lock of each
+ * thread is. The thread updating the costmap can be left out, so that the histograms
+ * show how the readers of the costmap wait for the updates and hold them back.
+ */
+class TimedRecursiveMutex
+{
+public:
+  TimedRecursiveMutex();
+
+  TimedRecursiveMutex(const TimedRecursiveMutex &) = delete;
+  TimedRecursiveMutex & operator=(const TimedRecursiveMutex &) = delete;
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+  /**
+   * @brief  Set the histograms recording the times in nanoseconds, which must outlive the
+   *         mutex or be unset first
+   * @param wait The histogram of the time spent waiting for the mutex, null to stop timing
+   * @param hold The histogram of the time the mutex is held, null to stop timing
+   */
+  void setHistograms(Histogram * wait, Histogram * hold);
+
+  /**
+   * @brief  Leave a thread out of the histograms
+   * @param id The thread, a default constructed id to time all threads
+   */
+  void setUntimedThread(std::thread::id id);
+
+private:
+  /** @brief Whether the calling thread is timed */
+  bool isTimed() const;
+
+  /** @brief Record the start of the outermost lock, once the mutex is held */
+  void locked(std::chrono::steady_clock::time_point start, bool timed);
+
+  std::recursive_mutex mutex_;
+  std::atomic<Histogram *> wait_;
+  std::atomic<Histogram *> hold_;
+  std::atomic<std::thread::id> untimed_thread_;
+
+  // the state of the thread holding the mutex
+  unsigned int depth_;
+  bool timed_;
+  std::chrono::steady_clock::time_point locked_at_;
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__TIMED_MUTEX_HPP_
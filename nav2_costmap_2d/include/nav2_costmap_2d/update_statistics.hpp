@@ -0,0 +1,58 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef NAV2_COSTMAP_2D__UPDATE_STATISTICS_HPP_
+#define NAV2_COSTMAP_2D__UPDATE_STATISTICS_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nav2_costmap_2d/histogram.hpp"
+
+namespace nav2_costmap_2d
+{
+
+/**
+ * @brief  The statistics of a layer over the updates of a costmap
+ */
+struct LayerStatistics
+{
+  explicit LayerStatistics(const std::string & layer_name)
+  : name(layer_name)
+  {
+  }
+
+  std::string name;
+  Histogram bounds_time;  ///< @brief Nanoseconds in updateBounds() or updateRegion()
+  Histogram costs_time;  ///< @brief Nanoseconds in updateCosts(), over all the windows
+  Histogram observations;  ///< @brief Observations used by each update
+};
+
+/**
+ * @brief  The statistics of the updates of a costmap, and of the threads reading it
+ */
+struct UpdateStatistics
+{
+  Histogram update_time;  ///< @brief Nanoseconds in LayeredCostmap::updateMap()
+  Histogram updated_cells;  ///< @brief Cells that every layer wrote, 0 for skipped updates
+  Histogram lock_wait;  ///< @brief Nanoseconds the readers waited for the master grid
+  Histogram lock_hold;  ///< @brief Nanoseconds the readers held the master grid
+  std::vector<std::unique_ptr<LayerStatistics>> layers;  ///< @brief In the order of the layers
+};
+
+}  // namespace nav2_costmap_2d
+
+#endif  // NAV2_COSTMAP_2D__UPDATE_STATISTICS_HPP_
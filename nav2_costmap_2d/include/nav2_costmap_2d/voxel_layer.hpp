@@ -38,6 +38,11 @@
 #ifndef NAV2_COSTMAP_2D__VOXEL_LAYER_HPP_
 #define NAV2_COSTMAP_2D__VOXEL_LAYER_HPP_
 
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include <rclcpp/rclcpp.hpp>
 #include <nav2_costmap_2d/layer.hpp>
 #include <nav2_costmap_2d/layered_costmap.hpp>
@@ -50,28 +55,40 @@
 #include <sensor_msgs/msg/point_cloud2.hpp>
 #include <message_filters/subscriber.h>
 #include <nav2_costmap_2d/obstacle_layer.hpp>
+#include <nav2_voxel_grid/sparse_voxel_grid.hpp>
 #include <nav2_voxel_grid/voxel_grid.hpp>
 
 namespace nav2_costmap_2d
 {
 
-class VoxelLayer : public ObstacleLayer
+/**
+ * @class BasicVoxelLayer
+ * @brief An obstacle layer that marks and clears a voxel grid whose columns are of type ColumnT,
+ *        which sets the number of levels it supports
+ *
+ * With voxel_backend set to "sparse", the voxels are kept in a SparseVoxelGrid instead, which
+ * has no limit on z_voxels and only stores the blocks of voxels that were observed. The
+ * columns whose voxels changed are then projected into the costmap after each update, rather
+ * than written as the rays go. Only the first LEVELS levels of the sparse grid are published
+ * on voxel_grid.
+ *
+ * With either backend, the layer only reports a change when a cell got a new cost.
+ */
+template<class ColumnT>
+class BasicVoxelLayer : public ObstacleLayer
 {
 public:
-  VoxelLayer()
-  : voxel_grid_(0, 0, 0)
+  BasicVoxelLayer()
+  : voxel_grid_(0, 0, 0), sparse_(false), sparse_grid_(0, 0, 0)
   {
     costmap_ = NULL;  // this is the unsigned char* member of parent class's parent class Costmap2D
   }
 
-  virtual ~VoxelLayer();
+  virtual ~BasicVoxelLayer();
 
   virtual void onInitialize();
-  virtual void updateBounds(
-    double robot_x, double robot_y, double robot_yaw, double * min_x,
-    double * min_y,
-    double * max_x,
-    double * max_y);
+  virtual void updateRegion(
+    double robot_x, double robot_y, double robot_yaw, WorldRegion & region);
 
   void updateOrigin(double new_origin_x, double new_origin_y);
   bool isDiscretized()
@@ -83,10 +100,24 @@ public:
 
 protected:
   virtual void resetMaps();
+  // clearing traces through the voxel columns from clouds
+  virtual bool supportsPlanarScans() const {return false;}
+
+  /** @brief The column of voxels of a cell, from whichever grid keeps them */
+  ColumnT getColumn(unsigned int x, unsigned int y);
 
 private:
   void reconfigureCB();
   void clearNonLethal(double wx, double wy, double w_size_x, double w_size_y, bool clear_no_info);
+
+  /**
+   * @brief  Write the cost of the columns of the sparse grid that changed into the costmap,
+   *         expanding the bounds to the cells whose cost changed
+   */
+  void projectColumns(double * min_x, double * min_y, double * max_x, double * max_y);
+
+  /** @brief A column of the sparse grid as a dense column, to publish it */
+  ColumnT getSparseColumn(unsigned int x, unsigned int y);
   virtual void raytraceFreespace(
     const nav2_costmap_2d::Observation & clearing_observation,
     double * min_x, double * min_y,
@@ -95,12 +126,29 @@ private:
 
   bool publish_voxel_;
   rclcpp_lifecycle::LifecyclePublisher<nav2_msgs::msg::VoxelGrid>::SharedPtr voxel_pub_;
-  nav2_voxel_grid::VoxelGrid voxel_grid_;
+  nav2_voxel_grid::BasicVoxelGrid<ColumnT> voxel_grid_;
+  // Whether the voxels are kept in sparse_grid_ rather than in voxel_grid_
+  bool sparse_;
+  nav2_voxel_grid::SparseVoxelGrid sparse_grid_;
+  std::vector<nav2_voxel_grid::SparseVoxelGrid::Column> changed_columns_;
   double z_resolution_, origin_z_;
   int unknown_threshold_, mark_threshold_, size_z_;
   rclcpp::Publisher<sensor_msgs::msg::PointCloud>::SharedPtr clearing_endpoints_pub_;
   sensor_msgs::msg::PointCloud clearing_endpoints_;
 
+  // An endpoint of a clearing observation, in voxels and in the world,
+  // with its squared distance to the sensor
+  struct VoxelEndpoint
+  {
+    double x, y, z;
+    double wx, wy, wz;
+    double distance;
+  };
+  // Endpoint voxels already traced for the current observation, in RAYTRACE_UNIQUE mode
+  std::unordered_set<uint64_t> raytrace_voxels_;
+  // Farthest endpoint of each angular bin of the current observation
+  std::unordered_map<int64_t, VoxelEndpoint> raytrace_voxel_bins_;
+
   inline bool worldToMap3DFloat(
     double wx, double wy, double wz, double & mx, double & my,
     double & mz)
@@ -159,6 +207,25 @@ private:
   }
 };
 
+extern template class BasicVoxelLayer<uint32_t>;
+extern template class BasicVoxelLayer<uint64_t>;
+
+/**
+ * @class VoxelLayer
+ * @brief A voxel layer of up to 16 levels
+ */
+class VoxelLayer : public BasicVoxelLayer<uint32_t>
+{
+};
+
+/**
+ * @class VoxelLayer64
+ * @brief A voxel layer of up to 32 levels, with twice the memory per column
+ */
+class VoxelLayer64 : public BasicVoxelLayer<uint64_t>
+{
+};
+
 }  // namespace nav2_costmap_2d
 
 #endif  // NAV2_COSTMAP_2D__VOXEL_LAYER_HPP_
@@ -0,0 +1,303 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/decaying_voxel_layer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pluginlib/class_list_macros.hpp"
+#include "sensor_msgs/point_cloud2_iterator.hpp"
+
+PLUGINLIB_EXPORT_CLASS(nav2_costmap_2d::DecayingVoxelLayer, nav2_costmap_2d::Layer)
+
+using nav2_costmap_2d::LETHAL_OBSTACLE;
+using nav2_costmap_2d::FREE_SPACE;
+
+namespace nav2_costmap_2d
+{
+
+void DecayingVoxelLayer::onInitialize()
+{
+  ObstacleLayer::onInitialize();
+
+  declareParameter("voxel_decay", rclcpp::ParameterValue(10.0));
+  declareParameter("frustum_decay", rclcpp::ParameterValue(1.0));
+  declareParameter("z_voxels", rclcpp::ParameterValue(10));
+  declareParameter("origin_z", rclcpp::ParameterValue(0.0));
+  declareParameter("z_resolution", rclcpp::ParameterValue(0.2));
+  declareParameter("mark_threshold", rclcpp::ParameterValue(0));
+
+  node_->get_parameter(name_ + "." + "voxel_decay", voxel_decay_);
+  node_->get_parameter(name_ + "." + "frustum_decay", frustum_decay_);
+  node_->get_parameter(name_ + "." + "z_voxels", size_z_);
+  node_->get_parameter(name_ + "." + "origin_z", origin_z_);
+  node_->get_parameter(name_ + "." + "z_resolution", z_resolution_);
+  node_->get_parameter(name_ + "." + "mark_threshold", mark_threshold_);
+
+  if (voxel_decay_ <= 0.0 || frustum_decay_ < 0.0) {
+    RCLCPP_FATAL(
+      node_->get_logger(),
+      "voxel_decay must be positive and frustum_decay can't be negative");
+    throw std::runtime_error("voxel_decay must be positive and frustum_decay can't be negative");
+  }
+  if (size_z_ < 1 || size_z_ > (1 << DecayingVoxelGrid::Z_BITS) || z_resolution_ <= 0.0) {
+    RCLCPP_FATAL(
+      node_->get_logger(),
+      "z_voxels must be between 1 and %d and z_resolution must be positive",
+      1 << DecayingVoxelGrid::Z_BITS);
+    throw std::runtime_error("Invalid z_voxels or z_resolution");
+  }
+
+  // the fields of view of the sources, in the order of their observation buffers
+  std::string topics_string;
+  node_->get_parameter(name_ + "." + "observation_sources", topics_string);
+  std::stringstream ss(topics_string);
+
+  std::string source;
+  for (unsigned int i = 0; ss >> source && i < observation_buffers_.size(); ++i) {
+    double horizontal_fov, vertical_fov;
+    bool clearing;
+
+    declareParameter(source + "." + "horizontal_fov", rclcpp::ParameterValue(0.0));
+    declareParameter(source + "." + "vertical_fov", rclcpp::ParameterValue(0.0));
+
+    node_->get_parameter(name_ + "." + source + "." + "horizontal_fov", horizontal_fov);
+    node_->get_parameter(name_ + "." + source + "." + "vertical_fov", vertical_fov);
+    node_->get_parameter(name_ + "." + source + "." + "clearing", clearing);
+
+    if (clearing && (horizontal_fov <= 0.0 || vertical_fov <= 0.0)) {
+      RCLCPP_WARN(
+        node_->get_logger(),
+        "Source %s is clearing but has no horizontal_fov and vertical_fov, "
+        "so it won't clear any voxels", source.c_str());
+    }
+    observation_buffers_[i]->setFieldOfView(horizontal_fov, vertical_fov);
+  }
+
+  matchSize();
+}
+
+DecayingVoxelLayer::~DecayingVoxelLayer()
+{
+}
+
+void DecayingVoxelLayer::matchSize()
+{
+  ObstacleLayer::matchSize();
+
+  // the voxels are kept relative to the origin of the map at this size
+  lattice_x_ = origin_x_;
+  lattice_y_ = origin_y_;
+  projected_offset_x_ = projected_offset_y_ = 0;
+  voxel_grid_.clear();
+  voxel_grid_.takeChangedColumns(columns_);
+}
+
+void DecayingVoxelLayer::reset()
+{
+  ObstacleLayer::reset();
+  voxel_grid_.clear();
+  voxel_grid_.takeChangedColumns(columns_);
+}
+
+void DecayingVoxelLayer::clearArea(int start_x, int start_y, int end_x, int end_y)
+{
+  int offset_x, offset_y;
+  getCellOffset(offset_x, offset_y);
+
+  // drop the voxels outside of the area kept, like CostmapLayer drops the cells
+  voxel_grid_.remove(
+    [&](int x, int y, unsigned int) {
+      int mx = x - offset_x, my = y - offset_y;
+      return !(mx > start_x && mx < end_x && my > start_y && my < end_y);
+    });
+  CostmapLayer::clearArea(start_x, start_y, end_x, end_y);
+}
+
+void DecayingVoxelLayer::updateRegion(
+  double robot_x, double robot_y, double robot_yaw, WorldRegion & region)
+{
+  if (rolling_window_) {
+    updateOrigin(robot_x - getSizeInMetersX() / 2, robot_y - getSizeInMetersY() / 2);
+  }
+  if (!enabled_) {
+    changed_ = false;
+    observation_count_ = 0;
+    return;
+  }
+
+  // the layer changed if an area was cleared, or if a column changes cost
+  changed_ = has_extra_bounds_;
+
+  double min_x, min_y, max_x, max_y;
+  auto reset_box = [&]() {
+      min_x = min_y = 1e30;
+      max_x = max_y = -1e30;
+    };
+  auto add_box = [&]() {
+      region.add(min_x, min_y, max_x, max_y);
+      reset_box();
+    };
+
+  reset_box();
+  useExtraBounds(&min_x, &min_y, &max_x, &max_y);
+  add_box();
+
+  bool current = true;
+  std::vector<Observation> observations, clearing_observations;
+
+  // get the marking observations
+  current = getMarkingObservations(observations) && current;
+
+  // get the clearing observations
+  current = getClearingObservations(clearing_observations) && current;
+
+  // update the global current status
+  current_ = current;
+  observation_count_ = observations.size() + clearing_observations.size();
+  recordObservations(observations, clearing_observations);
+
+  // clear first, so that the voxels seen again by the same sensor keep their full decay
+  for (const Observation & obs : clearing_observations) {
+    decayFrustum(obs);
+  }
+
+  for (const Observation & obs : observations) {
+    markVoxels(obs);
+  }
+
+  voxel_grid_.removeExpired(node_->now().seconds());
+
+  projectColumns(&min_x, &min_y, &max_x, &max_y);
+  add_box();
+
+  updateFootprint(robot_x, robot_y, robot_yaw, &min_x, &min_y, &max_x, &max_y);
+  add_box();
+  updateChanged();
+}
+
+void DecayingVoxelLayer::decayFrustum(const Observation & clearing_observation)
+{
+  const Observation & obs = clearing_observation;
+  if (obs.horizontal_fov_ <= 0.0 || obs.vertical_fov_ <= 0.0) {
+    return;
+  }
+
+  Frustum frustum(
+    obs.origin_, obs.orientation_, obs.horizontal_fov_, obs.vertical_fov_, obs.raytrace_range_);
+  double expiry = rclcpp::Time(obs.stamp()).seconds() + frustum_decay_;
+
+  // the center of each voxel is tested
+  voxel_grid_.decay(
+    [&](int x, int y, unsigned int z) {
+      return frustum.contains(
+        lattice_x_ + (x + 0.5) * resolution_, lattice_y_ + (y + 0.5) * resolution_,
+        origin_z_ + (z + 0.5) * z_resolution_);
+    }, expiry);
+}
+
+void DecayingVoxelLayer::markVoxels(const Observation & marking_observation)
+{
+  const Observation & obs = marking_observation;
+  const sensor_msgs::msg::PointCloud2 & cloud = *(obs.cloud_);
+  double sq_obstacle_range = obs.obstacle_range_ * obs.obstacle_range_;
+  double expiry = rclcpp::Time(obs.stamp()).seconds() + voxel_decay_;
+
+  int offset_x, offset_y;
+  getCellOffset(offset_x, offset_y);
+
+  sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_z(cloud, "z");
+
+  for (; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z) {
+    // if the obstacle is too high or too far away from the robot we won't add it
+    if (*iter_z > max_obstacle_height_) {
+      continue;
+    }
+
+    // compute the squared distance from the hitpoint to the pointcloud's origin
+    double sq_dist = (*iter_x - obs.origin_.x) * (*iter_x - obs.origin_.x) +
+      (*iter_y - obs.origin_.y) * (*iter_y - obs.origin_.y) +
+      (*iter_z - obs.origin_.z) * (*iter_z - obs.origin_.z);
+
+    // if the point is far enough away... we won't consider it
+    if (sq_dist >= sq_obstacle_range) {
+      continue;
+    }
+
+    // only the voxels over the map are kept, points below the grid marking its bottom voxel
+    int x = static_cast<int>(std::floor((*iter_x - lattice_x_) / resolution_));
+    int y = static_cast<int>(std::floor((*iter_y - lattice_y_) / resolution_));
+    int z = std::max(0, static_cast<int>(std::floor((*iter_z - origin_z_) / z_resolution_)));
+    if (x - offset_x < 0 || x - offset_x >= static_cast<int>(size_x_) ||
+      y - offset_y < 0 || y - offset_y >= static_cast<int>(size_y_) || z >= size_z_)
+    {
+      continue;
+    }
+
+    voxel_grid_.mark(x, y, z, expiry);
+  }
+}
+
+void DecayingVoxelLayer::projectColumns(
+  double * min_x, double * min_y, double * max_x, double * max_y)
+{
+  int offset_x, offset_y;
+  getCellOffset(offset_x, offset_y);
+
+  // once the map moved, the columns coming into it have to be projected too
+  voxel_grid_.takeChangedColumns(columns_);
+  if (offset_x != projected_offset_x_ || offset_y != projected_offset_y_) {
+    voxel_grid_.getColumns(columns_);
+    projected_offset_x_ = offset_x;
+    projected_offset_y_ = offset_y;
+  }
+
+  for (const DecayingVoxelGrid::Column & column : columns_) {
+    int mx = column.x - offset_x, my = column.y - offset_y;
+    if (mx < 0 || mx >= static_cast<int>(size_x_) || my < 0 || my >= static_cast<int>(size_y_)) {
+      continue;
+    }
+
+    unsigned char cost = default_value_;
+    if (column.count > static_cast<unsigned int>(mark_threshold_)) {
+      cost = LETHAL_OBSTACLE;
+    } else if (column.count > 0) {
+      cost = FREE_SPACE;
+    }
+
+    unsigned int index = getIndex(mx, my);
+    if (costmap_[index] != cost) {
+      costmap_[index] = cost;
+      changed_ = true;
+      double wx, wy;
+      mapToWorld(mx, my, wx, wy);
+      touch(wx, wy, min_x, min_y, max_x, max_y);
+    }
+  }
+}
+
+void DecayingVoxelLayer::getCellOffset(int & offset_x, int & offset_y) const
+{
+  // the map only moves by whole cells, so the offset is an integer up to rounding errors
+  offset_x = static_cast<int>(std::lround((origin_x_ - lattice_x_) / resolution_));
+  offset_y = static_cast<int>(std::lround((origin_y_ - lattice_y_) / resolution_));
+}
+
+}  // namespace nav2_costmap_2d
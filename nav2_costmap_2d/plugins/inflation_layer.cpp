@@ -39,11 +39,12 @@
 
 #include <algorithm>
 #include <limits>
-#include <map>
+#include <string>
 #include <vector>
 
 #include "nav2_costmap_2d/costmap_math.hpp"
 #include "nav2_costmap_2d/footprint.hpp"
+#include "nav2_costmap_2d/merge_kernels.hpp"
 #include "pluginlib/class_list_macros.hpp"
 #include "rclcpp/parameter_events_filter.hpp"
 
@@ -63,13 +64,15 @@ InflationLayer::InflationLayer()
   inflate_unknown_(false),
   cell_inflation_radius_(0),
   cached_cell_inflation_radius_(0),
-  cached_costs_(nullptr),
-  cached_distances_(nullptr),
-  last_min_x_(-std::numeric_limits<float>::max()),
-  last_min_y_(-std::numeric_limits<float>::max()),
-  last_max_x_(std::numeric_limits<float>::max()),
-  last_max_y_(std::numeric_limits<float>::max())
+  cache_length_(0),
+  algorithm_(WAVEFRONT),
+  field_synced_(false),
+  field_origin_x_(0.0),
+  field_origin_y_(0.0)
 {
+  last_region_.add(
+    -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+    std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
 }
 
 void
@@ -79,12 +82,35 @@ InflationLayer::onInitialize()
   declareParameter("inflation_radius", rclcpp::ParameterValue(0.55));
   declareParameter("cost_scaling_factor", rclcpp::ParameterValue(10.0));
   declareParameter("inflate_unknown", rclcpp::ParameterValue(false));
+  declareParameter("inflation_algorithm", rclcpp::ParameterValue(std::string("wavefront")));
 
   node_->get_parameter(name_ + "." + "enabled", enabled_);
   node_->get_parameter(name_ + "." + "inflation_radius", inflation_radius_);
   node_->get_parameter(name_ + "." + "cost_scaling_factor", cost_scaling_factor_);
   node_->get_parameter(name_ + "." + "inflate_unknown", inflate_unknown_);
 
+  std::string algorithm;
+  node_->get_parameter(name_ + "." + "inflation_algorithm", algorithm);
+  if (algorithm == "wavefront") {
+    algorithm_ = WAVEFRONT;
+  } else if (algorithm == "incremental") {
+    algorithm_ = INCREMENTAL;
+  } else if (algorithm == "distance_transform") {
+    algorithm_ = DISTANCE_TRANSFORM;
+  } else {
+    RCLCPP_FATAL(
+      node_->get_logger(),
+      "Unknown inflation_algorithm %s, it must be wavefront, incremental or distance_transform",
+      algorithm.c_str());
+    throw std::runtime_error("Unknown inflation_algorithm " + algorithm);
+  }
+  if (algorithm_ == INCREMENTAL && layered_costmap_->isRolling()) {
+    RCLCPP_WARN(
+      node_->get_logger(),
+      "The incremental inflation rebuilds its field each time the rolling window moves, "
+      "the wavefront is faster for rolling costmaps");
+  }
+
   current_ = true;
   seen_.clear();
   need_reinflation_ = false;
@@ -100,40 +126,50 @@ InflationLayer::matchSize()
   cell_inflation_radius_ = cellDistance(inflation_radius_);
   computeCaches();
   seen_ = std::vector<bool>(costmap->getSizeInCellsX() * costmap->getSizeInCellsY(), false);
+  field_synced_ = false;
 }
 
 void
 InflationLayer::updateBounds(
-  double /*robot_x*/, double /*robot_y*/, double /*robot_yaw*/, double * min_x,
+  double robot_x, double robot_y, double robot_yaw, double * min_x,
   double * min_y, double * max_x, double * max_y)
 {
+  WorldRegion region;
+  region.add(*min_x, *min_y, *max_x, *max_y);
+  updateRegion(robot_x, robot_y, robot_yaw, region);
+  region.getBounds(*min_x, *min_y, *max_x, *max_y);
+}
+
+void
+InflationLayer::updateRegion(
+  double /*robot_x*/, double /*robot_y*/, double /*robot_yaw*/, WorldRegion & region)
+{
+  // the inflated costs only depend on the layers below, unless the inflation itself changed
+  changed_ = need_reinflation_;
   if (need_reinflation_) {
-    last_min_x_ = *min_x;
-    last_min_y_ = *min_y;
-    last_max_x_ = *max_x;
-    last_max_y_ = *max_y;
+    last_region_ = region;
     // For some reason when I make these -<double>::max() it does not
     // work with Costmap2D::worldToMapEnforceBounds(), so I'm using
     // -<float>::max() instead.
-    *min_x = -std::numeric_limits<float>::max();
-    *min_y = -std::numeric_limits<float>::max();
-    *max_x = std::numeric_limits<float>::max();
-    *max_y = std::numeric_limits<float>::max();
+    region.add(
+      -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+      std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
     need_reinflation_ = false;
-  } else {
-    double tmp_min_x = last_min_x_;
-    double tmp_min_y = last_min_y_;
-    double tmp_max_x = last_max_x_;
-    double tmp_max_y = last_max_y_;
-    last_min_x_ = *min_x;
-    last_min_y_ = *min_y;
-    last_max_x_ = *max_x;
-    last_max_y_ = *max_y;
-    *min_x = std::min(tmp_min_x, *min_x) - inflation_radius_;
-    *min_y = std::min(tmp_min_y, *min_y) - inflation_radius_;
-    *max_x = std::max(tmp_max_x, *max_x) + inflation_radius_;
-    *max_y = std::max(tmp_max_y, *max_y) + inflation_radius_;
+    return;
   }
+
+  // Costs inflated around last cycle's changes may have to be cleared now,
+  // so both this and the last region grow by the inflation radius
+  WorldRegion inflated;
+  for (const WorldRegion * source : {&region, &last_region_}) {
+    for (const WorldRegion::Rect & rect : source->getRectangles()) {
+      inflated.add(
+        rect.min_x - inflation_radius_, rect.min_y - inflation_radius_,
+        rect.max_x + inflation_radius_, rect.max_y + inflation_radius_);
+    }
+  }
+  last_region_ = region;
+  region.add(inflated);
 }
 
 void
@@ -158,13 +194,27 @@ InflationLayer::updateCosts(
   int max_j)
 {
   if (!enabled_ || (cell_inflation_radius_ == 0)) {
+    // obstacles may change unseen until inflation is back on
+    field_synced_ = false;
+    return;
+  }
+
+  if (algorithm_ == INCREMENTAL) {
+    updateCostsIncremental(master_grid, min_i, min_j, max_i, max_j);
+    return;
+  }
+  if (algorithm_ == DISTANCE_TRANSFORM) {
+    updateCostsDistanceTransform(master_grid, min_i, min_j, max_i, max_j);
     return;
   }
 
   // make sure the inflation list is empty at the beginning of the cycle (should always be true)
   RCLCPP_FATAL_EXPRESSION(
     rclcpp::get_logger("nav2_costmap_2d"),
-    !inflation_cells_.empty(), "The inflation list must be empty at the beginning of inflation");
+    std::any_of(
+      inflation_cells_.begin(), inflation_cells_.end(),
+      [](const std::vector<CellData> & bin) {return !bin.empty();}),
+    "The inflation list must be empty at the beginning of inflation");
 
   unsigned char * master_array = master_grid.getCharMap();
   unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
@@ -176,8 +226,6 @@ InflationLayer::updateCosts(
     seen_ = std::vector<bool>(size_x * size_y, false);
   }
 
-  std::fill(begin(seen_), end(seen_), false);
-
   // We need to include in the inflation cells outside the bounding
   // box min_i...max_j, by the amount cell_inflation_radius_.  Cells
   // up to that distance outside the box can still influence the costs
@@ -192,13 +240,25 @@ InflationLayer::updateCosts(
   max_i = std::min(static_cast<int>(size_x), max_i);
   max_j = std::min(static_cast<int>(size_y), max_j);
 
+  // Inflation only reaches cells within the inflation radius of an obstacle
+  // in the window, so only those need to be marked as not seen
+  int radius = static_cast<int>(cell_inflation_radius_);
+  int seen_min_i = std::max(0, min_i - radius);
+  int seen_max_i = std::min(static_cast<int>(size_x), max_i + radius);
+  for (int j = std::max(0, min_j - radius);
+    j < std::min(static_cast<int>(size_y), max_j + radius); j++)
+  {
+    auto row = seen_.begin() + static_cast<size_t>(j) * size_x;
+    std::fill(row + seen_min_i, row + seen_max_i, false);
+  }
+
   // Inflation list; we append cells to visit in a list associated with
   // its distance to the nearest obstacle
-  // We use a map<distance, list> to emulate the priority queue used before,
-  // with a notable performance boost
+  // The buckets, one per distinct distance and in increasing order,
+  // act as the priority queue
 
   // Start with lethal obstacles: by definition distance is 0.0
-  std::vector<CellData> & obs_bin = inflation_cells_[0.0];
+  std::vector<CellData> & obs_bin = inflation_cells_[0];
   for (int j = min_j; j < max_j; j++) {
     for (int i = min_i; i < max_i; i++) {
       int index = master_grid.getIndex(i, j);
@@ -212,11 +272,10 @@ InflationLayer::updateCosts(
   // Process cells by increasing distance; new cells are appended to the
   // corresponding distance bin, so they
   // can overtake previously inserted but farther away cells
-  std::map<double, std::vector<CellData>>::iterator bin;
-  for (bin = inflation_cells_.begin(); bin != inflation_cells_.end(); ++bin) {
-    for (unsigned int i = 0; i < bin->second.size(); ++i) {
-      // process all cells at distance dist_bin.first
-      const CellData & cell = bin->second[i];
+  for (std::vector<CellData> & bin : inflation_cells_) {
+    for (unsigned int i = 0; i < bin.size(); ++i) {
+      // process all cells at this distance
+      const CellData & cell = bin[i];
 
       unsigned int index = cell.index_;
 
@@ -259,7 +318,137 @@ InflationLayer::updateCosts(
     }
   }
 
-  inflation_cells_.clear();
+  // empty the buckets, keeping their memory for the next update
+  for (std::vector<CellData> & bin : inflation_cells_) {
+    bin.clear();
+  }
+}
+
+void
+InflationLayer::updateCostsIncremental(
+  nav2_costmap_2d::Costmap2D & master_grid, int min_i, int min_j,
+  int max_i,
+  int max_j)
+{
+  unsigned char * master_array = master_grid.getCharMap();
+  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+
+  if (field_.getSizeInCellsX() != size_x || field_.getSizeInCellsY() != size_y) {
+    field_.resize(size_x, size_y);
+    field_synced_ = false;
+  }
+  if (field_.getCellRadius() != cell_inflation_radius_) {
+    field_.setRadius(cell_inflation_radius_);
+    field_synced_ = false;
+  }
+  // a rolling window moves every obstacle relative to the field
+  if (master_grid.getOriginX() != field_origin_x_ || master_grid.getOriginY() != field_origin_y_) {
+    field_origin_x_ = master_grid.getOriginX();
+    field_origin_y_ = master_grid.getOriginY();
+    field_synced_ = false;
+  }
+
+  min_i = std::max(0, min_i);
+  min_j = std::max(0, min_j);
+  max_i = std::min(static_cast<int>(size_x), max_i);
+  max_j = std::min(static_cast<int>(size_y), max_j);
+  if (max_i <= min_i || max_j <= min_j) {
+    return;
+  }
+
+  if (!field_synced_) {
+    field_.update(master_array, 0, 0, size_x, size_y);
+    field_synced_ = true;
+  } else {
+    // Obstacles only change inside this cycle's windows, and the layers below have
+    // finished all of them by now, so the field catches up with every window at the
+    // first one. A window that isn't one of them is only synced on its own.
+    const std::vector<CellRegion::Rect> & windows =
+      layered_costmap_->getUpdatedCells().getRectangles();
+    auto is_window = [&](const CellRegion::Rect & w) {
+        return static_cast<int>(w.min_x) == min_i && static_cast<int>(w.min_y) == min_j &&
+               static_cast<int>(w.max_x) == max_i && static_cast<int>(w.max_y) == max_j;
+      };
+    if (std::none_of(windows.begin(), windows.end(), is_window)) {
+      field_.update(master_array, min_i, min_j, max_i, max_j);
+    } else if (is_window(windows.front())) {
+      for (const CellRegion::Rect & w : windows) {
+        field_.update(master_array, w.min_x, w.min_y, w.max_x, w.max_y);
+      }
+    }
+  }
+
+  // The field reaches every cell within the radius of an obstacle, so unlike the
+  // wavefront only the window itself needs to be written
+  for (int j = min_j; j < max_j; j++) {
+    for (int i = min_i; i < max_i; i++) {
+      unsigned int sx, sy;
+      if (!field_.getNearest(i, j, sx, sy)) {
+        continue;
+      }
+
+      unsigned int index = master_grid.getIndex(i, j);
+      unsigned char cost = costLookup(i, j, sx, sy);
+      unsigned char old_cost = master_array[index];
+      if (old_cost == NO_INFORMATION &&
+        (inflate_unknown_ ? (cost > FREE_SPACE) : (cost >= INSCRIBED_INFLATED_OBSTACLE)))
+      {
+        master_array[index] = cost;
+      } else {
+        master_array[index] = std::max(old_cost, cost);
+      }
+    }
+  }
+}
+
+void
+InflationLayer::updateCostsDistanceTransform(
+  nav2_costmap_2d::Costmap2D & master_grid, int min_i, int min_j,
+  int max_i,
+  int max_j)
+{
+  unsigned char * master_array = master_grid.getCharMap();
+  int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+
+  min_i = std::max(0, min_i);
+  min_j = std::max(0, min_j);
+  max_i = std::min(size_x, max_i);
+  max_j = std::min(size_y, max_j);
+  if (max_i <= min_i || max_j <= min_j) {
+    return;
+  }
+
+  // only obstacles within the inflation radius of the window can reach it
+  int radius = static_cast<int>(cell_inflation_radius_);
+  distance_transform_.compute(
+    master_array, size_x,
+    std::max(0, min_i - radius), std::max(0, min_j - radius),
+    std::min(size_x, max_i + radius), std::min(size_y, max_j + radius),
+    cell_inflation_radius_, layered_costmap_->getThreadPool());
+
+  unsigned int max_squared = cached_square_costs_.size() - 1;
+  forEachRowTile(
+    layered_costmap_->getThreadPool(), min_j, max_j, max_i - min_i, [&](int j0, int jn) {
+      for (int j = j0; j < jn; j++) {
+        for (int i = min_i; i < max_i; i++) {
+          unsigned int squared = distance_transform_.getSquaredDistance(i, j);
+          if (squared > max_squared) {
+            continue;
+          }
+
+          unsigned int index = master_grid.getIndex(i, j);
+          unsigned char cost = cached_square_costs_[squared];
+          unsigned char old_cost = master_array[index];
+          if (old_cost == NO_INFORMATION &&
+            (inflate_unknown_ ? (cost > FREE_SPACE) : (cost >= INSCRIBED_INFLATED_OBSTACLE)))
+          {
+            master_array[index] = cost;
+          } else {
+            master_array[index] = std::max(old_cost, cost);
+          }
+        }
+      }
+    });
 }
 
 /**
@@ -279,16 +468,16 @@ InflationLayer::enqueue(
   if (!seen_[index]) {
     // we compute our distance table one cell further than the
     // inflation radius dictates so we can make the check below
-    double distance = distanceLookup(mx, my, src_x, src_y);
+    unsigned int level = levelLookup(mx, my, src_x, src_y);
 
     // we only want to put the cell in the list if it is within
     // the inflation radius of the obstacle point
-    if (distance > cell_inflation_radius_) {
+    if (level >= inflation_cells_.size()) {
       return;
     }
 
     // push the cell data onto the inflation list and mark
-    inflation_cells_[distance].push_back(CellData(index, mx, my, src_x, src_y));
+    inflation_cells_[level].push_back(CellData(index, mx, my, src_x, src_y));
   }
 }
 
@@ -301,52 +490,36 @@ InflationLayer::computeCaches()
 
   // based on the inflation radius... compute distance and cost caches
   if (cell_inflation_radius_ != cached_cell_inflation_radius_) {
-    deleteKernels();
-
-    cached_costs_ = new unsigned char *[cell_inflation_radius_ + 2];
-    cached_distances_ = new double *[cell_inflation_radius_ + 2];
-
-    for (unsigned int i = 0; i <= cell_inflation_radius_ + 1; ++i) {
-      cached_costs_[i] = new unsigned char[cell_inflation_radius_ + 2];
-      cached_distances_[i] = new double[cell_inflation_radius_ + 2];
-      for (unsigned int j = 0; j <= cell_inflation_radius_ + 1; ++j) {
-        cached_distances_[i][j] = hypot(i, j);
+    cache_length_ = cell_inflation_radius_ + 2;
+    cached_distances_.resize(cache_length_ * cache_length_);
+    for (unsigned int i = 0; i < cache_length_; ++i) {
+      for (unsigned int j = 0; j < cache_length_; ++j) {
+        cached_distances_[i * cache_length_ + j] = hypot(i, j);
       }
     }
 
-    cached_cell_inflation_radius_ = cell_inflation_radius_;
-  }
+    unsigned int num_levels =
+      NearestObstacleField::computeLevels(cell_inflation_radius_, cached_levels_);
+    inflation_cells_.clear();
+    inflation_cells_.resize(num_levels);
 
-  for (unsigned int i = 0; i <= cell_inflation_radius_ + 1; ++i) {
-    for (unsigned int j = 0; j <= cell_inflation_radius_ + 1; ++j) {
-      cached_costs_[i][j] = computeCost(cached_distances_[i][j]);
-    }
+    cached_cell_inflation_radius_ = cell_inflation_radius_;
   }
-}
 
-void
-InflationLayer::deleteKernels()
-{
-  if (cached_distances_ != NULL) {
-    for (unsigned int i = 0; i <= cached_cell_inflation_radius_ + 1; ++i) {
-      if (cached_distances_[i]) {
-        delete[] cached_distances_[i];
-      }
-    }
-    if (cached_distances_) {
-      delete[] cached_distances_;
-    }
-    cached_distances_ = NULL;
+  cached_costs_.resize(cache_length_ * cache_length_);
+  for (unsigned int i = 0; i < cached_costs_.size(); ++i) {
+    cached_costs_[i] = computeCost(cached_distances_[i]);
   }
 
-  if (cached_costs_ != NULL) {
-    for (unsigned int i = 0; i <= cached_cell_inflation_radius_ + 1; ++i) {
-      if (cached_costs_[i]) {
-        delete[] cached_costs_[i];
+  // every squared distance within the radius is the sum of two squares of the table
+  cached_square_costs_.assign(cell_inflation_radius_ * cell_inflation_radius_ + 1, 0);
+  for (unsigned int i = 0; i <= cell_inflation_radius_; ++i) {
+    for (unsigned int j = 0; j <= cell_inflation_radius_; ++j) {
+      unsigned int squared = i * i + j * j;
+      if (squared < cached_square_costs_.size()) {
+        cached_square_costs_[squared] = cached_costs_[i * cache_length_ + j];
       }
     }
-    delete[] cached_costs_;
-    cached_costs_ = NULL;
   }
 }
 
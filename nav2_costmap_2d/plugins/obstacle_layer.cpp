@@ -39,6 +39,8 @@
 #include "nav2_costmap_2d/obstacle_layer.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <memory>
 #include <string>
 #include <vector>
@@ -59,6 +61,24 @@ using nav2_costmap_2d::Observation;
 namespace nav2_costmap_2d
 {
 
+namespace
+{
+
+// Below this many rays, clearing observations aren't worth handing to other threads
+const size_t min_parallel_rays = 2048;
+// Observations raytraced to every point are split into tasks of at least this many rays
+const size_t min_rays_per_task = 256;
+
+size_t numPoints(const Observation & observation)
+{
+  if (observation.scan_) {
+    return observation.scan_->size();
+  }
+  return static_cast<size_t>(observation.cloud_->width) * observation.cloud_->height;
+}
+
+}  // namespace
+
 ObstacleLayer::~ObstacleLayer()
 {
   for (auto & notifier : observation_notifiers_) {
@@ -69,7 +89,9 @@ ObstacleLayer::~ObstacleLayer()
 void ObstacleLayer::onInitialize()
 {
   bool track_unknown_space;
+  bool toroidal_rolling_window = false;
   double transform_tolerance;
+  std::string robot_base_frame;
 
   // The topics that we'll subscribe to from the parameter server
   std::string topics_string;
@@ -89,6 +111,8 @@ void ObstacleLayer::onInitialize()
   node_->get_parameter(name_ + "." + "combination_method", combination_method_);
   node_->get_parameter("track_unknown_space", track_unknown_space);
   node_->get_parameter("transform_tolerance", transform_tolerance);
+  node_->get_parameter("toroidal_rolling_window", toroidal_rolling_window);
+  node_->get_parameter("robot_base_frame", robot_base_frame);
   node_->get_parameter(name_ + "." + "observation_sources", topics_string);
 
   RCLCPP_INFO(node_->get_logger(), "Subscribed to Topics: %s", topics_string.c_str());
@@ -102,6 +126,8 @@ void ObstacleLayer::onInitialize()
   }
 
   ObstacleLayer::matchSize();
+  // a rolling window can scroll by moving the storage offset instead of copying the grid
+  setToroidal(rolling_window_ && toroidal_rolling_window);
   current_ = true;
 
   global_frame_ = layered_costmap_->getGlobalFrameID();
@@ -128,6 +154,10 @@ void ObstacleLayer::onInitialize()
     declareParameter(source + "." + "clearing", rclcpp::ParameterValue(false));
     declareParameter(source + "." + "obstacle_range", rclcpp::ParameterValue(2.5));
     declareParameter(source + "." + "raytrace_range", rclcpp::ParameterValue(3.0));
+    declareParameter(source + "." + "raytrace_mode", rclcpp::ParameterValue(std::string("all")));
+    declareParameter(source + "." + "raytrace_angular_resolution", rclcpp::ParameterValue(0.01));
+    declareParameter(source + "." + "voxel_downsample", rclcpp::ParameterValue(false));
+    declareParameter(source + "." + "native_scan", rclcpp::ParameterValue(false));
 
     node_->get_parameter(name_ + "." + source + "." + "topic", topic);
     node_->get_parameter(name_ + "." + source + "." + "sensor_frame", sensor_frame);
@@ -160,6 +190,40 @@ void ObstacleLayer::onInitialize()
     double raytrace_range;
     node_->get_parameter(name_ + "." + source + "." + "raytrace_range", raytrace_range);
 
+    // get how the raytraces to the points are reduced
+    std::string raytrace_mode_name;
+    double raytrace_angular_resolution;
+    node_->get_parameter(name_ + "." + source + "." + "raytrace_mode", raytrace_mode_name);
+    node_->get_parameter(
+      name_ + "." + source + "." + "raytrace_angular_resolution",
+      raytrace_angular_resolution);
+    Observation::RaytraceMode raytrace_mode;
+    if (raytrace_mode_name == "all") {
+      raytrace_mode = Observation::RAYTRACE_ALL;
+    } else if (raytrace_mode_name == "unique") {
+      raytrace_mode = Observation::RAYTRACE_UNIQUE;
+    } else if (raytrace_mode_name == "angular" && raytrace_angular_resolution > 0.0) {
+      raytrace_mode = Observation::RAYTRACE_ANGULAR_BINS;
+    } else {
+      RCLCPP_FATAL(
+        node_->get_logger(),
+        "raytrace_mode of source %s must be all, unique, or angular with a positive "
+        "raytrace_angular_resolution", source.c_str());
+      throw std::runtime_error(
+              "raytrace_mode must be all, unique, or angular with a positive "
+              "raytrace_angular_resolution");
+    }
+
+    // keep one point per costmap cell sized cube of each cloud
+    bool voxel_downsample;
+    node_->get_parameter(name_ + "." + source + "." + "voxel_downsample", voxel_downsample);
+    double voxel_size = voxel_downsample ? layered_costmap_->getCostmap()->getResolution() : 0.0;
+
+    // optionally buffer laser scans as ranges and a pose instead of projecting them into clouds
+    bool native_scan;
+    node_->get_parameter(name_ + "." + source + "." + "native_scan", native_scan);
+    native_scan = native_scan && supportsPlanarScans();
+
     RCLCPP_DEBUG(
       node_->get_logger(),
       "Creating an observation buffer for source %s, topic %s, frame %s",
@@ -174,7 +238,9 @@ void ObstacleLayer::onInitialize()
           node_, topic, observation_keep_time, expected_update_rate,
           min_obstacle_height,
           max_obstacle_height, obstacle_range, raytrace_range, *tf_, global_frame_,
-          sensor_frame, transform_tolerance)));
+          sensor_frame, transform_tolerance, voxel_size)));
+    observation_buffers_.back()->setRaytraceMode(raytrace_mode, raytrace_angular_resolution);
+    observation_buffers_.back()->setRobotBaseFrame(robot_base_frame);
 
     // check if we'll add this buffer to our marking observation buffers
     if (marking) {
@@ -207,7 +273,13 @@ void ObstacleLayer::onInitialize()
         new tf2_ros::MessageFilter<sensor_msgs::msg::LaserScan>(
           *sub, *tf_, global_frame_, 50, rclcpp_node_));
 
-      if (inf_is_valid) {
+      if (native_scan) {
+        filter->registerCallback(
+          std::bind(
+            &ObstacleLayer::planarScanCallback, this, std::placeholders::_1,
+            observation_buffers_.back(), inf_is_valid));
+
+      } else if (inf_is_valid) {
         filter->registerCallback(
           std::bind(
             &ObstacleLayer::laserScanValidInfCallback, this, std::placeholders::_1,
@@ -284,6 +356,7 @@ ObstacleLayer::laserScanCallback(
   buffer->lock();
   buffer->bufferCloud(cloud);
   buffer->unlock();
+  layered_costmap_->notifyNewData();
 }
 
 void
@@ -320,6 +393,20 @@ ObstacleLayer::laserScanValidInfCallback(
   buffer->lock();
   buffer->bufferCloud(cloud);
   buffer->unlock();
+  layered_costmap_->notifyNewData();
+}
+
+void
+ObstacleLayer::planarScanCallback(
+  sensor_msgs::msg::LaserScan::ConstSharedPtr message,
+  const std::shared_ptr<nav2_costmap_2d::ObservationBuffer> & buffer,
+  bool inf_is_valid)
+{
+  // buffer the ranges, with the pose of the sensor
+  buffer->lock();
+  buffer->bufferScan(*message, inf_is_valid);
+  buffer->unlock();
+  layered_costmap_->notifyNewData();
 }
 
 void
@@ -331,20 +418,57 @@ ObstacleLayer::pointCloud2Callback(
   buffer->lock();
   buffer->bufferCloud(*message);
   buffer->unlock();
+  layered_costmap_->notifyNewData();
 }
 
 void
 ObstacleLayer::updateBounds(
   double robot_x, double robot_y, double robot_yaw, double * min_x,
   double * min_y, double * max_x, double * max_y)
+{
+  WorldRegion region;
+  updateRegion(robot_x, robot_y, robot_yaw, region);
+
+  double region_min_x, region_min_y, region_max_x, region_max_y;
+  if (region.getBounds(region_min_x, region_min_y, region_max_x, region_max_y)) {
+    *min_x = std::min(*min_x, region_min_x);
+    *min_y = std::min(*min_y, region_min_y);
+    *max_x = std::max(*max_x, region_max_x);
+    *max_y = std::max(*max_y, region_max_y);
+  }
+}
+
+void
+ObstacleLayer::updateRegion(
+  double robot_x, double robot_y, double robot_yaw, WorldRegion & region)
 {
   if (rolling_window_) {
     updateOrigin(robot_x - getSizeInMetersX() / 2, robot_y - getSizeInMetersY() / 2);
   }
   if (!enabled_) {
+    changed_ = false;
+    observation_count_ = 0;
     return;
   }
-  useExtraBounds(min_x, min_y, max_x, max_y);
+
+  // the layer changed if an area was cleared, or if a cell ends up with a new value
+  changed_ = has_extra_bounds_;
+
+  // each observation gets its own box, so sensors on opposite sides
+  // of the robot don't make the whole area between them dirty
+  double min_x, min_y, max_x, max_y;
+  auto reset_box = [&]() {
+      min_x = min_y = 1e30;
+      max_x = max_y = -1e30;
+    };
+  auto add_box = [&]() {
+      region.add(min_x, min_y, max_x, max_y);
+      reset_box();
+    };
+
+  reset_box();
+  useExtraBounds(&min_x, &min_y, &max_x, &max_y);
+  add_box();
 
   bool current = true;
   std::vector<Observation> observations, clearing_observations;
@@ -357,10 +481,22 @@ ObstacleLayer::updateBounds(
 
   // update the global current status
   current_ = current;
-
-  // raytrace freespace
-  for (unsigned int i = 0; i < clearing_observations.size(); ++i) {
-    raytraceFreespace(clearing_observations[i], min_x, min_y, max_x, max_y);
+  observation_count_ = observations.size() + clearing_observations.size();
+  recordObservations(observations, clearing_observations);
+
+  // raytrace freespace, on the update threads if there are enough rays to share
+  ThreadPool * pool = layered_costmap_->getThreadPool();
+  size_t num_rays = 0;
+  for (const Observation & obs : clearing_observations) {
+    num_rays += numPoints(obs);
+  }
+  if (pool != nullptr && pool->size() > 1 && num_rays >= min_parallel_rays) {
+    raytraceFreespaceParallel(clearing_observations, *pool, region);
+  } else {
+    for (unsigned int i = 0; i < clearing_observations.size(); ++i) {
+      raytraceFreespace(clearing_observations[i], &min_x, &min_y, &max_x, &max_y);
+      add_box();
+    }
   }
 
   // place the new obstacles into a priority queue... each with a priority of zero to begin with
@@ -369,49 +505,75 @@ ObstacleLayer::updateBounds(
   {
     const Observation & obs = *it;
 
-    const sensor_msgs::msg::PointCloud2 & cloud = *(obs.cloud_);
-
     double sq_obstacle_range = obs.obstacle_range_ * obs.obstacle_range_;
 
-    sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
-    sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
-    sensor_msgs::PointCloud2ConstIterator<float> iter_z(cloud, "z");
-
-    for (; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z) {
-      double px = *iter_x, py = *iter_y, pz = *iter_z;
-
-      // if the obstacle is too high or too far away from the robot we won't add it
-      if (pz > max_obstacle_height_) {
-        RCLCPP_DEBUG(node_->get_logger(), "The point is too high");
-        continue;
+    auto mark = [&](double px, double py, double pz) {
+        // if the obstacle is too high or too far away from the robot we won't add it
+        if (pz > max_obstacle_height_) {
+          RCLCPP_DEBUG(node_->get_logger(), "The point is too high");
+          return;
+        }
+
+        // compute the squared distance from the hitpoint to the pointcloud's origin
+        double sq_dist =
+          (px -
+          obs.origin_.x) * (px - obs.origin_.x) + (py - obs.origin_.y) * (py - obs.origin_.y) +
+          (pz - obs.origin_.z) * (pz - obs.origin_.z);
+
+        // if the point is far enough away... we won't consider it
+        if (sq_dist >= sq_obstacle_range) {
+          RCLCPP_DEBUG(node_->get_logger(), "The point is too far away");
+          return;
+        }
+
+        // now we need to compute the map coordinates for the observation
+        unsigned int mx, my;
+        if (!worldToMap(px, py, mx, my)) {
+          RCLCPP_DEBUG(node_->get_logger(), "Computing map coords failed");
+          return;
+        }
+
+        overwriteCell(getIndex(mx, my), LETHAL_OBSTACLE);
+        touch(px, py, &min_x, &min_y, &max_x, &max_y);
+      };
+
+    if (obs.scan_) {
+      const PlanarScan & scan = *(obs.scan_);
+      double px, py;
+      for (size_t i = 0; i < scan.size(); ++i) {
+        if (scan.getPoint(i, px, py)) {
+          mark(px, py, scan.z_);
+        }
       }
+    } else {
+      const sensor_msgs::msg::PointCloud2 & cloud = *(obs.cloud_);
 
-      // compute the squared distance from the hitpoint to the pointcloud's origin
-      double sq_dist =
-        (px -
-        obs.origin_.x) * (px - obs.origin_.x) + (py - obs.origin_.y) * (py - obs.origin_.y) +
-        (pz - obs.origin_.z) * (pz - obs.origin_.z);
+      sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
+      sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
+      sensor_msgs::PointCloud2ConstIterator<float> iter_z(cloud, "z");
 
-      // if the point is far enough away... we won't consider it
-      if (sq_dist >= sq_obstacle_range) {
-        RCLCPP_DEBUG(node_->get_logger(), "The point is too far away");
-        continue;
+      for (; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z) {
+        mark(*iter_x, *iter_y, *iter_z);
       }
+    }
+    add_box();
+  }
 
-      // now we need to compute the map coordinates for the observation
-      unsigned int mx, my;
-      if (!worldToMap(px, py, mx, my)) {
-        RCLCPP_DEBUG(node_->get_logger(), "Computing map coords failed");
-        continue;
-      }
+  updateFootprint(robot_x, robot_y, robot_yaw, &min_x, &min_y, &max_x, &max_y);
+  add_box();
+  updateChanged();
+}
 
-      unsigned int index = getIndex(mx, my);
-      costmap_[index] = LETHAL_OBSTACLE;
-      touch(px, py, min_x, min_y, max_x, max_y);
+void
+ObstacleLayer::updateChanged()
+{
+  for (const auto & cell : overwritten_cells_) {
+    if (costmap_[cell.first] != cell.second) {
+      changed_ = true;
+      break;
     }
   }
-
-  updateFootprint(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
+  overwritten_cells_.clear();
 }
 
 void
@@ -427,6 +589,21 @@ ObstacleLayer::updateFootprint(
   for (unsigned int i = 0; i < transformed_footprint_.size(); i++) {
     touch(transformed_footprint_[i].x, transformed_footprint_[i].y, min_x, min_y, max_x, max_y);
   }
+
+  // as setConvexPolygonCost(), but through overwriteCell()
+  std::vector<MapLocation> map_polygon;
+  for (const auto & point : transformed_footprint_) {
+    MapLocation loc;
+    if (!worldToMap(point.x, point.y, loc.x, loc.y)) {
+      return;
+    }
+    map_polygon.push_back(loc);
+  }
+  footprint_cells_.clear();
+  convexFillCells(map_polygon, footprint_cells_);
+  for (const MapLocation & cell : footprint_cells_) {
+    overwriteCell(getIndex(cell.x, cell.y), FREE_SPACE);
+  }
 }
 
 void
@@ -439,10 +616,6 @@ ObstacleLayer::updateCosts(
     return;
   }
 
-  if (footprint_clearing_enabled_) {
-    setConvexPolygonCost(transformed_footprint_, nav2_costmap_2d::FREE_SPACE);
-  }
-
   switch (combination_method_) {
     case 0:  // Overwrite
       updateWithOverwrite(master_grid, min_i, min_j, max_i, max_j);
@@ -479,6 +652,15 @@ ObstacleLayer::clearStaticObservations(bool marking, bool clearing)
   }
 }
 
+void
+ObstacleLayer::setReplayedObservations(
+  const std::vector<Observation> & marking,
+  const std::vector<Observation> & clearing)
+{
+  static_marking_observations_ = marking;
+  static_clearing_observations_ = clearing;
+}
+
 bool
 ObstacleLayer::getMarkingObservations(std::vector<Observation> & marking_observations) const
 {
@@ -513,6 +695,17 @@ ObstacleLayer::getClearingObservations(std::vector<Observation> & clearing_obser
   return current;
 }
 
+void
+ObstacleLayer::recordObservations(
+  const std::vector<Observation> & marking_observations,
+  const std::vector<Observation> & clearing_observations)
+{
+  SensorLogWriter * sensor_log = layered_costmap_->getSensorLog();
+  if (sensor_log != nullptr) {
+    sensor_log->addObservations(name_, marking_observations, clearing_observations);
+  }
+}
+
 void
 ObstacleLayer::raytraceFreespace(
   const Observation & clearing_observation, double * min_x,
@@ -522,7 +715,6 @@ ObstacleLayer::raytraceFreespace(
 {
   double ox = clearing_observation.origin_.x;
   double oy = clearing_observation.origin_.y;
-  const sensor_msgs::msg::PointCloud2 & cloud = *(clearing_observation.cloud_);
 
   // get the map coordinates of the origin of the sensor
   unsigned int x0, y0;
@@ -534,68 +726,201 @@ ObstacleLayer::raytraceFreespace(
     return;
   }
 
+  touch(ox, oy, min_x, min_y, max_x, max_y);
+
+  raytraceRays(
+    clearing_observation, 0, numPoints(clearing_observation), ClearCell(*this),
+    raytrace_scratch_, min_x, min_y, max_x, max_y);
+}
+
+void
+ObstacleLayer::raytraceFreespaceParallel(
+  const std::vector<Observation> & clearing_observations,
+  ThreadPool & pool, WorldRegion & region)
+{
+  struct Task
+  {
+    size_t observation, begin, end;
+    double min_x, min_y, max_x, max_y;
+  };
+
+  // observations reduced by endpoint or bin are traced by one task each,
+  // the others are split so the threads get about the same number of rays
+  unsigned int num_threads = pool.size();
+  size_t num_rays = 0;
+  for (const Observation & obs : clearing_observations) {
+    num_rays += numPoints(obs);
+  }
+  size_t rays_per_task = std::max(min_rays_per_task, num_rays / (4 * num_threads) + 1);
+
+  std::vector<Task> tasks;
+  for (size_t i = 0; i < clearing_observations.size(); ++i) {
+    const Observation & obs = clearing_observations[i];
+    unsigned int x0, y0;
+    if (!worldToMap(obs.origin_.x, obs.origin_.y, x0, y0)) {
+      RCLCPP_WARN(
+        node_->get_logger(),
+        "Sensor origin at (%.2f, %.2f) is out of map bounds. The costmap cannot raytrace for it.",
+        obs.origin_.x, obs.origin_.y);
+      continue;
+    }
+    size_t n = numPoints(obs);
+    size_t step = obs.raytrace_mode_ == Observation::RAYTRACE_ALL ? rays_per_task : n;
+    size_t begin = 0;
+    do {
+      size_t end = std::min(n, begin + step);
+      tasks.push_back(Task{i, begin, end, 1e30, 1e30, -1e30, -1e30});
+      begin = end;
+    } while (begin < n);
+  }
+
+  // each thread clears into its own mask, and the masks are written to the grid together
+  clearing_masks_.resize(num_threads, static_cast<size_t>(size_x_) * size_y_);
+  parallel_scratch_.resize(num_threads);
+  std::atomic<size_t> next_task(0);
+  pool.parallelFor(
+    num_threads, [&](unsigned int thread) {
+      size_t t;
+      while ((t = next_task++) < tasks.size()) {
+        Task & task = tasks[t];
+        raytraceRays(
+          clearing_observations[task.observation], task.begin, task.end,
+          clearing_masks_.setCell(thread), parallel_scratch_[thread],
+          &task.min_x, &task.min_y, &task.max_x, &task.max_y);
+      }
+    });
+  overwritten_scratch_.clear();
+  clearing_masks_.apply(costmap_, FREE_SPACE, &pool, &overwritten_scratch_);
+  for (const auto & cell : overwritten_scratch_) {
+    overwritten_cells_.emplace(cell.first, cell.second);
+  }
+
+  // one box per observation, as when raytracing them in turn
+  size_t t = 0;
+  while (t < tasks.size()) {
+    const Observation & obs = clearing_observations[tasks[t].observation];
+    double min_x = 1e30, min_y = 1e30, max_x = -1e30, max_y = -1e30;
+    touch(obs.origin_.x, obs.origin_.y, &min_x, &min_y, &max_x, &max_y);
+    size_t observation = tasks[t].observation;
+    for (; t < tasks.size() && tasks[t].observation == observation; ++t) {
+      min_x = std::min(min_x, tasks[t].min_x);
+      min_y = std::min(min_y, tasks[t].min_y);
+      max_x = std::max(max_x, tasks[t].max_x);
+      max_y = std::max(max_y, tasks[t].max_y);
+    }
+    region.add(min_x, min_y, max_x, max_y);
+  }
+}
+
+template<class ActionType>
+void
+ObstacleLayer::raytraceRays(
+  const Observation & clearing_observation, size_t begin, size_t end,
+  ActionType action, RaytraceScratch & scratch,
+  double * min_x, double * min_y, double * max_x, double * max_y)
+{
+  double ox = clearing_observation.origin_.x;
+  double oy = clearing_observation.origin_.y;
+  unsigned int x0, y0;
+  worldToMap(ox, oy, x0, y0);
+
   // we can pre-compute the enpoints of the map outside of the inner loop... we'll need these later
   double origin_x = origin_x_, origin_y = origin_y_;
   double map_end_x = origin_x + size_x_ * resolution_;
   double map_end_y = origin_y + size_y_ * resolution_;
 
+  unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
+  const Observation::RaytraceMode mode = clearing_observation.raytrace_mode_;
+  const double bin_size = clearing_observation.raytrace_angular_resolution_;
+  scratch.endpoints.clear();
+  scratch.bins.clear();
+
+  // for each point, we want to trace a line from the origin and clear obstacles along it
+  auto clear = [&](double wx, double wy) {
+      // now we also need to make sure that the enpoint we're raytracing
+      // to isn't off the costmap and scale if necessary
+      double a = wx - ox;
+      double b = wy - oy;
+
+      // the minimum value to raytrace from is the origin
+      if (wx < origin_x) {
+        double t = (origin_x - ox) / a;
+        wx = origin_x;
+        wy = oy + b * t;
+      }
+      if (wy < origin_y) {
+        double t = (origin_y - oy) / b;
+        wx = ox + a * t;
+        wy = origin_y;
+      }
 
-  touch(ox, oy, min_x, min_y, max_x, max_y);
+      // the maximum value to raytrace to is the end of the map
+      if (wx > map_end_x) {
+        double t = (map_end_x - ox) / a;
+        wx = map_end_x - .001;
+        wy = oy + b * t;
+      }
+      if (wy > map_end_y) {
+        double t = (map_end_y - oy) / b;
+        wx = ox + a * t;
+        wy = map_end_y - .001;
+      }
 
-  // for each point in the cloud, we want to trace a line from the origin
-  // and clear obstacles along it
-  sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
-  sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
-
-  for (; iter_x != iter_x.end(); ++iter_x, ++iter_y) {
-    double wx = *iter_x;
-    double wy = *iter_y;
-
-    // now we also need to make sure that the enpoint we're raytracing
-    // to isn't off the costmap and scale if necessary
-    double a = wx - ox;
-    double b = wy - oy;
-
-    // the minimum value to raytrace from is the origin
-    if (wx < origin_x) {
-      double t = (origin_x - ox) / a;
-      wx = origin_x;
-      wy = oy + b * t;
-    }
-    if (wy < origin_y) {
-      double t = (origin_y - oy) / b;
-      wx = ox + a * t;
-      wy = origin_y;
-    }
+      // now that the vector is scaled correctly... we'll get the map coordinates of its endpoint
+      unsigned int x1, y1;
 
-    // the maximum value to raytrace to is the end of the map
-    if (wx > map_end_x) {
-      double t = (map_end_x - ox) / a;
-      wx = map_end_x - .001;
-      wy = oy + b * t;
-    }
-    if (wy > map_end_y) {
-      double t = (map_end_y - oy) / b;
-      wx = ox + a * t;
-      wy = map_end_y - .001;
-    }
+      // check for legality just in case
+      if (!worldToMap(wx, wy, x1, y1)) {
+        return;
+      }
 
-    // now that the vector is scaled correctly... we'll get the map coordinates of its endpoint
-    unsigned int x1, y1;
+      updateRaytraceBounds(
+        ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x,
+        max_y);
+
+      if (mode == Observation::RAYTRACE_UNIQUE) {
+        // lines are traced between cells, so one per endpoint cell clears the same cells
+        if (!scratch.endpoints.insert(getIndex(x1, y1)).second) {
+          return;
+        }
+      } else if (mode == Observation::RAYTRACE_ANGULAR_BINS) {
+        // only the farthest endpoint of each bin is traced, after the loop
+        double dx = wx - ox, dy = wy - oy;
+        int bin = static_cast<int>(std::floor((std::atan2(dy, dx) + M_PI) / bin_size));
+        double distance = dx * dx + dy * dy;
+        auto inserted = scratch.bins.insert({bin, RaytraceEndpoint{x1, y1, distance}});
+        if (!inserted.second && inserted.first->second.distance < distance) {
+          inserted.first->second = RaytraceEndpoint{x1, y1, distance};
+        }
+        return;
+      }
 
-    // check for legality just in case
-    if (!worldToMap(wx, wy, x1, y1)) {
-      continue;
+      // and finally... we can execute our trace to clear obstacles along that line
+      raytraceLine(action, x0, y0, x1, y1, cell_raytrace_range);
+    };
+
+  if (clearing_observation.scan_) {
+    const PlanarScan & scan = *(clearing_observation.scan_);
+    double wx, wy;
+    for (size_t i = begin; i < end; ++i) {
+      if (scan.getPoint(i, wx, wy)) {
+        clear(wx, wy);
+      }
     }
+  } else {
+    const sensor_msgs::msg::PointCloud2 & cloud = *(clearing_observation.cloud_);
+    sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
+    sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
+    iter_x += static_cast<int>(begin);
+    iter_y += static_cast<int>(begin);
 
-    unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
-    MarkCell marker(costmap_, FREE_SPACE);
-    // and finally... we can execute our trace to clear obstacles along that line
-    raytraceLine(marker, x0, y0, x1, y1, cell_raytrace_range);
+    for (size_t i = begin; i < end; ++i, ++iter_x, ++iter_y) {
+      clear(*iter_x, *iter_y);
+    }
+  }
 
-    updateRaytraceBounds(
-      ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x,
-      max_y);
+  for (const auto & bin : scratch.bins) {
+    raytraceLine(action, x0, y0, bin.second.x, bin.second.y, cell_raytrace_range);
   }
 }
 
@@ -41,9 +41,11 @@
 
 #include <algorithm>
 #include <memory>
+#include <stdexcept>
 #include <string>
 
 #include "nav2_costmap_2d/costmap_math.hpp"
+#include "nav2_costmap_2d/costmap_snapshot.hpp"
 #include "pluginlib/class_list_macros.hpp"
 #include "tf2/convert.h"
 #include "tf2_geometry_msgs/tf2_geometry_msgs.h"
@@ -222,6 +224,72 @@ StaticLayer::matchSize()
   }
 }
 
+bool
+StaticLayer::saveSnapshot(const std::string & file_name, const std::string & name) const
+{
+  return Costmap2D::saveSnapshot(file_name, name, map_frame_);
+}
+
+bool
+StaticLayer::loadSnapshot(const std::string & file_name, const std::string & name)
+{
+  std::string map_frame;
+  try {
+    CostmapSnapshot snapshot(file_name);
+    const CostmapSnapshotHeader & header = snapshot.getHeader();
+    map_frame = snapshot.getFrame();
+
+    if (!name.empty() && snapshot.getName() != name) {
+      RCLCPP_WARN(
+        node_->get_logger(), "The costmap snapshot %s is of %s, not of %s", file_name.c_str(),
+        snapshot.getName().c_str(), name.c_str());
+      return false;
+    }
+    // without its frame, the map couldn't be transformed into a rolling window
+    // nor checked against the updates
+    if (map_frame.empty()) {
+      RCLCPP_WARN(
+        node_->get_logger(), "The costmap snapshot %s has no frame", file_name.c_str());
+      return false;
+    }
+
+    // the costmap takes the size of the map, as it does when the map is received
+    Costmap2D * master = layered_costmap_->getCostmap();
+    if (!layered_costmap_->isRolling() && (master->getSizeInCellsX() != header.size_x ||
+      master->getSizeInCellsY() != header.size_y ||
+      master->getResolution() != header.resolution ||
+      master->getOriginX() != header.origin_x ||
+      master->getOriginY() != header.origin_y))
+    {
+      layered_costmap_->resizeMap(
+        header.size_x, header.size_y, header.resolution, header.origin_x, header.origin_y,
+        true);
+    }
+  } catch (const std::runtime_error & e) {
+    RCLCPP_WARN(node_->get_logger(), "%s", e.what());
+    return false;
+  }
+
+  {
+    std::lock_guard<Costmap2D::mutex_t> guard(*getMutex());
+    if (!Costmap2D::loadSnapshot(file_name, name)) {
+      return false;
+    }
+    map_frame_ = map_frame;
+
+    // the whole map is new
+    x_ = y_ = 0;
+    width_ = size_x_;
+    height_ = size_y_;
+    has_updated_data_ = true;
+    map_received_ = true;
+
+    current_ = true;
+  }
+  layered_costmap_->notifyNewData();
+  return true;
+}
+
 unsigned char
 StaticLayer::interpretValue(unsigned char value)
 {
@@ -248,6 +316,7 @@ StaticLayer::incomingMap(const nav_msgs::msg::OccupancyGrid::SharedPtr new_map)
   if (!map_received_) {
     map_received_ = true;
   }
+  layered_costmap_->notifyNewData();
 }
 
 void
@@ -291,6 +360,7 @@ StaticLayer::incomingUpdate(map_msgs::msg::OccupancyGridUpdate::ConstSharedPtr u
   width_ = update->width;
   height_ = update->height;
   has_updated_data_ = true;
+  layered_costmap_->notifyNewData();
 }
 
 
@@ -302,10 +372,12 @@ StaticLayer::updateBounds(
   double * max_y)
 {
   if (!map_received_) {
+    changed_ = false;
     return;
   }
 
   std::lock_guard<Costmap2D::mutex_t> guard(*getMutex());
+  changed_ = has_updated_data_ || has_extra_bounds_;
   if (!layered_costmap_->isRolling() ) {
     if (!(has_updated_data_ || has_extra_bounds_)) {
       return;
@@ -40,13 +40,15 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <string>
 #include <vector>
 
 #include "pluginlib/class_list_macros.hpp"
 #include "sensor_msgs/point_cloud2_iterator.hpp"
 
-#define VOXEL_BITS 16
 PLUGINLIB_EXPORT_CLASS(nav2_costmap_2d::VoxelLayer, nav2_costmap_2d::Layer)
+PLUGINLIB_EXPORT_CLASS(nav2_costmap_2d::VoxelLayer64, nav2_costmap_2d::Layer)
 
 using nav2_costmap_2d::NO_INFORMATION;
 using nav2_costmap_2d::LETHAL_OBSTACLE;
@@ -55,7 +57,8 @@ using nav2_costmap_2d::FREE_SPACE;
 namespace nav2_costmap_2d
 {
 
-void VoxelLayer::onInitialize()
+template<class ColumnT>
+void BasicVoxelLayer<ColumnT>::onInitialize()
 {
   ObstacleLayer::onInitialize();
 
@@ -69,6 +72,7 @@ void VoxelLayer::onInitialize()
   declareParameter("mark_threshold", rclcpp::ParameterValue(0));
   declareParameter("combination_method", rclcpp::ParameterValue(1));
   declareParameter("publish_voxel_map", rclcpp::ParameterValue(false));
+  declareParameter("voxel_backend", rclcpp::ParameterValue(std::string("dense")));
 
   node_->get_parameter(name_ + "." + "enabled", enabled_);
   node_->get_parameter(name_ + "." + "footprint_clearing_enabled", footprint_clearing_enabled_);
@@ -80,6 +84,14 @@ void VoxelLayer::onInitialize()
   node_->get_parameter(name_ + "." + "mark_threshold", mark_threshold_);
   node_->get_parameter(name_ + "." + "combination_method", combination_method_);
   node_->get_parameter(name_ + "." + "publish_voxel_map", publish_voxel_);
+  std::string voxel_backend;
+  node_->get_parameter(name_ + "." + "voxel_backend", voxel_backend);
+  sparse_ = voxel_backend == "sparse";
+  if (!sparse_ && voxel_backend != "dense") {
+    RCLCPP_WARN(
+      node_->get_logger(),
+      "Unknown voxel_backend '%s' for %s, using 'dense'", voxel_backend.c_str(), name_.c_str());
+  }
 
   auto custom_qos = rclcpp::QoS(rclcpp::KeepLast(1)).transient_local().reliable();
 
@@ -93,49 +105,95 @@ void VoxelLayer::onInitialize()
   clearing_endpoints_pub_ = node_->create_publisher<sensor_msgs::msg::PointCloud>(
     "clearing_endpoints", custom_qos);
 
-  unknown_threshold_ += (VOXEL_BITS - size_z_);
+  // the sparse grid has no limit on z_voxels, and counts the unknown voxels over them only
+  const unsigned int levels = nav2_voxel_grid::BasicVoxelGrid<ColumnT>::LEVELS;
+  if (!sparse_) {
+    if (size_z_ > static_cast<int>(levels)) {
+      RCLCPP_WARN(
+        node_->get_logger(),
+        "z_voxels is %d but this voxel layer only has %u levels, VoxelLayer64 has 32",
+        size_z_, levels);
+      size_z_ = levels;
+    }
+
+    // the levels above the grid are always unknown
+    unknown_threshold_ += (levels - size_z_);
+  }
   matchSize();
 }
 
-VoxelLayer::~VoxelLayer()
+template<class ColumnT>
+BasicVoxelLayer<ColumnT>::~BasicVoxelLayer()
 {
 }
 
-void VoxelLayer::matchSize()
+template<class ColumnT>
+void BasicVoxelLayer<ColumnT>::matchSize()
 {
   ObstacleLayer::matchSize();
+  if (sparse_) {
+    sparse_grid_.resize(size_x_, size_y_, size_z_);
+    sparse_grid_.setToroidal(isToroidal());
+    return;
+  }
   voxel_grid_.resize(size_x_, size_y_, size_z_);
+  voxel_grid_.setToroidal(isToroidal());
   assert(voxel_grid_.sizeX() == size_x_ && voxel_grid_.sizeY() == size_y_);
 }
 
-void VoxelLayer::reset()
+template<class ColumnT>
+void BasicVoxelLayer<ColumnT>::reset()
 {
   // Call the base class method before adding our own functionality
   ObstacleLayer::reset();
   resetMaps();
+  sparse_grid_.reset();
 }
 
-void VoxelLayer::resetMaps()
+template<class ColumnT>
+void BasicVoxelLayer<ColumnT>::resetMaps()
 {
   // Call the base class method before adding our own functionality
   // Note: at the time this was written, ObstacleLayer doesn't implement
   // resetMaps so this goes to the next layer down Costmap2DLayer which also
   // doesn't implement this, so it actually goes all the way to Costmap2D
   ObstacleLayer::resetMaps();
-  voxel_grid_.reset();
+
+  // the sparse grid follows the origin on its own in updateOrigin(), which resets the maps
+  if (!sparse_) {
+    voxel_grid_.reset();
+  }
 }
 
-void VoxelLayer::updateBounds(
-  double robot_x, double robot_y, double robot_yaw, double * min_x,
-  double * min_y, double * max_x, double * max_y)
+template<class ColumnT>
+void BasicVoxelLayer<ColumnT>::updateRegion(
+  double robot_x, double robot_y, double robot_yaw, WorldRegion & region)
 {
   if (rolling_window_) {
     updateOrigin(robot_x - getSizeInMetersX() / 2, robot_y - getSizeInMetersY() / 2);
   }
   if (!enabled_) {
+    changed_ = false;
+    observation_count_ = 0;
     return;
   }
-  useExtraBounds(min_x, min_y, max_x, max_y);
+
+  // the layer changed if an area was cleared, or if a cell ends up with a new value
+  changed_ = has_extra_bounds_;
+
+  double min_x, min_y, max_x, max_y;
+  auto reset_box = [&]() {
+      min_x = min_y = 1e30;
+      max_x = max_y = -1e30;
+    };
+  auto add_box = [&]() {
+      region.add(min_x, min_y, max_x, max_y);
+      reset_box();
+    };
+
+  reset_box();
+  useExtraBounds(&min_x, &min_y, &max_x, &max_y);
+  add_box();
 
   bool current = true;
   std::vector<Observation> observations, clearing_observations;
@@ -148,10 +206,13 @@ void VoxelLayer::updateBounds(
 
   // update the global current status
   current_ = current;
+  observation_count_ = observations.size() + clearing_observations.size();
+  recordObservations(observations, clearing_observations);
 
   // raytrace freespace
   for (unsigned int i = 0; i < clearing_observations.size(); ++i) {
-    raytraceFreespace(clearing_observations[i], min_x, min_y, max_x, max_y);
+    raytraceFreespace(clearing_observations[i], &min_x, &min_y, &max_x, &max_y);
+    add_box();
   }
 
   // place the new obstacles into a priority queue... each with a priority of zero to begin with
@@ -194,26 +255,51 @@ void VoxelLayer::updateBounds(
         continue;
       }
 
+      if (sparse_) {
+        sparse_grid_.markVoxel(mx, my, mz);
+        continue;
+      }
+
       // mark the cell in the voxel grid and check if we should also mark it in the costmap
       if (voxel_grid_.markVoxelInMap(mx, my, mz, mark_threshold_)) {
-        unsigned int index = getIndex(mx, my);
-
-        costmap_[index] = LETHAL_OBSTACLE;
+        overwriteCell(getIndex(mx, my), LETHAL_OBSTACLE);
         touch(
           static_cast<double>(*iter_x), static_cast<double>(*iter_y),
-          min_x, min_y, max_x, max_y);
+          &min_x, &min_y, &max_x, &max_y);
       }
     }
+    add_box();
+  }
+
+  if (sparse_) {
+    projectColumns(&min_x, &min_y, &max_x, &max_y);
+    add_box();
   }
 
   if (publish_voxel_) {
     nav2_msgs::msg::VoxelGrid grid_msg;
-    unsigned int size = voxel_grid_.sizeX() * voxel_grid_.sizeY();
-    grid_msg.size_x = voxel_grid_.sizeX();
-    grid_msg.size_y = voxel_grid_.sizeY();
-    grid_msg.size_z = voxel_grid_.sizeZ();
-    grid_msg.data.resize(size);
-    memcpy(&grid_msg.data[0], voxel_grid_.getData(), size * sizeof(unsigned int));
+    unsigned int size = size_x_ * size_y_;
+    grid_msg.size_x = size_x_;
+    grid_msg.size_y = size_y_;
+    const unsigned int levels = nav2_voxel_grid::BasicVoxelGrid<ColumnT>::LEVELS;
+    grid_msg.size_z = sparse_ ? std::min(sparse_grid_.sizeZ(), levels) : voxel_grid_.sizeZ();
+    // wider columns are split in 32 bit words, least significant first
+    const unsigned int num_words = sizeof(ColumnT) / sizeof(uint32_t);
+    grid_msg.data.resize(size * num_words);
+    if (sparse_ || voxel_grid_.isToroidal() || num_words > 1) {
+      // unwrap the storage so the message is laid out row by row from the origin
+      for (unsigned int y = 0; y < grid_msg.size_y; ++y) {
+        for (unsigned int x = 0; x < grid_msg.size_x; ++x) {
+          ColumnT column = getColumn(x, y);
+          uint32_t * words = &grid_msg.data[(y * grid_msg.size_x + x) * num_words];
+          for (unsigned int w = 0; w < num_words; ++w) {
+            words[w] = static_cast<uint32_t>(column >> (32 * w));
+          }
+        }
+      }
+    } else {
+      memcpy(&grid_msg.data[0], voxel_grid_.getData(), size * sizeof(uint32_t));
+    }
 
     grid_msg.origin.x = origin_x_;
     grid_msg.origin.y = origin_y_;
@@ -227,10 +313,13 @@ void VoxelLayer::updateBounds(
     voxel_pub_->publish(grid_msg);
   }
 
-  updateFootprint(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
+  updateFootprint(robot_x, robot_y, robot_yaw, &min_x, &min_y, &max_x, &max_y);
+  add_box();
+  updateChanged();
 }
 
-void VoxelLayer::clearNonLethal(
+template<class ColumnT>
+void BasicVoxelLayer<ColumnT>::clearNonLethal(
   double wx, double wy, double w_size_x, double w_size_y,
   bool clear_no_info)
 {
@@ -263,27 +352,28 @@ void VoxelLayer::clearNonLethal(
 
   // we know that we want to clear all non-lethal obstacles in this
   // window to get it ready for inflation
-  unsigned int index = getIndex(map_sx, map_sy);
-  unsigned char * current = &costmap_[index];
   for (unsigned int j = map_sy; j <= map_ey; ++j) {
     for (unsigned int i = map_sx; i <= map_ex; ++i) {
+      unsigned int index = getIndex(i, j);
+      unsigned char * current = &costmap_[index];
       // if the cell is a lethal obstacle... we'll keep it and queue it,
       // otherwise... we'll clear it
       if (*current != LETHAL_OBSTACLE) {
         if (clear_no_info || *current != NO_INFORMATION) {
           *current = FREE_SPACE;
-          voxel_grid_.clearVoxelColumn(index);
+          if (sparse_) {
+            sparse_grid_.clearVoxelColumn(i, j);
+          } else {
+            voxel_grid_.clearVoxelColumn(index);
+          }
         }
       }
-      current++;
-      index++;
     }
-    current += size_x_ - (map_ex - map_sx) - 1;
-    index += size_x_ - (map_ex - map_sx) - 1;
   }
 }
 
-void VoxelLayer::raytraceFreespace(
+template<class ColumnT>
+void BasicVoxelLayer<ColumnT>::raytraceFreespace(
   const Observation & clearing_observation, double * min_x,
   double * min_y,
   double * max_x,
@@ -308,6 +398,9 @@ void VoxelLayer::raytraceFreespace(
     return;
   }
 
+  // the rays clear from the sensor, which may be outside the box of their endpoints
+  touch(ox, oy, min_x, min_y, max_x, max_y);
+
   bool publish_clearing_points = (node_->count_subscribers("clearing_endpoints") > 0);
   if (publish_clearing_points) {
     clearing_endpoints_.points.clear();
@@ -319,6 +412,39 @@ void VoxelLayer::raytraceFreespace(
   double map_end_y = origin_y_ + getSizeInMetersY();
   double map_end_z = origin_z_ + getSizeInMetersZ();
 
+  unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
+  auto trace = [&](
+    double point_x, double point_y, double point_z, double wpx, double wpy, double wpz) {
+      // voxel_grid_.markVoxelLine(sensor_x, sensor_y, sensor_z, point_x, point_y, point_z);
+      if (sparse_) {
+        sparse_grid_.clearVoxelLine(
+          sensor_x, sensor_y, sensor_z, point_x, point_y, point_z, cell_raytrace_range);
+      } else {
+        voxel_grid_.clearVoxelLineWithCosts(
+          sensor_x, sensor_y, sensor_z, point_x, point_y, point_z,
+          [this](unsigned int index, unsigned char cost) {
+            overwriteCell(index, cost);
+          },
+          unknown_threshold_, mark_threshold_, FREE_SPACE, NO_INFORMATION,
+          cell_raytrace_range);
+      }
+
+      if (publish_clearing_points) {
+        geometry_msgs::msg::Point32 point;
+        point.x = wpx;
+        point.y = wpy;
+        point.z = wpz;
+        clearing_endpoints_.points.push_back(point);
+      }
+    };
+
+  const Observation::RaytraceMode mode = clearing_observation.raytrace_mode_;
+  const double bin_size = clearing_observation.raytrace_angular_resolution_;
+  const int64_t elevation_bins = mode == Observation::RAYTRACE_ANGULAR_BINS ?
+    static_cast<int64_t>(std::ceil(M_PI / bin_size)) + 1 : 0;
+  raytrace_voxels_.clear();
+  raytrace_voxel_bins_.clear();
+
   sensor_msgs::PointCloud2ConstIterator<float> iter_x(*(clearing_observation.cloud_), "x");
   sensor_msgs::PointCloud2ConstIterator<float> iter_y(*(clearing_observation.cloud_), "y");
   sensor_msgs::PointCloud2ConstIterator<float> iter_z(*(clearing_observation.cloud_), "z");
@@ -372,30 +498,46 @@ void VoxelLayer::raytraceFreespace(
 
     double point_x, point_y, point_z;
     if (worldToMap3DFloat(wpx, wpy, wpz, point_x, point_y, point_z)) {
-      unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
-
-      // voxel_grid_.markVoxelLine(sensor_x, sensor_y, sensor_z, point_x, point_y, point_z);
-      voxel_grid_.clearVoxelLineInMap(
-        sensor_x, sensor_y, sensor_z, point_x, point_y, point_z,
-        costmap_,
-        unknown_threshold_, mark_threshold_, FREE_SPACE, NO_INFORMATION,
-        cell_raytrace_range);
-
       updateRaytraceBounds(
         ox, oy, wpx, wpy, clearing_observation.raytrace_range_, min_x, min_y,
         max_x,
         max_y);
 
-      if (publish_clearing_points) {
-        geometry_msgs::msg::Point32 point;
-        point.x = wpx;
-        point.y = wpy;
-        point.z = wpz;
-        clearing_endpoints_.points.push_back(point);
+      if (mode == Observation::RAYTRACE_UNIQUE) {
+        // lines start and end inside the voxels, so this traces to the first point of
+        // each voxel, which clears nearly but not exactly the same voxels as all of them
+        uint64_t voxel = static_cast<uint64_t>(point_x) + static_cast<uint64_t>(size_x_) *
+          (static_cast<uint64_t>(point_y) + static_cast<uint64_t>(size_y_) *
+          static_cast<uint64_t>(point_z));
+        if (!raytrace_voxels_.insert(voxel).second) {
+          continue;
+        }
+      } else if (mode == Observation::RAYTRACE_ANGULAR_BINS) {
+        // only the farthest endpoint of each bin of azimuth and elevation is traced
+        double dx = wpx - ox, dy = wpy - oy, dz = wpz - oz;
+        int64_t azimuth = static_cast<int64_t>(
+          std::floor((std::atan2(dy, dx) + M_PI) / bin_size));
+        int64_t elevation = static_cast<int64_t>(
+          std::floor((std::atan2(dz, std::hypot(dx, dy)) + M_PI / 2) / bin_size));
+        double distance = dx * dx + dy * dy + dz * dz;
+        VoxelEndpoint endpoint{point_x, point_y, point_z, wpx, wpy, wpz, distance};
+        auto inserted =
+          raytrace_voxel_bins_.insert({azimuth * elevation_bins + elevation, endpoint});
+        if (!inserted.second && inserted.first->second.distance < distance) {
+          inserted.first->second = endpoint;
+        }
+        continue;
       }
+
+      trace(point_x, point_y, point_z, wpx, wpy, wpz);
     }
   }
 
+  for (const auto & bin : raytrace_voxel_bins_) {
+    const VoxelEndpoint & e = bin.second;
+    trace(e.x, e.y, e.z, e.wx, e.wy, e.wz);
+  }
+
   if (publish_clearing_points) {
     clearing_endpoints_.header.frame_id = global_frame_;
     clearing_endpoints_.header.stamp = clearing_observation.cloud_->header.stamp;
@@ -404,7 +546,8 @@ void VoxelLayer::raytraceFreespace(
   }
 }
 
-void VoxelLayer::updateOrigin(double new_origin_x, double new_origin_y)
+template<class ColumnT>
+void BasicVoxelLayer<ColumnT>::updateOrigin(double new_origin_x, double new_origin_y)
 {
   // project the new origin into the grid
   int cell_ox, cell_oy;
@@ -417,6 +560,20 @@ void VoxelLayer::updateOrigin(double new_origin_x, double new_origin_y)
   new_grid_ox = origin_x_ + cell_ox * resolution_;
   new_grid_oy = origin_y_ + cell_oy * resolution_;
 
+  if (sparse_) {
+    // the sparse grid keeps the voxels still in view in both layouts
+    Costmap2D::updateOrigin(new_origin_x, new_origin_y);
+    sparse_grid_.updateOrigin(cell_ox, cell_oy);
+    return;
+  }
+
+  if (isToroidal()) {
+    // only the storage offsets move, so keep the costmap and voxel grid in step
+    Costmap2D::updateOrigin(new_origin_x, new_origin_y);
+    voxel_grid_.updateOrigin(cell_ox, cell_oy);
+    return;
+  }
+
   // To save casting from unsigned int to int a bunch of times
   int size_x = size_x_;
   int size_y = size_y_;
@@ -433,8 +590,8 @@ void VoxelLayer::updateOrigin(double new_origin_x, double new_origin_y)
 
   // we need a map to store the obstacles in the window temporarily
   unsigned char * local_map = new unsigned char[cell_size_x * cell_size_y];
-  unsigned int * local_voxel_map = new unsigned int[cell_size_x * cell_size_y];
-  unsigned int * voxel_map = voxel_grid_.getData();
+  ColumnT * local_voxel_map = new ColumnT[cell_size_x * cell_size_y];
+  ColumnT * voxel_map = voxel_grid_.getData();
 
   // copy the local window in the costmap to the local map
   copyMapRegion(
@@ -471,4 +628,61 @@ void VoxelLayer::updateOrigin(double new_origin_x, double new_origin_y)
   delete[] local_voxel_map;
 }
 
+template<class ColumnT>
+void BasicVoxelLayer<ColumnT>::projectColumns(
+  double * min_x, double * min_y, double * max_x, double * max_y)
+{
+  sparse_grid_.takeChangedColumns(changed_columns_);
+  for (const nav2_voxel_grid::SparseVoxelGrid::Column & column : changed_columns_) {
+    // the same cost as dense clearing and marking would write
+    unsigned char cost = NO_INFORMATION;
+    nav2_voxel_grid::VoxelStatus status = sparse_grid_.getVoxelColumn(
+      column.x, column.y, unknown_threshold_, mark_threshold_);
+    if (status == nav2_voxel_grid::MARKED) {
+      cost = LETHAL_OBSTACLE;
+    } else if (status == nav2_voxel_grid::FREE) {
+      cost = FREE_SPACE;
+    }
+
+    unsigned int index = getIndex(column.x, column.y);
+    if (costmap_[index] != cost) {
+      overwriteCell(index, cost);
+      double wx, wy;
+      mapToWorld(column.x, column.y, wx, wy);
+      touch(wx, wy, min_x, min_y, max_x, max_y);
+    }
+  }
+}
+
+template<class ColumnT>
+ColumnT BasicVoxelLayer<ColumnT>::getColumn(unsigned int x, unsigned int y)
+{
+  if (sparse_) {
+    return getSparseColumn(x, y);
+  }
+  return voxel_grid_.getData()[voxel_grid_.getIndex(x, y)];
+}
+
+template<class ColumnT>
+ColumnT BasicVoxelLayer<ColumnT>::getSparseColumn(unsigned int x, unsigned int y)
+{
+  typedef nav2_voxel_grid::BasicVoxelGrid<ColumnT> DenseGrid;
+  const unsigned int levels = DenseGrid::LEVELS;
+  ColumnT column = DenseGrid::unknownColumn();
+  unsigned int size_z = std::min(sparse_grid_.sizeZ(), levels);
+  for (unsigned int z = 0; z < size_z; ++z) {
+    nav2_voxel_grid::VoxelStatus status = sparse_grid_.getVoxel(x, y, z);
+    if (status == nav2_voxel_grid::MARKED) {
+      column |= DenseGrid::voxelMask(z);
+    } else if (status == nav2_voxel_grid::FREE) {
+      column &= ~DenseGrid::voxelMask(z);
+    }
+  }
+  return column;
+}
+
+// the two widths of column, built once here
+template class BasicVoxelLayer<uint32_t>;
+template class BasicVoxelLayer<uint64_t>;
+
 }  // namespace nav2_costmap_2d
@@ -0,0 +1,100 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/cell_masks.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+// Words of every mask handed to a thread at a time when applying them
+const size_t words_per_task = 1 << 12;
+}  // namespace
+
+void CellMasks::resize(unsigned int num_masks, size_t cells)
+{
+  size_t words = (cells + 63) / 64;
+  if (cells != cells_) {
+    masks_.clear();
+    cells_ = cells;
+  }
+  masks_.resize(num_masks);
+  for (auto & mask : masks_) {
+    if (mask.size() != words) {
+      mask.assign(words, 0);
+    }
+  }
+}
+
+bool CellMasks::isSet(size_t offset) const
+{
+  for (const auto & mask : masks_) {
+    if (mask[offset >> 6] & (static_cast<uint64_t>(1) << (offset & 63))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void CellMasks::apply(
+  unsigned char * grid, unsigned char value, ThreadPool * pool,
+  std::vector<std::pair<size_t, unsigned char>> * overwritten)
+{
+  if (masks_.empty()) {
+    return;
+  }
+
+  size_t words = masks_.front().size();
+  std::mutex overwritten_mutex;
+  auto apply_words = [&](size_t w0, size_t wn) {
+      std::vector<std::pair<size_t, unsigned char>> cells;
+      for (size_t w = w0; w < wn; ++w) {
+        uint64_t bits = 0;
+        for (auto & mask : masks_) {
+          bits |= mask[w];
+          mask[w] = 0;
+        }
+        for (size_t offset = w * 64; bits != 0; ++offset, bits >>= 1) {
+          if ((bits & 1) && grid[offset] != value) {
+            if (overwritten) {
+              cells.emplace_back(offset, grid[offset]);
+            }
+            grid[offset] = value;
+          }
+        }
+      }
+      if (!cells.empty()) {
+        std::lock_guard<std::mutex> lock(overwritten_mutex);
+        overwritten->insert(overwritten->end(), cells.begin(), cells.end());
+      }
+    };
+
+  size_t tasks = (words + words_per_task - 1) / words_per_task;
+  if (pool == nullptr || tasks < 2) {
+    apply_words(0, words);
+    return;
+  }
+  pool->parallelFor(
+    tasks, [&](unsigned int t) {
+      apply_words(t * words_per_task, std::min(words, (t + 1) * words_per_task));
+    });
+}
+
+}  // namespace nav2_costmap_2d
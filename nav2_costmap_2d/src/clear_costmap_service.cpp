@@ -146,6 +146,7 @@ void ClearCostmapService::clearAroundRobot(double window_size_x, double window_s
   clear_poly.push_back(pt);
 
   costmap_.getCostmap()->setConvexPolygonCost(clear_poly, reset_value_);
+  costmap_.getLayeredCostmap()->invalidate();
 }
 
 void ClearCostmapService::clearEntirely()
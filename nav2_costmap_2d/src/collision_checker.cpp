@@ -35,7 +35,8 @@ CollisionChecker::CollisionChecker(
   tf2_ros::Buffer & tf,
   std::string name,
   std::string global_frame)
-: name_(name),
+: costmap_version_(0),
+  name_(name),
   global_frame_(global_frame),
   tf_(tf),
   costmap_sub_(costmap_sub),
@@ -71,7 +72,9 @@ double CollisionChecker::scorePose(
   const geometry_msgs::msg::Pose2D & pose)
 {
   try {
-    costmap_ = costmap_sub_.getCostmap();
+    if (!costmap_ || costmap_sub_.hasChangedSince(costmap_version_)) {
+      costmap_ = costmap_sub_.getCostmap(costmap_version_);
+    }
   } catch (const std::runtime_error & e) {
     throw CollisionCheckerException(e.what());
   }
@@ -39,16 +39,24 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "nav2_costmap_2d/costmap_snapshot.hpp"
+#include "rclcpp/rclcpp.hpp"
+
 namespace nav2_costmap_2d
 {
 Costmap2D::Costmap2D(
   unsigned int cells_size_x, unsigned int cells_size_y, double resolution,
   double origin_x, double origin_y, unsigned char default_value)
 : size_x_(cells_size_x), size_y_(cells_size_y), resolution_(resolution), origin_x_(origin_x),
-  origin_y_(origin_y), costmap_(NULL), default_value_(default_value)
+  origin_y_(origin_y), costmap_(NULL), default_value_(default_value), toroidal_(false),
+  wrap_x_(0), wrap_y_(0)
 {
   access_ = new mutex_t();
 
@@ -81,6 +89,8 @@ void Costmap2D::resizeMap(
   resolution_ = resolution;
   origin_x_ = origin_x;
   origin_y_ = origin_y;
+  wrap_x_ = 0;
+  wrap_y_ = 0;
 
   initMaps(size_x, size_y);
 
@@ -92,6 +102,17 @@ void Costmap2D::resetMaps()
 {
   std::unique_lock<mutex_t> lock(*access_);
   memset(costmap_, default_value_, size_x_ * size_y_ * sizeof(unsigned char));
+  wrap_x_ = 0;
+  wrap_y_ = 0;
+}
+
+void Costmap2D::setToroidal(bool toroidal)
+{
+  if (toroidal == toroidal_) {
+    return;
+  }
+  toroidal_ = toroidal;
+  resetMaps();
 }
 
 void Costmap2D::resetMap(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn)
@@ -103,10 +124,10 @@ void Costmap2D::resetMapToValue(
   unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn, unsigned char value)
 {
   std::unique_lock<mutex_t> lock(*(access_));
-  unsigned int len = xn - x0;
-  for (unsigned int y = y0 * size_x_ + x0; y < yn * size_x_ + x0; y += size_x_) {
-    memset(costmap_ + y, value, len * sizeof(unsigned char));
-  }
+  forEachRun(
+    [this, value](unsigned int index, unsigned int, unsigned int, unsigned int length) {
+      memset(costmap_ + index, value, length * sizeof(unsigned char));
+    }, x0, y0, xn, yn);
 }
 
 bool Costmap2D::copyCostmapWindow(
@@ -143,11 +164,19 @@ bool Costmap2D::copyCostmapWindow(
   // initialize our various maps and reset markers for inflation
   initMaps(size_x_, size_y_);
 
-  // copy the window of the static map and the costmap that we're taking
-  copyMapRegion(
-    map.costmap_, lower_left_x, lower_left_y, map.size_x_, costmap_, 0, 0, size_x_,
-    size_x_,
-    size_y_);
+  // the new storage starts at the origin of the window, even if this costmap is toroidal
+  wrap_x_ = 0;
+  wrap_y_ = 0;
+
+  // copy the window of the static map and the costmap that we're taking,
+  // a run at a time since the map may be toroidal
+  map.forEachRun(
+    [this, &map, lower_left_x, lower_left_y](
+      unsigned int index, unsigned int mx, unsigned int my, unsigned int length) {
+      memcpy(
+        costmap_ + (my - lower_left_y) * size_x_ + (mx - lower_left_x),
+        map.costmap_ + index, length * sizeof(unsigned char));
+    }, lower_left_x, lower_left_y, upper_right_x, upper_right_y);
   return true;
 }
 
@@ -158,17 +187,24 @@ Costmap2D & Costmap2D::operator=(const Costmap2D & map)
     return *this;
   }
 
-  // clean up old data
-  deleteMaps();
+  // only reallocate if the dimensions differ, so repeated copies
+  // into the same costmap (e.g. snapshots) reuse the existing buffer
+  if (costmap_ == NULL || size_x_ != map.size_x_ || size_y_ != map.size_y_) {
+    // clean up old data
+    deleteMaps();
+
+    // initialize our various maps
+    initMaps(map.size_x_, map.size_y_);
+  }
 
   size_x_ = map.size_x_;
   size_y_ = map.size_y_;
   resolution_ = map.resolution_;
   origin_x_ = map.origin_x_;
   origin_y_ = map.origin_y_;
-
-  // initialize our various maps
-  initMaps(size_x_, size_y_);
+  toroidal_ = map.toroidal_;
+  wrap_x_ = map.wrap_x_;
+  wrap_y_ = map.wrap_y_;
 
   // copy the cost map
   memcpy(costmap_, map.costmap_, size_x_ * size_y_ * sizeof(unsigned char));
@@ -177,7 +213,7 @@ Costmap2D & Costmap2D::operator=(const Costmap2D & map)
 }
 
 Costmap2D::Costmap2D(const Costmap2D & map)
-: costmap_(NULL)
+: costmap_(NULL), toroidal_(false), wrap_x_(0), wrap_y_(0)
 {
   access_ = new mutex_t();
   *this = map;
@@ -185,7 +221,8 @@ Costmap2D::Costmap2D(const Costmap2D & map)
 
 // just initialize everything to NULL by default
 Costmap2D::Costmap2D()
-: size_x_(0), size_y_(0), resolution_(0.0), origin_x_(0.0), origin_y_(0.0), costmap_(NULL)
+: size_x_(0), size_y_(0), resolution_(0.0), origin_x_(0.0), origin_y_(0.0), costmap_(NULL),
+  toroidal_(false), wrap_x_(0), wrap_y_(0)
 {
   access_ = new mutex_t();
 }
@@ -280,6 +317,15 @@ void Costmap2D::updateOrigin(double new_origin_x, double new_origin_y)
   new_grid_ox = origin_x_ + cell_ox * resolution_;
   new_grid_oy = origin_y_ + cell_oy * resolution_;
 
+  if (toroidal_) {
+    // keep the data where it is and only move the storage offset,
+    // then clear the cells that scrolled into view
+    shiftToroidalOrigin(cell_ox, cell_oy);
+    origin_x_ = new_grid_ox;
+    origin_y_ = new_grid_oy;
+    return;
+  }
+
   // To save casting from unsigned int to int a bunch of times
   int size_x = size_x_;
   int size_y = size_y_;
@@ -323,6 +369,36 @@ void Costmap2D::updateOrigin(double new_origin_x, double new_origin_y)
   delete[] local_map;
 }
 
+void Costmap2D::shiftToroidalOrigin(int cell_ox, int cell_oy)
+{
+  int size_x = size_x_;
+  int size_y = size_y_;
+
+  // nothing overlaps anymore, so every cell is new
+  if (std::abs(cell_ox) >= size_x || std::abs(cell_oy) >= size_y) {
+    resetMaps();
+    return;
+  }
+
+  // map cell (cell_ox, cell_oy) becomes the new (0, 0)
+  wrap_x_ = (wrap_x_ + cell_ox + size_x) % size_x;
+  wrap_y_ = (wrap_y_ + cell_oy + size_y) % size_y;
+
+  // the cells that scrolled into view still hold data from the other side of
+  // the window, reset those strips: first the new columns, then the new rows
+  if (cell_ox > 0) {
+    resetMap(size_x - cell_ox, 0, size_x, size_y);
+  } else if (cell_ox < 0) {
+    resetMap(0, 0, -cell_ox, size_y);
+  }
+
+  if (cell_oy > 0) {
+    resetMap(0, size_y - cell_oy, size_x, size_y);
+  } else if (cell_oy < 0) {
+    resetMap(0, 0, size_x, -cell_oy);
+  }
+}
+
 bool Costmap2D::setConvexPolygonCost(
   const std::vector<geometry_msgs::msg::Point> & polygon,
   unsigned char cost_value)
@@ -493,4 +569,50 @@ bool Costmap2D::saveMap(std::string file_name)
   return true;
 }
 
+bool Costmap2D::saveSnapshot(
+  const std::string & file_name, const std::string & name,
+  const std::string & frame) const
+{
+  std::unique_lock<mutex_t> lock(*access_);
+  try {
+    CostmapSnapshot::write(file_name, *this, name, frame);
+  } catch (const std::runtime_error &) {
+    return false;
+  }
+  return true;
+}
+
+bool Costmap2D::saveSnapshot(const std::string & file_name, const std::string & name) const
+{
+  return saveSnapshot(file_name, name, "");
+}
+
+bool Costmap2D::loadSnapshot(const std::string & file_name, const std::string & name)
+{
+  std::unique_ptr<CostmapSnapshot> snapshot;
+  try {
+    snapshot = std::make_unique<CostmapSnapshot>(file_name);
+  } catch (const std::runtime_error & e) {
+    RCLCPP_WARN(rclcpp::get_logger("nav2_costmap_2d"), "%s", e.what());
+    return false;
+  }
+  if (!name.empty() && snapshot->getName() != name) {
+    RCLCPP_WARN(
+      rclcpp::get_logger("nav2_costmap_2d"), "The costmap snapshot %s is of %s, not of %s",
+      file_name.c_str(), snapshot->getName().c_str(), name.c_str());
+    return false;
+  }
+
+  std::unique_lock<mutex_t> lock(*access_);
+  const CostmapSnapshotHeader & header = snapshot->getHeader();
+  resizeMap(
+    header.size_x, header.size_y, header.resolution, header.origin_x, header.origin_y);
+  const unsigned char * costs = snapshot->getPlane(0);
+  forEachRun(
+    [&](unsigned int index, unsigned int mx, unsigned int my, unsigned int length) {
+      memcpy(costmap_ + index, costs + static_cast<size_t>(my) * size_x_ + mx, length);
+    }, 0, 0, size_x_, size_y_);
+  return true;
+}
+
 }  // namespace nav2_costmap_2d
@@ -87,13 +87,17 @@ void voxelCallback(const nav2_msgs::msg::VoxelGrid::ConstSharedPtr grid)
   const uint32_t x_size = grid->size_x;
   const uint32_t y_size = grid->size_y;
   const uint32_t z_size = grid->size_z;
+  // Columns of more than 16 levels are published as two words each
+  const bool wide_columns = grid->data.size() >= 2 * static_cast<size_t>(x_size) * y_size;
 
   g_cells.clear();
   uint32_t num_markers = 0;
   for (uint32_t y_grid = 0; y_grid < y_size; ++y_grid) {
     for (uint32_t x_grid = 0; x_grid < x_size; ++x_grid) {
       for (uint32_t z_grid = 0; z_grid < z_size; ++z_grid) {
-        nav2_voxel_grid::VoxelStatus status =
+        nav2_voxel_grid::VoxelStatus status = wide_columns ?
+          nav2_voxel_grid::VoxelGrid64::getVoxelFromWords(
+          x_grid, y_grid, z_grid, x_size, y_size, z_size, data) :
           nav2_voxel_grid::VoxelGrid::getVoxel(
           x_grid, y_grid,
           z_grid, x_size, y_size, z_size, data);
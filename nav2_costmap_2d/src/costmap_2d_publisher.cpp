@@ -38,10 +38,14 @@
  *********************************************************************/
 #include "nav2_costmap_2d/costmap_2d_publisher.hpp"
 
+#include <cstring>
 #include <string>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "nav2_costmap_2d/cost_values.hpp"
+#include "nav2_costmap_2d/run_length_encoding.hpp"
 
 namespace nav2_costmap_2d
 {
@@ -67,6 +71,8 @@ Costmap2DPublisher::Costmap2DPublisher(
     custom_qos);
   costmap_update_pub_ = node_->create_publisher<map_msgs::msg::OccupancyGridUpdate>(
     topic_name + "_updates", custom_qos);
+  costmap_raw_update_pub_ = node_->create_publisher<nav2_msgs::msg::CostmapUpdate>(
+    topic_name + "_raw_updates", custom_qos);
 
   // Create a service that will use the callback function to handle requests.
   costmap_service_ = node_->create_service<nav2_msgs::srv::GetCostmap>(
@@ -90,10 +96,6 @@ Costmap2DPublisher::Costmap2DPublisher(
       cost_translation_table_[i] = static_cast<char>(1 + (97 * (i - 1)) / 251);
     }
   }
-
-  xn_ = yn_ = 0;
-  x0_ = costmap_->getSizeInCellsX();
-  y0_ = costmap_->getSizeInCellsY();
 }
 
 Costmap2DPublisher::~Costmap2DPublisher() {}
@@ -106,32 +108,48 @@ void Costmap2DPublisher::onNewSubscription(const ros::SingleSubscriberPublisher&
   pub.publish(grid_);
 } */
 
+const Costmap2D * Costmap2DPublisher::acquireCostmap(
+  std::shared_ptr<const Costmap2D> & snapshot,
+  std::unique_lock<Costmap2D::mutex_t> & lock)
+{
+  if (snapshot_source_) {
+    snapshot = snapshot_source_();
+    if (snapshot) {
+      return snapshot.get();
+    }
+  }
+  lock = std::unique_lock<Costmap2D::mutex_t>(*(costmap_->getMutex()));
+  return costmap_;
+}
+
 // prepare grid_ message for publication.
 void Costmap2DPublisher::prepareGrid()
 {
-  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_->getMutex()));
-  double resolution = costmap_->getResolution();
+  std::shared_ptr<const Costmap2D> snapshot;
+  std::unique_lock<Costmap2D::mutex_t> lock;
+  const Costmap2D * costmap = acquireCostmap(snapshot, lock);
+  double resolution = costmap->getResolution();
 
   grid_.header.frame_id = global_frame_;
   grid_.header.stamp = rclcpp::Time();
 
   grid_.info.resolution = resolution;
 
-  grid_.info.width = costmap_->getSizeInCellsX();
-  grid_.info.height = costmap_->getSizeInCellsY();
+  grid_.info.width = costmap->getSizeInCellsX();
+  grid_.info.height = costmap->getSizeInCellsY();
 
   double wx, wy;
-  costmap_->mapToWorld(0, 0, wx, wy);
+  costmap->mapToWorld(0, 0, wx, wy);
   grid_.info.origin.position.x = wx - resolution / 2;
   grid_.info.origin.position.y = wy - resolution / 2;
   grid_.info.origin.position.z = 0.0;
   grid_.info.origin.orientation.w = 1.0;
-  saved_origin_x_ = costmap_->getOriginX();
-  saved_origin_y_ = costmap_->getOriginY();
+  saved_origin_x_ = costmap->getOriginX();
+  saved_origin_y_ = costmap->getOriginY();
 
   grid_.data.resize(grid_.info.width * grid_.info.height);
 
-  unsigned char * data = costmap_->getCharMap();
+  unsigned char * data = costmap->getCharMap();
   for (unsigned int i = 0; i < grid_.data.size(); i++) {
     grid_.data[i] = cost_translation_table_[data[i]];
   }
@@ -139,31 +157,117 @@ void Costmap2DPublisher::prepareGrid()
 
 void Costmap2DPublisher::prepareCostmap()
 {
-  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_->getMutex()));
-  double resolution = costmap_->getResolution();
+  std::shared_ptr<const Costmap2D> snapshot;
+  std::unique_lock<Costmap2D::mutex_t> lock;
+  const Costmap2D * costmap = acquireCostmap(snapshot, lock);
 
   costmap_raw_.header.frame_id = global_frame_;
   costmap_raw_.header.stamp = node_->now();
 
-  costmap_raw_.metadata.layer = "master";
-  costmap_raw_.metadata.resolution = resolution;
+  prepareMetaData(*costmap, costmap_raw_.metadata);
 
-  costmap_raw_.metadata.size_x = costmap_->getSizeInCellsX();
-  costmap_raw_.metadata.size_y = costmap_->getSizeInCellsY();
+  costmap_raw_.data.resize(costmap_raw_.metadata.size_x * costmap_raw_.metadata.size_y);
+  memcpy(costmap_raw_.data.data(), costmap->getCharMap(), costmap_raw_.data.size());
+}
+
+void Costmap2DPublisher::prepareMetaData(
+  const Costmap2D & costmap, nav2_msgs::msg::CostmapMetaData & metadata)
+{
+  double resolution = costmap.getResolution();
+
+  metadata.layer = "master";
+  metadata.resolution = resolution;
+
+  metadata.size_x = costmap.getSizeInCellsX();
+  metadata.size_y = costmap.getSizeInCellsY();
 
   double wx, wy;
-  costmap_->mapToWorld(0, 0, wx, wy);
-  costmap_raw_.metadata.origin.position.x = wx - resolution / 2;
-  costmap_raw_.metadata.origin.position.y = wy - resolution / 2;
-  costmap_raw_.metadata.origin.position.z = 0.0;
-  costmap_raw_.metadata.origin.orientation.w = 1.0;
+  costmap.mapToWorld(0, 0, wx, wy);
+  metadata.origin.position.x = wx - resolution / 2;
+  metadata.origin.position.y = wy - resolution / 2;
+  metadata.origin.position.z = 0.0;
+  metadata.origin.orientation.w = 1.0;
+}
 
-  costmap_raw_.data.resize(costmap_raw_.metadata.size_x * costmap_raw_.metadata.size_y);
+void Costmap2DPublisher::publishRawUpdate()
+{
+  // a new subscriber has nothing to apply changes to yet
+  size_t subscribers = node_->count_subscribers(costmap_raw_update_pub_->get_topic_name());
+  bool keyframe = subscribers > raw_update_subscribers_;
+  raw_update_subscribers_ = subscribers;
+  if (subscribers == 0) {
+    return;
+  }
 
-  unsigned char * data = costmap_->getCharMap();
-  for (unsigned int i = 0; i < costmap_raw_.data.size(); i++) {
-    costmap_raw_.data[i] = data[i];
+  std::shared_ptr<const Costmap2D> snapshot;
+  std::unique_lock<Costmap2D::mutex_t> lock;
+  const Costmap2D * costmap = acquireCostmap(snapshot, lock);
+
+  nav2_msgs::msg::CostmapUpdate update;
+  update.header.frame_id = global_frame_;
+  update.header.stamp = node_->now();
+  prepareMetaData(*costmap, update.metadata);
+
+  // the changed cells are only meaningful within the same grid
+  keyframe = keyframe || raw_keyframe_period_ == 0 ||
+    raw_updates_since_keyframe_ >= raw_keyframe_period_ ||
+    update.metadata.size_x != raw_update_metadata_.size_x ||
+    update.metadata.size_y != raw_update_metadata_.size_y ||
+    update.metadata.resolution != raw_update_metadata_.resolution ||
+    update.metadata.origin.position.x != raw_update_metadata_.origin.position.x ||
+    update.metadata.origin.position.y != raw_update_metadata_.origin.position.y;
+
+  if (keyframe) {
+    addRawPatch(
+      *costmap, 0, 0, costmap->getSizeInCellsX(), costmap->getSizeInCellsY(), update);
+    raw_updates_since_keyframe_ = 0;
+  } else {
+    if (changed_cells_.empty()) {
+      return;
+    }
+    for (const CellRegion::Rect & w : changed_cells_.getRectangles()) {
+      addRawPatch(*costmap, w.min_x, w.min_y, w.max_x, w.max_y, update);
+    }
+    ++raw_updates_since_keyframe_;
+  }
+  if (lock.owns_lock()) {
+    lock.unlock();
+  }
+
+  raw_update_metadata_ = update.metadata;
+  update.keyframe = keyframe;
+  update.sequence = ++raw_update_sequence_;
+  costmap_raw_update_pub_->publish(update);
+}
+
+void Costmap2DPublisher::addRawPatch(
+  const Costmap2D & costmap, unsigned int x0, unsigned int y0,
+  unsigned int xn, unsigned int yn, nav2_msgs::msg::CostmapUpdate & update)
+{
+  nav2_msgs::msg::CostmapPatch patch;
+  patch.x = x0;
+  patch.y = y0;
+  patch.width = xn - x0;
+  patch.height = yn - y0;
+  patch.encoding = nav2_msgs::msg::CostmapPatch::ENCODING_RAW;
+  patch.data.resize(patch.width * patch.height);
+
+  const unsigned char * data = costmap.getCharMap();
+  costmap.forEachRun(
+    [&](unsigned int index, unsigned int mx, unsigned int my, unsigned int length) {
+      memcpy(&patch.data[(my - y0) * patch.width + (mx - x0)], &data[index], length);
+    }, x0, y0, xn, yn);
+
+  if (raw_run_length_encoding_) {
+    std::vector<uint8_t> encoded;
+    encodeRunLength(patch.data.data(), patch.data.size(), encoded);
+    if (encoded.size() < patch.data.size()) {
+      patch.encoding = nav2_msgs::msg::CostmapPatch::ENCODING_RUN_LENGTH;
+      patch.data.swap(encoded);
+    }
   }
+
+  update.patches.push_back(std::move(patch));
 }
 
 void Costmap2DPublisher::publishCostmap()
@@ -172,6 +276,7 @@ void Costmap2DPublisher::publishCostmap()
     prepareCostmap();
     costmap_raw_pub_->publish(costmap_raw_);
   }
+  publishRawUpdate();
   float resolution = costmap_->getResolution();
 
   if (always_send_full_costmap_ || grid_.info.resolution != resolution ||
@@ -184,32 +289,55 @@ void Costmap2DPublisher::publishCostmap()
       prepareGrid();
       costmap_pub_->publish(grid_);
     }
-  } else if (x0_ < xn_) {
+  } else if (!changed_cells_.empty()) {
     if (node_->count_subscribers(costmap_update_pub_->get_topic_name()) > 0) {
-      std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_->getMutex()));
-      // Publish Just an Update
-      map_msgs::msg::OccupancyGridUpdate update;
-      update.header.stamp = rclcpp::Time();
-      update.header.frame_id = global_frame_;
-      update.x = x0_;
-      update.y = y0_;
-      update.width = xn_ - x0_;
-      update.height = yn_ - y0_;
-      update.data.resize(update.width * update.height);
-      unsigned int i = 0;
-      for (unsigned int y = y0_; y < yn_; y++) {
-        for (unsigned int x = x0_; x < xn_; x++) {
-          unsigned char cost = costmap_->getCost(x, y);
-          update.data[i++] = cost_translation_table_[cost];
+      std::shared_ptr<const Costmap2D> snapshot;
+      std::unique_lock<Costmap2D::mutex_t> lock;
+      const Costmap2D * costmap = acquireCostmap(snapshot, lock);
+      // Publish Just an Update, one message per changed window
+      for (const CellRegion::Rect & w : changed_cells_.getRectangles()) {
+        map_msgs::msg::OccupancyGridUpdate update;
+        update.header.stamp = rclcpp::Time();
+        update.header.frame_id = global_frame_;
+        update.x = w.min_x;
+        update.y = w.min_y;
+        update.width = w.max_x - w.min_x;
+        update.height = w.max_y - w.min_y;
+        update.data.resize(update.width * update.height);
+        unsigned int i = 0;
+        for (unsigned int y = w.min_y; y < w.max_y; y++) {
+          for (unsigned int x = w.min_x; x < w.max_x; x++) {
+            unsigned char cost = costmap->getCost(x, y);
+            update.data[i++] = cost_translation_table_[cost];
+          }
         }
+        costmap_update_pub_->publish(update);
       }
-      costmap_update_pub_->publish(update);
     }
   }
 
-  xn_ = yn_ = 0;
-  x0_ = costmap_->getSizeInCellsX();
-  y0_ = costmap_->getSizeInCellsY();
+  changed_cells_.clear();
+  published_ = true;
+  published_origin_x_ = costmap_->getOriginX();
+  published_origin_y_ = costmap_->getOriginY();
+  published_size_x_ = costmap_->getSizeInCellsX();
+  published_size_y_ = costmap_->getSizeInCellsY();
+}
+
+bool Costmap2DPublisher::hasUpdates()
+{
+  if (!published_ || !changed_cells_.empty() ||
+    published_origin_x_ != costmap_->getOriginX() ||
+    published_origin_y_ != costmap_->getOriginY() ||
+    published_size_x_ != costmap_->getSizeInCellsX() ||
+    published_size_y_ != costmap_->getSizeInCellsY())
+  {
+    return true;
+  }
+
+  // a new subscriber to the raw updates needs a keyframe
+  return node_->count_subscribers(costmap_raw_update_pub_->get_topic_name()) >
+         raw_update_subscribers_;
 }
 
 void
@@ -224,22 +352,26 @@ Costmap2DPublisher::costmap_service_callback(
   tf2::Quaternion quaternion;
   quaternion.setRPY(0.0, 0.0, 0.0);
 
-  auto size_x = costmap_->getSizeInCellsX();
-  auto size_y = costmap_->getSizeInCellsY();
+  std::shared_ptr<const Costmap2D> snapshot;
+  std::unique_lock<Costmap2D::mutex_t> lock;
+  const Costmap2D * costmap = acquireCostmap(snapshot, lock);
+
+  auto size_x = costmap->getSizeInCellsX();
+  auto size_y = costmap->getSizeInCellsY();
   auto data_length = size_x * size_y;
-  unsigned char * data = costmap_->getCharMap();
+  unsigned char * data = costmap->getCharMap();
   auto current_time = node_->now();
 
   response->map.header.stamp = current_time;
   response->map.header.frame_id = global_frame_;
   response->map.metadata.size_x = size_x;
   response->map.metadata.size_y = size_y;
-  response->map.metadata.resolution = costmap_->getResolution();
+  response->map.metadata.resolution = costmap->getResolution();
   response->map.metadata.layer = "master";
   response->map.metadata.map_load_time = current_time;
   response->map.metadata.update_time = current_time;
-  response->map.metadata.origin.position.x = costmap_->getOriginX();
-  response->map.metadata.origin.position.y = costmap_->getOriginY();
+  response->map.metadata.origin.position.x = costmap->getOriginX();
+  response->map.metadata.origin.position.y = costmap->getOriginY();
   response->map.metadata.origin.position.z = 0.0;
   response->map.metadata.origin.orientation = tf2::toMsg(quaternion);
   response->map.data.resize(data_length);
@@ -0,0 +1,101 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Replays a sensor log recorded by a costmap with its sensor_log parameter set, printing the
+// time and the checksum of the master grid of each update, then a summary of the times
+//
+// Usage: nav2_costmap_2d_replay <sensor log> [--threads <n>] [--quiet]
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "nav2_costmap_2d/costmap_replay.hpp"
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  std::vector<std::string> args = rclcpp::remove_ros_arguments(argc, argv);
+
+  std::string path;
+  int threads = 0;
+  bool quiet = false;
+  for (size_t i = 1; i < args.size(); ++i) {
+    if (args[i] == "--threads" && i + 1 < args.size()) {
+      threads = std::atoi(args[++i].c_str());
+    } else if (args[i] == "--quiet") {
+      quiet = true;
+    } else if (path.empty()) {
+      path = args[i];
+    } else {
+      path.clear();
+      break;
+    }
+  }
+  if (path.empty()) {
+    fprintf(stderr, "Usage: %s <sensor log> [--threads <n>] [--quiet]\n", argv[0]);
+    rclcpp::shutdown();
+    return 1;
+  }
+
+  std::vector<uint64_t> update_times;
+  uint64_t checksum = 0;
+  try {
+    nav2_costmap_2d::CostmapReplay replay(path, threads);
+    nav2_costmap_2d::CostmapReplay::Result result;
+    if (!quiet) {
+      printf("cycle stamp update_ms checksum\n");
+    }
+    while (rclcpp::ok() && replay.replayCycle(result)) {
+      if (!quiet) {
+        printf(
+          "%zu %" PRId64 " %.3f %016" PRIx64 "\n", update_times.size(), result.stamp,
+          result.update_time * 1e-6, result.checksum);
+      }
+      update_times.push_back(result.update_time);
+      // the checksum of the run covers every update in order
+      checksum = (checksum ^ result.checksum) * 1099511628211ULL;
+    }
+  } catch (const std::exception & e) {
+    fprintf(stderr, "%s\n", e.what());
+    rclcpp::shutdown();
+    return 1;
+  }
+
+  printf("cycles: %zu\n", update_times.size());
+  if (!update_times.empty()) {
+    uint64_t total = 0;
+    for (uint64_t time : update_times) {
+      total += time;
+    }
+    std::sort(update_times.begin(), update_times.end());
+    auto percentile = [&update_times](double p) {
+        return update_times[static_cast<size_t>(p * (update_times.size() - 1))] * 1e-6;
+      };
+    printf(
+      "update_ms: mean %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f\n",
+      total * 1e-6 / update_times.size(), percentile(0.5), percentile(0.9), percentile(0.99),
+      update_times.back() * 1e-6);
+  }
+  printf("checksum: %016" PRIx64 "\n", checksum);
+
+  rclcpp::shutdown();
+  return 0;
+}
@@ -38,10 +38,19 @@
 
 #include "nav2_costmap_2d/costmap_2d_ros.hpp"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "nav2_costmap_2d/costmap_layer.hpp"
 #include "nav2_costmap_2d/layered_costmap.hpp"
 #include "nav2_util/execution_timer.hpp"
 #include "nav2_util/node_utils.hpp"
@@ -81,8 +90,11 @@ Costmap2DROS::Costmap2DROS(
   std::vector<std::string> plugin_types{"nav2_costmap_2d::StaticLayer",
     "nav2_costmap_2d::ObstacleLayer", "nav2_costmap_2d::InflationLayer"};
   std::vector<std::string> clearable_layers{"obstacle_layer"};
+  std::vector<std::string> snapshot_layers{"static_layer"};
 
   declare_parameter("always_send_full_costmap", rclcpp::ParameterValue(false));
+  declare_parameter("diagnostics_frequency", rclcpp::ParameterValue(0.0));
+  declare_parameter("event_driven_updates", rclcpp::ParameterValue(false));
   declare_parameter("footprint_padding", rclcpp::ParameterValue(0.01f));
   declare_parameter("footprint", rclcpp::ParameterValue(std::string("[]")));
   declare_parameter("global_frame", rclcpp::ParameterValue(std::string("map")));
@@ -92,22 +104,32 @@ Costmap2DROS::Costmap2DROS(
   declare_parameter(
     "map_topic", rclcpp::ParameterValue(
       (parent_namespace_ == "/" ? "/" : parent_namespace_ + "/") + std::string("map")));
+  declare_parameter("min_update_period", rclcpp::ParameterValue(0.05));
   declare_parameter("observation_sources", rclcpp::ParameterValue(std::string("")));
   declare_parameter("origin_x", rclcpp::ParameterValue(0.0));
   declare_parameter("origin_y", rclcpp::ParameterValue(0.0));
   declare_parameter("plugin_names", rclcpp::ParameterValue(plugin_names));
   declare_parameter("plugin_types", rclcpp::ParameterValue(plugin_types));
   declare_parameter("publish_frequency", rclcpp::ParameterValue(1.0));
+  declare_parameter("pyramid_levels", rclcpp::ParameterValue(0));
+  declare_parameter("raw_updates_keyframe_period", rclcpp::ParameterValue(10));
+  declare_parameter("raw_updates_run_length_encoding", rclcpp::ParameterValue(false));
   declare_parameter("resolution", rclcpp::ParameterValue(0.1));
   declare_parameter("robot_base_frame", rclcpp::ParameterValue(std::string("base_link")));
   declare_parameter("robot_radius", rclcpp::ParameterValue(0.1));
   declare_parameter("rolling_window", rclcpp::ParameterValue(false));
+  declare_parameter("sensor_log", rclcpp::ParameterValue(std::string("")));
+  declare_parameter("snapshot_directory", rclcpp::ParameterValue(std::string("")));
+  declare_parameter("snapshot_layers", rclcpp::ParameterValue(snapshot_layers));
+  declare_parameter("toroidal_rolling_window", rclcpp::ParameterValue(false));
   declare_parameter("track_unknown_space", rclcpp::ParameterValue(false));
   declare_parameter("transform_tolerance", rclcpp::ParameterValue(0.3));
   declare_parameter("trinary_costmap", rclcpp::ParameterValue(true));
   declare_parameter("unknown_cost_value", rclcpp::ParameterValue(static_cast<unsigned char>(0xff)));
   declare_parameter("update_frequency", rclcpp::ParameterValue(5.0));
+  declare_parameter("update_threads", rclcpp::ParameterValue(1));
   declare_parameter("use_maximum", rclcpp::ParameterValue(false));
+  declare_parameter("use_snapshots", rclcpp::ParameterValue(false));
   declare_parameter("clearable_layers", rclcpp::ParameterValue(clearable_layers));
 }
 
@@ -124,6 +146,9 @@ Costmap2DROS::on_configure(const rclcpp_lifecycle::State & /*state*/)
 
   // Create the costmap itself
   layered_costmap_ = new LayeredCostmap(global_frame_, rolling_window_, track_unknown_space_);
+  layered_costmap_->setUpdateThreads(std::max(update_threads_, 1));
+  layered_costmap_->setPyramidLevels(std::max(pyramid_levels_, 0));
+  layered_costmap_->setStatisticsEnabled(diagnostics_frequency_ > 0.0);
 
   if (!layered_costmap_->isSizeLocked()) {
     layered_costmap_->resizeMap(
@@ -154,6 +179,24 @@ Costmap2DROS::on_configure(const rclcpp_lifecycle::State & /*state*/)
     RCLCPP_INFO(get_logger(), "Initialized plugin \"%s\"", plugin_names_[i].c_str());
   }
 
+  if (!snapshot_directory_.empty()) {
+    loadSnapshots();
+  }
+
+  // Record the updates, with the parameters the plugins declared
+  if (!sensor_log_path_.empty()) {
+    try {
+      sensor_log_ = std::make_unique<SensorLogWriter>(
+        sensor_log_path_, get_parameters(
+          list_parameters(
+            {}, rcl_interfaces::srv::ListParameters::Request::DEPTH_RECURSIVE).names));
+      layered_costmap_->setSensorLog(sensor_log_.get());
+      RCLCPP_INFO(get_logger(), "Recording the sensor log %s", sensor_log_path_.c_str());
+    } catch (const std::runtime_error & e) {
+      RCLCPP_ERROR(get_logger(), "Not recording the sensor log: %s", e.what());
+    }
+  }
+
   // Create the publishers and subscribers
   footprint_sub_ = create_subscription<geometry_msgs::msg::Polygon>(
     "footprint",
@@ -163,10 +206,22 @@ Costmap2DROS::on_configure(const rclcpp_lifecycle::State & /*state*/)
   footprint_pub_ = create_publisher<geometry_msgs::msg::PolygonStamped>(
     "published_footprint", rclcpp::SystemDefaultsQoS());
 
+  if (diagnostics_frequency_ > 0.0) {
+    diagnostics_pub_ = create_publisher<diagnostic_msgs::msg::DiagnosticArray>(
+      "/diagnostics", rclcpp::SystemDefaultsQoS());
+  }
+
   costmap_publisher_ = new Costmap2DPublisher(
     shared_from_this(),
     layered_costmap_->getCostmap(), global_frame_,
     "costmap", always_send_full_costmap_);
+  costmap_publisher_->setRawUpdateOptions(
+    std::max(raw_updates_keyframe_period_, 0), raw_updates_run_length_encoding_);
+
+  if (use_snapshots_) {
+    costmap_publisher_->setSnapshotSource(
+      std::bind(&Costmap2DROS::getCostmapSnapshot, this));
+  }
 
   // Set the footprint
   if (use_radius_) {
@@ -190,6 +245,9 @@ Costmap2DROS::on_activate(const rclcpp_lifecycle::State & /*state*/)
 
   costmap_publisher_->on_activate();
   footprint_pub_->on_activate();
+  if (diagnostics_pub_) {
+    diagnostics_pub_->on_activate();
+  }
 
   // First, make sure that the transform between the robot base frame
   // and the global frame is available
@@ -234,16 +292,24 @@ Costmap2DROS::on_deactivate(const rclcpp_lifecycle::State & /*state*/)
 
   costmap_publisher_->on_deactivate();
   footprint_pub_->on_deactivate();
+  if (diagnostics_pub_) {
+    diagnostics_pub_->on_deactivate();
+  }
 
   stop();
 
   // Map thread stuff
   // TODO(mjeronimo): unique_ptr
   map_update_thread_shutdown_ = true;
+  layered_costmap_->notifyNewData();
   map_update_thread_->join();
   delete map_update_thread_;
   map_update_thread_ = nullptr;
 
+  if (!snapshot_directory_.empty()) {
+    saveSnapshots();
+  }
+
   return nav2_util::CallbackReturn::SUCCESS;
 }
 
@@ -254,12 +320,14 @@ Costmap2DROS::on_cleanup(const rclcpp_lifecycle::State & /*state*/)
 
   delete layered_costmap_;
   layered_costmap_ = nullptr;
+  sensor_log_.reset();
 
   tf_listener_.reset();
   tf_buffer_.reset();
 
   footprint_sub_.reset();
   footprint_pub_.reset();
+  diagnostics_pub_.reset();
 
   if (costmap_publisher_ != nullptr) {
     delete costmap_publisher_;
@@ -268,6 +336,10 @@ Costmap2DROS::on_cleanup(const rclcpp_lifecycle::State & /*state*/)
 
   clear_costmap_service_.reset();
 
+  std::atomic_store(&snapshot_, std::shared_ptr<const Costmap2D>());
+  front_snapshot_.reset();
+  back_snapshot_.reset();
+
   return nav2_util::CallbackReturn::SUCCESS;
 }
 
@@ -292,22 +364,33 @@ Costmap2DROS::getParameters()
 
   // Get all of the required parameters
   get_parameter("always_send_full_costmap", always_send_full_costmap_);
+  get_parameter("diagnostics_frequency", diagnostics_frequency_);
+  get_parameter("event_driven_updates", event_driven_updates_);
   get_parameter("footprint", footprint_);
   get_parameter("footprint_padding", footprint_padding_);
   get_parameter("global_frame", global_frame_);
   get_parameter("height", map_height_meters_);
+  get_parameter("min_update_period", min_update_period_);
   get_parameter("origin_x", origin_x_);
   get_parameter("origin_y", origin_y_);
   get_parameter("plugin_names", plugin_names_);
   get_parameter("plugin_types", plugin_types_);
   get_parameter("publish_frequency", map_publish_frequency_);
+  get_parameter("pyramid_levels", pyramid_levels_);
+  get_parameter("raw_updates_keyframe_period", raw_updates_keyframe_period_);
+  get_parameter("raw_updates_run_length_encoding", raw_updates_run_length_encoding_);
   get_parameter("resolution", resolution_);
   get_parameter("robot_base_frame", robot_base_frame_);
   get_parameter("robot_radius", robot_radius_);
   get_parameter("rolling_window", rolling_window_);
+  get_parameter("sensor_log", sensor_log_path_);
+  get_parameter("snapshot_directory", snapshot_directory_);
+  get_parameter("snapshot_layers", snapshot_layers_);
   get_parameter("track_unknown_space", track_unknown_space_);
   get_parameter("transform_tolerance", transform_tolerance_);
   get_parameter("update_frequency", map_update_frequency_);
+  get_parameter("update_threads", update_threads_);
+  get_parameter("use_snapshots", use_snapshots_);
   get_parameter("width", map_width_meters_);
 
   // Semantic checks...
@@ -388,7 +471,30 @@ Costmap2DROS::mapUpdateLoop(double frequency)
 
   rclcpp::Rate r(frequency);    // 200ms by default
 
+  // when updates are event driven, the update period only bounds the time between updates
+  // so that the layers are still checked for being current without any data
+  const auto max_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(1.0 / frequency));
+  const auto min_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(std::max(min_update_period_, 0.0)));
+  auto last_update = std::chrono::steady_clock::now();
+
+  const auto diagnostics_period =
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(1.0 / std::max(diagnostics_frequency_, 1e-9)));
+  last_diagnostics_ = std::chrono::steady_clock::now();
+
   while (rclcpp::ok() && !map_update_thread_shutdown_) {
+    if (event_driven_updates_) {
+      // data received during the minimum period is flagged, so the wait returns right away
+      std::this_thread::sleep_until(last_update + min_period);
+      layered_costmap_->waitForNewData(last_update + max_period);
+      if (map_update_thread_shutdown_) {
+        break;
+      }
+      last_update = std::chrono::steady_clock::now();
+    }
+
     nav2_util::ExecutionTimer timer;
 
     // Measure the execution time of the updateMap method
@@ -398,22 +504,31 @@ Costmap2DROS::mapUpdateLoop(double frequency)
 
     RCLCPP_DEBUG(get_logger(), "Map update time: %.9f", timer.elapsed_time_in_seconds());
     if (publish_cycle_ > rclcpp::Duration(0) && layered_costmap_->isInitialized()) {
-      unsigned int x0, y0, xn, yn;
-      layered_costmap_->getBounds(&x0, &xn, &y0, &yn);
-      costmap_publisher_->updateBounds(x0, xn, y0, yn);
+      costmap_publisher_->updateBounds(layered_costmap_->getUpdatedCells());
 
       auto current_time = now();
       if ((last_publish_ + publish_cycle_ < current_time) ||  // publish_cycle_ is due
         (current_time < last_publish_))      // time has moved backwards, probably due to a switch to sim_time // NOLINT
       {
-        RCLCPP_DEBUG(get_logger(), "Publish costmap at %s", name_.c_str());
-        costmap_publisher_->publishCostmap();
+        // an idle costmap isn't sent again
+        if (costmap_publisher_->hasUpdates()) {
+          RCLCPP_DEBUG(get_logger(), "Publish costmap at %s", name_.c_str());
+          costmap_publisher_->publishCostmap();
+        }
         last_publish_ = current_time;
       }
     }
 
+    if (diagnostics_pub_ &&
+      std::chrono::steady_clock::now() >= last_diagnostics_ + diagnostics_period)
+    {
+      publishDiagnostics();
+    }
+
     // Make sure to sleep for the remainder of our cycle time
-    r.sleep();
+    if (!event_driven_updates_) {
+      r.sleep();
+    }
 
 #if 0
     // TODO(bpwilcox): find ROS2 equivalent or port for r.cycletime()
@@ -439,7 +554,25 @@ Costmap2DROS::updateMap()
       const double & x = pose.pose.position.x;
       const double & y = pose.pose.position.y;
       const double yaw = tf2::getYaw(pose.pose.orientation);
+      if (sensor_log_) {
+        sensor_log_->beginCycle(
+          now().nanoseconds(), x, y, yaw, layered_costmap_->getFootprint(),
+          *layered_costmap_->getCostmap());
+      }
       layered_costmap_->updateMap(x, y, yaw);
+      if (sensor_log_) {
+        try {
+          sensor_log_->endCycle();
+        } catch (const std::runtime_error & e) {
+          RCLCPP_ERROR(get_logger(), "Stopped recording the sensor log: %s", e.what());
+          layered_costmap_->setSensorLog(nullptr);
+          sensor_log_.reset();
+        }
+      }
+
+      if (use_snapshots_ && !layered_costmap_->isUnchanged()) {
+        updateSnapshot();
+      }
 
       geometry_msgs::msg::PolygonStamped footprint;
       footprint.header.frame_id = global_frame_;
@@ -453,6 +586,174 @@ Costmap2DROS::updateMap()
   }
 }
 
+void
+Costmap2DROS::updateSnapshot()
+{
+  // The back buffer can only be reused once every reader has released it. It is
+  // no longer reachable through snapshot_, so its use count can only go down.
+  if (!back_snapshot_ || back_snapshot_.use_count() > 1) {
+    back_snapshot_ = std::make_shared<Costmap2D>();
+  } else {
+    // make the readers' last accesses visible before we overwrite the buffer
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+
+  Costmap2D * master = layered_costmap_->getCostmap();
+  {
+    std::unique_lock<Costmap2D::mutex_t> lock(*(master->getMutex()));
+    *back_snapshot_ = *master;
+  }
+
+  std::atomic_store(&snapshot_, std::shared_ptr<const Costmap2D>(back_snapshot_));
+  std::swap(front_snapshot_, back_snapshot_);
+}
+
+namespace
+{
+std::string formatDouble(double value)
+{
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(3) << value;
+  return stream.str();
+}
+
+// Add the summary of a histogram to a status, with its values multiplied by scale
+void addSummary(
+  diagnostic_msgs::msg::DiagnosticStatus & status, const std::string & key,
+  const Histogram::Summary & summary, double scale)
+{
+  auto add = [&status](const std::string & name, const std::string & value) {
+      diagnostic_msgs::msg::KeyValue key_value;
+      key_value.key = name;
+      key_value.value = value;
+      status.values.push_back(key_value);
+    };
+  add(key + " count", std::to_string(summary.count));
+  add(key + " mean", formatDouble(summary.mean * scale));
+  add(key + " p50", formatDouble(summary.p50 * scale));
+  add(key + " p90", formatDouble(summary.p90 * scale));
+  add(key + " p99", formatDouble(summary.p99 * scale));
+  add(key + " max", formatDouble(summary.max * scale));
+}
+}  // namespace
+
+void
+Costmap2DROS::publishDiagnostics()
+{
+  last_diagnostics_ = std::chrono::steady_clock::now();
+  UpdateStatistics * statistics = layered_costmap_->getStatistics();
+  if (statistics == nullptr) {
+    return;
+  }
+
+  const double ms = 1e-6;
+  diagnostic_msgs::msg::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = now();
+
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.name = std::string(get_name()) + ": updates";
+  status.hardware_id = name_;
+  Histogram::Summary update_time = statistics->update_time.summarizeAndReset();
+  addSummary(status, "update_time_ms", update_time, ms);
+  addSummary(status, "updated_cells", statistics->updated_cells.summarizeAndReset(), 1.0);
+  addSummary(status, "reader_lock_wait_ms", statistics->lock_wait.summarizeAndReset(), ms);
+  addSummary(status, "reader_lock_hold_ms", statistics->lock_hold.summarizeAndReset(), ms);
+  if (map_update_frequency_ > 0.0 && update_time.max * ms > 1000.0 / map_update_frequency_) {
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    status.message = "Updates took up to " + formatDouble(update_time.max * ms) +
+      " ms, longer than the update period";
+  } else {
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.message = "OK";
+  }
+  diagnostics.status.push_back(status);
+
+  for (const auto & layer : statistics->layers) {
+    diagnostic_msgs::msg::DiagnosticStatus layer_status;
+    layer_status.name = std::string(get_name()) + ": " + layer->name;
+    layer_status.hardware_id = name_;
+    layer_status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+    layer_status.message = "OK";
+    addSummary(layer_status, "bounds_time_ms", layer->bounds_time.summarizeAndReset(), ms);
+    addSummary(layer_status, "costs_time_ms", layer->costs_time.summarizeAndReset(), ms);
+    addSummary(layer_status, "observations", layer->observations.summarizeAndReset(), 1.0);
+    diagnostics.status.push_back(layer_status);
+  }
+
+  diagnostics_pub_->publish(diagnostics);
+}
+
+std::string
+Costmap2DROS::getSnapshotFileName(const std::string & layer_name) const
+{
+  return snapshot_directory_ + "/" + name_ + (layer_name.empty() ? "" : "." + layer_name) +
+         ".costmap";
+}
+
+void
+Costmap2DROS::loadSnapshots()
+{
+  // nothing was saved before the first shutdown, which isn't worth a warning
+  auto exists = [](const std::string & file_name) {
+      return access(file_name.c_str(), F_OK) == 0;
+    };
+
+  // a rolling window only holds what the sensors see around the robot,
+  // the grid of a static one is worth having before the first update
+  if (!rolling_window_ && exists(getSnapshotFileName("")) &&
+    layered_costmap_->loadSnapshot(getSnapshotFileName(""), name_))
+  {
+    RCLCPP_INFO(get_logger(), "Restored the costmap from %s", getSnapshotFileName("").c_str());
+  }
+
+  std::vector<std::shared_ptr<Layer>> * plugins = layered_costmap_->getPlugins();
+  for (std::vector<std::shared_ptr<Layer>>::iterator plugin = plugins->begin();
+    plugin != plugins->end(); ++plugin)
+  {
+    std::string layer_name = (*plugin)->getName();
+    auto costmap_layer = std::dynamic_pointer_cast<CostmapLayer>(*plugin);
+    if (!costmap_layer ||
+      std::count(snapshot_layers_.begin(), snapshot_layers_.end(), layer_name) == 0 ||
+      !exists(getSnapshotFileName(layer_name)))
+    {
+      continue;
+    }
+    if (costmap_layer->loadSnapshot(getSnapshotFileName(layer_name), layer_name)) {
+      RCLCPP_INFO(
+        get_logger(), "Restored layer %s from %s", layer_name.c_str(),
+        getSnapshotFileName(layer_name).c_str());
+    }
+  }
+}
+
+void
+Costmap2DROS::saveSnapshots()
+{
+  if (!rolling_window_ && !layered_costmap_->saveSnapshot(getSnapshotFileName(""), name_))
+  {
+    RCLCPP_WARN(
+      get_logger(), "Could not save the costmap to %s", getSnapshotFileName("").c_str());
+  }
+
+  std::vector<std::shared_ptr<Layer>> * plugins = layered_costmap_->getPlugins();
+  for (std::vector<std::shared_ptr<Layer>>::iterator plugin = plugins->begin();
+    plugin != plugins->end(); ++plugin)
+  {
+    std::string layer_name = (*plugin)->getName();
+    auto costmap_layer = std::dynamic_pointer_cast<CostmapLayer>(*plugin);
+    if (std::count(snapshot_layers_.begin(), snapshot_layers_.end(), layer_name) == 0) {
+      continue;
+    }
+    if (!costmap_layer) {
+      RCLCPP_WARN(get_logger(), "Layer %s has no costmap to save", layer_name.c_str());
+    } else if (!costmap_layer->saveSnapshot(getSnapshotFileName(layer_name), layer_name)) {
+      RCLCPP_WARN(
+        get_logger(), "Could not save layer %s to %s", layer_name.c_str(),
+        getSnapshotFileName(layer_name).c_str());
+    }
+  }
+}
+
 void
 Costmap2DROS::start()
 {
@@ -519,6 +820,7 @@ Costmap2DROS::resetLayers()
 {
   Costmap2D * top = layered_costmap_->getCostmap();
   top->resetMap(0, 0, top->getSizeInCellsX(), top->getSizeInCellsY());
+  layered_costmap_->invalidate();
 
   // Reset each of the plugins
   std::vector<std::shared_ptr<Layer>> * plugins = layered_costmap_->getPlugins();
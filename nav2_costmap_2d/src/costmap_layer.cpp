@@ -37,7 +37,11 @@
  *********************************************************************/
 
 #include <nav2_costmap_2d/costmap_layer.hpp>
+#include <nav2_costmap_2d/costmap_snapshot.hpp>
+#include <nav2_costmap_2d/merge_kernels.hpp>
+#include <cstring>
 #include <stdexcept>
+#include <string>
 #include <algorithm>
 
 namespace nav2_costmap_2d
@@ -88,6 +92,36 @@ void CostmapLayer::addExtraBounds(double mx0, double my0, double mx1, double my1
   has_extra_bounds_ = true;
 }
 
+bool CostmapLayer::saveSnapshot(const std::string & file_name, const std::string & name) const
+{
+  return Costmap2D::saveSnapshot(file_name, name, layered_costmap_->getGlobalFrameID());
+}
+
+bool CostmapLayer::loadSnapshot(const std::string & file_name, const std::string & name)
+{
+  // the costs only belong where they were in the frame they were saved in
+  try {
+    std::string frame = CostmapSnapshot(file_name).getFrame();
+    if (frame != layered_costmap_->getGlobalFrameID()) {
+      RCLCPP_WARN(
+        node_->get_logger(), "The costmap snapshot %s is in %s, not in %s", file_name.c_str(),
+        frame.c_str(), layered_costmap_->getGlobalFrameID().c_str());
+      return false;
+    }
+  } catch (const std::runtime_error & e) {
+    RCLCPP_WARN(node_->get_logger(), "%s", e.what());
+    return false;
+  }
+  if (!Costmap2D::loadSnapshot(file_name, name)) {
+    return false;
+  }
+
+  addExtraBounds(
+    origin_x_, origin_y_, origin_x_ + getSizeInMetersX(), origin_y_ + getSizeInMetersY());
+  layered_costmap_->notifyNewData();
+  return true;
+}
+
 void CostmapLayer::useExtraBounds(double * min_x, double * min_y, double * max_x, double * max_y)
 {
   if (!has_extra_bounds_) {
@@ -114,24 +148,7 @@ void CostmapLayer::updateWithMax(
     return;
   }
 
-  unsigned char * master_array = master_grid.getCharMap();
-  unsigned int span = master_grid.getSizeInCellsX();
-
-  for (int j = min_j; j < max_j; j++) {
-    unsigned int it = j * span + min_i;
-    for (int i = min_i; i < max_i; i++) {
-      if (costmap_[it] == NO_INFORMATION) {
-        it++;
-        continue;
-      }
-
-      unsigned char old_cost = master_array[it];
-      if (old_cost == NO_INFORMATION || old_cost < costmap_[it]) {
-        master_array[it] = costmap_[it];
-      }
-      it++;
-    }
-  }
+  updateWithKernel(master_grid, min_i, min_j, max_i, max_j, mergeRowMax);
 }
 
 void CostmapLayer::updateWithTrueOverwrite(
@@ -148,16 +165,11 @@ void CostmapLayer::updateWithTrueOverwrite(
     throw std::runtime_error("Can't update costmap layer: It has't been initialized yet!");
   }
 
-  unsigned char * master = master_grid.getCharMap();
-  unsigned int span = master_grid.getSizeInCellsX();
-
-  for (int j = min_j; j < max_j; j++) {
-    unsigned int it = span * j + min_i;
-    for (int i = min_i; i < max_i; i++) {
-      master[it] = costmap_[it];
-      it++;
-    }
-  }
+  updateWithKernel(
+    master_grid, min_i, min_j, max_i, max_j,
+    [](unsigned char * master, const unsigned char * layer, unsigned int length) {
+      memcpy(master, layer, length * sizeof(unsigned char));
+    });
 }
 
 void CostmapLayer::updateWithOverwrite(
@@ -167,18 +179,8 @@ void CostmapLayer::updateWithOverwrite(
   if (!enabled_) {
     return;
   }
-  unsigned char * master = master_grid.getCharMap();
-  unsigned int span = master_grid.getSizeInCellsX();
 
-  for (int j = min_j; j < max_j; j++) {
-    unsigned int it = span * j + min_i;
-    for (int i = min_i; i < max_i; i++) {
-      if (costmap_[it] != NO_INFORMATION) {
-        master[it] = costmap_[it];
-      }
-      it++;
-    }
-  }
+  updateWithKernel(master_grid, min_i, min_j, max_i, max_j, mergeRowOverwrite);
 }
 
 void CostmapLayer::updateWithAddition(
@@ -188,30 +190,30 @@ void CostmapLayer::updateWithAddition(
   if (!enabled_) {
     return;
   }
-  unsigned char * master_array = master_grid.getCharMap();
-  unsigned int span = master_grid.getSizeInCellsX();
 
-  for (int j = min_j; j < max_j; j++) {
-    unsigned int it = j * span + min_i;
-    for (int i = min_i; i < max_i; i++) {
-      if (costmap_[it] == NO_INFORMATION) {
-        it++;
-        continue;
-      }
+  updateWithKernel(master_grid, min_i, min_j, max_i, max_j, mergeRowAddition);
+}
 
-      unsigned char old_cost = master_array[it];
-      if (old_cost == NO_INFORMATION) {
-        master_array[it] = costmap_[it];
-      } else {
-        int sum = old_cost + costmap_[it];
-        if (sum >= nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE) {
-          master_array[it] = nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1;
-        } else {
-          master_array[it] = sum;
-        }
-      }
-      it++;
-    }
+void CostmapLayer::updateWithKernel(
+  nav2_costmap_2d::Costmap2D & master_grid, int min_i, int min_j, int max_i,
+  int max_j, RowKernel kernel)
+{
+  if (max_i <= min_i) {
+    return;
   }
+
+  unsigned char * master_array = master_grid.getCharMap();
+  unsigned int span = master_grid.getSizeInCellsX();
+  ThreadPool * pool = layered_costmap_ ? layered_costmap_->getThreadPool() : nullptr;
+
+  forEachRowTile(
+    pool, min_j, max_j, max_i - min_i,
+    [this, master_array, span, kernel, min_i, max_i](int tile_min_j, int tile_max_j) {
+      forEachRun(
+        [this, master_array, span, kernel](
+          unsigned int index, unsigned int mx, unsigned int my, unsigned int length) {
+          kernel(master_array + my * span + mx, costmap_ + index, length);
+        }, min_i, tile_min_j, max_i, tile_max_j);
+    });
 }
 }  // namespace nav2_costmap_2d
@@ -0,0 +1,332 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "nav2_costmap_2d/costmap_pyramid.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+// Lines of up to this many cells are read from the costmap directly
+const unsigned int direct_line_cells = 8;
+}  // namespace
+
+CostmapPyramid::CostmapPyramid(const Costmap2D & costmap)
+: costmap_(costmap)
+{
+}
+
+void CostmapPyramid::setLevels(unsigned int levels)
+{
+  levels_.resize(levels);
+  update();
+}
+
+void CostmapPyramid::update()
+{
+  unsigned int size_x = costmap_.getSizeInCellsX();
+  unsigned int size_y = costmap_.getSizeInCellsY();
+  for (Level & level : levels_) {
+    size_x = (size_x + 1) / 2;
+    size_y = (size_y + 1) / 2;
+    level.size_x = size_x;
+    level.size_y = size_y;
+    level.cells.resize(static_cast<size_t>(size_x) * size_y);
+  }
+  for (unsigned int l = 1; l <= levels_.size(); ++l) {
+    updateLevel(l, 0, 0, levels_[l - 1].size_x, levels_[l - 1].size_y);
+  }
+}
+
+void CostmapPyramid::update(unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn)
+{
+  if (levels_.empty()) {
+    return;
+  }
+  unsigned int size_x = costmap_.getSizeInCellsX();
+  unsigned int size_y = costmap_.getSizeInCellsY();
+  if (levels_[0].size_x != (size_x + 1) / 2 || levels_[0].size_y != (size_y + 1) / 2) {
+    update();
+    return;
+  }
+
+  xn = std::min(xn, size_x);
+  yn = std::min(yn, size_y);
+  if (xn <= x0 || yn <= y0) {
+    return;
+  }
+  for (unsigned int l = 1; l <= levels_.size(); ++l) {
+    // the blocks covering the window of the level below
+    x0 /= 2;
+    y0 /= 2;
+    xn = (xn + 1) / 2;
+    yn = (yn + 1) / 2;
+    updateLevel(l, x0, y0, xn, yn);
+  }
+}
+
+void CostmapPyramid::updateLevel(
+  unsigned int level, unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn)
+{
+  Level & parent = levels_[level - 1];
+  unsigned int child_size_x = getSizeInCellsX(level - 1);
+  unsigned int child_size_y = getSizeInCellsY(level - 1);
+  unsigned int cx0 = 2 * x0, cxn = std::min(2 * xn, child_size_x);
+  const unsigned char * charmap = costmap_.getCharMap();
+
+  for (unsigned int y = y0; y < yn; ++y) {
+    unsigned char * row = &parent.cells[static_cast<size_t>(y) * parent.size_x];
+    std::fill(row + x0, row + xn, 0);
+    for (unsigned int cy = 2 * y; cy < std::min(2 * y + 2, child_size_y); ++cy) {
+      if (level == 1) {
+        // the costmap may be toroidal, so its rows are read in runs
+        costmap_.forEachRun(
+          [&](unsigned int index, unsigned int mx, unsigned int, unsigned int length) {
+            const unsigned char * cells = charmap + index;
+            for (unsigned int i = 0; i < length; ++i) {
+              unsigned char & max_cost = row[(mx + i) / 2];
+              max_cost = std::max(max_cost, cells[i]);
+            }
+          }, cx0, cy, cxn, cy + 1);
+      } else {
+        const Level & child = levels_[level - 2];
+        const unsigned char * cells = &child.cells[static_cast<size_t>(cy) * child.size_x];
+        for (unsigned int cx = cx0; cx < cxn; ++cx) {
+          unsigned char & max_cost = row[cx / 2];
+          max_cost = std::max(max_cost, cells[cx]);
+        }
+      }
+    }
+  }
+}
+
+unsigned char CostmapPyramid::getCost(unsigned int level, unsigned int x, unsigned int y) const
+{
+  if (level == 0) {
+    return costmap_.getCost(x, y);
+  }
+  const Level & l = levels_[level - 1];
+  return l.cells[static_cast<size_t>(y) * l.size_x + x];
+}
+
+unsigned int CostmapPyramid::getSizeInCellsX(unsigned int level) const
+{
+  return level == 0 ? costmap_.getSizeInCellsX() : levels_[level - 1].size_x;
+}
+
+unsigned int CostmapPyramid::getSizeInCellsY(unsigned int level) const
+{
+  return level == 0 ? costmap_.getSizeInCellsY() : levels_[level - 1].size_y;
+}
+
+unsigned char CostmapPyramid::getMaxCost(
+  unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn) const
+{
+  xn = std::min(xn, costmap_.getSizeInCellsX());
+  yn = std::min(yn, costmap_.getSizeInCellsY());
+  unsigned char max_cost = 0;
+  if (xn <= x0 || yn <= y0) {
+    return max_cost;
+  }
+
+  unsigned int top = levels_.size();
+  for (unsigned int by = y0 >> top; by <= (yn - 1) >> top; ++by) {
+    for (unsigned int bx = x0 >> top; bx <= (xn - 1) >> top; ++bx) {
+      maxBlock(top, bx, by, x0, y0, xn, yn, max_cost);
+      if (max_cost == std::numeric_limits<unsigned char>::max()) {
+        return max_cost;
+      }
+    }
+  }
+  return max_cost;
+}
+
+bool CostmapPyramid::hasCostInRegion(
+  unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+  unsigned char cost) const
+{
+  xn = std::min(xn, costmap_.getSizeInCellsX());
+  yn = std::min(yn, costmap_.getSizeInCellsY());
+  if (xn <= x0 || yn <= y0) {
+    return false;
+  }
+
+  unsigned int top = levels_.size();
+  for (unsigned int by = y0 >> top; by <= (yn - 1) >> top; ++by) {
+    for (unsigned int bx = x0 >> top; bx <= (xn - 1) >> top; ++bx) {
+      if (searchBlock(top, bx, by, x0, y0, xn, yn, cost)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool CostmapPyramid::searchBlock(
+  unsigned int level, unsigned int bx, unsigned int by,
+  unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+  unsigned char cost) const
+{
+  if (getCost(level, bx, by) < cost) {
+    return false;
+  }
+
+  // a block entirely within the window holds the cost, which single cells always are
+  unsigned int cx0 = bx << level, cy0 = by << level;
+  unsigned int cxn = std::min(cx0 + (1u << level), costmap_.getSizeInCellsX());
+  unsigned int cyn = std::min(cy0 + (1u << level), costmap_.getSizeInCellsY());
+  if (cx0 >= x0 && cy0 >= y0 && cxn <= xn && cyn <= yn) {
+    return true;
+  }
+
+  unsigned int child = level - 1;
+  unsigned int child_xn = std::min(2 * bx + 2, ((xn - 1) >> child) + 1);
+  unsigned int child_yn = std::min(2 * by + 2, ((yn - 1) >> child) + 1);
+  child_xn = std::min(child_xn, getSizeInCellsX(child));
+  child_yn = std::min(child_yn, getSizeInCellsY(child));
+  for (unsigned int y = std::max(2 * by, y0 >> child); y < child_yn; ++y) {
+    for (unsigned int x = std::max(2 * bx, x0 >> child); x < child_xn; ++x) {
+      if (searchBlock(child, x, y, x0, y0, xn, yn, cost)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void CostmapPyramid::maxBlock(
+  unsigned int level, unsigned int bx, unsigned int by,
+  unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+  unsigned char & max_cost) const
+{
+  unsigned char block_cost = getCost(level, bx, by);
+  if (block_cost <= max_cost) {
+    return;
+  }
+
+  unsigned int cx0 = bx << level, cy0 = by << level;
+  unsigned int cxn = std::min(cx0 + (1u << level), costmap_.getSizeInCellsX());
+  unsigned int cyn = std::min(cy0 + (1u << level), costmap_.getSizeInCellsY());
+  if (cx0 >= x0 && cy0 >= y0 && cxn <= xn && cyn <= yn) {
+    max_cost = block_cost;
+    return;
+  }
+
+  unsigned int child = level - 1;
+  unsigned int child_xn = std::min(2 * bx + 2, ((xn - 1) >> child) + 1);
+  unsigned int child_yn = std::min(2 * by + 2, ((yn - 1) >> child) + 1);
+  child_xn = std::min(child_xn, getSizeInCellsX(child));
+  child_yn = std::min(child_yn, getSizeInCellsY(child));
+  for (unsigned int y = std::max(2 * by, y0 >> child); y < child_yn; ++y) {
+    for (unsigned int x = std::max(2 * bx, x0 >> child); x < child_xn; ++x) {
+      maxBlock(child, x, y, x0, y0, xn, yn, max_cost);
+      // the block can't hold more than its own cost
+      if (max_cost == block_cost) {
+        return;
+      }
+    }
+  }
+}
+
+void CostmapPyramid::Line::getCell(unsigned int i, unsigned int & x, unsigned int & y) const
+{
+  // as Costmap2D::bresenham2D(), whose error starts at abs_da / 2
+  unsigned int a = a0 + step_a * static_cast<int>(i);
+  unsigned int b = b0;
+  if (abs_da > 0) {
+    uint64_t steps = (abs_da / 2 + static_cast<uint64_t>(i) * abs_db) / abs_da;
+    b = b0 + step_b * static_cast<int>(steps);
+  }
+  x = x_major ? a : b;
+  y = x_major ? b : a;
+}
+
+bool CostmapPyramid::hasCostOnLine(
+  unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+  unsigned char cost) const
+{
+  int dx = static_cast<int>(x1) - static_cast<int>(x0);
+  int dy = static_cast<int>(y1) - static_cast<int>(y0);
+
+  Line line;
+  line.x_major = std::abs(dx) >= std::abs(dy);
+  if (line.x_major) {
+    line.a0 = x0;
+    line.b0 = y0;
+    line.step_a = dx >= 0 ? 1 : -1;
+    line.step_b = dy >= 0 ? 1 : -1;
+    line.abs_da = std::abs(dx);
+    line.abs_db = std::abs(dy);
+  } else {
+    line.a0 = y0;
+    line.b0 = x0;
+    line.step_a = dy >= 0 ? 1 : -1;
+    line.step_b = dx >= 0 ? 1 : -1;
+    line.abs_da = std::abs(dy);
+    line.abs_db = std::abs(dx);
+  }
+  return searchLine(line, 0, line.abs_da + 1, cost);
+}
+
+bool CostmapPyramid::searchLine(
+  const Line & line, unsigned int i0, unsigned int i1, unsigned char cost) const
+{
+  if (i1 - i0 <= direct_line_cells) {
+    for (unsigned int i = i0; i < i1; ++i) {
+      unsigned int x, y;
+      line.getCell(i, x, y);
+      if (costmap_.getCost(x, y) >= cost) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // the cells of a line are monotonic, so its ends bound them
+  unsigned int xa, ya, xb, yb;
+  line.getCell(i0, xa, ya);
+  line.getCell(i1 - 1, xb, yb);
+  unsigned int min_x = std::min(xa, xb), max_x = std::max(xa, xb);
+  unsigned int min_y = std::min(ya, yb), max_y = std::max(ya, yb);
+
+  // the first level whose blocks are larger than the span, so at most 2 x 2 of them cover it
+  unsigned int span = std::max(max_x - min_x, max_y - min_y);
+  unsigned int level = 0;
+  while ((1u << level) <= span) {
+    ++level;
+  }
+  if (level <= levels_.size()) {
+    bool may_hold = false;
+    for (unsigned int by = min_y >> level; by <= max_y >> level && !may_hold; ++by) {
+      for (unsigned int bx = min_x >> level; bx <= max_x >> level && !may_hold; ++bx) {
+        may_hold = getCost(level, bx, by) >= cost;
+      }
+    }
+    if (!may_hold) {
+      return false;
+    }
+  }
+
+  unsigned int mid = i0 + (i1 - i0) / 2;
+  return searchLine(line, i0, mid, cost) || searchLine(line, mid, i1, cost);
+}
+
+}  // namespace nav2_costmap_2d
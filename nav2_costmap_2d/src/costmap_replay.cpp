@@ -0,0 +1,195 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "nav2_costmap_2d/costmap_replay.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rcl/time.h"
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+
+template<class T>
+T getRecordedParameter(
+  const std::vector<rclcpp::Parameter> & parameters, const std::string & name, T default_value)
+{
+  for (const rclcpp::Parameter & parameter : parameters) {
+    if (parameter.get_name() == name) {
+      return parameter.get_value<T>();
+    }
+  }
+  return default_value;
+}
+
+bool endsWith(const std::string & value, const std::string & suffix)
+{
+  return value.size() >= suffix.size() &&
+         value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+CostmapReplay::CostmapReplay(const std::string & path, int update_threads)
+: reader_(path)
+{
+  const std::vector<rclcpp::Parameter> & recorded = reader_.getParameters();
+
+  // the layers don't subscribe to their sources, and read the time set for each update
+  std::vector<rclcpp::Parameter> parameters;
+  for (const rclcpp::Parameter & parameter : recorded) {
+    if (parameter.get_name() == "use_sim_time") {
+      continue;
+    }
+    if (endsWith(parameter.get_name(), ".observation_sources")) {
+      parameters.emplace_back(parameter.get_name(), std::string(""));
+    } else {
+      parameters.push_back(parameter);
+    }
+  }
+  parameters.emplace_back("use_sim_time", true);
+
+  // declared up front, as Costmap2DROS declares those its layers read without declaring them
+  node_ = std::make_shared<nav2_util::LifecycleNode>(
+    "costmap_replay", "", false,
+    rclcpp::NodeOptions().parameter_overrides(parameters)
+    .automatically_declare_parameters_from_overrides(true));
+  client_node_ = std::make_shared<rclcpp::Node>("costmap_replay_client");
+  tf_buffer_ = std::make_shared<tf2_ros::Buffer>(node_->get_clock());
+
+  // create the costmap as Costmap2DROS does
+  layered_costmap_ = std::make_unique<LayeredCostmap>(
+    getRecordedParameter(recorded, "global_frame", std::string("map")),
+    getRecordedParameter(recorded, "rolling_window", false),
+    getRecordedParameter(recorded, "track_unknown_space", false));
+  if (update_threads <= 0) {
+    update_threads = getRecordedParameter(recorded, "update_threads", 1);
+  }
+  layered_costmap_->setUpdateThreads(std::max(update_threads, 1));
+  layered_costmap_->setPyramidLevels(
+    std::max(getRecordedParameter(recorded, "pyramid_levels", 0), 0));
+
+  if (!layered_costmap_->isSizeLocked()) {
+    double resolution = getRecordedParameter(recorded, "resolution", 0.1);
+    layered_costmap_->resizeMap(
+      (unsigned int)(getRecordedParameter(recorded, "width", 5) / resolution),
+      (unsigned int)(getRecordedParameter(recorded, "height", 5) / resolution), resolution,
+      getRecordedParameter(recorded, "origin_x", 0.0),
+      getRecordedParameter(recorded, "origin_y", 0.0));
+  }
+
+  std::vector<std::string> plugin_names =
+    getRecordedParameter(recorded, "plugin_names", std::vector<std::string>());
+  std::vector<std::string> plugin_types =
+    getRecordedParameter(recorded, "plugin_types", std::vector<std::string>());
+  if (plugin_names.size() != plugin_types.size()) {
+    throw std::runtime_error("Size of plugin_names and plugin_type parameters do not match");
+  }
+  for (unsigned int i = 0; i < plugin_names.size(); ++i) {
+    std::shared_ptr<Layer> plugin = plugin_loader_.createSharedInstance(plugin_types[i]);
+    layered_costmap_->addPlugin(plugin);
+    plugin->initialize(
+      layered_costmap_.get(), plugin_names[i], tf_buffer_.get(),
+      node_, client_node_, client_node_);
+    plugin->activate();
+  }
+}
+
+CostmapReplay::~CostmapReplay()
+{
+  for (auto & plugin : *layered_costmap_->getPlugins()) {
+    plugin->deactivate();
+  }
+}
+
+bool CostmapReplay::replayCycle(Result & result)
+{
+  SensorLogCycle cycle;
+  if (!reader_.readCycle(cycle)) {
+    return false;
+  }
+  setTime(cycle.stamp);
+
+  // sizes set by layers outside of the updates, e.g. from a map, are set again here
+  Costmap2D * master = layered_costmap_->getCostmap();
+  if (cycle.has_geometry &&
+    (cycle.size_x != master->getSizeInCellsX() || cycle.size_y != master->getSizeInCellsY() ||
+    cycle.resolution != master->getResolution()))
+  {
+    layered_costmap_->resizeMap(
+      cycle.size_x, cycle.size_y, cycle.resolution, cycle.origin_x, cycle.origin_y);
+  }
+  if (cycle.has_footprint) {
+    layered_costmap_->setFootprint(cycle.footprint);
+  }
+
+  const std::vector<Observation> none;
+  for (auto & plugin : *layered_costmap_->getPlugins()) {
+    auto layer = cycle.layers.find(plugin->getName());
+    if (layer != cycle.layers.end()) {
+      plugin->setReplayedObservations(layer->second.marking, layer->second.clearing);
+    } else {
+      plugin->setReplayedObservations(none, none);
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  layered_costmap_->updateMap(cycle.robot_x, cycle.robot_y, cycle.robot_yaw);
+  result.update_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  result.stamp = cycle.stamp;
+  result.checksum = getCostmapChecksum(*master);
+  return true;
+}
+
+void CostmapReplay::setTime(int64_t stamp)
+{
+  rcl_clock_t * clock = node_->get_clock()->get_clock_handle();
+  if (rcl_enable_ros_time_override(clock) != RCL_RET_OK ||
+    rcl_set_ros_time_override(clock, stamp) != RCL_RET_OK)
+  {
+    throw std::runtime_error("Could not set the time of the replay");
+  }
+}
+
+uint64_t getCostmapChecksum(const Costmap2D & costmap)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  auto add = [&hash](const unsigned char * bytes, size_t size) {
+      for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+      }
+    };
+
+  unsigned int size_x = costmap.getSizeInCellsX(), size_y = costmap.getSizeInCellsY();
+  add(reinterpret_cast<const unsigned char *>(&size_x), sizeof(size_x));
+  add(reinterpret_cast<const unsigned char *>(&size_y), sizeof(size_y));
+  const unsigned char * charmap = costmap.getCharMap();
+  costmap.forEachRun(
+    [&](unsigned int index, unsigned int, unsigned int, unsigned int length) {
+      add(charmap + index, length);
+    }, 0, 0, size_x, size_y);
+  return hash;
+}
+
+}  // namespace nav2_costmap_2d
@@ -0,0 +1,168 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "nav2_costmap_2d/costmap_snapshot.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'N', 'A', 'V', '2', 'C', 'M', 'A', 'P'};
+
+std::string errorString(const std::string & what, const std::string & file_name)
+{
+  return what + " " + file_name + ": " + strerror(errno);
+}
+
+}  // namespace
+
+CostmapSnapshot::CostmapSnapshot(const std::string & file_name)
+: data_(nullptr), size_(0)
+{
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(errorString("Could not open the costmap snapshot", file_name));
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    std::string error = errorString("Could not read the costmap snapshot", file_name);
+    close(fd);
+    throw std::runtime_error(error);
+  }
+  size_ = static_cast<size_t>(status.st_size);
+  if (size_ < sizeof(CostmapSnapshotHeader)) {
+    close(fd);
+    throw std::runtime_error("Truncated costmap snapshot " + file_name);
+  }
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file open
+  close(fd);
+  if (data_ == MAP_FAILED) {
+    data_ = nullptr;
+    throw std::runtime_error(errorString("Could not map the costmap snapshot", file_name));
+  }
+
+  const CostmapSnapshotHeader & header = getHeader();
+  std::string error;
+  if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    error = "Not a costmap snapshot ";
+  } else if (header.version != CostmapSnapshotHeader::VERSION) {
+    error = "Unsupported version " + std::to_string(header.version) + " of costmap snapshot ";
+  } else if (header.header_size < sizeof(CostmapSnapshotHeader) || header.num_planes == 0 ||
+    header.name[CostmapSnapshotHeader::NAME_SIZE - 1] != '\0' ||
+    header.frame[CostmapSnapshotHeader::FRAME_SIZE - 1] != '\0')
+  {
+    error = "Corrupt costmap snapshot ";
+  } else if (size_ < header.header_size || size_ - header.header_size <
+    static_cast<uint64_t>(header.size_x) * header.size_y * header.num_planes)
+  {
+    error = "Truncated costmap snapshot ";
+  }
+  if (!error.empty()) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    throw std::runtime_error(error + file_name);
+  }
+}
+
+CostmapSnapshot::~CostmapSnapshot()
+{
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
+
+std::string CostmapSnapshot::getName() const
+{
+  return getHeader().name;
+}
+
+std::string CostmapSnapshot::getFrame() const
+{
+  return getHeader().frame;
+}
+
+const unsigned char * CostmapSnapshot::getPlane(unsigned int plane) const
+{
+  const CostmapSnapshotHeader & header = getHeader();
+  if (plane >= header.num_planes) {
+    throw std::out_of_range("No plane " + std::to_string(plane) + " in the costmap snapshot");
+  }
+  return static_cast<const unsigned char *>(data_) + header.header_size +
+         static_cast<size_t>(header.size_x) * header.size_y * plane;
+}
+
+void CostmapSnapshot::write(
+  const std::string & file_name, const Costmap2D & costmap,
+  const std::string & name, const std::string & frame)
+{
+  if (name.size() >= CostmapSnapshotHeader::NAME_SIZE) {
+    throw std::runtime_error("The costmap snapshot name " + name + " is too long");
+  }
+  if (frame.size() >= CostmapSnapshotHeader::FRAME_SIZE) {
+    throw std::runtime_error("The costmap snapshot frame " + frame + " is too long");
+  }
+
+  CostmapSnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = CostmapSnapshotHeader::VERSION;
+  header.header_size = sizeof(CostmapSnapshotHeader);
+  header.size_x = costmap.getSizeInCellsX();
+  header.size_y = costmap.getSizeInCellsY();
+  header.resolution = costmap.getResolution();
+  header.origin_x = costmap.getOriginX();
+  header.origin_y = costmap.getOriginY();
+  header.num_planes = 1;
+  memcpy(header.name, name.c_str(), name.size());
+  memcpy(header.frame, frame.c_str(), frame.size());
+
+  std::string temporary_name = file_name + ".tmp";
+  FILE * fp = fopen(temporary_name.c_str(), "wb");
+  if (!fp) {
+    throw std::runtime_error(errorString("Could not create the costmap snapshot", file_name));
+  }
+  bool written = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+  // the runs of each row come in order, also across the seam of a toroidal costmap
+  const unsigned char * costs = costmap.getCharMap();
+  costmap.forEachRun(
+    [&](unsigned int index, unsigned int, unsigned int, unsigned int length) {
+      written = written && fwrite(costs + index, 1, length, fp) == length;
+    }, 0, 0, header.size_x, header.size_y);
+
+  written = fflush(fp) == 0 && written;
+  written = fclose(fp) == 0 && written;
+  if (!written || rename(temporary_name.c_str(), file_name.c_str()) != 0) {
+    std::string error = errorString("Could not write the costmap snapshot", file_name);
+    remove(temporary_name.c_str());
+    throw std::runtime_error(error);
+  }
+}
+
+}  // namespace nav2_costmap_2d
@@ -12,10 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstring>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "nav2_costmap_2d/costmap_subscriber.hpp"
+#include "nav2_costmap_2d/run_length_encoding.hpp"
 
 namespace nav2_costmap_2d
 {
@@ -48,58 +51,159 @@ CostmapSubscriber::CostmapSubscriber(
   node_logging_(node_logging),
   topic_name_(topic_name)
 {
-  costmap_sub_ = rclcpp::create_subscription<nav2_msgs::msg::Costmap>(
+  costmap_sub_ = rclcpp::create_subscription<nav2_msgs::msg::CostmapUpdate>(
+    node_topics_, topic_name_ + "_updates",
+    rclcpp::QoS(rclcpp::KeepLast(1)).transient_local().reliable(),
+    std::bind(&CostmapSubscriber::costmapUpdateCallback, this, std::placeholders::_1));
+  full_costmap_sub_ = rclcpp::create_subscription<nav2_msgs::msg::Costmap>(
     node_topics_, topic_name_,
     rclcpp::QoS(rclcpp::KeepLast(1)).transient_local().reliable(),
     std::bind(&CostmapSubscriber::costmapCallback, this, std::placeholders::_1));
 }
 
-std::shared_ptr<Costmap2D> CostmapSubscriber::getCostmap()
+std::shared_ptr<const Costmap2D> CostmapSubscriber::getCostmap()
+{
+  uint64_t version;
+  return getCostmap(version);
+}
+
+std::shared_ptr<const Costmap2D> CostmapSubscriber::getCostmap(uint64_t & version)
 {
-  if (!costmap_received_) {
+  std::lock_guard<std::mutex> lock(costmap_mutex_);
+  if (!grid_) {
     throw std::runtime_error("Costmap is not available");
   }
-  toCostmap2D();
+
+  // copy the grid once per version, into the last copy if nobody holds it anymore
+  if (costmap_version_ != version_) {
+    if (costmap_ && costmap_.use_count() == 1) {
+      *costmap_ = *grid_;
+    } else {
+      costmap_ = std::make_shared<Costmap2D>(*grid_);
+    }
+    costmap_version_ = version_;
+  }
+  version = version_;
   return costmap_;
 }
 
-void CostmapSubscriber::toCostmap2D()
+uint64_t CostmapSubscriber::getVersion()
+{
+  std::lock_guard<std::mutex> lock(costmap_mutex_);
+  return version_;
+}
+
+bool CostmapSubscriber::decodePatches(
+  const nav2_msgs::msg::CostmapUpdate & update,
+  std::vector<std::vector<uint8_t>> & decoded) const
+{
+  decoded.resize(update.patches.size());
+  for (size_t i = 0; i < update.patches.size(); ++i) {
+    const nav2_msgs::msg::CostmapPatch & patch = update.patches[i];
+    if (patch.x + patch.width < patch.x || patch.x + patch.width > update.metadata.size_x ||
+      patch.y + patch.height < patch.y || patch.y + patch.height > update.metadata.size_y)
+    {
+      return false;
+    }
+
+    size_t size = static_cast<size_t>(patch.width) * patch.height;
+    if (patch.encoding == nav2_msgs::msg::CostmapPatch::ENCODING_RAW) {
+      if (patch.data.size() != size) {
+        return false;
+      }
+    } else if (patch.encoding == nav2_msgs::msg::CostmapPatch::ENCODING_RUN_LENGTH) {
+      decoded[i].resize(size);
+      if (!decodeRunLength(patch.data, decoded[i].data(), size)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CostmapSubscriber::costmapUpdateCallback(
+  const nav2_msgs::msg::CostmapUpdate::SharedPtr update)
 {
-  if (costmap_ == nullptr) {
-    costmap_ = std::make_shared<Costmap2D>(
-      costmap_msg_->metadata.size_x, costmap_msg_->metadata.size_y,
-      costmap_msg_->metadata.resolution, costmap_msg_->metadata.origin.position.x,
-      costmap_msg_->metadata.origin.position.y);
-  } else if (costmap_->getSizeInCellsX() != costmap_msg_->metadata.size_x ||  // NOLINT
-    costmap_->getSizeInCellsY() != costmap_msg_->metadata.size_y ||
-    costmap_->getResolution() != costmap_msg_->metadata.resolution ||
-    costmap_->getOriginX() != costmap_msg_->metadata.origin.position.x ||
-    costmap_->getOriginY() != costmap_msg_->metadata.origin.position.y)
-  {
-    // Update the size of the costmap
-    costmap_->resizeMap(
-      costmap_msg_->metadata.size_x, costmap_msg_->metadata.size_y,
-      costmap_msg_->metadata.resolution,
-      costmap_msg_->metadata.origin.position.x,
-      costmap_msg_->metadata.origin.position.y);
+  std::vector<std::vector<uint8_t>> decoded;
+  if (!decodePatches(*update, decoded)) {
+    RCLCPP_WARN(
+      node_logging_->get_logger(),
+      "Malformed costmap update on %s, waiting for the next keyframe", topic_name_.c_str());
+    synchronized_ = false;
+    return;
+  }
+
+  const nav2_msgs::msg::CostmapMetaData & metadata = update->metadata;
+  bool same_grid = matchesGrid(metadata);
+  if (!update->keyframe && (!synchronized_ || !same_grid || update->sequence != sequence_ + 1)) {
+    if (synchronized_) {
+      RCLCPP_WARN(
+        node_logging_->get_logger(),
+        "Lost costmap updates on %s, waiting for the next keyframe", topic_name_.c_str());
+    }
+    synchronized_ = false;
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(costmap_mutex_);
+  if (!same_grid) {
+    grid_ = std::make_unique<Costmap2D>(
+      metadata.size_x, metadata.size_y, metadata.resolution,
+      metadata.origin.position.x, metadata.origin.position.y);
   }
 
-  unsigned char * master_array = costmap_->getCharMap();
-  unsigned int index = 0;
-  for (unsigned int i = 0; i < costmap_msg_->metadata.size_x; ++i) {
-    for (unsigned int j = 0; j < costmap_msg_->metadata.size_y; ++j) {
-      master_array[index] = costmap_msg_->data[index];
-      ++index;
+  unsigned char * data = grid_->getCharMap();
+  for (size_t i = 0; i < update->patches.size(); ++i) {
+    const nav2_msgs::msg::CostmapPatch & patch = update->patches[i];
+    const uint8_t * patch_data = decoded[i].empty() ? patch.data.data() : decoded[i].data();
+    for (unsigned int y = 0; y < patch.height; ++y) {
+      memcpy(
+        data + grid_->getIndex(patch.x, patch.y + y),
+        patch_data + static_cast<size_t>(y) * patch.width, patch.width);
     }
   }
+
+  ++version_;
+  sequence_ = update->sequence;
+  synchronized_ = true;
+
+  // the update stream works, so the whole costmaps aren't needed anymore
+  full_costmap_sub_.reset();
 }
 
 void CostmapSubscriber::costmapCallback(const nav2_msgs::msg::Costmap::SharedPtr msg)
 {
-  costmap_msg_ = msg;
-  if (!costmap_received_) {
-    costmap_received_ = true;
+  const nav2_msgs::msg::CostmapMetaData & metadata = msg->metadata;
+  if (msg->data.size() != static_cast<size_t>(metadata.size_x) * metadata.size_y) {
+    RCLCPP_WARN(
+      node_logging_->get_logger(),
+      "Malformed costmap on %s, waiting for the next one", topic_name_.c_str());
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(costmap_mutex_);
+  if (!matchesGrid(metadata)) {
+    grid_ = std::make_unique<Costmap2D>(
+      metadata.size_x, metadata.size_y, metadata.resolution,
+      metadata.origin.position.x, metadata.origin.position.y);
   }
+  memcpy(grid_->getCharMap(), msg->data.data(), msg->data.size());
+  ++version_;
+
+  // the update stream has to start again from a keyframe
+  synchronized_ = false;
+}
+
+bool CostmapSubscriber::matchesGrid(const nav2_msgs::msg::CostmapMetaData & metadata) const
+{
+  return grid_ &&
+         grid_->getSizeInCellsX() == metadata.size_x &&
+         grid_->getSizeInCellsY() == metadata.size_y &&
+         grid_->getResolution() == metadata.resolution &&
+         grid_->getOriginX() == metadata.origin.position.x &&
+         grid_->getOriginY() == metadata.origin.position.y;
 }
 
 }  // namespace nav2_costmap_2d
@@ -0,0 +1,137 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/decaying_voxel_grid.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace nav2_costmap_2d
+{
+
+Frustum::Frustum(
+  const geometry_msgs::msg::Point & origin, const geometry_msgs::msg::Quaternion & orientation,
+  double horizontal_fov, double vertical_fov, double range)
+: ox_(origin.x), oy_(origin.y), oz_(origin.z),
+  horizontal_fov_(horizontal_fov), vertical_fov_(vertical_fov),
+  sq_tan_horizontal_(0.0), sq_tan_vertical_(0.0), sq_range_(range * range)
+{
+  double norm = std::sqrt(
+    orientation.x * orientation.x + orientation.y * orientation.y +
+    orientation.z * orientation.z + orientation.w * orientation.w);
+  double qx = orientation.x / norm, qy = orientation.y / norm;
+  double qz = orientation.z / norm, qw = orientation.w / norm;
+  rotation_[0][0] = 1.0 - 2.0 * (qy * qy + qz * qz);
+  rotation_[0][1] = 2.0 * (qx * qy - qw * qz);
+  rotation_[0][2] = 2.0 * (qx * qz + qw * qy);
+  rotation_[1][0] = 2.0 * (qx * qy + qw * qz);
+  rotation_[1][1] = 1.0 - 2.0 * (qx * qx + qz * qz);
+  rotation_[1][2] = 2.0 * (qy * qz - qw * qx);
+  rotation_[2][0] = 2.0 * (qx * qz - qw * qy);
+  rotation_[2][1] = 2.0 * (qy * qz + qw * qx);
+  rotation_[2][2] = 1.0 - 2.0 * (qx * qx + qy * qy);
+
+  if (horizontal_fov_ < M_PI) {
+    double t = std::tan(horizontal_fov_ / 2.0);
+    sq_tan_horizontal_ = t * t;
+  }
+  if (vertical_fov_ < M_PI) {
+    double t = std::tan(vertical_fov_ / 2.0);
+    sq_tan_vertical_ = t * t;
+  }
+}
+
+bool Frustum::contains(double x, double y, double z) const
+{
+  double dx = x - ox_, dy = y - oy_, dz = z - oz_;
+  double sq_horizontal;
+  double sx, sy, sz;
+  if (dx * dx + dy * dy + dz * dz > sq_range_) {
+    return false;
+  }
+
+  // into the sensor frame, with the transpose of the rotation
+  sx = rotation_[0][0] * dx + rotation_[1][0] * dy + rotation_[2][0] * dz;
+  sy = rotation_[0][1] * dx + rotation_[1][1] * dy + rotation_[2][1] * dz;
+  sz = rotation_[0][2] * dx + rotation_[1][2] * dy + rotation_[2][2] * dz;
+  sq_horizontal = sx * sx + sy * sy;
+
+  // elevation within half the vertical field of view
+  if (vertical_fov_ < M_PI && sz * sz > sq_horizontal * sq_tan_vertical_) {
+    return false;
+  }
+
+  // azimuth within half the horizontal field of view, without trigonometry in front
+  if (horizontal_fov_ < M_PI) {
+    return sx > 0.0 && sy * sy <= sx * sx * sq_tan_horizontal_;
+  }
+  if (horizontal_fov_ < 2.0 * M_PI) {
+    return std::fabs(std::atan2(sy, sx)) <= horizontal_fov_ / 2.0;
+  }
+  return true;
+}
+
+void DecayingVoxelGrid::removeExpired(double now)
+{
+  for (auto it = voxels_.begin(); it != voxels_.end(); ) {
+    if (it->second <= now) {
+      it = erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void DecayingVoxelGrid::clear()
+{
+  voxels_.clear();
+  columns_.clear();
+}
+
+unsigned int DecayingVoxelGrid::getCount(int x, int y) const
+{
+  const unsigned int * count = columns_.find(nav2_voxel_grid::VoxelKey::column(x, y));
+  return count ? *count : 0;
+}
+
+void DecayingVoxelGrid::takeChangedColumns(std::vector<Column> & columns)
+{
+  columns.clear();
+  columns.reserve(columns_.numChanged());
+  columns_.takeChanged(
+    [&](int x, int y, const unsigned int * count) {
+      columns.push_back(Column{x, y, count ? *count : 0});
+    });
+}
+
+void DecayingVoxelGrid::getColumns(std::vector<Column> & columns) const
+{
+  columns.clear();
+  columns.reserve(columns_.size());
+  columns_.forEach(
+    [&](int x, int y, unsigned int count) {
+      columns.push_back(Column{x, y, count});
+    });
+}
+
+DecayingVoxelGrid::VoxelMap::iterator DecayingVoxelGrid::erase(VoxelMap::iterator voxel)
+{
+  uint64_t column = voxel->first >> Z_BITS;
+  if (--columns_.change(column) == 0) {
+    columns_.erase(column);
+  }
+  return voxels_.erase(voxel);
+}
+
+}  // namespace nav2_costmap_2d
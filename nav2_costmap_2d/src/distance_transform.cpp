@@ -0,0 +1,170 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/distance_transform.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "nav2_costmap_2d/merge_kernels.hpp"
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+// Below this many cells the window isn't worth handing to other threads
+const unsigned int min_parallel_cells = 1 << 16;
+
+// Columns per strip of the column pass, so each thread still works on long runs of a row
+const unsigned int min_strip_width = 64;
+
+inline int64_t floorDiv(int64_t a, int64_t b)
+{
+  int64_t q = a / b;
+  return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+}  // namespace
+
+DistanceTransform::DistanceTransform()
+: x0_(0), y0_(0), width_(0), height_(0), cap_(0)
+{
+}
+
+void DistanceTransform::compute(
+  const unsigned char * grid, unsigned int size_x,
+  unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+  unsigned int max_distance, ThreadPool * pool)
+{
+  x0_ = x0;
+  y0_ = y0;
+  width_ = xn > x0 ? xn - x0 : 0;
+  height_ = yn > y0 ? yn - y0 : 0;
+  cap_ = max_distance + 1;
+
+  size_t cells = static_cast<size_t>(width_) * height_;
+  vertical_.resize(cells);
+  squared_.resize(cells);
+  if (cells == 0) {
+    return;
+  }
+
+  unsigned int strips = 1;
+  if (pool != nullptr && pool->size() > 1 && cells >= min_parallel_cells) {
+    strips = std::max(1u, std::min(pool->size() * 4, width_ / min_strip_width));
+  }
+  if (strips == 1) {
+    columnPass(grid, size_x, 0, width_);
+  } else {
+    unsigned int strip_width = (width_ + strips - 1) / strips;
+    pool->parallelFor(
+      strips, [&](unsigned int s) {
+        unsigned int c0 = s * strip_width;
+        if (c0 < width_) {
+          columnPass(grid, size_x, c0, std::min(width_, c0 + strip_width));
+        }
+      });
+  }
+
+  forEachRowTile(
+    pool, 0, height_, width_, [this](int r0, int rn) {
+      rowPass(r0, rn);
+    });
+}
+
+void DistanceTransform::columnPass(
+  const unsigned char * grid, unsigned int size_x, unsigned int c0, unsigned int cn)
+{
+  unsigned int n = cn - c0;
+
+  // down the columns, one row at a time so the inner loops vectorize
+  const unsigned char * row = grid + static_cast<size_t>(y0_) * size_x + x0_ + c0;
+  unsigned int * g = &vertical_[c0];
+  for (unsigned int x = 0; x < n; ++x) {
+    g[x] = row[x] == LETHAL_OBSTACLE ? 0 : cap_;
+  }
+  for (unsigned int y = 1; y < height_; ++y) {
+    row += size_x;
+    const unsigned int * above = g;
+    g += width_;
+    for (unsigned int x = 0; x < n; ++x) {
+      g[x] = row[x] == LETHAL_OBSTACLE ? 0 : std::min(above[x] + 1, cap_);
+    }
+  }
+
+  // and back up
+  for (unsigned int y = height_ - 1; y-- > 0; ) {
+    unsigned int * up = &vertical_[static_cast<size_t>(y) * width_ + c0];
+    const unsigned int * below = up + width_;
+    for (unsigned int x = 0; x < n; ++x) {
+      up[x] = std::min(up[x], below[x] + 1);
+    }
+  }
+}
+
+void DistanceTransform::rowPass(unsigned int r0, unsigned int rn)
+{
+  const int m = width_;
+  // the parabolas are evaluated in 64 bits, since the squared offsets along a row aren't
+  // capped and overflow 32 bits in windows more than 46340 cells wide
+  const int64_t cap_squared = static_cast<int64_t>(cap_) * cap_;
+
+  // the columns whose parabolas make up the lower envelope, and where each one starts
+  std::vector<int> s(m), t(m);
+
+  for (unsigned int y = r0; y < rn; ++y) {
+    const unsigned int * g = &vertical_[static_cast<size_t>(y) * width_];
+    unsigned int * out = &squared_[static_cast<size_t>(y) * width_];
+
+    auto f = [g](int64_t x, int i) {
+        return (x - i) * (x - i) + static_cast<int64_t>(g[i]) * g[i];
+      };
+    // the first cell from which column u is closer than column i < u
+    auto sep = [g](int64_t i, int64_t u) {
+        return floorDiv(
+          u * u - i * i + static_cast<int64_t>(g[u]) * g[u] - static_cast<int64_t>(g[i]) * g[i],
+          2 * (u - i));
+      };
+
+    int q = 0;
+    s[0] = 0;
+    t[0] = 0;
+    for (int u = 1; u < m; ++u) {
+      while (q >= 0 && f(t[q], s[q]) > f(t[q], u)) {
+        --q;
+      }
+      if (q < 0) {
+        q = 0;
+        s[0] = u;
+      } else {
+        int64_t w = 1 + sep(s[q], u);
+        if (w < m) {
+          ++q;
+          s[q] = u;
+          t[q] = static_cast<int>(w);
+        }
+      }
+    }
+
+    for (int u = m - 1; u >= 0; --u) {
+      out[u] = static_cast<unsigned int>(std::min(f(u, s[q]), cap_squared));
+      if (u == t[q]) {
+        --q;
+      }
+    }
+  }
+}
+
+}  // namespace nav2_costmap_2d
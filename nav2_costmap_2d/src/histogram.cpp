@@ -0,0 +1,117 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "nav2_costmap_2d/histogram.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace nav2_costmap_2d
+{
+
+const unsigned int Histogram::num_buckets;
+
+Histogram::Histogram()
+: sum_(0), max_(0)
+{
+  for (auto & bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+unsigned int Histogram::getBucket(uint64_t value)
+{
+  if (value < 4) {
+    return value;
+  }
+  // the exponent, then the two bits after the leading one
+  unsigned int exponent = 63 - __builtin_clzll(value);
+  unsigned int mantissa = (value >> (exponent - 2)) & 3;
+  return 4 * (exponent - 1) + mantissa;
+}
+
+uint64_t Histogram::getBucketMax(unsigned int bucket)
+{
+  if (bucket < 4) {
+    return bucket;
+  }
+  unsigned int exponent = bucket / 4 + 1;
+  uint64_t mantissa = bucket % 4;
+  // the lowest value of the next bucket, minus one
+  return ((4 + mantissa + 1) << (exponent - 2)) - 1;
+}
+
+void Histogram::record(uint64_t value)
+{
+  buckets_[getBucket(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Summary Histogram::summarize() const
+{
+  std::array<uint64_t, num_buckets> counts;
+  for (unsigned int i = 0; i < num_buckets; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  return summarizeCounts(
+    counts, sum_.load(std::memory_order_relaxed), max_.load(std::memory_order_relaxed));
+}
+
+Histogram::Summary Histogram::summarizeAndReset()
+{
+  std::array<uint64_t, num_buckets> counts;
+  for (unsigned int i = 0; i < num_buckets; ++i) {
+    counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+  }
+  return summarizeCounts(
+    counts, sum_.exchange(0, std::memory_order_relaxed),
+    max_.exchange(0, std::memory_order_relaxed));
+}
+
+Histogram::Summary Histogram::summarizeCounts(
+  const std::array<uint64_t, num_buckets> & counts, uint64_t sum, uint64_t max)
+{
+  Summary summary;
+  summary.count = 0;
+  for (uint64_t count : counts) {
+    summary.count += count;
+  }
+  summary.mean = summary.count > 0 ? static_cast<double>(sum) / summary.count : 0.0;
+  summary.max = max;
+
+  // the first bucket reaching each rank
+  uint64_t ranks[3] = {
+    (summary.count * 50 + 99) / 100, (summary.count * 90 + 99) / 100,
+    (summary.count * 99 + 99) / 100};
+  uint64_t * percentiles[3] = {&summary.p50, &summary.p90, &summary.p99};
+  uint64_t seen = 0;
+  unsigned int p = 0;
+  for (unsigned int i = 0; i < num_buckets && p < 3; ++i) {
+    seen += counts[i];
+    while (p < 3 && seen >= ranks[p] && seen > 0) {
+      // a bucket doesn't go past the highest sample
+      *percentiles[p++] = std::min(getBucketMax(i), max);
+    }
+  }
+  for (; p < 3; ++p) {
+    *percentiles[p] = 0;
+  }
+  return summary;
+}
+
+}  // namespace nav2_costmap_2d
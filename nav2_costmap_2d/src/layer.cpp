@@ -41,6 +41,8 @@ Layer::Layer()
   name_(),
   tf_(nullptr),
   current_(false),
+  changed_(true),
+  observation_count_(0),
   enabled_(false)
 {}
 
@@ -61,6 +63,17 @@ Layer::initialize(
   onInitialize();
 }
 
+void
+Layer::updateRegion(double robot_x, double robot_y, double robot_yaw, WorldRegion & region)
+{
+  double min_x = 1e30, min_y = 1e30, max_x = -1e30, max_y = -1e30;
+  if (!isUpdateBoundsConcurrent()) {
+    region.getBounds(min_x, min_y, max_x, max_y);
+  }
+  updateBounds(robot_x, robot_y, robot_yaw, &min_x, &min_y, &max_x, &max_y);
+  region.add(min_x, min_y, max_x, max_y);
+}
+
 const std::vector<geometry_msgs::msg::Point> &
 Layer::getFootprint() const
 {
@@ -38,11 +38,16 @@
 #include "nav2_costmap_2d/layered_costmap.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "nav2_costmap_2d/costmap_snapshot.hpp"
 #include "nav2_costmap_2d/footprint.hpp"
 
 
@@ -51,8 +56,38 @@ using std::vector;
 namespace nav2_costmap_2d
 {
 
+namespace
+{
+// Records the nanoseconds from its construction to its destruction into a histogram, if any
+class ScopedTimer
+{
+public:
+  explicit ScopedTimer(Histogram * histogram)
+  : histogram_(histogram)
+  {
+    if (histogram_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedTimer()
+  {
+    if (histogram_) {
+      histogram_->record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start_).count());
+    }
+  }
+
+private:
+  Histogram * histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+}  // namespace
+
 LayeredCostmap::LayeredCostmap(std::string global_frame, bool rolling_window, bool track_unknown)
 : costmap_(),
+  pyramid_(costmap_),
   global_frame_(global_frame),
   rolling_window_(rolling_window),
   current_(false),
@@ -64,7 +99,11 @@ LayeredCostmap::LayeredCostmap(std::string global_frame, bool rolling_window, bo
   bxn_(0),
   by0_(0),
   byn_(0),
+  sensor_log_(nullptr),
+  new_data_(false),
   initialized_(false),
+  invalidated_(true),
+  unchanged_(false),
   size_locked_(false),
   circumscribed_radius_(1.0),
   inscribed_radius_(0.1)
@@ -78,6 +117,7 @@ LayeredCostmap::LayeredCostmap(std::string global_frame, bool rolling_window, bo
 
 LayeredCostmap::~LayeredCostmap()
 {
+  setStatisticsEnabled(false);
   while (plugins_.size() > 0) {
     plugins_.pop_back();
   }
@@ -91,7 +131,9 @@ void LayeredCostmap::resizeMap(
 {
   std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
   size_locked_ = size_locked;
+  invalidated_ = true;
   costmap_.resizeMap(size_x, size_y, resolution, origin_x, origin_y);
+  pyramid_.update();
   for (vector<std::shared_ptr<Layer>>::iterator plugin = plugins_.begin();
     plugin != plugins_.end(); ++plugin)
   {
@@ -99,6 +141,74 @@ void LayeredCostmap::resizeMap(
   }
 }
 
+bool LayeredCostmap::saveSnapshot(const std::string & file_name, const std::string & name) const
+{
+  return costmap_.saveSnapshot(file_name, name, global_frame_);
+}
+
+bool LayeredCostmap::loadSnapshot(const std::string & file_name, const std::string & name)
+{
+  try {
+    std::string frame = CostmapSnapshot(file_name).getFrame();
+    if (frame != global_frame_) {
+      RCLCPP_WARN(
+        rclcpp::get_logger("nav2_costmap_2d"), "The costmap snapshot %s is in %s, not in %s",
+        file_name.c_str(), frame.c_str(), global_frame_.c_str());
+      return false;
+    }
+  } catch (const std::runtime_error & e) {
+    RCLCPP_WARN(rclcpp::get_logger("nav2_costmap_2d"), "%s", e.what());
+    return false;
+  }
+
+  {
+    std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+    if (!costmap_.loadSnapshot(file_name, name)) {
+      return false;
+    }
+    invalidated_ = true;
+    pyramid_.update();
+    for (vector<std::shared_ptr<Layer>>::iterator plugin = plugins_.begin();
+      plugin != plugins_.end(); ++plugin)
+    {
+      (*plugin)->matchSize();
+    }
+  }
+  notifyNewData();
+  return true;
+}
+
+void LayeredCostmap::setPyramidLevels(unsigned int levels)
+{
+  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+  pyramid_.setLevels(levels);
+}
+
+void LayeredCostmap::setStatisticsEnabled(bool enabled)
+{
+  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+  if (enabled == (statistics_ != nullptr)) {
+    return;
+  }
+  if (enabled) {
+    statistics_ = std::make_unique<UpdateStatistics>();
+    costmap_.getMutex()->setHistograms(&statistics_->lock_wait, &statistics_->lock_hold);
+  } else {
+    costmap_.getMutex()->setHistograms(nullptr, nullptr);
+    statistics_.reset();
+  }
+}
+
+void LayeredCostmap::setUpdateThreads(unsigned int threads)
+{
+  std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+  if (threads > 1) {
+    thread_pool_ = std::make_unique<ThreadPool>(threads);
+  } else {
+    thread_pool_.reset();
+  }
+}
+
 bool LayeredCostmap::isOutofBounds(double robot_x, double robot_y)
 {
   unsigned int mx, my;
@@ -109,14 +219,26 @@ void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
 {
   // Lock for the remainder of this function, some plugins (e.g. VoxelLayer)
   // implement thread unsafe updateBounds() functions.
+  // The statistics of the lock are about the threads reading the costmap.
+  costmap_.getMutex()->setUntimedThread(std::this_thread::get_id());
   std::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+  ScopedTimer update_timer(statistics_ ? &statistics_->update_time : nullptr);
+  if (statistics_) {
+    while (statistics_->layers.size() < plugins_.size()) {
+      statistics_->layers.push_back(
+        std::make_unique<LayerStatistics>(plugins_[statistics_->layers.size()]->getName()));
+    }
+  }
 
   // if we're using a rolling buffer costmap...
   // we need to update the origin using the robot's position
+  bool moved = false;
   if (rolling_window_) {
     double new_origin_x = robot_x - costmap_.getSizeInMetersX() / 2;
     double new_origin_y = robot_y - costmap_.getSizeInMetersY() / 2;
+    double origin_x = costmap_.getOriginX(), origin_y = costmap_.getOriginY();
     costmap_.updateOrigin(new_origin_x, new_origin_y);
+    moved = costmap_.getOriginX() != origin_x || costmap_.getOriginY() != origin_y;
   }
 
   if (isOutofBounds(robot_x, robot_y)) {
@@ -125,64 +247,166 @@ void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
       "Robot is out of bounds of the costmap!");
   }
 
+  unchanged_ = false;
   if (plugins_.size() == 0) {
     return;
   }
 
+  WorldRegion region;
+  for (size_t i = 0; i < plugins_.size(); ) {
+    // consecutive layers that allow it compute their regions at the same time,
+    // the others see the region of every layer before them as usual
+    size_t last = i;
+    if (thread_pool_) {
+      while (last < plugins_.size() && plugins_[last]->isUpdateBoundsConcurrent()) {
+        ++last;
+      }
+    }
+    if (last - i > 1) {
+      updateRegionConcurrently(i, last, robot_x, robot_y, robot_yaw, region);
+      i = last;
+      continue;
+    }
+
+    double prev_minx = 1e30, prev_miny = 1e30, prev_maxx = -1e30, prev_maxy = -1e30;
+    region.getBounds(prev_minx, prev_miny, prev_maxx, prev_maxy);
+    updateLayerRegion(i, robot_x, robot_y, robot_yaw, region);
+    double minx = 1e30, miny = 1e30, maxx = -1e30, maxy = -1e30;
+    region.getBounds(minx, miny, maxx, maxy);
+    checkBounds(*plugins_[i], prev_minx, prev_miny, prev_maxx, prev_maxy, minx, miny, maxx, maxy);
+    ++i;
+  }
+
   minx_ = miny_ = 1e30;
   maxx_ = maxy_ = -1e30;
+  region.getBounds(minx_, miny_, maxx_, maxy_);
 
-  for (vector<std::shared_ptr<Layer>>::iterator plugin = plugins_.begin();
-    plugin != plugins_.end(); ++plugin)
-  {
-    double prev_minx = minx_;
-    double prev_miny = miny_;
-    double prev_maxx = maxx_;
-    double prev_maxy = maxy_;
-    (*plugin)->updateBounds(robot_x, robot_y, robot_yaw, &minx_, &miny_, &maxx_, &maxy_);
-    if (minx_ > prev_minx || miny_ > prev_miny || maxx_ < prev_maxx || maxy_ < prev_maxy) {
-      RCLCPP_WARN(
-        rclcpp::get_logger(
-          "nav2_costmap_2d"), "Illegal bounds change, was [tl: (%f, %f), br: (%f, %f)], but "
-        "is now [tl: (%f, %f), br: (%f, %f)]. The offending layer is %s",
-        prev_minx, prev_miny, prev_maxx, prev_maxy,
-        minx_, miny_, maxx_, maxy_,
-        (*plugin)->getName().c_str());
+  // layers that didn't change write the same costs as last time, so when none of them
+  // changed the master grid already holds what resetting and merging would give
+  bool changed = invalidated_ || moved || !initialized_;
+  for (const std::shared_ptr<Layer> & plugin : plugins_) {
+    changed = changed || plugin->hasChanged();
+  }
+  if (!changed) {
+    updated_cells_.clear();
+    unchanged_ = true;
+    if (statistics_) {
+      statistics_->updated_cells.record(0);
     }
+    return;
+  }
+  // the pyramid can't follow a grid that scrolled or was modified outside of the
+  // update window by window
+  if (moved || invalidated_) {
+    pyramid_.update();
   }
+  invalidated_ = false;
 
-  int x0, xn, y0, yn;
-  costmap_.worldToMapEnforceBounds(minx_, miny_, x0, y0);
-  costmap_.worldToMapEnforceBounds(maxx_, maxy_, xn, yn);
+  // rectangles that end up on the same cells are merged again,
+  // so every cell is updated at most once
+  updated_cells_.clear();
+  for (const WorldRegion::Rect & rect : region.getRectangles()) {
+    int x0, xn, y0, yn;
+    costmap_.worldToMapEnforceBounds(rect.min_x, rect.min_y, x0, y0);
+    costmap_.worldToMapEnforceBounds(rect.max_x, rect.max_y, xn, yn);
 
-  x0 = std::max(0, x0);
-  xn = std::min(static_cast<int>(costmap_.getSizeInCellsX()), xn + 1);
-  y0 = std::max(0, y0);
-  yn = std::min(static_cast<int>(costmap_.getSizeInCellsY()), yn + 1);
+    x0 = std::max(0, x0);
+    xn = std::min(static_cast<int>(costmap_.getSizeInCellsX()), xn + 1);
+    y0 = std::max(0, y0);
+    yn = std::min(static_cast<int>(costmap_.getSizeInCellsY()), yn + 1);
 
-  RCLCPP_DEBUG(
-    rclcpp::get_logger(
-      "nav2_costmap_2d"), "Updating area x: [%d, %d] y: [%d, %d]", x0, xn, y0, yn);
+    RCLCPP_DEBUG(
+      rclcpp::get_logger(
+        "nav2_costmap_2d"), "Updating area x: [%d, %d] y: [%d, %d]", x0, xn, y0, yn);
+
+    if (xn > x0 && yn > y0) {
+      updated_cells_.add(x0, y0, xn, yn);
+    }
+  }
 
-  if (xn < x0 || yn < y0) {
+  if (updated_cells_.empty()) {
+    if (statistics_) {
+      statistics_->updated_cells.record(0);
+    }
     return;
   }
 
-  costmap_.resetMap(x0, y0, xn, yn);
-  for (vector<std::shared_ptr<Layer>>::iterator plugin = plugins_.begin();
-    plugin != plugins_.end(); ++plugin)
-  {
-    (*plugin)->updateCosts(costmap_, x0, y0, xn, yn);
+  const std::vector<CellRegion::Rect> & windows = updated_cells_.getRectangles();
+  uint64_t cells = 0;
+  for (const CellRegion::Rect & w : windows) {
+    costmap_.resetMap(w.min_x, w.min_y, w.max_x, w.max_y);
+    cells += static_cast<uint64_t>(w.max_x - w.min_x) * (w.max_y - w.min_y);
+  }
+  if (statistics_) {
+    statistics_->updated_cells.record(cells);
+  }
+
+  // every layer finishes all windows before the next one starts, since
+  // layers like inflation read the master grid around their window
+  for (size_t i = 0; i < plugins_.size(); ++i) {
+    ScopedTimer costs_timer(statistics_ ? &statistics_->layers[i]->costs_time : nullptr);
+    for (const CellRegion::Rect & w : windows) {
+      plugins_[i]->updateCosts(costmap_, w.min_x, w.min_y, w.max_x, w.max_y);
+    }
+  }
+  for (const CellRegion::Rect & w : windows) {
+    pyramid_.update(w.min_x, w.min_y, w.max_x, w.max_y);
   }
 
-  bx0_ = x0;
-  bxn_ = xn;
-  by0_ = y0;
-  byn_ = yn;
+  updated_cells_.getBounds(bx0_, by0_, bxn_, byn_);
 
   initialized_ = true;
 }
 
+void LayeredCostmap::updateRegionConcurrently(
+  size_t first, size_t last, double robot_x, double robot_y, double robot_yaw,
+  WorldRegion & region)
+{
+  // these layers don't read the region they are given, so each one fills its
+  // own and the union afterwards matches running them one by one
+  std::vector<WorldRegion> regions(last - first);
+
+  thread_pool_->parallelFor(
+    last - first, [&](unsigned int i) {
+      updateLayerRegion(first + i, robot_x, robot_y, robot_yaw, regions[i]);
+    });
+
+  for (const WorldRegion & layer_region : regions) {
+    region.add(layer_region);
+  }
+}
+
+void LayeredCostmap::updateLayerRegion(
+  size_t i, double robot_x, double robot_y, double robot_yaw, WorldRegion & region)
+{
+  if (!statistics_) {
+    plugins_[i]->updateRegion(robot_x, robot_y, robot_yaw, region);
+    return;
+  }
+
+  LayerStatistics & layer_statistics = *statistics_->layers[i];
+  {
+    ScopedTimer bounds_timer(&layer_statistics.bounds_time);
+    plugins_[i]->updateRegion(robot_x, robot_y, robot_yaw, region);
+  }
+  layer_statistics.observations.record(plugins_[i]->getObservationCount());
+}
+
+void LayeredCostmap::checkBounds(
+  const Layer & plugin, double prev_minx, double prev_miny, double prev_maxx,
+  double prev_maxy, double minx, double miny, double maxx, double maxy)
+{
+  if (minx > prev_minx || miny > prev_miny || maxx < prev_maxx || maxy < prev_maxy) {
+    RCLCPP_WARN(
+      rclcpp::get_logger(
+        "nav2_costmap_2d"), "Illegal bounds change, was [tl: (%f, %f), br: (%f, %f)], but "
+      "is now [tl: (%f, %f), br: (%f, %f)]. The offending layer is %s",
+      prev_minx, prev_miny, prev_maxx, prev_maxy,
+      minx, miny, maxx, maxy,
+      plugin.getName().c_str());
+  }
+}
+
 bool LayeredCostmap::isCurrent()
 {
   current_ = true;
@@ -194,12 +418,30 @@ bool LayeredCostmap::isCurrent()
   return current_;
 }
 
+void LayeredCostmap::notifyNewData()
+{
+  {
+    std::lock_guard<std::mutex> lock(new_data_mutex_);
+    new_data_ = true;
+  }
+  new_data_condition_.notify_one();
+}
+
+bool LayeredCostmap::waitForNewData(std::chrono::steady_clock::time_point deadline)
+{
+  std::unique_lock<std::mutex> lock(new_data_mutex_);
+  bool new_data = new_data_condition_.wait_until(lock, deadline, [this] {return new_data_;});
+  new_data_ = false;
+  return new_data;
+}
+
 void LayeredCostmap::setFootprint(const std::vector<geometry_msgs::msg::Point> & footprint_spec)
 {
   footprint_ = footprint_spec;
   nav2_costmap_2d::calculateMinAndMaxDistances(
     footprint_spec,
     inscribed_radius_, circumscribed_radius_);
+  invalidated_ = true;
 
   for (vector<std::shared_ptr<Layer>>::iterator plugin = plugins_.begin();
     plugin != plugins_.end();
@@ -0,0 +1,261 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/merge_kernels.hpp"
+
+#include <algorithm>
+
+#include "nav2_costmap_2d/cost_values.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define NAV2_COSTMAP_2D_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+
+typedef void (* RowKernel)(unsigned char *, const unsigned char *, unsigned int);
+
+// The portable kernels, also used for the tail of each row by the SIMD ones
+
+void maxScalar(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; i++) {
+    if (layer[i] == NO_INFORMATION) {
+      continue;
+    }
+    if (master[i] == NO_INFORMATION || master[i] < layer[i]) {
+      master[i] = layer[i];
+    }
+  }
+}
+
+void overwriteScalar(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; i++) {
+    if (layer[i] != NO_INFORMATION) {
+      master[i] = layer[i];
+    }
+  }
+}
+
+void additionScalar(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; i++) {
+    if (layer[i] == NO_INFORMATION) {
+      continue;
+    }
+    if (master[i] == NO_INFORMATION) {
+      master[i] = layer[i];
+    } else {
+      int sum = master[i] + layer[i];
+      if (sum >= INSCRIBED_INFLATED_OBSTACLE) {
+        master[i] = INSCRIBED_INFLATED_OBSTACLE - 1;
+      } else {
+        master[i] = sum;
+      }
+    }
+  }
+}
+
+#ifdef NAV2_COSTMAP_2D_X86_KERNELS
+
+// NO_INFORMATION is 255, so adding one (mod 256) moves it below every other
+// cost and max(master + 1, layer + 1) - 1 applies the updateWithMax rules
+
+void maxSSE2(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  const __m128i one = _mm_set1_epi8(1);
+  unsigned int i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(master + i));
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(layer + i));
+    __m128i r = _mm_max_epu8(_mm_add_epi8(m, one), _mm_add_epi8(l, one));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(master + i), _mm_sub_epi8(r, one));
+  }
+  maxScalar(master + i, layer + i, length - i);
+}
+
+void overwriteSSE2(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  const __m128i no_info = _mm_set1_epi8(static_cast<char>(NO_INFORMATION));
+  unsigned int i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(master + i));
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(layer + i));
+    __m128i keep = _mm_cmpeq_epi8(l, no_info);
+    __m128i r = _mm_or_si128(_mm_and_si128(keep, m), _mm_andnot_si128(keep, l));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(master + i), r);
+  }
+  overwriteScalar(master + i, layer + i, length - i);
+}
+
+void additionSSE2(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  const __m128i no_info = _mm_set1_epi8(static_cast<char>(NO_INFORMATION));
+  const __m128i cap = _mm_set1_epi8(static_cast<char>(INSCRIBED_INFLATED_OBSTACLE - 1));
+  unsigned int i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(master + i));
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(layer + i));
+    // the saturated sum only reaches 255 when the real one is past the cap
+    __m128i r = _mm_min_epu8(_mm_adds_epu8(m, l), cap);
+    __m128i m_unknown = _mm_cmpeq_epi8(m, no_info);
+    r = _mm_or_si128(_mm_and_si128(m_unknown, l), _mm_andnot_si128(m_unknown, r));
+    __m128i l_unknown = _mm_cmpeq_epi8(l, no_info);
+    r = _mm_or_si128(_mm_and_si128(l_unknown, m), _mm_andnot_si128(l_unknown, r));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(master + i), r);
+  }
+  additionScalar(master + i, layer + i, length - i);
+}
+
+__attribute__((target("avx2")))
+void maxAVX2(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  const __m256i one = _mm256_set1_epi8(1);
+  unsigned int i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(master + i));
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(layer + i));
+    __m256i r = _mm256_max_epu8(_mm256_add_epi8(m, one), _mm256_add_epi8(l, one));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(master + i), _mm256_sub_epi8(r, one));
+  }
+  maxSSE2(master + i, layer + i, length - i);
+}
+
+__attribute__((target("avx2")))
+void overwriteAVX2(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  const __m256i no_info = _mm256_set1_epi8(static_cast<char>(NO_INFORMATION));
+  unsigned int i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(master + i));
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(layer + i));
+    __m256i r = _mm256_blendv_epi8(l, m, _mm256_cmpeq_epi8(l, no_info));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(master + i), r);
+  }
+  overwriteSSE2(master + i, layer + i, length - i);
+}
+
+__attribute__((target("avx2")))
+void additionAVX2(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  const __m256i no_info = _mm256_set1_epi8(static_cast<char>(NO_INFORMATION));
+  const __m256i cap = _mm256_set1_epi8(static_cast<char>(INSCRIBED_INFLATED_OBSTACLE - 1));
+  unsigned int i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(master + i));
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(layer + i));
+    __m256i r = _mm256_min_epu8(_mm256_adds_epu8(m, l), cap);
+    r = _mm256_blendv_epi8(r, l, _mm256_cmpeq_epi8(m, no_info));
+    r = _mm256_blendv_epi8(r, m, _mm256_cmpeq_epi8(l, no_info));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(master + i), r);
+  }
+  additionSSE2(master + i, layer + i, length - i);
+}
+
+#endif  // NAV2_COSTMAP_2D_X86_KERNELS
+
+struct Kernels
+{
+  Kernels()
+  : max(maxScalar), overwrite(overwriteScalar), addition(additionScalar), name("scalar")
+  {
+#ifdef NAV2_COSTMAP_2D_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      max = maxAVX2;
+      overwrite = overwriteAVX2;
+      addition = additionAVX2;
+      name = "avx2";
+    } else {
+      max = maxSSE2;
+      overwrite = overwriteSSE2;
+      addition = additionSSE2;
+      name = "sse2";
+    }
+#endif
+  }
+
+  RowKernel max;
+  RowKernel overwrite;
+  RowKernel addition;
+  const char * name;
+};
+
+const Kernels & kernels()
+{
+  static const Kernels k;
+  return k;
+}
+
+// Below this many cells the window isn't worth handing to other threads
+const unsigned int min_parallel_cells = 1 << 16;
+
+}  // namespace
+
+void mergeRowMax(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  kernels().max(master, layer, length);
+}
+
+void mergeRowOverwrite(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  kernels().overwrite(master, layer, length);
+}
+
+void mergeRowAddition(unsigned char * master, const unsigned char * layer, unsigned int length)
+{
+  kernels().addition(master, layer, length);
+}
+
+const char * mergeKernelsName()
+{
+  return kernels().name;
+}
+
+void forEachRowTile(
+  ThreadPool * pool, int y0, int yn, unsigned int width,
+  const std::function<void(int, int)> & work)
+{
+  if (yn <= y0) {
+    return;
+  }
+
+  unsigned int rows = yn - y0;
+  if (pool == nullptr || pool->size() < 2 || rows < 2 ||
+    static_cast<size_t>(rows) * width < min_parallel_cells)
+  {
+    work(y0, yn);
+    return;
+  }
+
+  // a few tiles per thread so a slow one doesn't hold the others up
+  unsigned int tiles = std::min(rows, pool->size() * 4);
+  unsigned int rows_per_tile = (rows + tiles - 1) / tiles;
+  tiles = (rows + rows_per_tile - 1) / rows_per_tile;
+
+  pool->parallelFor(
+    tiles, [&](unsigned int t) {
+      int tile_y0 = y0 + t * rows_per_tile;
+      int tile_yn = std::min(yn, static_cast<int>(tile_y0 + rows_per_tile));
+      work(tile_y0, tile_yn);
+    });
+}
+
+}  // namespace nav2_costmap_2d
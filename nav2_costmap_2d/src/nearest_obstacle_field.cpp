@@ -0,0 +1,302 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/nearest_obstacle_field.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "nav2_costmap_2d/cost_values.hpp"
+
+namespace nav2_costmap_2d
+{
+
+const unsigned int NearestObstacleField::NONE;
+const unsigned char NearestObstacleField::NO_PUSH;
+
+NearestObstacleField::NearestObstacleField()
+: size_x_(0), size_y_(0), cell_radius_(0), length_(0), num_levels_(0)
+{
+}
+
+unsigned int NearestObstacleField::computeLevels(
+  unsigned int cell_radius, std::vector<unsigned int> & levels)
+{
+  unsigned int length = cell_radius + 2;
+
+  // two distances are equal exactly when their integer squares are,
+  // so the distinct squares within the radius number the levels
+  std::vector<unsigned int> squares;
+  for (unsigned int i = 0; i < length; ++i) {
+    for (unsigned int j = 0; j < length; ++j) {
+      if (hypot(i, j) <= cell_radius) {
+        squares.push_back(i * i + j * j);
+      }
+    }
+  }
+  std::sort(squares.begin(), squares.end());
+  squares.erase(std::unique(squares.begin(), squares.end()), squares.end());
+
+  levels.resize(length * length);
+  for (unsigned int i = 0; i < length; ++i) {
+    for (unsigned int j = 0; j < length; ++j) {
+      unsigned int level = squares.size();
+      if (hypot(i, j) <= cell_radius) {
+        level = std::lower_bound(squares.begin(), squares.end(), i * i + j * j) -
+          squares.begin();
+      }
+      levels[i * length + j] = level;
+    }
+  }
+  return squares.size();
+}
+
+void NearestObstacleField::setRadius(unsigned int cell_radius)
+{
+  if (cell_radius == cell_radius_ && length_ != 0) {
+    return;
+  }
+  cell_radius_ = cell_radius;
+  length_ = cell_radius + 2;
+  num_levels_ = computeLevels(cell_radius, levels_);
+  queue_.clear();
+  queue_.resize(num_levels_);
+  clear();
+}
+
+void NearestObstacleField::resize(unsigned int size_x, unsigned int size_y)
+{
+  size_x_ = size_x;
+  size_y_ = size_y;
+  clear();
+}
+
+void NearestObstacleField::clear()
+{
+  sources_.assign(size_x_ * size_y_, NONE);
+  pushes_.assign(size_x_ * size_y_, NO_PUSH);
+  obstacles_.assign(size_x_ * size_y_, false);
+  reordered_.assign(size_x_ * size_y_, false);
+}
+
+void NearestObstacleField::update(
+  const unsigned char * grid, unsigned int x0, unsigned int y0,
+  unsigned int xn, unsigned int yn)
+{
+  if (length_ == 0) {
+    return;
+  }
+
+  xn = std::min(xn, size_x_);
+  yn = std::min(yn, size_y_);
+  for (unsigned int y = y0; y < yn; ++y) {
+    for (unsigned int x = x0; x < xn; ++x) {
+      unsigned int index = y * size_x_ + x;
+      bool obstacle = grid[index] == LETHAL_OBSTACLE;
+      if (obstacle != obstacles_[index]) {
+        obstacles_[index] = obstacle;
+        updateCell(index);
+      }
+    }
+  }
+
+  propagate();
+}
+
+unsigned int NearestObstacleField::level(unsigned int index, unsigned int source) const
+{
+  unsigned int dx = std::abs(
+    static_cast<int>(index % size_x_) - static_cast<int>(source % size_x_));
+  unsigned int dy = std::abs(
+    static_cast<int>(index / size_x_) - static_cast<int>(source / size_x_));
+  if (dx >= length_ || dy >= length_) {
+    return num_levels_;
+  }
+  return levels_[dx * length_ + dy];
+}
+
+unsigned int NearestObstacleField::pusher(unsigned int index, unsigned char push) const
+{
+  switch (push) {
+    case 0:
+      return index + 1;
+    case 1:
+      return index + size_x_;
+    case 2:
+      return index - 1;
+    default:
+      return index - size_x_;
+  }
+}
+
+bool NearestObstacleField::precedes(unsigned int index, const Offer & a, const Offer & b) const
+{
+  if (a.source == NONE || b.source == NONE) {
+    return b.source == NONE && a.source != NONE;
+  }
+  if (a.level != b.level) {
+    return a.level < b.level;
+  }
+  if (a.push == NO_PUSH || b.push == NO_PUSH) {
+    return a.push < b.push;
+  }
+
+  // the levels of a chain of pushers strictly decrease, so the walk ends at obstacles,
+  // which the wavefront takes in row-major order
+  unsigned int x = pusher(index, a.push), y = pusher(index, b.push);
+  unsigned char x_push = a.push, y_push = b.push;
+  for (unsigned int step = 0; step < num_levels_; ++step) {
+    if (x == y) {
+      return x_push < y_push;
+    }
+    unsigned int x_level = levelOf(x), y_level = levelOf(y);
+    if (x_level != y_level) {
+      return x_level < y_level;
+    }
+    if (pushes_[x] == NO_PUSH || pushes_[y] == NO_PUSH) {
+      break;
+    }
+    x_push = pushes_[x];
+    y_push = pushes_[y];
+    x = pusher(x, x_push);
+    y = pusher(y, y_push);
+  }
+  return x < y;
+}
+
+NearestObstacleField::Offer NearestObstacleField::bestOffer(unsigned int index) const
+{
+  if (obstacles_[index]) {
+    return Offer{0, index, NO_PUSH};
+  }
+
+  // like the wavefront, a neighbor only passes its obstacle on to cells
+  // farther from that obstacle than itself
+  Offer best{num_levels_, NONE, NO_PUSH};
+  unsigned int mx = index % size_x_;
+  unsigned int my = index / size_x_;
+  auto offer = [&](unsigned int neighbor, unsigned char push) {
+      unsigned int source = sources_[neighbor];
+      if (source == NONE) {
+        return;
+      }
+      Offer candidate{level(index, source), source, push};
+      if (candidate.level < num_levels_ && level(neighbor, source) < candidate.level &&
+        precedes(index, candidate, best))
+      {
+        best = candidate;
+      }
+    };
+  if (mx > 0) {
+    offer(index - 1, 2);
+  }
+  if (my > 0) {
+    offer(index - size_x_, 3);
+  }
+  if (mx < size_x_ - 1) {
+    offer(index + 1, 0);
+  }
+  if (my < size_y_ - 1) {
+    offer(index + size_x_, 1);
+  }
+  return best;
+}
+
+void NearestObstacleField::updateCell(unsigned int index)
+{
+  Offer now = current(index);
+  Offer offer = bestOffer(index);
+  if (now.source != offer.source || now.push != offer.push) {
+    push(index, std::min(now.level, offer.level));
+  }
+}
+
+void NearestObstacleField::updateNeighbors(unsigned int index)
+{
+  unsigned int mx = index % size_x_;
+  unsigned int my = index / size_x_;
+  auto update = [&](unsigned int neighbor) {
+      if (pushes_[neighbor] != NO_PUSH && pusher(neighbor, pushes_[neighbor]) == index) {
+        unsigned int neighbor_level = levelOf(neighbor);
+        if (neighbor_level < num_levels_) {
+          reordered_[neighbor] = true;
+          push(neighbor, neighbor_level);
+        }
+      }
+      updateCell(neighbor);
+    };
+  if (mx > 0) {
+    update(index - 1);
+  }
+  if (my > 0) {
+    update(index - size_x_);
+  }
+  if (mx < size_x_ - 1) {
+    update(index + 1);
+  }
+  if (my < size_y_ - 1) {
+    update(index + size_x_);
+  }
+}
+
+void NearestObstacleField::push(unsigned int index, unsigned int key)
+{
+  if (key < num_levels_) {
+    queue_[key].push_back(index);
+  }
+}
+
+void NearestObstacleField::propagate()
+{
+  for (unsigned int key = 0; key < num_levels_; ++key) {
+    std::vector<unsigned int> & bucket = queue_[key];
+    // cells settled at this level only queue others above it, and the offers
+    // of this level only depend on cells below it, which are all settled
+    for (size_t i = 0; i < bucket.size(); ++i) {
+      unsigned int index = bucket[i];
+      Offer now = current(index);
+      Offer offer = bestOffer(index);
+      if (std::min(now.level, offer.level) != key) {
+        // queued again under its current key
+        continue;
+      }
+      if (now.source == offer.source && now.push == offer.push) {
+        if (reordered_[index]) {
+          // settled, but the cells after it in the wavefront may be taken in another order
+          reordered_[index] = false;
+          updateNeighbors(index);
+        }
+        continue;
+      }
+
+      reordered_[index] = false;
+      if (offer.level == key) {
+        // lower: take the closer obstacle, or the one the wavefront reaches first
+        sources_[index] = offer.source;
+        pushes_[index] = offer.push;
+      } else {
+        // raise: drop the obstacle that is gone or out of reach, and
+        // settle again once the neighbors have been updated
+        sources_[index] = NONE;
+        pushes_[index] = NO_PUSH;
+        updateCell(index);
+      }
+      updateNeighbors(index);
+    }
+    bucket.clear();
+  }
+}
+
+}  // namespace nav2_costmap_2d
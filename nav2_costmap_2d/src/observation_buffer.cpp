@@ -37,28 +37,42 @@
 #include "nav2_costmap_2d/observation_buffer.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <list>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "tf2/convert.h"
-#include "sensor_msgs/point_cloud2_iterator.hpp"
+#include "tf2/exceptions.h"
 
 namespace nav2_costmap_2d
 {
+
+// Scans whose plane is tilted by more than this many radians in the global frame are
+// buffered as clouds, since their points aren't all at the height of the sensor
+static const double max_scan_tilt = 1e-3;
+
+// The static transforms above a frame are walked again after this many seconds of data,
+// as a static transform may be republished with a new value
+static const double static_chain_lifetime = 1.0;
+
 ObservationBuffer::ObservationBuffer(
   nav2_util::LifecycleNode::SharedPtr nh, std::string topic_name, double observation_keep_time,
   double expected_update_rate,
   double min_obstacle_height, double max_obstacle_height, double obstacle_range,
   double raytrace_range, tf2_ros::Buffer & tf2_buffer, std::string global_frame,
-  std::string sensor_frame, double tf_tolerance)
+  std::string sensor_frame, double tf_tolerance, double voxel_size)
 : tf2_buffer_(tf2_buffer),
   observation_keep_time_(rclcpp::Duration::from_seconds(observation_keep_time)),
   expected_update_rate_(rclcpp::Duration::from_seconds(expected_update_rate)), nh_(nh),
   last_updated_(nh->now()), global_frame_(global_frame), sensor_frame_(sensor_frame),
   topic_name_(topic_name),
   min_obstacle_height_(min_obstacle_height), max_obstacle_height_(max_obstacle_height),
-  obstacle_range_(obstacle_range), raytrace_range_(raytrace_range), tf_tolerance_(tf_tolerance)
+  obstacle_range_(obstacle_range), raytrace_range_(raytrace_range), tf_tolerance_(tf_tolerance),
+  raytrace_mode_(Observation::RAYTRACE_ALL), raytrace_angular_resolution_(0.0),
+  horizontal_fov_(0.0), vertical_fov_(0.0),
+  point_filter_(min_obstacle_height, max_obstacle_height, voxel_size)
 {
 }
 
@@ -89,17 +103,30 @@ bool ObservationBuffer::setGlobalFrame(const std::string new_global_frame)
     try {
       Observation & obs = *obs_it;
 
-      geometry_msgs::msg::PointStamped origin;
+      geometry_msgs::msg::PoseStamped origin;
       origin.header.frame_id = global_frame_;
       origin.header.stamp = transform_time;
-      origin.point = obs.origin_;
+      origin.pose.position = obs.origin_;
+      origin.pose.orientation = obs.orientation_;
 
-      // we need to transform the origin of the observation to the new global frame
+      // we need to transform the pose of the sensor to the new global frame
       tf2_buffer_.transform(origin, origin, new_global_frame);
-      obs.origin_ = origin.point;
+      obs.origin_ = origin.pose.position;
+      obs.orientation_ = origin.pose.orientation;
 
-      // we also need to transform the cloud of the observation to the new global frame
-      tf2_buffer_.transform(*(obs.cloud_), *(obs.cloud_), new_global_frame);
+      // a scan may not be level in the new frame, so its points are kept as a cloud from now on
+      if (obs.scan_) {
+        auto scan_cloud = std::make_shared<sensor_msgs::msg::PointCloud2>();
+        obs.scan_->toCloud(global_frame_, *scan_cloud);
+        obs.cloud_ = scan_cloud;
+        obs.scan_.reset();
+      }
+
+      // we also need to transform the cloud of the observation to the new global frame,
+      // into a new cloud since the old one may still be in use by the layers
+      auto cloud = std::make_shared<sensor_msgs::msg::PointCloud2>();
+      tf2_buffer_.transform(*(obs.cloud_), *cloud, new_global_frame);
+      obs.cloud_ = cloud;
     } catch (tf2::TransformException & ex) {
       RCLCPP_ERROR(
         rclcpp::get_logger(
@@ -110,15 +137,14 @@ bool ObservationBuffer::setGlobalFrame(const std::string new_global_frame)
     }
   }
 
-  // now we need to update our global_frame member
+  // now we need to update our global_frame member, and look up the static transforms again
   global_frame_ = new_global_frame;
+  static_chains_.clear();
   return true;
 }
 
 void ObservationBuffer::bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud)
 {
-  geometry_msgs::msg::PointStamped global_origin;
-
   // create a new observation on the list to be populated
   observation_list_.push_front(Observation());
 
@@ -128,64 +154,35 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud)
 
   try {
     // given these observations come from sensors...
-    // we'll need to store the origin pt of the sensor
-    geometry_msgs::msg::PointStamped local_origin;
-    local_origin.header.stamp = cloud.header.stamp;
-    local_origin.header.frame_id = origin_frame;
-    local_origin.point.x = 0;
-    local_origin.point.y = 0;
-    local_origin.point.z = 0;
-    tf2_buffer_.transform(local_origin, global_origin, global_frame_);
-    tf2::convert(global_origin.point, observation_list_.front().origin_);
+    // we'll need to store the pose of the sensor
+    geometry_msgs::msg::Transform sensor_transform, transform;
+    lookupTransforms(
+      origin_frame, cloud.header.frame_id, cloud.header.stamp, sensor_transform, transform);
+    setSensorPose(observation_list_.front(), sensor_transform);
 
     // make sure to pass on the raytrace/obstacle range
     // of the observation buffer to the observations
     observation_list_.front().raytrace_range_ = raytrace_range_;
     observation_list_.front().obstacle_range_ = obstacle_range_;
+    observation_list_.front().raytrace_mode_ = raytrace_mode_;
+    observation_list_.front().raytrace_angular_resolution_ = raytrace_angular_resolution_;
+    observation_list_.front().horizontal_fov_ = horizontal_fov_;
+    observation_list_.front().vertical_fov_ = vertical_fov_;
 
-    sensor_msgs::msg::PointCloud2 global_frame_cloud;
-
-    // transform the point cloud
-    tf2_buffer_.transform(cloud, global_frame_cloud, global_frame_);
-    global_frame_cloud.header.stamp = cloud.header.stamp;
-
-    // now we need to remove observations from the cloud that are below
-    // or above our height thresholds
-    sensor_msgs::msg::PointCloud2 & observation_cloud = *(observation_list_.front().cloud_);
-    observation_cloud.height = global_frame_cloud.height;
-    observation_cloud.width = global_frame_cloud.width;
-    observation_cloud.fields = global_frame_cloud.fields;
-    observation_cloud.is_bigendian = global_frame_cloud.is_bigendian;
-    observation_cloud.point_step = global_frame_cloud.point_step;
-    observation_cloud.row_step = global_frame_cloud.row_step;
-    observation_cloud.is_dense = global_frame_cloud.is_dense;
-
-    unsigned int cloud_size = global_frame_cloud.height * global_frame_cloud.width;
-    sensor_msgs::PointCloud2Modifier modifier(observation_cloud);
-    modifier.resize(cloud_size);
-    unsigned int point_count = 0;
-
-    // copy over the points that are within our height bounds
-    sensor_msgs::PointCloud2Iterator<float> iter_z(global_frame_cloud, "z");
-    std::vector<unsigned char>::const_iterator iter_global = global_frame_cloud.data.begin(),
-      iter_global_end = global_frame_cloud.data.end();
-    std::vector<unsigned char>::iterator iter_obs = observation_cloud.data.begin();
-    for (; iter_global != iter_global_end; ++iter_z, iter_global +=
-      global_frame_cloud.point_step)
-    {
-      if ((*iter_z) <= max_obstacle_height_ &&
-        (*iter_z) >= min_obstacle_height_)
-      {
-        std::copy(iter_global, iter_global + global_frame_cloud.point_step, iter_obs);
-        iter_obs += global_frame_cloud.point_step;
-        ++point_count;
-      }
+    // transform the point cloud and remove the points that are below or above our
+    // height thresholds, in one pass that only keeps the coordinates
+    auto observation_cloud = std::make_shared<sensor_msgs::msg::PointCloud2>();
+    if (!point_filter_.filter(cloud, transform, global_frame_, *observation_cloud)) {
+      observation_list_.pop_front();
+      RCLCPP_ERROR(
+        rclcpp::get_logger(
+          "nav2_costmap_2d"),
+        "Cloud on %s doesn't have float32 x, y and z fields, dropping it", topic_name_.c_str());
+      return;
     }
 
-    // resize the cloud for the number of legal points
-    modifier.resize(point_count);
-    observation_cloud.header.stamp = cloud.header.stamp;
-    observation_cloud.header.frame_id = global_frame_cloud.header.frame_id;
+    // from here on the cloud is only shared, never modified
+    observation_list_.front().cloud_ = observation_cloud;
   } catch (tf2::TransformException & ex) {
     // if an exception occurs, we need to remove the empty observation from the list
     observation_list_.pop_front();
@@ -205,13 +202,110 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::msg::PointCloud2 & cloud)
   purgeStaleObservations();
 }
 
-// returns a copy of the observations
+void ObservationBuffer::bufferScan(const sensor_msgs::msg::LaserScan & scan, bool inf_is_valid)
+{
+  // create a new observation on the list to be populated
+  observation_list_.push_front(Observation());
+
+  // check whether the origin frame has been set explicitly
+  // or whether we should get it from the scan
+  std::string origin_frame = sensor_frame_ == "" ? scan.header.frame_id : sensor_frame_;
+
+  try {
+    // one transform for the whole scan
+    geometry_msgs::msg::Transform sensor_transform, transform;
+    lookupTransforms(
+      origin_frame, scan.header.frame_id, scan.header.stamp, sensor_transform, transform);
+    setSensorPose(observation_list_.front(), sensor_transform);
+
+    observation_list_.front().raytrace_range_ = raytrace_range_;
+    observation_list_.front().obstacle_range_ = obstacle_range_;
+    observation_list_.front().raytrace_mode_ = raytrace_mode_;
+    observation_list_.front().raytrace_angular_resolution_ = raytrace_angular_resolution_;
+    observation_list_.front().horizontal_fov_ = horizontal_fov_;
+    observation_list_.front().vertical_fov_ = vertical_fov_;
+
+    // the angles of a sensor don't change, so its beam table is only computed once
+    if (!beams_ || !beams_->matches(scan.angle_min, scan.angle_increment, scan.ranges.size())) {
+      beams_ = std::make_shared<const BeamTable>(
+        scan.angle_min, scan.angle_increment, scan.ranges.size());
+    }
+
+    auto planar_scan = std::make_shared<PlanarScan>();
+    planar_scan->stamp_ = scan.header.stamp;
+    planar_scan->range_min_ = scan.range_min;
+    planar_scan->range_max_ = scan.range_max;
+    planar_scan->ranges_ = scan.ranges;
+    planar_scan->beams_ = beams_;
+
+    if (inf_is_valid) {
+      // Filter positive infinities ("Inf"s) to max_range.
+      const float epsilon = 0.0001;  // a tenth of a millimeter
+      for (float & range : planar_scan->ranges_) {
+        if (!std::isfinite(range) && range > 0) {
+          range = scan.range_max - epsilon;
+        }
+      }
+    }
+
+    // the z axis of the sensor in the global frame is the last column of its rotation
+    const geometry_msgs::msg::Quaternion & q = transform.rotation;
+    double up = 1.0 - 2.0 * (q.x * q.x + q.y * q.y);
+
+    if (up >= std::cos(max_scan_tilt) && !point_filter_.downsamples()) {
+      const geometry_msgs::msg::Vector3 & t = transform.translation;
+      double heading_x = 1.0 - 2.0 * (q.y * q.y + q.z * q.z);
+      double heading_y = 2.0 * (q.x * q.y + q.w * q.z);
+      double norm = std::hypot(heading_x, heading_y);
+      planar_scan->x_ = t.x;
+      planar_scan->y_ = t.y;
+      planar_scan->z_ = t.z;
+      planar_scan->cos_yaw_ = heading_x / norm;
+      planar_scan->sin_yaw_ = heading_y / norm;
+
+      // every point of the scan is at the height of the sensor
+      if (t.z < min_obstacle_height_ || t.z > max_obstacle_height_) {
+        planar_scan->ranges_.clear();
+      }
+
+      // from here on the scan is only shared, never modified
+      observation_list_.front().scan_ = planar_scan;
+    } else {
+      // the points in the sensor frame, the scan's pose being the identity
+      sensor_msgs::msg::PointCloud2 sensor_cloud;
+      planar_scan->toCloud(scan.header.frame_id, sensor_cloud);
+
+      auto observation_cloud = std::make_shared<sensor_msgs::msg::PointCloud2>();
+      point_filter_.filter(sensor_cloud, transform, global_frame_, *observation_cloud);
+      observation_list_.front().cloud_ = observation_cloud;
+    }
+  } catch (tf2::TransformException & ex) {
+    // if an exception occurs, we need to remove the empty observation from the list
+    observation_list_.pop_front();
+    RCLCPP_ERROR(
+      rclcpp::get_logger(
+        "nav2_costmap_2d"),
+      "TF Exception that should never happen for sensor frame: %s, scan frame: %s, %s",
+      sensor_frame_.c_str(),
+      scan.header.frame_id.c_str(), ex.what());
+    return;
+  }
+
+  // if the update was successful, we want to update the last updated time
+  last_updated_ = nh_->now();
+
+  // we'll also remove any stale observations from the list
+  purgeStaleObservations();
+}
+
+// returns the observations, sharing their clouds
 void ObservationBuffer::getObservations(std::vector<Observation> & observations)
 {
   // first... let's make sure that we don't have any stale observations
   purgeStaleObservations();
 
-  // now we'll just copy the observations for the caller
+  // now we'll just copy the observations for the caller, which doesn't copy the points
+  observations.reserve(observations.size() + observation_list_.size());
   std::list<Observation>::iterator obs_it;
   for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it) {
     observations.push_back(*obs_it);
@@ -233,7 +327,7 @@ void ObservationBuffer::purgeStaleObservations()
       Observation & obs = *obs_it;
       // check if the observation is out of date... and if it is,
       // remove it and those that follow from the list
-      if ((last_updated_ - obs.cloud_->header.stamp) > observation_keep_time_) {
+      if ((last_updated_ - obs.stamp()) > observation_keep_time_) {
         observation_list_.erase(obs_it, observation_list_.end());
         return;
       }
@@ -241,6 +335,106 @@ void ObservationBuffer::purgeStaleObservations()
   }
 }
 
+void ObservationBuffer::setRaytraceMode(
+  Observation::RaytraceMode mode, double angular_resolution)
+{
+  raytrace_mode_ = mode;
+  raytrace_angular_resolution_ = angular_resolution;
+}
+
+void ObservationBuffer::setFieldOfView(double horizontal_fov, double vertical_fov)
+{
+  horizontal_fov_ = horizontal_fov;
+  vertical_fov_ = vertical_fov;
+}
+
+void ObservationBuffer::setRobotBaseFrame(const std::string & robot_base_frame)
+{
+  robot_base_frame_ = robot_base_frame;
+  static_chains_.clear();
+}
+
+void ObservationBuffer::setSensorPose(
+  Observation & observation, const geometry_msgs::msg::Transform & sensor_transform)
+{
+  // the pose of the sensor frame is the transform from it to the global frame
+  observation.origin_.x = sensor_transform.translation.x;
+  observation.origin_.y = sensor_transform.translation.y;
+  observation.origin_.z = sensor_transform.translation.z;
+  observation.orientation_ = sensor_transform.rotation;
+}
+
+const ObservationBuffer::StaticChain & ObservationBuffer::getStaticChain(
+  const std::string & frame, const tf2::TimePoint & time)
+{
+  auto cached = static_chains_.find(frame);
+  if (cached != static_chains_.end() &&
+    std::abs(tf2::durationToSec(time - cached->second.walked)) < static_chain_lifetime)
+  {
+    return cached->second;
+  }
+
+  StaticChain chain;
+  chain.root = frame;
+  chain.transform.setIdentity();
+  chain.walked = time;
+
+  // the latest transform to the robot is stamped at time zero when it's static all the way
+  if (!robot_base_frame_.empty() && frame != robot_base_frame_) {
+    try {
+      geometry_msgs::msg::TransformStamped to_base = tf2_buffer_.lookupTransform(
+        robot_base_frame_, frame, tf2::TimePointZero, tf2::durationFromSec(0.0));
+      if (tf2_ros::fromMsg(to_base.header.stamp) == tf2::TimePointZero) {
+        tf2::fromMsg(to_base.transform, chain.transform);
+        chain.root = robot_base_frame_;
+      }
+    } catch (tf2::TransformException & ex) {
+      // the lookup from the global frame reports it if the frame doesn't exist at all
+      RCLCPP_DEBUG(
+        rclcpp::get_logger(
+          "nav2_costmap_2d"), "Frame %s of %s isn't connected to %s: %s",
+        frame.c_str(), topic_name_.c_str(), robot_base_frame_.c_str(), ex.what());
+    }
+  }
+
+  RCLCPP_DEBUG(
+    rclcpp::get_logger(
+      "nav2_costmap_2d"), "Frame %s of %s is static relative to %s",
+    frame.c_str(), topic_name_.c_str(), chain.root.c_str());
+  StaticChain & cached_chain = static_chains_[frame];
+  cached_chain = chain;
+  return cached_chain;
+}
+
+void ObservationBuffer::lookupTransforms(
+  const std::string & sensor_frame, const std::string & data_frame,
+  const builtin_interfaces::msg::Time & stamp,
+  geometry_msgs::msg::Transform & sensor_transform,
+  geometry_msgs::msg::Transform & data_transform)
+{
+  tf2::TimePoint time = tf2_ros::fromMsg(stamp);
+  const StaticChain & sensor_chain = getStaticChain(sensor_frame, time);
+  const StaticChain & data_chain = getStaticChain(data_frame, time);
+
+  // only the transforms from the roots of the chains vary, and they're usually the same root
+  tf2::Transform sensor_root;
+  tf2::fromMsg(
+    tf2_buffer_.lookupTransform(
+      global_frame_, sensor_chain.root, time,
+      tf2::durationFromSec(0.0)).transform, sensor_root);
+
+  tf2::Transform data_root = sensor_root;
+  if (data_chain.root != sensor_chain.root) {
+    tf2::fromMsg(
+      tf2_buffer_.lookupTransform(
+        global_frame_, data_chain.root, time,
+        tf2::durationFromSec(0.0)).transform, data_root);
+  }
+
+  sensor_transform = tf2::toMsg(sensor_root * sensor_chain.transform);
+  data_transform = tf2::toMsg(data_root * data_chain.transform);
+}
+
 bool ObservationBuffer::isCurrent() const
 {
   if (expected_update_rate_ == rclcpp::Duration(0.0)) {
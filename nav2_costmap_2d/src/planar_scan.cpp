@@ -0,0 +1,67 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/planar_scan.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace nav2_costmap_2d
+{
+
+BeamTable::BeamTable(float angle_min, float angle_increment, size_t count)
+: angle_min_(angle_min), angle_increment_(angle_increment), cos_(count), sin_(count)
+{
+  for (size_t i = 0; i < count; ++i) {
+    double angle = static_cast<double>(angle_min) + static_cast<double>(i) * angle_increment;
+    cos_[i] = std::cos(angle);
+    sin_[i] = std::sin(angle);
+  }
+}
+
+void PlanarScan::toCloud(const std::string & frame_id, sensor_msgs::msg::PointCloud2 & cloud) const
+{
+  cloud.header.stamp = stamp_;
+  cloud.header.frame_id = frame_id;
+  cloud.height = 1;
+  cloud.is_bigendian = false;
+  cloud.point_step = 3 * sizeof(float);
+  cloud.is_dense = true;
+  cloud.fields.resize(3);
+  const char * names[3] = {"x", "y", "z"};
+  for (unsigned int i = 0; i < 3; ++i) {
+    cloud.fields[i].name = names[i];
+    cloud.fields[i].offset = i * sizeof(float);
+    cloud.fields[i].datatype = sensor_msgs::msg::PointField::FLOAT32;
+    cloud.fields[i].count = 1;
+  }
+
+  cloud.data.resize(size() * cloud.point_step);
+  size_t num_points = 0;
+  double wx, wy;
+  for (size_t i = 0; i < size(); ++i) {
+    if (!getPoint(i, wx, wy)) {
+      continue;
+    }
+    float point[3] = {static_cast<float>(wx), static_cast<float>(wy), static_cast<float>(z_)};
+    std::memcpy(&cloud.data[num_points * cloud.point_step], point, sizeof(point));
+    ++num_points;
+  }
+  cloud.data.resize(num_points * cloud.point_step);
+  cloud.width = num_points;
+  cloud.row_step = cloud.data.size();
+}
+
+}  // namespace nav2_costmap_2d
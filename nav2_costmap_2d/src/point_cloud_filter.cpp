@@ -0,0 +1,230 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/point_cloud_filter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define NAV2_COSTMAP_2D_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+
+struct Affine
+{
+  float r[9];
+  float t[3];
+};
+
+Affine toAffine(const geometry_msgs::msg::Transform & transform)
+{
+  double x = transform.rotation.x, y = transform.rotation.y;
+  double z = transform.rotation.z, w = transform.rotation.w;
+  double n = x * x + y * y + z * z + w * w;
+  double s = n > 0.0 ? 2.0 / n : 0.0;
+
+  Affine a;
+  a.r[0] = 1.0 - s * (y * y + z * z);
+  a.r[1] = s * (x * y - z * w);
+  a.r[2] = s * (x * z + y * w);
+  a.r[3] = s * (x * y + z * w);
+  a.r[4] = 1.0 - s * (x * x + z * z);
+  a.r[5] = s * (y * z - x * w);
+  a.r[6] = s * (x * z - y * w);
+  a.r[7] = s * (y * z + x * w);
+  a.r[8] = 1.0 - s * (x * x + y * y);
+  a.t[0] = transform.translation.x;
+  a.t[1] = transform.translation.y;
+  a.t[2] = transform.translation.z;
+  return a;
+}
+
+bool floatFieldOffset(
+  const sensor_msgs::msg::PointCloud2 & cloud, const std::string & name, uint32_t & offset)
+{
+  for (const auto & field : cloud.fields) {
+    if (field.name == name) {
+      offset = field.offset;
+      return field.datatype == sensor_msgs::msg::PointField::FLOAT32 &&
+             offset + sizeof(float) <= cloud.point_step;
+    }
+  }
+  return false;
+}
+
+inline float readFloat(const unsigned char * p)
+{
+  float f;
+  std::memcpy(&f, p, sizeof(float));
+  return f;
+}
+
+inline unsigned char * writePoint(unsigned char * out, float x, float y, float z)
+{
+  std::memcpy(out, &x, sizeof(float));
+  std::memcpy(out + 4, &y, sizeof(float));
+  std::memcpy(out + 8, &z, sizeof(float));
+  return out + 12;
+}
+
+// Largest float not above, and smallest float not below, a double bound, so the
+// comparisons in float keep exactly the points the double bounds would
+float floatAtMost(double v)
+{
+  float f = static_cast<float>(v);
+  return static_cast<double>(f) > v ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+float floatAtLeast(double v)
+{
+  float f = static_cast<float>(v);
+  return static_cast<double>(f) < v ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+
+}  // namespace
+
+PointCloudFilter::PointCloudFilter(double min_z, double max_z, double voxel_size)
+: min_z_(floatAtLeast(min_z)), max_z_(floatAtMost(max_z)), voxel_size_(voxel_size)
+{
+}
+
+bool PointCloudFilter::firstInVoxel(float x, float y, float z)
+{
+  // 21 bits per axis, centred on the origin, is millions of voxels each way
+  const int64_t half = 1 << 20;
+  const uint64_t mask = (1 << 21) - 1;
+  uint64_t ix = static_cast<uint64_t>(static_cast<int64_t>(std::floor(x / voxel_size_)) + half);
+  uint64_t iy = static_cast<uint64_t>(static_cast<int64_t>(std::floor(y / voxel_size_)) + half);
+  uint64_t iz = static_cast<uint64_t>(static_cast<int64_t>(std::floor(z / voxel_size_)) + half);
+  return voxels_.insert((ix & mask) | ((iy & mask) << 21) | ((iz & mask) << 42)).second;
+}
+
+bool PointCloudFilter::filter(
+  const sensor_msgs::msg::PointCloud2 & cloud, const geometry_msgs::msg::Transform & transform,
+  const std::string & global_frame, sensor_msgs::msg::PointCloud2 & output)
+{
+  output.header.stamp = cloud.header.stamp;
+  output.header.frame_id = global_frame;
+  output.height = 1;
+  output.width = 0;
+  output.is_bigendian = false;
+  output.point_step = 3 * sizeof(float);
+  output.row_step = 0;
+  output.is_dense = true;
+  output.fields.resize(3);
+  const char * names[3] = {"x", "y", "z"};
+  for (unsigned int i = 0; i < 3; ++i) {
+    output.fields[i].name = names[i];
+    output.fields[i].offset = i * sizeof(float);
+    output.fields[i].datatype = sensor_msgs::msg::PointField::FLOAT32;
+    output.fields[i].count = 1;
+  }
+  output.data.clear();
+
+  uint32_t ox, oy, oz;
+  if (!floatFieldOffset(cloud, "x", ox) || !floatFieldOffset(cloud, "y", oy) ||
+    !floatFieldOffset(cloud, "z", oz))
+  {
+    return false;
+  }
+
+  const Affine a = toAffine(transform);
+  const size_t step = cloud.point_step;
+  const size_t num_points = std::min(
+    static_cast<size_t>(cloud.width) * cloud.height,
+    step == 0 ? 0 : cloud.data.size() / step);
+  const bool downsample = voxel_size_ > 0.0;
+  if (downsample) {
+    voxels_.clear();
+  }
+
+  output.data.resize(num_points * output.point_step);
+  const unsigned char * in = cloud.data.data();
+  unsigned char * out = output.data.data();
+  size_t i = 0;
+
+#ifdef NAV2_COSTMAP_2D_X86_KERNELS
+  const __m128 r0 = _mm_set1_ps(a.r[0]), r1 = _mm_set1_ps(a.r[1]), r2 = _mm_set1_ps(a.r[2]);
+  const __m128 r3 = _mm_set1_ps(a.r[3]), r4 = _mm_set1_ps(a.r[4]), r5 = _mm_set1_ps(a.r[5]);
+  const __m128 r6 = _mm_set1_ps(a.r[6]), r7 = _mm_set1_ps(a.r[7]), r8 = _mm_set1_ps(a.r[8]);
+  const __m128 t0 = _mm_set1_ps(a.t[0]), t1 = _mm_set1_ps(a.t[1]), t2 = _mm_set1_ps(a.t[2]);
+  const __m128 lo = _mm_set1_ps(min_z_), hi = _mm_set1_ps(max_z_);
+  for (; i + 4 <= num_points; i += 4) {
+    // the points are strided, so gather each field of four of them into a register
+    const unsigned char * p = in + i * step;
+    __m128 x = _mm_setr_ps(
+      readFloat(p + ox), readFloat(p + step + ox),
+      readFloat(p + 2 * step + ox), readFloat(p + 3 * step + ox));
+    __m128 y = _mm_setr_ps(
+      readFloat(p + oy), readFloat(p + step + oy),
+      readFloat(p + 2 * step + oy), readFloat(p + 3 * step + oy));
+    __m128 z = _mm_setr_ps(
+      readFloat(p + oz), readFloat(p + step + oz),
+      readFloat(p + 2 * step + oz), readFloat(p + 3 * step + oz));
+
+    __m128 gz = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(r6, x), _mm_mul_ps(r7, y)), _mm_add_ps(_mm_mul_ps(r8, z), t2));
+    // NaN heights fail both comparisons, as they do in the scalar loop
+    int keep = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(gz, lo), _mm_cmple_ps(gz, hi)));
+    if (keep == 0) {
+      continue;
+    }
+
+    __m128 gx = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(r0, x), _mm_mul_ps(r1, y)), _mm_add_ps(_mm_mul_ps(r2, z), t0));
+    __m128 gy = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(r3, x), _mm_mul_ps(r4, y)), _mm_add_ps(_mm_mul_ps(r5, z), t1));
+    float xs[4], ys[4], zs[4];
+    _mm_storeu_ps(xs, gx);
+    _mm_storeu_ps(ys, gy);
+    _mm_storeu_ps(zs, gz);
+    for (int k = 0; k < 4; ++k) {
+      if ((keep & (1 << k)) && (!downsample || firstInVoxel(xs[k], ys[k], zs[k]))) {
+        out = writePoint(out, xs[k], ys[k], zs[k]);
+      }
+    }
+  }
+#endif
+
+  for (; i < num_points; ++i) {
+    const unsigned char * p = in + i * step;
+    float x = readFloat(p + ox), y = readFloat(p + oy), z = readFloat(p + oz);
+    float gz = (a.r[6] * x + a.r[7] * y) + (a.r[8] * z + a.t[2]);
+    if (!(gz >= min_z_ && gz <= max_z_)) {
+      continue;
+    }
+    float gx = (a.r[0] * x + a.r[1] * y) + (a.r[2] * z + a.t[0]);
+    float gy = (a.r[3] * x + a.r[4] * y) + (a.r[5] * z + a.t[1]);
+    if (!downsample || firstInVoxel(gx, gy, gz)) {
+      out = writePoint(out, gx, gy, gz);
+    }
+  }
+
+  output.data.resize(out - output.data.data());
+  output.width = output.data.size() / output.point_step;
+  output.row_step = output.data.size();
+  return true;
+}
+
+}  // namespace nav2_costmap_2d
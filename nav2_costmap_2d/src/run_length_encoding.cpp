@@ -0,0 +1,57 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/run_length_encoding.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace nav2_costmap_2d
+{
+
+void encodeRunLength(const uint8_t * data, size_t length, std::vector<uint8_t> & encoded)
+{
+  encoded.clear();
+  size_t i = 0;
+  while (i < length) {
+    uint8_t value = data[i];
+    size_t run = 1;
+    while (run < 255 && i + run < length && data[i + run] == value) {
+      ++run;
+    }
+    encoded.push_back(static_cast<uint8_t>(run));
+    encoded.push_back(value);
+    i += run;
+  }
+}
+
+bool decodeRunLength(const std::vector<uint8_t> & encoded, uint8_t * data, size_t length)
+{
+  if (encoded.size() % 2 != 0) {
+    return false;
+  }
+
+  size_t written = 0;
+  for (size_t i = 0; i < encoded.size(); i += 2) {
+    size_t run = encoded[i];
+    if (run == 0 || written + run > length) {
+      return false;
+    }
+    memset(data + written, encoded[i + 1], run);
+    written += run;
+  }
+  return written == length;
+}
+
+}  // namespace nav2_costmap_2d
@@ -0,0 +1,764 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "nav2_costmap_2d/sensor_log.hpp"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+
+const char log_magic[8] = {'N', 'A', 'V', '2', 'S', 'L', 'O', 'G'};
+const uint32_t log_version = 1;
+
+// How many updates may wait to be written before endCycle() waits for the writing thread
+const size_t max_queued_cycles = 64;
+
+// Each record is its type, the size of its payload and the payload
+enum RecordType : uint8_t
+{
+  PARAMETERS_RECORD = 1,
+  CYCLE_RECORD = 2
+};
+
+enum CycleFlags : uint8_t
+{
+  HAS_FOOTPRINT = 1,
+  HAS_GEOMETRY = 2
+};
+
+// How each observation of a cycle is written
+enum ObservationKind : uint8_t
+{
+  NEW_OBSERVATION = 0,
+  PREVIOUS_OBSERVATION = 1  // the index of the observation in the last cycle of the layer
+};
+
+// Appends values to the payload of a record
+class Encoder
+{
+public:
+  explicit Encoder(std::string & buffer)
+  : buffer_(buffer)
+  {
+  }
+
+  template<class T>
+  void put(T value)
+  {
+    buffer_.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void putString(const std::string & value)
+  {
+    put<uint32_t>(value.size());
+    buffer_.append(value);
+  }
+
+  template<class T>
+  void putArray(const std::vector<T> & values)
+  {
+    put<uint32_t>(values.size());
+    if (!values.empty()) {
+      buffer_.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+    }
+  }
+
+  void putPoint(const geometry_msgs::msg::Point & point)
+  {
+    put(point.x);
+    put(point.y);
+    put(point.z);
+  }
+
+private:
+  std::string & buffer_;
+};
+
+// Reads values back from the payload of a record, throwing if they run past its end
+class Decoder
+{
+public:
+  explicit Decoder(const std::string & buffer)
+  : buffer_(buffer), position_(0)
+  {
+  }
+
+  template<class T>
+  T get()
+  {
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string getString()
+  {
+    uint32_t size = get<uint32_t>();
+    return std::string(take(size), size);
+  }
+
+  template<class T>
+  void getArray(std::vector<T> & values)
+  {
+    uint32_t size = get<uint32_t>();
+    const char * data = take(static_cast<size_t>(size) * sizeof(T));
+    values.resize(size);
+    if (size > 0) {
+      std::memcpy(values.data(), data, values.size() * sizeof(T));
+    }
+  }
+
+  geometry_msgs::msg::Point getPoint()
+  {
+    geometry_msgs::msg::Point point;
+    point.x = get<double>();
+    point.y = get<double>();
+    point.z = get<double>();
+    return point;
+  }
+
+private:
+  const char * take(size_t size)
+  {
+    if (size > buffer_.size() - position_) {
+      throw std::runtime_error("Corrupt sensor log record");
+    }
+    const char * data = buffer_.data() + position_;
+    position_ += size;
+    return data;
+  }
+
+  const std::string & buffer_;
+  size_t position_;
+};
+
+void encodeParameters(Encoder & encoder, const std::vector<rclcpp::Parameter> & parameters)
+{
+  encoder.put<uint32_t>(parameters.size());
+  for (const rclcpp::Parameter & parameter : parameters) {
+    encoder.putString(parameter.get_name());
+    encoder.put<uint8_t>(parameter.get_type());
+    switch (parameter.get_type()) {
+      case rclcpp::ParameterType::PARAMETER_BOOL:
+        encoder.put<uint8_t>(parameter.as_bool());
+        break;
+      case rclcpp::ParameterType::PARAMETER_INTEGER:
+        encoder.put<int64_t>(parameter.as_int());
+        break;
+      case rclcpp::ParameterType::PARAMETER_DOUBLE:
+        encoder.put<double>(parameter.as_double());
+        break;
+      case rclcpp::ParameterType::PARAMETER_STRING:
+        encoder.putString(parameter.as_string());
+        break;
+      case rclcpp::ParameterType::PARAMETER_BYTE_ARRAY:
+        encoder.putArray(parameter.as_byte_array());
+        break;
+      case rclcpp::ParameterType::PARAMETER_BOOL_ARRAY:
+        {
+          const std::vector<bool> & values = parameter.as_bool_array();
+          encoder.putArray(std::vector<uint8_t>(values.begin(), values.end()));
+          break;
+        }
+      case rclcpp::ParameterType::PARAMETER_INTEGER_ARRAY:
+        encoder.putArray(parameter.as_integer_array());
+        break;
+      case rclcpp::ParameterType::PARAMETER_DOUBLE_ARRAY:
+        encoder.putArray(parameter.as_double_array());
+        break;
+      case rclcpp::ParameterType::PARAMETER_STRING_ARRAY:
+        encoder.put<uint32_t>(parameter.as_string_array().size());
+        for (const std::string & value : parameter.as_string_array()) {
+          encoder.putString(value);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void decodeParameters(Decoder & decoder, std::vector<rclcpp::Parameter> & parameters)
+{
+  uint32_t size = decoder.get<uint32_t>();
+  for (uint32_t i = 0; i < size; ++i) {
+    std::string name = decoder.getString();
+    switch (decoder.get<uint8_t>()) {
+      case rclcpp::ParameterType::PARAMETER_BOOL:
+        parameters.emplace_back(name, decoder.get<uint8_t>() != 0);
+        break;
+      case rclcpp::ParameterType::PARAMETER_INTEGER:
+        parameters.emplace_back(name, decoder.get<int64_t>());
+        break;
+      case rclcpp::ParameterType::PARAMETER_DOUBLE:
+        parameters.emplace_back(name, decoder.get<double>());
+        break;
+      case rclcpp::ParameterType::PARAMETER_STRING:
+        parameters.emplace_back(name, decoder.getString());
+        break;
+      case rclcpp::ParameterType::PARAMETER_BYTE_ARRAY:
+        {
+          std::vector<uint8_t> values;
+          decoder.getArray(values);
+          parameters.emplace_back(name, values);
+          break;
+        }
+      case rclcpp::ParameterType::PARAMETER_BOOL_ARRAY:
+        {
+          std::vector<uint8_t> values;
+          decoder.getArray(values);
+          parameters.emplace_back(name, std::vector<bool>(values.begin(), values.end()));
+          break;
+        }
+      case rclcpp::ParameterType::PARAMETER_INTEGER_ARRAY:
+        {
+          std::vector<int64_t> values;
+          decoder.getArray(values);
+          parameters.emplace_back(name, values);
+          break;
+        }
+      case rclcpp::ParameterType::PARAMETER_DOUBLE_ARRAY:
+        {
+          std::vector<double> values;
+          decoder.getArray(values);
+          parameters.emplace_back(name, values);
+          break;
+        }
+      case rclcpp::ParameterType::PARAMETER_STRING_ARRAY:
+        {
+          std::vector<std::string> values(decoder.get<uint32_t>());
+          for (std::string & value : values) {
+            value = decoder.getString();
+          }
+          parameters.emplace_back(name, values);
+          break;
+        }
+      default:
+        parameters.emplace_back(name);
+        break;
+    }
+  }
+}
+
+void encodeObservation(Encoder & encoder, const Observation & observation)
+{
+  encoder.putPoint(observation.origin_);
+  encoder.put(observation.orientation_.x);
+  encoder.put(observation.orientation_.y);
+  encoder.put(observation.orientation_.z);
+  encoder.put(observation.orientation_.w);
+  encoder.put(observation.obstacle_range_);
+  encoder.put(observation.raytrace_range_);
+  encoder.put<uint8_t>(observation.raytrace_mode_);
+  encoder.put(observation.raytrace_angular_resolution_);
+  encoder.put(observation.horizontal_fov_);
+  encoder.put(observation.vertical_fov_);
+
+  encoder.put<uint8_t>(observation.scan_ != nullptr);
+  if (observation.scan_) {
+    const PlanarScan & scan = *observation.scan_;
+    encoder.put(scan.stamp_.sec);
+    encoder.put(scan.stamp_.nanosec);
+    encoder.put(scan.x_);
+    encoder.put(scan.y_);
+    encoder.put(scan.z_);
+    encoder.put(scan.cos_yaw_);
+    encoder.put(scan.sin_yaw_);
+    encoder.put(scan.range_min_);
+    encoder.put(scan.range_max_);
+    encoder.putArray(scan.ranges_);
+    // the beam table is computed again from its angles when read
+    encoder.put(scan.beams_->angle_min_);
+    encoder.put(scan.beams_->angle_increment_);
+    encoder.put<uint32_t>(scan.beams_->cos_.size());
+    return;
+  }
+
+  const sensor_msgs::msg::PointCloud2 & cloud = *observation.cloud_;
+  encoder.put(cloud.header.stamp.sec);
+  encoder.put(cloud.header.stamp.nanosec);
+  encoder.putString(cloud.header.frame_id);
+  encoder.put(cloud.height);
+  encoder.put(cloud.width);
+  encoder.put<uint32_t>(cloud.fields.size());
+  for (const sensor_msgs::msg::PointField & field : cloud.fields) {
+    encoder.putString(field.name);
+    encoder.put(field.offset);
+    encoder.put(field.datatype);
+    encoder.put(field.count);
+  }
+  encoder.put<uint8_t>(cloud.is_bigendian);
+  encoder.put(cloud.point_step);
+  encoder.put(cloud.row_step);
+  encoder.putArray(cloud.data);
+  encoder.put<uint8_t>(cloud.is_dense);
+}
+
+Observation decodeObservation(Decoder & decoder, std::shared_ptr<const BeamTable> & beams)
+{
+  Observation observation;
+  observation.origin_ = decoder.getPoint();
+  observation.orientation_.x = decoder.get<double>();
+  observation.orientation_.y = decoder.get<double>();
+  observation.orientation_.z = decoder.get<double>();
+  observation.orientation_.w = decoder.get<double>();
+  observation.obstacle_range_ = decoder.get<double>();
+  observation.raytrace_range_ = decoder.get<double>();
+  observation.raytrace_mode_ = static_cast<Observation::RaytraceMode>(decoder.get<uint8_t>());
+  observation.raytrace_angular_resolution_ = decoder.get<double>();
+  observation.horizontal_fov_ = decoder.get<double>();
+  observation.vertical_fov_ = decoder.get<double>();
+
+  if (decoder.get<uint8_t>()) {
+    auto scan = std::make_shared<PlanarScan>();
+    scan->stamp_.sec = decoder.get<decltype(scan->stamp_.sec)>();
+    scan->stamp_.nanosec = decoder.get<decltype(scan->stamp_.nanosec)>();
+    scan->x_ = decoder.get<double>();
+    scan->y_ = decoder.get<double>();
+    scan->z_ = decoder.get<double>();
+    scan->cos_yaw_ = decoder.get<double>();
+    scan->sin_yaw_ = decoder.get<double>();
+    scan->range_min_ = decoder.get<float>();
+    scan->range_max_ = decoder.get<float>();
+    decoder.getArray(scan->ranges_);
+    float angle_min = decoder.get<float>();
+    float angle_increment = decoder.get<float>();
+    uint32_t count = decoder.get<uint32_t>();
+    if (count != scan->ranges_.size()) {
+      throw std::runtime_error("Corrupt sensor log record");
+    }
+    if (!beams || !beams->matches(angle_min, angle_increment, count)) {
+      beams = std::make_shared<const BeamTable>(angle_min, angle_increment, count);
+    }
+    scan->beams_ = beams;
+    observation.scan_ = scan;
+    return observation;
+  }
+
+  auto cloud = std::make_shared<sensor_msgs::msg::PointCloud2>();
+  cloud->header.stamp.sec = decoder.get<decltype(cloud->header.stamp.sec)>();
+  cloud->header.stamp.nanosec = decoder.get<decltype(cloud->header.stamp.nanosec)>();
+  cloud->header.frame_id = decoder.getString();
+  cloud->height = decoder.get<uint32_t>();
+  cloud->width = decoder.get<uint32_t>();
+  cloud->fields.resize(decoder.get<uint32_t>());
+  for (sensor_msgs::msg::PointField & field : cloud->fields) {
+    field.name = decoder.getString();
+    field.offset = decoder.get<decltype(field.offset)>();
+    field.datatype = decoder.get<decltype(field.datatype)>();
+    field.count = decoder.get<decltype(field.count)>();
+  }
+  cloud->is_bigendian = decoder.get<uint8_t>() != 0;
+  cloud->point_step = decoder.get<uint32_t>();
+  cloud->row_step = decoder.get<uint32_t>();
+  decoder.getArray(cloud->data);
+  cloud->is_dense = decoder.get<uint8_t>() != 0;
+  observation.cloud_ = cloud;
+  return observation;
+}
+
+// Observations are only the same if they share their points
+bool isSameObservation(const Observation & a, const Observation & b)
+{
+  return a.cloud_ == b.cloud_ && a.scan_ == b.scan_ &&
+         a.origin_.x == b.origin_.x && a.origin_.y == b.origin_.y && a.origin_.z == b.origin_.z &&
+         a.orientation_.x == b.orientation_.x && a.orientation_.y == b.orientation_.y &&
+         a.orientation_.z == b.orientation_.z && a.orientation_.w == b.orientation_.w &&
+         a.obstacle_range_ == b.obstacle_range_ && a.raytrace_range_ == b.raytrace_range_ &&
+         a.raytrace_mode_ == b.raytrace_mode_ &&
+         a.raytrace_angular_resolution_ == b.raytrace_angular_resolution_ &&
+         a.horizontal_fov_ == b.horizontal_fov_ && a.vertical_fov_ == b.vertical_fov_;
+}
+
+// The index of an observation in a list, or the size of the list if it isn't there
+size_t findObservation(
+  const std::vector<Observation> & observations, const Observation & observation)
+{
+  size_t i = 0;
+  while (i < observations.size() && !isSameObservation(observations[i], observation)) {
+    ++i;
+  }
+  return i;
+}
+
+bool isSameFootprint(
+  const std::vector<geometry_msgs::msg::Point> & a,
+  const std::vector<geometry_msgs::msg::Point> & b)
+{
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].z != b[i].z) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+SensorLogWriter::SensorLogWriter(
+  const std::string & path, const std::vector<rclcpp::Parameter> & parameters)
+: file_(fopen(path.c_str(), "wb")), in_cycle_(false), first_cycle_(true), closing_(false)
+{
+  if (!file_) {
+    throw std::runtime_error("Could not create the sensor log " + path);
+  }
+
+  std::string payload;
+  Encoder encoder(payload);
+  encodeParameters(encoder, parameters);
+  try {
+    if (fwrite(log_magic, sizeof(log_magic), 1, file_) != 1 ||
+      fwrite(&log_version, sizeof(log_version), 1, file_) != 1)
+    {
+      throw std::runtime_error("Could not write the sensor log " + path);
+    }
+    writeRecord(PARAMETERS_RECORD, payload);
+  } catch (const std::runtime_error &) {
+    fclose(file_);
+    throw;
+  }
+
+  writer_ = std::thread(&SensorLogWriter::writeCycles, this);
+}
+
+SensorLogWriter::~SensorLogWriter()
+{
+  // the updates handed over are all written before the log is closed
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    closing_ = true;
+  }
+  queue_cv_.notify_all();
+  writer_.join();
+  fclose(file_);
+}
+
+void SensorLogWriter::beginCycle(
+  int64_t stamp, double robot_x, double robot_y, double robot_yaw,
+  const std::vector<geometry_msgs::msg::Point> & footprint, Costmap2D & master_grid)
+{
+  // the layers record their observations with the grid locked, so it isn't locked here
+  // while the cycle is
+  unsigned int size_x, size_y;
+  double resolution, origin_x, origin_y;
+  {
+    std::unique_lock<Costmap2D::mutex_t> grid_lock(*(master_grid.getMutex()));
+    size_x = master_grid.getSizeInCellsX();
+    size_y = master_grid.getSizeInCellsY();
+    resolution = master_grid.getResolution();
+    origin_x = master_grid.getOriginX();
+    origin_y = master_grid.getOriginY();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  in_cycle_ = true;
+  cycle_.stamp = stamp;
+  cycle_.robot_x = robot_x;
+  cycle_.robot_y = robot_y;
+  cycle_.robot_yaw = robot_yaw;
+
+  cycle_.has_footprint = first_cycle_ || !isSameFootprint(footprint, last_footprint_);
+  if (cycle_.has_footprint) {
+    last_footprint_ = footprint;
+    cycle_.footprint = footprint;
+  }
+
+  cycle_.has_geometry = first_cycle_ || size_x != cycle_.size_x || size_y != cycle_.size_y ||
+    resolution != cycle_.resolution;
+  cycle_.size_x = size_x;
+  cycle_.size_y = size_y;
+  cycle_.resolution = resolution;
+  cycle_.origin_x = origin_x;
+  cycle_.origin_y = origin_y;
+  first_cycle_ = false;
+}
+
+void SensorLogWriter::addObservations(
+  const std::string & layer, const std::vector<Observation> & marking,
+  const std::vector<Observation> & clearing)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!in_cycle_) {
+    return;
+  }
+  SensorLogObservations & observations = cycle_.layers[layer];
+  observations.marking = marking;
+  observations.clearing = clearing;
+}
+
+void SensorLogWriter::endCycle()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!in_cycle_) {
+    return;
+  }
+  in_cycle_ = false;
+
+  std::unique_lock<std::mutex> queue_lock(queue_mutex_);
+  queue_cv_.wait(
+    queue_lock, [this] {return queue_.size() < max_queued_cycles || !error_.empty();});
+  if (!error_.empty()) {
+    cycle_.layers.clear();
+    throw std::runtime_error(error_);
+  }
+  queue_.push_back(std::move(cycle_));
+  queue_cv_.notify_all();
+  cycle_.footprint.clear();
+  cycle_.layers.clear();
+}
+
+void SensorLogWriter::writeCycles()
+{
+  std::unique_lock<std::mutex> lock(queue_mutex_);
+  while (true) {
+    queue_cv_.wait(lock, [this] {return !queue_.empty() || closing_;});
+    if (queue_.empty()) {
+      return;
+    }
+    SensorLogCycle cycle = std::move(queue_.front());
+    queue_.pop_front();
+    queue_cv_.notify_all();
+    if (!error_.empty()) {
+      continue;
+    }
+
+    lock.unlock();
+    std::string error;
+    try {
+      writeCycle(cycle);
+    } catch (const std::runtime_error & e) {
+      error = e.what();
+    }
+    lock.lock();
+    error_ = error;
+    if (!error_.empty()) {
+      queue_cv_.notify_all();
+    }
+  }
+}
+
+void SensorLogWriter::writeCycle(const SensorLogCycle & cycle)
+{
+  std::string payload;
+  Encoder encoder(payload);
+  encoder.put(cycle.stamp);
+  encoder.put(cycle.robot_x);
+  encoder.put(cycle.robot_y);
+  encoder.put(cycle.robot_yaw);
+  encoder.put<uint8_t>(
+    (cycle.has_footprint ? HAS_FOOTPRINT : 0) | (cycle.has_geometry ? HAS_GEOMETRY : 0));
+  if (cycle.has_footprint) {
+    encoder.put<uint32_t>(cycle.footprint.size());
+    for (const geometry_msgs::msg::Point & point : cycle.footprint) {
+      encoder.putPoint(point);
+    }
+  }
+  if (cycle.has_geometry) {
+    encoder.put<uint32_t>(cycle.size_x);
+    encoder.put<uint32_t>(cycle.size_y);
+    encoder.put(cycle.resolution);
+    encoder.put(cycle.origin_x);
+    encoder.put(cycle.origin_y);
+  }
+
+  encoder.put<uint32_t>(cycle.layers.size());
+  for (const auto & layer : cycle.layers) {
+    encoder.putString(layer.first);
+
+    // an observation used to both mark and clear, or kept from the last cycle, is written once
+    std::vector<Observation> table;
+    auto index = [&table](const Observation & observation) {
+        size_t i = findObservation(table, observation);
+        if (i == table.size()) {
+          table.push_back(observation);
+        }
+        return static_cast<uint32_t>(i);
+      };
+    std::vector<uint32_t> marking, clearing;
+    for (const Observation & observation : layer.second.marking) {
+      marking.push_back(index(observation));
+    }
+    for (const Observation & observation : layer.second.clearing) {
+      clearing.push_back(index(observation));
+    }
+
+    std::vector<Observation> & previous = previous_[layer.first];
+    encoder.put<uint32_t>(table.size());
+    for (const Observation & observation : table) {
+      size_t i = findObservation(previous, observation);
+      if (i < previous.size()) {
+        encoder.put<uint8_t>(PREVIOUS_OBSERVATION);
+        encoder.put<uint32_t>(i);
+      } else {
+        encoder.put<uint8_t>(NEW_OBSERVATION);
+        encodeObservation(encoder, observation);
+      }
+    }
+    encoder.putArray(marking);
+    encoder.putArray(clearing);
+    previous = std::move(table);
+  }
+
+  writeRecord(CYCLE_RECORD, payload);
+}
+
+void SensorLogWriter::writeRecord(uint8_t type, const std::string & payload)
+{
+  uint32_t size = payload.size();
+  if (fwrite(&type, sizeof(type), 1, file_) != 1 ||
+    fwrite(&size, sizeof(size), 1, file_) != 1 ||
+    fwrite(payload.data(), 1, payload.size(), file_) != payload.size())
+  {
+    throw std::runtime_error("Could not write the sensor log");
+  }
+}
+
+SensorLogReader::SensorLogReader(const std::string & path)
+: file_(fopen(path.c_str(), "rb"))
+{
+  if (!file_) {
+    throw std::runtime_error("Could not open the sensor log " + path);
+  }
+
+  char magic[sizeof(log_magic)];
+  uint32_t version;
+  uint8_t type;
+  std::string payload;
+  std::string error;
+  if (fread(magic, sizeof(magic), 1, file_) != 1 ||
+    std::memcmp(magic, log_magic, sizeof(magic)) != 0 ||
+    fread(&version, sizeof(version), 1, file_) != 1)
+  {
+    error = path + " is not a sensor log";
+  } else if (version != log_version) {
+    error = "The sensor log " + path + " has the unsupported version " + std::to_string(version);
+  } else if (!readRecord(type, payload) || type != PARAMETERS_RECORD) {
+    error = "The sensor log " + path + " has no parameters";
+  } else {
+    try {
+      Decoder decoder(payload);
+      decodeParameters(decoder, parameters_);
+    } catch (const std::runtime_error & e) {
+      error = e.what();
+    }
+  }
+  if (!error.empty()) {
+    fclose(file_);
+    throw std::runtime_error(error);
+  }
+}
+
+SensorLogReader::~SensorLogReader()
+{
+  fclose(file_);
+}
+
+bool SensorLogReader::readCycle(SensorLogCycle & cycle)
+{
+  uint8_t type;
+  std::string payload;
+  do {
+    if (!readRecord(type, payload)) {
+      return false;
+    }
+  } while (type != CYCLE_RECORD);  // records of other types are for newer readers
+
+  Decoder decoder(payload);
+  cycle.stamp = decoder.get<int64_t>();
+  cycle.robot_x = decoder.get<double>();
+  cycle.robot_y = decoder.get<double>();
+  cycle.robot_yaw = decoder.get<double>();
+  uint8_t flags = decoder.get<uint8_t>();
+
+  cycle.has_footprint = (flags & HAS_FOOTPRINT) != 0;
+  cycle.footprint.clear();
+  if (cycle.has_footprint) {
+    cycle.footprint.resize(decoder.get<uint32_t>());
+    for (geometry_msgs::msg::Point & point : cycle.footprint) {
+      point = decoder.getPoint();
+    }
+  }
+
+  cycle.has_geometry = (flags & HAS_GEOMETRY) != 0;
+  if (cycle.has_geometry) {
+    cycle.size_x = decoder.get<uint32_t>();
+    cycle.size_y = decoder.get<uint32_t>();
+    cycle.resolution = decoder.get<double>();
+    cycle.origin_x = decoder.get<double>();
+    cycle.origin_y = decoder.get<double>();
+  }
+
+  cycle.layers.clear();
+  uint32_t num_layers = decoder.get<uint32_t>();
+  for (uint32_t i = 0; i < num_layers; ++i) {
+    std::string name = decoder.getString();
+    std::vector<Observation> & previous = previous_[name];
+
+    std::vector<Observation> table;
+    uint32_t table_size = decoder.get<uint32_t>();
+    for (uint32_t j = 0; j < table_size; ++j) {
+      if (decoder.get<uint8_t>() == PREVIOUS_OBSERVATION) {
+        uint32_t k = decoder.get<uint32_t>();
+        if (k >= previous.size()) {
+          throw std::runtime_error("Corrupt sensor log record");
+        }
+        table.push_back(previous[k]);
+      } else {
+        table.push_back(decodeObservation(decoder, beams_));
+      }
+    }
+
+    SensorLogObservations & observations = cycle.layers[name];
+    auto select = [&table](const std::vector<uint32_t> & indices, std::vector<Observation> & out) {
+        for (uint32_t index : indices) {
+          if (index >= table.size()) {
+            throw std::runtime_error("Corrupt sensor log record");
+          }
+          out.push_back(table[index]);
+        }
+      };
+    std::vector<uint32_t> indices;
+    decoder.getArray(indices);
+    select(indices, observations.marking);
+    decoder.getArray(indices);
+    select(indices, observations.clearing);
+    previous = std::move(table);
+  }
+  return true;
+}
+
+bool SensorLogReader::readRecord(uint8_t & type, std::string & payload)
+{
+  uint32_t size;
+  if (fread(&type, sizeof(type), 1, file_) != 1 || fread(&size, sizeof(size), 1, file_) != 1) {
+    return false;
+  }
+  payload.resize(size);
+  return size == 0 || fread(&payload[0], 1, size, file_) == size;
+}
+
+}  // namespace nav2_costmap_2d
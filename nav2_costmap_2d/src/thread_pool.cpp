@@ -0,0 +1,136 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_costmap_2d/thread_pool.hpp"
+
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+// set while a thread works on tasks, so nested calls don't wait on themselves
+thread_local bool in_task = false;
+}  // namespace
+
+struct ThreadPool::Job
+{
+  Job(unsigned int n, const Task & t)
+  : task(t), size(n), next(0), pending(n) {}
+
+  const Task & task;
+  const unsigned int size;
+  std::atomic<unsigned int> next;
+  std::atomic<unsigned int> pending;
+  std::mutex error_mutex;
+  std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(unsigned int num_threads)
+: stop_(false)
+{
+  for (unsigned int i = 1; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto & worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(unsigned int n, const Task & task)
+{
+  if (n == 0) {
+    return;
+  }
+
+  if (workers_.empty() || n == 1 || in_task) {
+    for (unsigned int i = 0; i < n; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> call_lock(call_mutex_);
+  auto job = std::make_shared<Job>(n, task);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = job;
+  }
+  work_cv_.notify_all();
+
+  runJob(*job);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [&job] {return job->pending == 0;});
+  job_.reset();
+  lock.unlock();
+
+  if (job->error) {
+    std::rethrow_exception(job->error);
+  }
+}
+
+void ThreadPool::workerLoop()
+{
+  std::shared_ptr<Job> last_job;
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [this, &last_job] {return stop_ || (job_ && job_ != last_job);});
+      if (stop_) {
+        return;
+      }
+      job = job_;
+    }
+    runJob(*job);
+    last_job = job;
+  }
+}
+
+void ThreadPool::runJob(Job & job)
+{
+  in_task = true;
+  unsigned int i;
+  while ((i = job.next++) < job.size) {
+    try {
+      job.task(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(job.error_mutex);
+      if (!job.error) {
+        job.error = std::current_exception();
+      }
+    }
+
+    if (--job.pending == 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_cv_.notify_all();
+    }
+  }
+  in_task = false;
+}
+
+}  // namespace nav2_costmap_2d
@@ -0,0 +1,108 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "nav2_costmap_2d/timed_mutex.hpp"
+
+#include <chrono>
+#include <thread>
+
+namespace nav2_costmap_2d
+{
+
+namespace
+{
+uint64_t nanoseconds(std::chrono::steady_clock::duration duration)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+}  // namespace
+
+TimedRecursiveMutex::TimedRecursiveMutex()
+: wait_(nullptr), hold_(nullptr), untimed_thread_(std::thread::id()),
+  depth_(0), timed_(false)
+{
+}
+
+bool TimedRecursiveMutex::isTimed() const
+{
+  return wait_.load(std::memory_order_relaxed) != nullptr &&
+         untimed_thread_.load(std::memory_order_relaxed) != std::this_thread::get_id();
+}
+
+void TimedRecursiveMutex::lock()
+{
+  if (!isTimed()) {
+    mutex_.lock();
+    locked(std::chrono::steady_clock::time_point(), false);
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  mutex_.lock();
+  locked(start, true);
+}
+
+bool TimedRecursiveMutex::try_lock()
+{
+  bool timed = isTimed();
+  auto start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  if (!mutex_.try_lock()) {
+    return false;
+  }
+  locked(start, timed);
+  return true;
+}
+
+void TimedRecursiveMutex::locked(std::chrono::steady_clock::time_point start, bool timed)
+{
+  if (depth_++ > 0) {
+    return;
+  }
+  timed_ = false;
+  Histogram * wait = wait_.load(std::memory_order_relaxed);
+  if (timed && wait != nullptr) {
+    locked_at_ = std::chrono::steady_clock::now();
+    wait->record(nanoseconds(locked_at_ - start));
+    timed_ = true;
+  }
+}
+
+void TimedRecursiveMutex::unlock()
+{
+  if (--depth_ == 0 && timed_) {
+    Histogram * hold = hold_.load(std::memory_order_relaxed);
+    if (hold != nullptr) {
+      hold->record(nanoseconds(std::chrono::steady_clock::now() - locked_at_));
+    }
+  }
+  mutex_.unlock();
+}
+
+void TimedRecursiveMutex::setHistograms(Histogram * wait, Histogram * hold)
+{
+  // held so that no lock in progress records into histograms that are being unset
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (wait == nullptr || hold == nullptr) {
+    wait = hold = nullptr;
+  }
+  wait_.store(wait, std::memory_order_relaxed);
+  hold_.store(hold, std::memory_order_relaxed);
+}
+
+void TimedRecursiveMutex::setUntimedThread(std::thread::id id)
+{
+  untimed_thread_.store(id, std::memory_order_relaxed);
+}
+
+}  // namespace nav2_costmap_2d
@@ -0,0 +1,167 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_subscriber.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+class RclCppFixture
+{
+public:
+  RclCppFixture() {rclcpp::init(0, nullptr);}
+  ~RclCppFixture() {rclcpp::shutdown();}
+};
+RclCppFixture g_rclcppfixture;
+
+/**
+ * A subscriber fed updates directly, which exposes its grid and last handed out copy
+ */
+class TestCostmapSubscriber : public nav2_costmap_2d::CostmapSubscriber
+{
+public:
+  explicit TestCostmapSubscriber(rclcpp::Node::SharedPtr node)
+  : CostmapSubscriber(node, "costmap_raw")
+  {
+  }
+
+  /**
+   * @brief Apply an update of one patch of a single value, the whole 10x10 grid for keyframes
+   */
+  void update(
+    uint32_t sequence, bool keyframe, unsigned int x, unsigned int y, unsigned int size,
+    unsigned char value)
+  {
+    auto update = std::make_shared<nav2_msgs::msg::CostmapUpdate>();
+    update->sequence = sequence;
+    update->keyframe = keyframe;
+    update->metadata = makeMetaData();
+    nav2_msgs::msg::CostmapPatch patch;
+    patch.x = keyframe ? 0 : x;
+    patch.y = keyframe ? 0 : y;
+    patch.width = keyframe ? 10 : size;
+    patch.height = patch.width;
+    patch.encoding = nav2_msgs::msg::CostmapPatch::ENCODING_RAW;
+    patch.data.assign(patch.width * patch.height, value);
+    update->patches.push_back(patch);
+    costmapUpdateCallback(update);
+  }
+
+  /**
+   * @brief Apply a whole 10x10 costmap of a single value from the full costmap topic
+   */
+  void setCostmap(unsigned char value)
+  {
+    auto msg = std::make_shared<nav2_msgs::msg::Costmap>();
+    msg->metadata = makeMetaData();
+    msg->data.assign(100, value);
+    costmapCallback(msg);
+  }
+
+  const unsigned char * gridData() const
+  {
+    return grid_->getCharMap();
+  }
+
+  const nav2_costmap_2d::Costmap2D * lastCopy() const
+  {
+    return costmap_.get();
+  }
+
+  bool subscribedToFullCostmap() const
+  {
+    return static_cast<bool>(full_costmap_sub_);
+  }
+
+private:
+  static nav2_msgs::msg::CostmapMetaData makeMetaData()
+  {
+    nav2_msgs::msg::CostmapMetaData metadata;
+    metadata.size_x = 10;
+    metadata.size_y = 10;
+    metadata.resolution = 0.5;
+    return metadata;
+  }
+};
+
+/**
+ * While a reader holds an old version, patches go to the grid in place and the grid is only
+ * copied once a newer version is asked for
+ */
+TEST(CostmapSubscriber, patchesInPlace)
+{
+  auto node = std::make_shared<rclcpp::Node>("costmap_subscriber_test");
+  TestCostmapSubscriber subscriber(node);
+  EXPECT_THROW(subscriber.getCostmap(), std::runtime_error);
+
+  subscriber.update(1, true, 0, 0, 0, 0);
+  uint64_t version;
+  std::shared_ptr<const nav2_costmap_2d::Costmap2D> reader = subscriber.getCostmap(version);
+  EXPECT_EQ(version, 1u);
+  EXPECT_EQ(subscriber.lastCopy(), reader.get());
+
+  const unsigned char * grid_data = subscriber.gridData();
+  for (uint32_t sequence = 2; sequence <= 6; ++sequence) {
+    subscriber.update(sequence, false, sequence, 3, 2, 100 + sequence);
+    EXPECT_EQ(subscriber.gridData(), grid_data);
+    EXPECT_EQ(subscriber.lastCopy(), reader.get());
+  }
+  EXPECT_EQ(subscriber.getVersion(), 6u);
+  EXPECT_EQ(reader->getCost(6, 4), 0);
+
+  // one copy for the new version, shared by every caller
+  std::shared_ptr<const nav2_costmap_2d::Costmap2D> latest = subscriber.getCostmap(version);
+  EXPECT_EQ(version, 6u);
+  EXPECT_NE(latest, reader);
+  EXPECT_EQ(subscriber.getCostmap(), latest);
+  EXPECT_EQ(latest->getCost(2, 3), 102);
+  EXPECT_EQ(latest->getCost(6, 4), 106);
+  EXPECT_EQ(latest->getCost(7, 4), 106);
+  EXPECT_EQ(latest->getCost(8, 4), 0);
+
+  // without readers, the next copy reuses the last one
+  const nav2_costmap_2d::Costmap2D * recycled = latest.get();
+  reader.reset();
+  latest.reset();
+  subscriber.update(7, false, 0, 0, 1, 7);
+  latest = subscriber.getCostmap();
+  EXPECT_EQ(latest.get(), recycled);
+  EXPECT_EQ(latest->getCost(0, 0), 7);
+}
+
+/**
+ * Whole costmaps are applied as keyframes until the update stream works
+ */
+TEST(CostmapSubscriber, fallsBackToFullCostmap)
+{
+  auto node = std::make_shared<rclcpp::Node>("costmap_subscriber_test");
+  TestCostmapSubscriber subscriber(node);
+  EXPECT_TRUE(subscriber.subscribedToFullCostmap());
+
+  subscriber.setCostmap(20);
+  EXPECT_EQ(subscriber.getVersion(), 1u);
+  EXPECT_EQ(subscriber.getCostmap()->getCost(9, 9), 20);
+
+  // the update stream starts again from a keyframe
+  subscriber.update(1, false, 0, 0, 1, 30);
+  EXPECT_EQ(subscriber.getVersion(), 1u);
+  EXPECT_TRUE(subscriber.subscribedToFullCostmap());
+
+  subscriber.update(2, true, 0, 0, 0, 40);
+  EXPECT_EQ(subscriber.getVersion(), 2u);
+  EXPECT_EQ(subscriber.getCostmap()->getCost(9, 9), 40);
+  EXPECT_FALSE(subscriber.subscribedToFullCostmap());
+}
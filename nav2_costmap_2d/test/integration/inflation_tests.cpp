@@ -36,6 +36,7 @@
 #include <cmath>
 #include <map>
 #include <memory>
+#include <random>
 #include <string>
 #include <vector>
 
@@ -75,7 +76,7 @@ public:
     nav2_costmap_2d::InflationLayer * ilayer,
     double inflation_radius);
 
-  void initNode(double inflation_radius);
+  void initNode(double inflation_radius, const std::string & inflation_algorithm = "wavefront");
 
   void waitForMap(nav2_costmap_2d::StaticLayer * slayer);
 
@@ -169,12 +170,13 @@ void TestNode::validatePointInflation(
   delete[] seen;
 }
 
-void TestNode::initNode(double inflation_radius)
+void TestNode::initNode(double inflation_radius, const std::string & inflation_algorithm)
 {
   std::vector<rclcpp::Parameter> parameters;
   // Set cost_scaling_factor parameter to 1.0 for inflation layer
   parameters.push_back(rclcpp::Parameter("inflation.cost_scaling_factor", 1.0));
   parameters.push_back(rclcpp::Parameter("inflation.inflation_radius", inflation_radius));
+  parameters.push_back(rclcpp::Parameter("inflation.inflation_algorithm", inflation_algorithm));
 
   auto options = rclcpp::NodeOptions();
   options.parameter_overrides(parameters);
@@ -490,3 +492,116 @@ TEST_F(TestNode, testInflation3)
   ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 1u);
   ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE), 4u);
 }
+
+/**
+ * Test that the incremental inflation gives the same costs as the wavefront
+ */
+TEST_F(TestNode, testIncrementalInflation)
+{
+  initNode(3, "incremental");
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+
+  std::vector<Point> polygon = setRadii(layers, 1, 1.75);
+
+  nav2_costmap_2d::ObstacleLayer * olayer = addObstacleLayer(layers, tf, node_);
+  nav2_costmap_2d::InflationLayer * ilayer = addInflationLayer(layers, tf, node_);
+  layers.setFootprint(polygon);
+
+  nav2_costmap_2d::Costmap2D * costmap = layers.getCostmap();
+  addObservation(olayer, 5, 5, MAX_Z);
+  layers.updateMap(0, 0, 0);
+
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::FREE_SPACE, false), 29u);
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 1u);
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE), 4u);
+  validatePointInflation(5, 5, costmap, ilayer, 3);
+
+  // An update without new obstacles leaves the field as it is
+  layers.updateMap(0, 0, 0);
+
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::FREE_SPACE, false), 29u);
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 1u);
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE), 4u);
+}
+
+/**
+ * Test that the incremental inflation gives the costs of the wavefront on many obstacles,
+ * where cells are often as far from several of them, as obstacles come and go
+ */
+TEST_F(TestNode, testIncrementalInflationMatchesWavefront)
+{
+  initNode(6, "wavefront");
+  nav2_util::LifecycleNode::SharedPtr wavefront_node = node_;
+  initNode(6, "incremental");
+  tf2_ros::Buffer tf(node_->get_clock());
+
+  nav2_costmap_2d::LayeredCostmap wavefront_layers("frame", false, false);
+  wavefront_layers.resizeMap(60, 60, 1, 0, 0);
+  nav2_costmap_2d::ObstacleLayer * wavefront_olayer =
+    addObstacleLayer(wavefront_layers, tf, wavefront_node);
+  addInflationLayer(wavefront_layers, tf, wavefront_node);
+  std::vector<Point> polygon = setRadii(wavefront_layers, 1, 1.75);
+
+  nav2_costmap_2d::LayeredCostmap incremental_layers("frame", false, false);
+  incremental_layers.resizeMap(60, 60, 1, 0, 0);
+  nav2_costmap_2d::ObstacleLayer * incremental_olayer =
+    addObstacleLayer(incremental_layers, tf, node_);
+  addInflationLayer(incremental_layers, tf, node_);
+  setRadii(incremental_layers, 1, 1.75);
+
+  nav2_costmap_2d::Costmap2D * wavefront = wavefront_layers.getCostmap();
+  nav2_costmap_2d::Costmap2D * incremental = incremental_layers.getCostmap();
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<int> cell(0, 59);
+  for (int round = 0; round < 20; ++round) {
+    // the rays from the origin also clear some of the obstacles of earlier rounds
+    for (int i = 0; i < 20; ++i) {
+      double x = cell(rng) + 0.5, y = cell(rng) + 0.5;
+      addObservation(wavefront_olayer, x, y, MAX_Z);
+      addObservation(incremental_olayer, x, y, MAX_Z);
+    }
+    // the wavefront of a window depends on the obstacles around it, so compare with
+    // a wavefront over the whole grid, which setting the footprint again triggers
+    wavefront_layers.setFootprint(polygon);
+    wavefront_layers.updateMap(0, 0, 0);
+    incremental_layers.updateMap(0, 0, 0);
+    wavefront_olayer->clearStaticObservations(true, true);
+    incremental_olayer->clearStaticObservations(true, true);
+
+    for (unsigned int j = 0; j < wavefront->getSizeInCellsY(); ++j) {
+      for (unsigned int i = 0; i < wavefront->getSizeInCellsX(); ++i) {
+        ASSERT_EQ(wavefront->getCost(i, j), incremental->getCost(i, j)) <<
+          "round " << round << ", cell " << i << ", " << j;
+      }
+    }
+  }
+  ASSERT_GT(countValues(*wavefront, nav2_costmap_2d::LETHAL_OBSTACLE), 20u);
+}
+
+/**
+ * Test the distance transform inflation on a single obstacle
+ */
+TEST_F(TestNode, testDistanceTransformInflation)
+{
+  initNode(3, "distance_transform");
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+
+  std::vector<Point> polygon = setRadii(layers, 1, 1.75);
+
+  nav2_costmap_2d::ObstacleLayer * olayer = addObstacleLayer(layers, tf, node_);
+  nav2_costmap_2d::InflationLayer * ilayer = addInflationLayer(layers, tf, node_);
+  layers.setFootprint(polygon);
+
+  nav2_costmap_2d::Costmap2D * costmap = layers.getCostmap();
+  addObservation(olayer, 5, 5, MAX_Z);
+  layers.updateMap(0, 0, 0);
+
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::FREE_SPACE, false), 29u);
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 1u);
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE), 4u);
+  validatePointInflation(5, 5, costmap, ilayer, 3);
+}
@@ -0,0 +1,195 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/observation_buffer.hpp"
+#include "nav2_util/lifecycle_node.hpp"
+#include "sensor_msgs/point_cloud2_iterator.hpp"
+#include "tf2/LinearMath/Quaternion.h"
+
+using nav2_costmap_2d::Observation;
+using nav2_costmap_2d::ObservationBuffer;
+
+class RclCppFixture
+{
+public:
+  RclCppFixture() {rclcpp::init(0, nullptr);}
+  ~RclCppFixture() {rclcpp::shutdown();}
+};
+RclCppFixture g_rclcppfixture;
+
+builtin_interfaces::msg::Time makeStamp(double seconds)
+{
+  return rclcpp::Time(static_cast<int64_t>(seconds * 1e9));
+}
+
+void setTransform(
+  tf2_ros::Buffer & tf, const std::string & parent, const std::string & child, double seconds,
+  double x, double y, double z, double yaw, bool is_static)
+{
+  geometry_msgs::msg::TransformStamped transform;
+  transform.header.frame_id = parent;
+  transform.header.stamp = makeStamp(seconds);
+  transform.child_frame_id = child;
+  transform.transform.translation.x = x;
+  transform.transform.translation.y = y;
+  transform.transform.translation.z = z;
+  tf2::Quaternion rotation;
+  rotation.setRPY(0.0, 0.0, yaw);
+  transform.transform.rotation = tf2::toMsg(rotation);
+  tf.setTransform(transform, "observation_buffer_tests", is_static);
+}
+
+/**
+ * A cloud of the single point (1, 0, 0) in the frame of the sensor
+ */
+sensor_msgs::msg::PointCloud2 makeCloud(const std::string & frame, double seconds)
+{
+  sensor_msgs::msg::PointCloud2 cloud;
+  cloud.header.frame_id = frame;
+  cloud.header.stamp = makeStamp(seconds);
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2FieldsByString(1, "xyz");
+  modifier.resize(1);
+  sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+  sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+  sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+  *iter_x = 1.0;
+  *iter_y = 0.0;
+  *iter_z = 0.0;
+  return cloud;
+}
+
+/**
+ * Buffer a cloud of the sensor at a time, and check its observation against a direct
+ * lookup of the transform from the sensor to the global frame
+ */
+void expectDirectTransform(ObservationBuffer & buffer, tf2_ros::Buffer & tf, double seconds)
+{
+  buffer.bufferCloud(makeCloud("laser", seconds));
+  std::vector<Observation> observations;
+  buffer.getObservations(observations);
+  ASSERT_EQ(observations.size(), 1u) << seconds;
+
+  tf2::Transform direct;
+  tf2::fromMsg(
+    tf.lookupTransform("odom", "laser", tf2_ros::fromMsg(makeStamp(seconds))).transform, direct);
+  const Observation & observation = observations[0];
+  EXPECT_NEAR(observation.origin_.x, direct.getOrigin().x(), 1e-9) << seconds;
+  EXPECT_NEAR(observation.origin_.y, direct.getOrigin().y(), 1e-9) << seconds;
+  EXPECT_NEAR(observation.origin_.z, direct.getOrigin().z(), 1e-9) << seconds;
+
+  // the points are stored as floats
+  tf2::Vector3 point = direct * tf2::Vector3(1.0, 0.0, 0.0);
+  ASSERT_EQ(observation.cloud_->width * observation.cloud_->height, 1u) << seconds;
+  sensor_msgs::PointCloud2ConstIterator<float> iter_x(*observation.cloud_, "x");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_y(*observation.cloud_, "y");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_z(*observation.cloud_, "z");
+  EXPECT_NEAR(*iter_x, point.x(), 1e-5) << seconds;
+  EXPECT_NEAR(*iter_y, point.y(), 1e-5) << seconds;
+  EXPECT_NEAR(*iter_z, point.z(), 1e-5) << seconds;
+}
+
+/**
+ * The cached static transform of a sensor composed with the moving rest of the tree
+ * matches a direct lookup, and picks up a static transform republished with a new value
+ */
+TEST(ObservationBuffer, testStaticChain)
+{
+  auto node = std::make_shared<nav2_util::LifecycleNode>("observation_buffer_test_node");
+  tf2_ros::Buffer tf(node->get_clock());
+  setTransform(tf, "base_link", "laser", 0.0, 0.2, 0.1, 0.3, 0.5, true);
+  for (int i = 0; i <= 6; ++i) {
+    double seconds = 10.0 + 0.5 * i;
+    setTransform(
+      tf, "odom", "base_link", seconds, seconds, 0.5 * seconds, 0.0, 0.1 * seconds, false);
+  }
+
+  ObservationBuffer buffer(
+    node, "cloud", 0.0, 0.0, -10.0, 10.0, 10.0, 10.0, tf, "odom", "", 0.3);
+  buffer.setRobotBaseFrame("base_link");
+  for (double seconds : {10.0, 10.25, 10.5, 11.0, 11.75, 12.0}) {
+    expectDirectTransform(buffer, tf, seconds);
+  }
+
+  // a second of data after the last cloud, the static transform is walked again
+  setTransform(tf, "base_link", "laser", 0.0, -0.4, 0.3, 0.1, -1.0, true);
+  for (double seconds : {13.0, 12.5}) {
+    expectDirectTransform(buffer, tf, seconds);
+  }
+}
+
+/**
+ * Copies of an observation share its cloud instead of copying the points
+ */
+TEST(ObservationBuffer, testCopiesShareCloud)
+{
+  auto node = std::make_shared<nav2_util::LifecycleNode>("observation_buffer_test_node");
+  tf2_ros::Buffer tf(node->get_clock());
+  setTransform(tf, "map", "odom", 0.0, 1.0, 0.0, 0.0, 0.0, true);
+
+  geometry_msgs::msg::Point origin;
+  Observation observation(origin, makeCloud("odom", 10.0), 1.0, 2.0);
+  Observation copy = observation;
+  EXPECT_EQ(copy.cloud_, observation.cloud_);
+
+  ObservationBuffer buffer(
+    node, "cloud", 0.0, 0.0, -10.0, 10.0, 10.0, 10.0, tf, "odom", "", 0.3);
+  buffer.bufferCloud(makeCloud("odom", 10.0));
+  std::vector<Observation> observations;
+  buffer.getObservations(observations);
+  buffer.getObservations(observations);
+  ASSERT_EQ(observations.size(), 2u);
+  EXPECT_EQ(observations[0].cloud_, observations[1].cloud_);
+}
+
+/**
+ * Changing the global frame transforms the buffered observations into new clouds,
+ * leaving those of the copies already handed out as they were
+ */
+TEST(ObservationBuffer, testSetGlobalFrameKeepsCopies)
+{
+  auto node = std::make_shared<nav2_util::LifecycleNode>("observation_buffer_test_node");
+  tf2_ros::Buffer tf(node->get_clock());
+  setTransform(tf, "map", "odom", 0.0, 1.0, 0.0, 0.0, 0.0, true);
+
+  ObservationBuffer buffer(
+    node, "cloud", 0.0, 0.0, -10.0, 10.0, 10.0, 10.0, tf, "odom", "", 0.3);
+  buffer.bufferCloud(makeCloud("odom", 10.0));
+  std::vector<Observation> old_observations;
+  buffer.getObservations(old_observations);
+  ASSERT_EQ(old_observations.size(), 1u);
+  Observation::CloudConstPtr old_cloud = old_observations[0].cloud_;
+  std::vector<uint8_t> old_data = old_cloud->data;
+
+  ASSERT_TRUE(buffer.setGlobalFrame("map"));
+  std::vector<Observation> observations;
+  buffer.getObservations(observations);
+  ASSERT_EQ(observations.size(), 1u);
+  EXPECT_NE(observations[0].cloud_, old_cloud);
+  EXPECT_EQ(observations[0].cloud_->header.frame_id, "map");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_x(*observations[0].cloud_, "x");
+  EXPECT_NEAR(*iter_x, 2.0, 1e-5);
+  EXPECT_NEAR(observations[0].origin_.x, 1.0, 1e-9);
+
+  // the copy handed out before still sees the cloud in the old frame
+  EXPECT_EQ(old_observations[0].cloud_, old_cloud);
+  EXPECT_EQ(old_cloud->data, old_data);
+  EXPECT_EQ(old_cloud->header.frame_id, "odom");
+  EXPECT_NEAR(old_observations[0].origin_.x, 0.0, 1e-9);
+}
@@ -32,10 +32,12 @@
  * Test harness for ObstacleLayer for Costmap2D
  */
 
+#include <cmath>
 #include <memory>
 #include <string>
 #include <algorithm>
 #include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "nav2_costmap_2d/costmap_2d.hpp"
@@ -122,6 +124,41 @@ protected:
   std::shared_ptr<TestLifecycleNode> node_;
 };
 
+/**
+ * An observation of points at half height, from a sensor at (ox, oy) at the same height
+ */
+nav2_costmap_2d::Observation makeObservation(
+  const std::vector<pair<double, double>> & points, double ox, double oy,
+  nav2_costmap_2d::Observation::RaytraceMode raytrace_mode =
+  nav2_costmap_2d::Observation::RAYTRACE_ALL,
+  double raytrace_angular_resolution = 0.0)
+{
+  sensor_msgs::msg::PointCloud2 cloud;
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2FieldsByString(1, "xyz");
+  modifier.resize(points.size());
+  sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+  sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+  sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+  for (const auto & point : points) {
+    *iter_x = point.first;
+    *iter_y = point.second;
+    *iter_z = MAX_Z / 2;
+    ++iter_x;
+    ++iter_y;
+    ++iter_z;
+  }
+
+  geometry_msgs::msg::Point origin;
+  origin.x = ox;
+  origin.y = oy;
+  origin.z = MAX_Z / 2;
+  nav2_costmap_2d::Observation obs(origin, cloud, 100.0, 100.0);
+  obs.raytrace_mode_ = raytrace_mode;
+  obs.raytrace_angular_resolution_ = raytrace_angular_resolution;
+  return obs;
+}
+
 /*
  * For reference, the static map looks like this:
  *
@@ -367,3 +404,237 @@ TEST_F(TestNode, testRepeatedResets) {
         plugin->reset();
       }));
 }
+
+/**
+ * Verify that updates that don't change the obstacle layer keep the master grid as it is
+ */
+TEST_F(TestNode, testUnchangedUpdates) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+
+  nav2_costmap_2d::ObstacleLayer * olayer = addObstacleLayer(layers, tf, node_);
+
+  addObservation(olayer, 5.0, 5.0);
+  layers.updateMap(0, 0, 0);
+  ASSERT_FALSE(layers.isUnchanged());
+  nav2_costmap_2d::Costmap2D * costmap = layers.getCostmap();
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 1);
+
+  // the point is cleared by its own ray and marked again, which isn't a change
+  layers.updateMap(0, 0, 0);
+  ASSERT_TRUE(layers.isUnchanged());
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 1);
+
+  addObservation(olayer, 7.0, 2.0);
+  layers.updateMap(0, 0, 0);
+  ASSERT_FALSE(layers.isUnchanged());
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 2);
+
+  layers.invalidate();
+  layers.updateMap(0, 0, 0);
+  ASSERT_FALSE(layers.isUnchanged());
+}
+
+/**
+ * Verify that tracing one ray per endpoint cell clears the same cells as tracing every point
+ */
+TEST_F(TestNode, testUniqueRaytracing) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap all_layers("frame", false, false);
+  nav2_costmap_2d::LayeredCostmap unique_layers("frame", false, false);
+  all_layers.resizeMap(50, 50, 0.1, 0, 0);
+  unique_layers.resizeMap(50, 50, 0.1, 0, 0);
+  nav2_costmap_2d::ObstacleLayer * all_layer = addObstacleLayer(all_layers, tf, node_);
+  nav2_costmap_2d::ObstacleLayer * unique_layer = addObstacleLayer(unique_layers, tf, node_);
+
+  // an obstacle in every cell
+  std::vector<pair<double, double>> cells;
+  for (unsigned int y = 0; y < 50; ++y) {
+    for (unsigned int x = 0; x < 50; ++x) {
+      cells.emplace_back(0.1 * x + 0.05, 0.1 * y + 0.05);
+    }
+  }
+  // a dense cloud, with many points in each of the endpoint cells
+  std::vector<pair<double, double>> points;
+  for (int i = 0; i < 5000; ++i) {
+    double angle = 0.002 * i, range = 0.8 + 1.5 * std::fabs(std::sin(0.37 * i));
+    points.emplace_back(2.53 + range * std::cos(angle), 2.47 + range * std::sin(angle));
+  }
+
+  nav2_costmap_2d::Observation marking = makeObservation(cells, 2.53, 2.47);
+  all_layer->addStaticObservation(marking, true, false);
+  unique_layer->addStaticObservation(marking, true, false);
+  all_layers.updateMap(0, 0, 0);
+  unique_layers.updateMap(0, 0, 0);
+
+  all_layer->clearStaticObservations(true, false);
+  unique_layer->clearStaticObservations(true, false);
+  nav2_costmap_2d::Observation all = makeObservation(points, 2.53, 2.47);
+  nav2_costmap_2d::Observation unique =
+    makeObservation(points, 2.53, 2.47, nav2_costmap_2d::Observation::RAYTRACE_UNIQUE);
+  all_layer->addStaticObservation(all, false, true);
+  unique_layer->addStaticObservation(unique, false, true);
+  all_layers.updateMap(0, 0, 0);
+  unique_layers.updateMap(0, 0, 0);
+
+  nav2_costmap_2d::Costmap2D * all_costmap = all_layers.getCostmap();
+  nav2_costmap_2d::Costmap2D * unique_costmap = unique_layers.getCostmap();
+  ASSERT_LT(countValues(*all_costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 2000u);
+  for (unsigned int y = 0; y < 50; ++y) {
+    for (unsigned int x = 0; x < 50; ++x) {
+      ASSERT_EQ(all_costmap->getCost(x, y), unique_costmap->getCost(x, y)) << x << ", " << y;
+    }
+  }
+}
+
+/**
+ * Verify that angular bins trace one ray, to the farthest point of each bin
+ */
+TEST_F(TestNode, testAngularRaytracing) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(100, 100, 0.1, 0, 0);
+  nav2_costmap_2d::ObstacleLayer * olayer = addObstacleLayer(layers, tf, node_);
+
+  // in the same 0.5 radian bin, seen from (1.05, 5.05): the farthest point at 8 m straight
+  // ahead, a nearer one in front of it, and one off to the side
+  const double ox = 1.05, oy = 5.05;
+  std::vector<pair<double, double>> points{
+    {ox + 8.0, oy}, {ox + 3.0, oy}, {ox + 5.0 * std::cos(0.3), oy + 5.0 * std::sin(0.3)}};
+
+  // obstacles at the nearer point, and on the way to the one off to the side
+  std::vector<pair<double, double>> obstacles{
+    {ox + 3.0, oy}, {ox + 3.0 * std::cos(0.3), oy + 3.0 * std::sin(0.3)}};
+  nav2_costmap_2d::Observation marking = makeObservation(obstacles, ox, oy);
+  olayer->addStaticObservation(marking, true, false);
+  layers.updateMap(0, 0, 0);
+  nav2_costmap_2d::Costmap2D * costmap = layers.getCostmap();
+  unsigned int near_x, near_y, side_x, side_y;
+  ASSERT_TRUE(costmap->worldToMap(obstacles[0].first, obstacles[0].second, near_x, near_y));
+  ASSERT_TRUE(costmap->worldToMap(obstacles[1].first, obstacles[1].second, side_x, side_y));
+  ASSERT_EQ(costmap->getCost(near_x, near_y), nav2_costmap_2d::LETHAL_OBSTACLE);
+  ASSERT_EQ(costmap->getCost(side_x, side_y), nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  // the ray to the farthest point clears the nearer one, the ray off to the side isn't traced
+  olayer->clearStaticObservations(true, false);
+  nav2_costmap_2d::Observation binned =
+    makeObservation(points, ox, oy, nav2_costmap_2d::Observation::RAYTRACE_ANGULAR_BINS, 0.5);
+  olayer->addStaticObservation(binned, false, true);
+  layers.updateMap(0, 0, 0);
+  ASSERT_EQ(costmap->getCost(near_x, near_y), nav2_costmap_2d::FREE_SPACE);
+  ASSERT_EQ(costmap->getCost(side_x, side_y), nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  // tracing every point clears both
+  olayer->clearStaticObservations(false, true);
+  nav2_costmap_2d::Observation all = makeObservation(points, ox, oy);
+  olayer->addStaticObservation(all, false, true);
+  layers.updateMap(0, 0, 0);
+  ASSERT_EQ(costmap->getCost(side_x, side_y), nav2_costmap_2d::FREE_SPACE);
+  ASSERT_EQ(countValues(*costmap, nav2_costmap_2d::LETHAL_OBSTACLE), 0);
+}
+
+/**
+ * Verify that raytracing on the update threads clears the same cells, reports the same
+ * regions and the same changes as raytracing on the calling thread
+ */
+TEST_F(TestNode, testParallelRaytracing) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap serial_layers("frame", false, false);
+  nav2_costmap_2d::LayeredCostmap parallel_layers("frame", false, false);
+  serial_layers.resizeMap(100, 100, 0.1, 0, 0);
+  parallel_layers.resizeMap(100, 100, 0.1, 0, 0);
+  serial_layers.setUpdateThreads(1);
+  parallel_layers.setUpdateThreads(4);
+  nav2_costmap_2d::ObstacleLayer * serial_layer = addObstacleLayer(serial_layers, tf, node_);
+  nav2_costmap_2d::ObstacleLayer * parallel_layer = addObstacleLayer(parallel_layers, tf, node_);
+
+  // obstacles in a fifth of the cells
+  std::vector<pair<double, double>> obstacles;
+  for (unsigned int y = 0; y < 100; ++y) {
+    for (unsigned int x = 0; x < 100; ++x) {
+      if ((7 * x + 3 * y) % 5 == 0) {
+        obstacles.emplace_back(0.1 * x + 0.05, 0.1 * y + 0.05);
+      }
+    }
+  }
+  nav2_costmap_2d::Observation marking = makeObservation(obstacles, 5.05, 5.05);
+
+  // far more rays than are worth sharing, in each mode, some leaving the map,
+  // and a narrow fan whose box has to be grown to its sensor
+  auto fan = [](double ox, double oy, int count, double arc, double scale, double frequency) {
+      std::vector<pair<double, double>> points;
+      for (int i = 0; i < count; ++i) {
+        double angle = 0.3 + arc * i / count;
+        double range = 0.5 + scale * std::fabs(std::sin(frequency * i));
+        points.emplace_back(ox + range * std::cos(angle), oy + range * std::sin(angle));
+      }
+      return points;
+    };
+  std::vector<nav2_costmap_2d::Observation> clearing{
+    makeObservation(fan(1.03, 1.97, 3000, 2 * M_PI, 1.5, 0.37), 1.03, 1.97),
+    makeObservation(
+      fan(8.51, 8.49, 2000, 2 * M_PI, 1.2, 0.53), 8.51, 8.49,
+      nav2_costmap_2d::Observation::RAYTRACE_UNIQUE),
+    makeObservation(
+      fan(7.52, 1.48, 1500, 0.8, 2.0, 0.71), 7.52, 1.48,
+      nav2_costmap_2d::Observation::RAYTRACE_ANGULAR_BINS, 0.05)};
+
+  auto update = [&]() {
+      serial_layers.updateMap(0, 0, 0);
+      parallel_layers.updateMap(0, 0, 0);
+
+      ASSERT_EQ(serial_layer->hasChanged(), parallel_layer->hasChanged());
+      const auto & serial_rects = serial_layers.getUpdatedCells().getRectangles();
+      const auto & parallel_rects = parallel_layers.getUpdatedCells().getRectangles();
+      ASSERT_EQ(serial_rects.size(), parallel_rects.size());
+      for (size_t i = 0; i < serial_rects.size(); ++i) {
+        ASSERT_EQ(serial_rects[i].min_x, parallel_rects[i].min_x);
+        ASSERT_EQ(serial_rects[i].min_y, parallel_rects[i].min_y);
+        ASSERT_EQ(serial_rects[i].max_x, parallel_rects[i].max_x);
+        ASSERT_EQ(serial_rects[i].max_y, parallel_rects[i].max_y);
+      }
+      nav2_costmap_2d::Costmap2D * serial_costmap = serial_layers.getCostmap();
+      nav2_costmap_2d::Costmap2D * parallel_costmap = parallel_layers.getCostmap();
+      for (unsigned int y = 0; y < 100; ++y) {
+        for (unsigned int x = 0; x < 100; ++x) {
+          ASSERT_EQ(serial_layer->getCost(x, y), parallel_layer->getCost(x, y)) << x << ", " << y;
+          ASSERT_EQ(serial_costmap->getCost(x, y), parallel_costmap->getCost(x, y)) <<
+            x << ", " << y;
+        }
+      }
+    };
+
+  for (nav2_costmap_2d::ObstacleLayer * olayer : {serial_layer, parallel_layer}) {
+    olayer->addStaticObservation(marking, true, false);
+  }
+  update();
+  ASSERT_EQ(
+    countValues(*serial_layers.getCostmap(), nav2_costmap_2d::LETHAL_OBSTACLE), obstacles.size());
+
+  // the rays clear part of the obstacles
+  for (nav2_costmap_2d::ObstacleLayer * olayer : {serial_layer, parallel_layer}) {
+    olayer->clearStaticObservations(true, false);
+    for (auto & obs : clearing) {
+      olayer->addStaticObservation(obs, false, true);
+    }
+  }
+  update();
+  ASSERT_TRUE(parallel_layer->hasChanged());
+  ASSERT_LT(
+    countValues(*serial_layers.getCostmap(), nav2_costmap_2d::LETHAL_OBSTACLE), obstacles.size());
+  update();
+  ASSERT_FALSE(parallel_layer->hasChanged());
+
+  // cells cleared and marked again in the same update are a change once, then not anymore
+  for (nav2_costmap_2d::ObstacleLayer * olayer : {serial_layer, parallel_layer}) {
+    olayer->addStaticObservation(marking, true, false);
+  }
+  update();
+  ASSERT_TRUE(parallel_layer->hasChanged());
+  ASSERT_EQ(
+    countValues(*serial_layers.getCostmap(), nav2_costmap_2d::LETHAL_OBSTACLE), obstacles.size());
+  update();
+  ASSERT_FALSE(parallel_layer->hasChanged());
+  ASSERT_TRUE(parallel_layers.isUnchanged());
+}
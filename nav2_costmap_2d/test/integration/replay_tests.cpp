@@ -0,0 +1,133 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/costmap_replay.hpp"
+#include "nav2_costmap_2d/layered_costmap.hpp"
+#include "nav2_costmap_2d/sensor_log.hpp"
+#include "nav2_costmap_2d/testing_helper.hpp"
+#include "rcl_interfaces/srv/list_parameters.hpp"
+
+using geometry_msgs::msg::Point;
+
+class RclCppFixture
+{
+public:
+  RclCppFixture() {rclcpp::init(0, nullptr);}
+  ~RclCppFixture() {rclcpp::shutdown();}
+};
+RclCppFixture g_rclcppfixture;
+
+const char log_path[] = "replay_tests.log";
+
+std::vector<Point> makeFootprint(double radius)
+{
+  std::vector<Point> polygon(4);
+  polygon[0].x = radius;
+  polygon[0].y = radius;
+  polygon[1].x = radius;
+  polygon[1].y = -radius;
+  polygon[2].x = -radius;
+  polygon[2].y = -radius;
+  polygon[3].x = -radius;
+  polygon[3].y = radius;
+  return polygon;
+}
+
+/**
+ * Record the updates of an obstacle and an inflation layer, then replay them
+ * through the layers loaded from the log, which must give the same costs
+ */
+TEST(CostmapReplay, testRecordedChecksums)
+{
+  std::vector<rclcpp::Parameter> overrides;
+  overrides.push_back(rclcpp::Parameter("inflation.cost_scaling_factor", 1.0));
+  overrides.push_back(rclcpp::Parameter("inflation.inflation_radius", 3.0));
+  auto options = rclcpp::NodeOptions();
+  options.parameter_overrides(overrides);
+  auto node = std::make_shared<nav2_util::LifecycleNode>("replay_test_node", "", false, options);
+  node->declare_parameter("track_unknown_space", rclcpp::ParameterValue(false));
+  node->declare_parameter("transform_tolerance", rclcpp::ParameterValue(0.3));
+  node->declare_parameter("observation_sources", rclcpp::ParameterValue(std::string("")));
+
+  tf2_ros::Buffer tf(node->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(20, 20, 0.5, 0.0, 0.0);
+  nav2_costmap_2d::ObstacleLayer * olayer = addObstacleLayer(layers, tf, node);
+  addInflationLayer(layers, tf, node);
+  layers.setFootprint(makeFootprint(0.5));
+
+  // the parameters of the costmap, as Costmap2DROS records them
+  std::vector<rclcpp::Parameter> parameters = node->get_parameters(
+    node->list_parameters(
+      {}, rcl_interfaces::srv::ListParameters::Request::DEPTH_RECURSIVE).names);
+  parameters.emplace_back("global_frame", std::string("frame"));
+  parameters.emplace_back("rolling_window", false);
+  parameters.emplace_back("width", 10);
+  parameters.emplace_back("height", 10);
+  parameters.emplace_back("resolution", 0.5);
+  parameters.emplace_back(
+    "plugin_names", std::vector<std::string>{"obstacles", "inflation"});
+  parameters.emplace_back(
+    "plugin_types",
+    std::vector<std::string>{"nav2_costmap_2d::ObstacleLayer", "nav2_costmap_2d::InflationLayer"});
+
+  std::vector<uint64_t> checksums;
+  {
+    nav2_costmap_2d::SensorLogWriter writer(log_path, parameters);
+    layers.setSensorLog(&writer);
+    auto update = [&](int64_t stamp) {
+        writer.beginCycle(stamp, 0.0, 0.0, 0.0, layers.getFootprint(), *layers.getCostmap());
+        layers.updateMap(0.0, 0.0, 0.0);
+        writer.endCycle();
+        checksums.push_back(nav2_costmap_2d::getCostmapChecksum(*layers.getCostmap()));
+      };
+
+    addObservation(olayer, 5.0, 5.0, MAX_Z / 2, 0.0, 0.0, MAX_Z / 2);
+    update(100);
+
+    // kept from the last update, along with two new observations that clear across it
+    addObservation(olayer, 2.0, 7.0, MAX_Z / 2, 0.0, 0.0, MAX_Z / 2);
+    addObservation(olayer, 8.0, 2.0, MAX_Z / 2, 9.0, 9.0, MAX_Z / 2);
+    update(200);
+
+    // a larger robot, and observations that clear the first obstacle
+    layers.setFootprint(makeFootprint(1.0));
+    olayer->clearStaticObservations(true, true);
+    addObservation(olayer, 4.0, 4.0, MAX_Z / 2, 9.0, 9.0, MAX_Z / 2);
+    update(300);
+
+    olayer->clearStaticObservations(true, true);
+    update(400);
+    layers.setSensorLog(nullptr);
+  }
+  EXPECT_NE(checksums[0], checksums[1]);
+  EXPECT_NE(checksums[1], checksums[2]);
+
+  nav2_costmap_2d::CostmapReplay replay(log_path);
+  nav2_costmap_2d::CostmapReplay::Result result;
+  for (size_t i = 0; i < checksums.size(); ++i) {
+    ASSERT_TRUE(replay.replayCycle(result)) << i;
+    EXPECT_EQ(result.stamp, static_cast<int64_t>(100 * (i + 1)));
+    EXPECT_EQ(result.checksum, checksums[i]) << i;
+  }
+  EXPECT_FALSE(replay.replayCycle(result));
+  std::remove(log_path);
+}
@@ -0,0 +1,234 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/costmap_2d_ros.hpp"
+#include "nav2_costmap_2d/costmap_snapshot.hpp"
+#include "nav2_costmap_2d/layered_costmap.hpp"
+#include "nav2_costmap_2d/testing_helper.hpp"
+
+using nav2_costmap_2d::Costmap2D;
+using nav2_costmap_2d::CostmapSnapshot;
+
+class RclCppFixture
+{
+public:
+  RclCppFixture() {rclcpp::init(0, nullptr);}
+  ~RclCppFixture() {rclcpp::shutdown();}
+};
+RclCppFixture g_rclcppfixture;
+
+const char snapshot_path[] = "snapshot_tests.costmap";
+
+class TestLifecycleNode : public nav2_util::LifecycleNode
+{
+public:
+  explicit TestLifecycleNode(const std::string & name)
+  : nav2_util::LifecycleNode(name)
+  {
+  }
+
+  nav2_util::CallbackReturn on_configure(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn on_activate(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn on_deactivate(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn on_cleanup(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn onShutdown(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn onError(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+};
+
+class TestNode : public ::testing::Test
+{
+public:
+  TestNode()
+  {
+    node_ = std::make_shared<TestLifecycleNode>("snapshot_test_node");
+    node_->declare_parameter("map_topic", rclcpp::ParameterValue(std::string("map")));
+    node_->declare_parameter("track_unknown_space", rclcpp::ParameterValue(false));
+    node_->declare_parameter("use_maximum", rclcpp::ParameterValue(false));
+    node_->declare_parameter("lethal_cost_threshold", rclcpp::ParameterValue(100));
+    node_->declare_parameter(
+      "unknown_cost_value",
+      rclcpp::ParameterValue(static_cast<unsigned char>(0xff)));
+    node_->declare_parameter("trinary_costmap", rclcpp::ParameterValue(true));
+  }
+
+  ~TestNode()
+  {
+    std::remove(snapshot_path);
+  }
+
+protected:
+  /**
+   * @brief A 20x10 map at (1, 2) with a lethal cell at (3, 4), saved in the given frame
+   */
+  static void writeMap(const std::string & file_name, const std::string & frame)
+  {
+    Costmap2D map(20, 10, 0.1, 1.0, 2.0);
+    map.setCost(3, 4, nav2_costmap_2d::LETHAL_OBSTACLE);
+    CostmapSnapshot::write(file_name, map, "static", frame);
+  }
+
+  std::shared_ptr<TestLifecycleNode> node_;
+};
+
+/**
+ * A static costmap takes the size of the restored map, as it does that of a received one
+ */
+TEST_F(TestNode, testStaticLayerResizes) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("map", false, false);
+  nav2_costmap_2d::StaticLayer * slayer = addStaticLayer(layers, tf, node_);
+  writeMap(snapshot_path, "map");
+
+  ASSERT_TRUE(slayer->loadSnapshot(snapshot_path, "static"));
+  EXPECT_TRUE(slayer->isCurrent());
+  Costmap2D * master = layers.getCostmap();
+  ASSERT_EQ(master->getSizeInCellsX(), 20u);
+  ASSERT_EQ(master->getSizeInCellsY(), 10u);
+  EXPECT_DOUBLE_EQ(master->getOriginX(), 1.0);
+  EXPECT_DOUBLE_EQ(master->getOriginY(), 2.0);
+
+  layers.updateMap(0, 0, 0);
+  EXPECT_EQ(master->getCost(3, 4), nav2_costmap_2d::LETHAL_OBSTACLE);
+  EXPECT_EQ(countValues(*master, nav2_costmap_2d::LETHAL_OBSTACLE), 1u);
+
+  // the restored map is saved back in its own frame
+  ASSERT_TRUE(slayer->saveSnapshot(snapshot_path, "static"));
+  EXPECT_EQ(CostmapSnapshot(snapshot_path).getFrame(), "map");
+}
+
+/**
+ * A rolling window transforms the restored map from its frame, like a received one
+ */
+TEST_F(TestNode, testStaticLayerRolling) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("map", true, false);
+  layers.resizeMap(40, 40, 0.1, 0.0, 0.0);
+  nav2_costmap_2d::StaticLayer * slayer = addStaticLayer(layers, tf, node_);
+  writeMap(snapshot_path, "map");
+
+  ASSERT_TRUE(slayer->loadSnapshot(snapshot_path, "static"));
+  // the rolling window keeps its own size
+  Costmap2D * master = layers.getCostmap();
+  ASSERT_EQ(master->getSizeInCellsX(), 40u);
+
+  // centered on (2, 2), the window spans (0, 0) to (4, 4)
+  layers.updateMap(2.0, 2.0, 0);
+  unsigned int mx, my;
+  ASSERT_TRUE(master->worldToMap(1.35, 2.45, mx, my));
+  EXPECT_EQ(master->getCost(mx, my), nav2_costmap_2d::LETHAL_OBSTACLE);
+  EXPECT_EQ(countValues(*master, nav2_costmap_2d::LETHAL_OBSTACLE), 1u);
+}
+
+/**
+ * A map of unknown frame is not restored at all
+ */
+TEST_F(TestNode, testStaticLayerNeedsFrame) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("map", false, false);
+  layers.resizeMap(5, 5, 0.1, 0.0, 0.0);
+  nav2_costmap_2d::StaticLayer * slayer = addStaticLayer(layers, tf, node_);
+
+  writeMap(snapshot_path, "");
+  EXPECT_FALSE(slayer->loadSnapshot(snapshot_path, "static"));
+  EXPECT_EQ(layers.getCostmap()->getSizeInCellsX(), 5u);
+
+  writeMap(snapshot_path, "map");
+  EXPECT_FALSE(slayer->loadSnapshot(snapshot_path, "obstacles"));
+  EXPECT_EQ(layers.getCostmap()->getSizeInCellsX(), 5u);
+}
+
+/**
+ * The master costmap is only restored in the frame it was saved in
+ */
+TEST_F(TestNode, testLayeredCostmapFrame) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("map", false, false);
+  layers.resizeMap(5, 5, 0.1, 0.0, 0.0);
+  addStaticLayer(layers, tf, node_);
+
+  writeMap(snapshot_path, "odom");
+  EXPECT_FALSE(layers.loadSnapshot(snapshot_path, ""));
+  EXPECT_EQ(layers.getCostmap()->getSizeInCellsX(), 5u);
+
+  writeMap(snapshot_path, "map");
+  ASSERT_TRUE(layers.loadSnapshot(snapshot_path, ""));
+  EXPECT_EQ(layers.getCostmap()->getSizeInCellsX(), 20u);
+  EXPECT_EQ(layers.getCostmap()->getCost(3, 4), nav2_costmap_2d::LETHAL_OBSTACLE);
+
+  ASSERT_TRUE(layers.saveSnapshot(snapshot_path, ""));
+  EXPECT_EQ(CostmapSnapshot(snapshot_path).getFrame(), "map");
+}
+
+/**
+ * Costmap2DROS restores the static layer of a rolling window from the snapshot directory
+ */
+TEST(Costmap2DROS, restoresStaticLayer) {
+  auto costmap_ros = std::make_shared<nav2_costmap_2d::Costmap2DROS>("snapshot_costmap");
+  costmap_ros->set_parameter(
+    rclcpp::Parameter("plugin_names", std::vector<std::string>{"static_layer"}));
+  costmap_ros->set_parameter(
+    rclcpp::Parameter(
+      "plugin_types", std::vector<std::string>{"nav2_costmap_2d::StaticLayer"}));
+  costmap_ros->set_parameter(rclcpp::Parameter("rolling_window", true));
+  costmap_ros->set_parameter(rclcpp::Parameter("global_frame", std::string("map")));
+  costmap_ros->set_parameter(rclcpp::Parameter("snapshot_directory", std::string(".")));
+
+  std::string file_name = "./snapshot_costmap.static_layer.costmap";
+  Costmap2D map(20, 10, 0.1, 1.0, 2.0);
+  map.setCost(3, 4, nav2_costmap_2d::LETHAL_OBSTACLE);
+  CostmapSnapshot::write(file_name, map, "static_layer", "map");
+
+  costmap_ros->on_configure(costmap_ros->get_current_state());
+  nav2_costmap_2d::LayeredCostmap * layers = costmap_ros->getLayeredCostmap();
+  layers->updateMap(2.0, 2.0, 0);
+
+  Costmap2D * master = layers->getCostmap();
+  unsigned int mx, my;
+  ASSERT_TRUE(master->worldToMap(1.35, 2.45, mx, my));
+  EXPECT_EQ(master->getCost(mx, my), nav2_costmap_2d::LETHAL_OBSTACLE);
+  EXPECT_EQ(countValues(*master, nav2_costmap_2d::LETHAL_OBSTACLE), 1u);
+
+  costmap_ros->on_cleanup(costmap_ros->get_current_state());
+  std::remove(file_name.c_str());
+}
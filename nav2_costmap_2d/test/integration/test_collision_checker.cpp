@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstring>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <memory>
@@ -59,11 +61,44 @@ public:
   : CostmapSubscriber(node, topic_name)
   {}
 
+  // Sends the whole costmap as a keyframe
   void setCostmap(nav2_msgs::msg::Costmap::SharedPtr msg)
   {
-    costmap_msg_ = msg;
-    costmap_received_ = true;
+    auto update = std::make_shared<nav2_msgs::msg::CostmapUpdate>();
+    update->header = msg->header;
+    update->sequence = ++published_sequence_;
+    update->keyframe = true;
+    update->metadata = msg->metadata;
+    nav2_msgs::msg::CostmapPatch patch;
+    patch.width = msg->metadata.size_x;
+    patch.height = msg->metadata.size_y;
+    patch.encoding = nav2_msgs::msg::CostmapPatch::ENCODING_RAW;
+    patch.data = msg->data;
+    update->patches.push_back(patch);
+    costmapUpdateCallback(update);
   }
+
+  // Sends a run-length encoded update setting one cell
+  void setCost(
+    const nav2_msgs::msg::CostmapMetaData & metadata,
+    unsigned int x, unsigned int y, unsigned char cost, uint64_t sequence)
+  {
+    auto update = std::make_shared<nav2_msgs::msg::CostmapUpdate>();
+    update->sequence = sequence;
+    update->keyframe = false;
+    update->metadata = metadata;
+    nav2_msgs::msg::CostmapPatch patch;
+    patch.x = x;
+    patch.y = y;
+    patch.width = 1;
+    patch.height = 1;
+    patch.encoding = nav2_msgs::msg::CostmapPatch::ENCODING_RUN_LENGTH;
+    patch.data = {1, cost};
+    update->patches.push_back(patch);
+    costmapUpdateCallback(update);
+  }
+
+  uint64_t published_sequence_{0};
 };
 
 class DummyFootprintSubscriber : public nav2_costmap_2d::FootprintSubscriber
@@ -184,6 +219,61 @@ public:
     return collision_checker_->isCollisionFree(pose);
   }
 
+  // Publishes the costmap twice and checks the subscriber only hands out a new one
+  // once the second message arrives
+  void testCostmapVersions()
+  {
+    EXPECT_THROW(costmap_sub_->getCostmap(), std::runtime_error);
+    EXPECT_EQ(costmap_sub_->getVersion(), 0u);
+
+    publishCostmap();
+    uint64_t version;
+    auto costmap = costmap_sub_->getCostmap(version);
+    EXPECT_EQ(version, 1u);
+    EXPECT_FALSE(costmap_sub_->hasChangedSince(version));
+    EXPECT_EQ(costmap, costmap_sub_->getCostmap());
+    EXPECT_EQ(
+      memcmp(
+        costmap->getCharMap(), layers_->getCostmap()->getCharMap(),
+        costmap->getSizeInCellsX() * costmap->getSizeInCellsY()), 0);
+
+    publishCostmap();
+    EXPECT_TRUE(costmap_sub_->hasChangedSince(version));
+    EXPECT_NE(costmap, costmap_sub_->getCostmap(version));
+    EXPECT_EQ(version, 2u);
+  }
+
+  // Applies single cell updates, then loses one and checks nothing is applied
+  // until the next keyframe
+  void testCostmapUpdates()
+  {
+    publishCostmap();
+    nav2_msgs::msg::Costmap msg = toCostmapMsg(layers_->getCostmap());
+    uint64_t sequence = costmap_sub_->published_sequence_;
+
+    costmap_sub_->setCost(msg.metadata, 3, 2, 42, sequence + 1);
+    uint64_t version;
+    auto costmap = costmap_sub_->getCostmap(version);
+    EXPECT_EQ(costmap->getCost(3, 2), 42);
+
+    // the costmap held above must not change
+    costmap_sub_->setCost(msg.metadata, 3, 2, 43, sequence + 2);
+    EXPECT_EQ(costmap->getCost(3, 2), 42);
+    EXPECT_EQ(costmap_sub_->getCostmap()->getCost(3, 2), 43);
+    EXPECT_TRUE(costmap_sub_->hasChangedSince(version));
+    costmap_sub_->getCostmap(version);
+
+    costmap_sub_->setCost(msg.metadata, 4, 2, 44, sequence + 4);
+    costmap_sub_->setCost(msg.metadata, 5, 2, 45, sequence + 5);
+    EXPECT_FALSE(costmap_sub_->hasChangedSince(version));
+    EXPECT_EQ(costmap_sub_->getCostmap()->getCost(4, 2), msg.data[2 * msg.metadata.size_x + 4]);
+
+    costmap_sub_->published_sequence_ = sequence + 5;
+    publishCostmap();
+    EXPECT_TRUE(costmap_sub_->hasChangedSince(version));
+    EXPECT_EQ(costmap_sub_->getCostmap()->getCost(3, 2), msg.data[2 * msg.metadata.size_x + 3]);
+  }
+
   void setFootprint(double footprint_padding, double robot_radius)
   {
     std::vector<geometry_msgs::msg::Point> new_footprint;
@@ -336,3 +426,13 @@ TEST_F(TestNode, CollisionSpace)
   // Partially in obstacle
   ASSERT_EQ(collision_checker_->testPose(4.5, 4.5, 0), false);
 }
+
+TEST_F(TestNode, CostmapVersions)
+{
+  collision_checker_->testCostmapVersions();
+}
+
+TEST_F(TestNode, CostmapUpdates)
+{
+  collision_checker_->testCostmapUpdates();
+}
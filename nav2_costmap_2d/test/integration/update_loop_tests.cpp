@@ -0,0 +1,248 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_2d_ros.hpp"
+#include "nav2_costmap_2d/layer.hpp"
+#include "nav2_costmap_2d/layered_costmap.hpp"
+
+class RclCppFixture
+{
+public:
+  RclCppFixture() {rclcpp::init(0, nullptr);}
+  ~RclCppFixture() {rclcpp::shutdown();}
+};
+RclCppFixture g_rclcppfixture;
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * A layer that records the times it is updated at. Like the layers buffering observations,
+ * it is only current while it received data in the last 0.3 s.
+ */
+class UpdateRecorder : public nav2_costmap_2d::Layer
+{
+public:
+  virtual void reset() {}
+
+  virtual void updateBounds(
+    double, double, double, double *, double *, double *, double *)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Clock::time_point now = Clock::now();
+    updates_.push_back(now);
+    current_ = now - last_data_ < data_timeout_;
+    updated_.notify_all();
+
+    // an update can be held, for data to arrive during it
+    updated_.wait(lock, [this] {return !held_;});
+  }
+
+  virtual void updateCosts(nav2_costmap_2d::Costmap2D &, int, int, int, int) {}
+
+  /** @brief Receive data, waking the update thread as the layers do */
+  void receiveData()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      last_data_ = Clock::now();
+    }
+    layered_costmap_->notifyNewData();
+  }
+
+  /** @brief Make the updates from now on wait until released */
+  void hold(bool held)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      held_ = held;
+    }
+    updated_.notify_all();
+  }
+
+  /** @brief Wait until the layer was updated count times, false after the timeout */
+  bool waitForUpdates(size_t count, std::chrono::milliseconds timeout)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return updated_.wait_for(lock, timeout, [&] {return updates_.size() >= count;});
+  }
+
+  std::vector<Clock::time_point> getUpdates()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return updates_;
+  }
+
+private:
+  const std::chrono::milliseconds data_timeout_{300};
+  std::mutex mutex_;
+  std::condition_variable updated_;
+  std::vector<Clock::time_point> updates_;
+  Clock::time_point last_data_;
+  bool held_{false};
+};
+
+class UpdateLoopTest : public ::testing::Test
+{
+protected:
+  /**
+   * @brief Configure a costmap updated when its layers receive data, add the recorder to it
+   *        and activate it, with data waiting so the first update doesn't wait for the period
+   * @param update_frequency The frequency of the updates without data
+   */
+  void activate(double update_frequency)
+  {
+    costmap_ros_ = std::make_shared<nav2_costmap_2d::Costmap2DROS>("update_loop_costmap");
+    costmap_ros_->set_parameter(
+      rclcpp::Parameter("plugin_names", std::vector<std::string>{"inflation_layer"}));
+    costmap_ros_->set_parameter(
+      rclcpp::Parameter(
+        "plugin_types", std::vector<std::string>{"nav2_costmap_2d::InflationLayer"}));
+    costmap_ros_->set_parameter(rclcpp::Parameter("global_frame", std::string("odom")));
+    costmap_ros_->set_parameter(rclcpp::Parameter("event_driven_updates", true));
+    costmap_ros_->set_parameter(rclcpp::Parameter("update_frequency", update_frequency));
+    costmap_ros_->set_parameter(rclcpp::Parameter("min_update_period", min_update_period_));
+    costmap_ros_->on_configure(costmap_ros_->get_current_state());
+
+    geometry_msgs::msg::TransformStamped transform;
+    transform.header.frame_id = "odom";
+    transform.child_frame_id = "base_link";
+    transform.transform.rotation.w = 1.0;
+    costmap_ros_->getTfBuffer()->setTransform(transform, "update_loop_tests", true);
+
+    recorder_ = std::make_shared<UpdateRecorder>();
+    recorder_->initialize(
+      costmap_ros_->getLayeredCostmap(), "update_recorder", costmap_ros_->getTfBuffer().get(),
+      costmap_ros_, nullptr, nullptr);
+    costmap_ros_->getLayeredCostmap()->addPlugin(recorder_);
+
+    recorder_->receiveData();
+    costmap_ros_->on_activate(costmap_ros_->get_current_state());
+    active_ = true;
+  }
+
+  void deactivate()
+  {
+    costmap_ros_->on_deactivate(costmap_ros_->get_current_state());
+    active_ = false;
+  }
+
+  void TearDown() override
+  {
+    if (!costmap_ros_) {
+      return;
+    }
+    if (active_) {
+      recorder_->hold(false);
+      deactivate();
+    }
+    costmap_ros_->on_cleanup(costmap_ros_->get_current_state());
+  }
+
+  const double min_update_period_ = 0.2;
+  // the time updates may come late by on a loaded machine
+  const std::chrono::milliseconds slack_{20};
+
+  std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros_;
+  std::shared_ptr<UpdateRecorder> recorder_;
+  bool active_{false};
+};
+
+/**
+ * Data received while an update runs triggers the next update, which doesn't wait
+ * for the period of the updates without data
+ */
+TEST_F(UpdateLoopTest, testDataDuringUpdate) {
+  activate(0.2);
+  ASSERT_TRUE(recorder_->waitForUpdates(1, std::chrono::milliseconds(1000)));
+
+  recorder_->hold(true);
+  recorder_->receiveData();
+  ASSERT_TRUE(recorder_->waitForUpdates(2, std::chrono::milliseconds(1000)));
+  recorder_->receiveData();
+  recorder_->hold(false);
+
+  EXPECT_TRUE(recorder_->waitForUpdates(3, std::chrono::milliseconds(1000)));
+  std::vector<Clock::time_point> updates = recorder_->getUpdates();
+  ASSERT_GE(updates.size(), 3u);
+  EXPECT_GE(
+    updates[2] - updates[1],
+    std::chrono::duration<double>(min_update_period_) - slack_);
+}
+
+/**
+ * Updates triggered by a stream of data are at least min_update_period apart
+ */
+TEST_F(UpdateLoopTest, testMinUpdatePeriod) {
+  activate(0.2);
+  ASSERT_TRUE(recorder_->waitForUpdates(1, std::chrono::milliseconds(1000)));
+
+  Clock::time_point end = Clock::now() + std::chrono::milliseconds(1000);
+  while (Clock::now() < end) {
+    recorder_->receiveData();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  // without data, the period alone would have allowed no update at all
+  std::vector<Clock::time_point> updates = recorder_->getUpdates();
+  EXPECT_GE(updates.size(), 4u);
+  for (size_t i = 1; i < updates.size(); ++i) {
+    EXPECT_GE(
+      updates[i] - updates[i - 1],
+      std::chrono::duration<double>(min_update_period_) - slack_) << i;
+  }
+}
+
+/**
+ * Without data, the costmap is still updated once per period, so that layers whose data
+ * stopped are no longer current
+ */
+TEST_F(UpdateLoopTest, testUpdateWithoutData) {
+  activate(2.0);
+  ASSERT_TRUE(recorder_->waitForUpdates(1, std::chrono::milliseconds(1000)));
+  EXPECT_TRUE(costmap_ros_->isCurrent());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1300));
+  std::vector<Clock::time_point> updates = recorder_->getUpdates();
+  EXPECT_GE(updates.size(), 3u);
+  EXPECT_FALSE(costmap_ros_->isCurrent());
+
+  size_t count = updates.size();
+  recorder_->receiveData();
+  ASSERT_TRUE(recorder_->waitForUpdates(count + 1, std::chrono::milliseconds(1000)));
+  EXPECT_TRUE(costmap_ros_->isCurrent());
+}
+
+/**
+ * Deactivating the costmap wakes the update thread waiting for data
+ */
+TEST_F(UpdateLoopTest, testDeactivateWakes) {
+  activate(0.1);
+  ASSERT_TRUE(recorder_->waitForUpdates(1, std::chrono::milliseconds(1000)));
+
+  // the thread is now waiting for data, or for ten seconds
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  Clock::time_point start = Clock::now();
+  deactivate();
+  EXPECT_LT(Clock::now() - start, std::chrono::milliseconds(2000));
+  EXPECT_EQ(recorder_->getUpdates().size(), 1u);
+}
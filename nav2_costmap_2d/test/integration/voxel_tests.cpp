@@ -0,0 +1,262 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/layered_costmap.hpp"
+#include "nav2_costmap_2d/testing_helper.hpp"
+#include "nav2_costmap_2d/voxel_layer.hpp"
+#include "sensor_msgs/point_cloud2_iterator.hpp"
+
+using nav2_costmap_2d::LETHAL_OBSTACLE;
+using nav2_costmap_2d::FREE_SPACE;
+
+class RclCppFixture
+{
+public:
+  RclCppFixture() {rclcpp::init(0, nullptr);}
+  ~RclCppFixture() {rclcpp::shutdown();}
+};
+RclCppFixture g_rclcppfixture;
+
+class TestLifecycleNode : public nav2_util::LifecycleNode
+{
+public:
+  explicit TestLifecycleNode(const std::string & name)
+  : nav2_util::LifecycleNode(name)
+  {
+  }
+
+  nav2_util::CallbackReturn on_configure(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn on_activate(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn on_deactivate(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn on_cleanup(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn onShutdown(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+
+  nav2_util::CallbackReturn onError(const rclcpp_lifecycle::State &)
+  {
+    return nav2_util::CallbackReturn::SUCCESS;
+  }
+};
+
+/**
+ * A voxel layer whose columns can be compared
+ */
+class TestVoxelLayer : public nav2_costmap_2d::VoxelLayer
+{
+public:
+  using nav2_costmap_2d::VoxelLayer::getColumn;
+};
+
+class TestNode : public ::testing::Test
+{
+public:
+  TestNode()
+  {
+    node_ = std::make_shared<TestLifecycleNode>("voxel_test_node");
+    node_->declare_parameter("track_unknown_space", rclcpp::ParameterValue(false));
+    node_->declare_parameter("transform_tolerance", rclcpp::ParameterValue(0.3));
+    node_->declare_parameter("observation_sources", rclcpp::ParameterValue(std::string("")));
+    node_->declare_parameter("toroidal_rolling_window", rclcpp::ParameterValue(false));
+  }
+
+  ~TestNode() {}
+
+protected:
+  /**
+   * @brief Add a voxel layer of the given name, which publishes its voxels
+   */
+  TestVoxelLayer * addVoxelLayer(
+    nav2_costmap_2d::LayeredCostmap & layers, tf2_ros::Buffer & tf, const std::string & name)
+  {
+    node_->declare_parameter(name + ".publish_voxel_map", rclcpp::ParameterValue(true));
+    TestVoxelLayer * vlayer = new TestVoxelLayer();
+    vlayer->initialize(&layers, name, &tf, node_, nullptr, nullptr);
+    layers.addPlugin(std::shared_ptr<nav2_costmap_2d::Layer>(vlayer));
+    return vlayer;
+  }
+
+  /**
+   * @brief An observation of the points that marks and clears up to 3 m from the origin
+   */
+  nav2_costmap_2d::Observation makeObservation(
+    geometry_msgs::msg::Point origin, const std::vector<geometry_msgs::msg::Point> & points)
+  {
+    sensor_msgs::msg::PointCloud2 cloud;
+    sensor_msgs::PointCloud2Modifier modifier(cloud);
+    modifier.setPointCloud2FieldsByString(1, "xyz");
+    modifier.resize(points.size());
+    sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+    sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+    sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+    for (const auto & point : points) {
+      *iter_x = point.x;
+      *iter_y = point.y;
+      *iter_z = point.z;
+      ++iter_x;
+      ++iter_y;
+      ++iter_z;
+    }
+    return nav2_costmap_2d::Observation(origin, cloud, 3.0, 3.0);
+  }
+
+  /**
+   * @brief Feed the same random observations to a dense and a sparse voxel layer, checking
+   *        after each update that their columns, their costs and the master grids match
+   */
+  void compareBackends(bool rolling)
+  {
+    node_->set_parameter(rclcpp::Parameter("track_unknown_space", true));
+    node_->declare_parameter("dense.unknown_threshold", rclcpp::ParameterValue(9));
+    node_->declare_parameter("sparse.unknown_threshold", rclcpp::ParameterValue(9));
+    node_->declare_parameter("sparse.voxel_backend", rclcpp::ParameterValue(std::string("sparse")));
+
+    tf2_ros::Buffer tf(node_->get_clock());
+    nav2_costmap_2d::LayeredCostmap dense_layers("frame", rolling, true);
+    nav2_costmap_2d::LayeredCostmap sparse_layers("frame", rolling, true);
+    dense_layers.resizeMap(40, 40, 0.1, -2.0, -2.0);
+    sparse_layers.resizeMap(40, 40, 0.1, -2.0, -2.0);
+    TestVoxelLayer * dense = addVoxelLayer(dense_layers, tf, "dense");
+    TestVoxelLayer * sparse = addVoxelLayer(sparse_layers, tf, "sparse");
+    ASSERT_EQ(dense->isToroidal(), sparse->isToroidal());
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> step(-0.3, 0.3), offset(-1.8, 1.8), height(0.0, 1.9);
+    geometry_msgs::msg::Point origin;
+    origin.z = 0.5;
+    for (int round = 0; round < 40; ++round) {
+      if (rolling) {
+        origin.x += step(rng);
+        origin.y += step(rng);
+      }
+      std::vector<geometry_msgs::msg::Point> points(50);
+      for (auto & point : points) {
+        point.x = origin.x + offset(rng);
+        point.y = origin.y + offset(rng);
+        point.z = height(rng);
+      }
+      nav2_costmap_2d::Observation obs = makeObservation(origin, points);
+      for (TestVoxelLayer * vlayer : {dense, sparse}) {
+        vlayer->clearStaticObservations(true, true);
+        // some rounds only clear
+        vlayer->addStaticObservation(obs, round % 3 != 2, true);
+      }
+      dense_layers.updateMap(origin.x, origin.y, 0);
+      sparse_layers.updateMap(origin.x, origin.y, 0);
+
+      ASSERT_EQ(dense->getOriginX(), sparse->getOriginX());
+      ASSERT_EQ(dense->getOriginY(), sparse->getOriginY());
+      EXPECT_EQ(dense->hasChanged(), sparse->hasChanged()) << "round " << round;
+      nav2_costmap_2d::Costmap2D * dense_costmap = dense_layers.getCostmap();
+      nav2_costmap_2d::Costmap2D * sparse_costmap = sparse_layers.getCostmap();
+      for (unsigned int y = 0; y < 40; ++y) {
+        for (unsigned int x = 0; x < 40; ++x) {
+          ASSERT_EQ(dense->getColumn(x, y), sparse->getColumn(x, y)) <<
+            "cell " << x << ", " << y << " in round " << round;
+          ASSERT_EQ(dense->getCost(x, y), sparse->getCost(x, y)) <<
+            "cell " << x << ", " << y << " in round " << round;
+          ASSERT_EQ(dense_costmap->getCost(x, y), sparse_costmap->getCost(x, y)) <<
+            "cell " << x << ", " << y << " in round " << round;
+        }
+      }
+    }
+  }
+
+  std::shared_ptr<TestLifecycleNode> node_;
+};
+
+/**
+ * The dense voxel layer only reports a change when a cell ends up with a new cost,
+ * so observations that hit the same obstacles again leave the master grid idle
+ */
+TEST_F(TestNode, testDenseChanges) {
+  tf2_ros::Buffer tf(node_->get_clock());
+  nav2_costmap_2d::LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+  nav2_costmap_2d::VoxelLayer * vlayer = addVoxelLayer(layers, tf, "voxels");
+  nav2_costmap_2d::Costmap2D * costmap = layers.getCostmap();
+
+  addObservation(vlayer, 5.0, 5.0, MAX_Z / 2, 0.0, 0.0, MAX_Z / 2);
+  layers.updateMap(0, 0, 0);
+  EXPECT_TRUE(vlayer->hasChanged());
+  EXPECT_EQ(costmap->getCost(5, 5), LETHAL_OBSTACLE);
+
+  layers.updateMap(0, 0, 0);
+  EXPECT_FALSE(vlayer->hasChanged());
+  EXPECT_TRUE(layers.isUnchanged());
+  EXPECT_EQ(costmap->getCost(5, 5), LETHAL_OBSTACLE);
+
+  // a new obstacle
+  addObservation(vlayer, 7.0, 3.0, MAX_Z / 2, 0.0, 0.0, MAX_Z / 2);
+  layers.updateMap(0, 0, 0);
+  EXPECT_TRUE(vlayer->hasChanged());
+  EXPECT_EQ(costmap->getCost(7, 3), LETHAL_OBSTACLE);
+
+  // a ray clearing the first obstacle
+  vlayer->clearStaticObservations(true, true);
+  addObservation(vlayer, 9.0, 9.0, MAX_Z / 2, 0.0, 0.0, MAX_Z / 2);
+  layers.updateMap(0, 0, 0);
+  EXPECT_TRUE(vlayer->hasChanged());
+  EXPECT_EQ(costmap->getCost(5, 5), FREE_SPACE);
+  EXPECT_EQ(costmap->getCost(9, 9), LETHAL_OBSTACLE);
+
+  layers.updateMap(0, 0, 0);
+  EXPECT_FALSE(vlayer->hasChanged());
+}
+
+/**
+ * The sparse backend marks, clears and projects the same voxels as the dense one
+ */
+TEST_F(TestNode, testSparseMatchesDense) {
+  compareBackends(false);
+}
+
+/**
+ * The sparse grid keeps the same voxels as the dense one when the window rolls
+ */
+TEST_F(TestNode, testSparseMatchesDenseRolling) {
+  compareBackends(true);
+}
+
+/**
+ * The sparse grid keeps the same voxels as the toroidal dense one when the window rolls
+ */
+TEST_F(TestNode, testSparseMatchesDenseToroidal) {
+  node_->set_parameter(rclcpp::Parameter("toroidal_rolling_window", true));
+  compareBackends(true);
+}
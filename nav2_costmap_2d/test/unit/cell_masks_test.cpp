@@ -0,0 +1,144 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cell_masks.hpp"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+
+using nav2_costmap_2d::CellMasks;
+using nav2_costmap_2d::Costmap2D;
+using nav2_costmap_2d::ThreadPool;
+
+namespace
+{
+
+// raytraceLine() is protected
+class RaytracingCostmap : public Costmap2D
+{
+public:
+  using Costmap2D::Costmap2D;
+  using Costmap2D::raytraceLine;
+};
+
+struct Line
+{
+  unsigned int x0, y0, x1, y1;
+};
+
+class SetValue
+{
+public:
+  explicit SetValue(std::vector<unsigned char> & grid)
+  : grid_(grid) {}
+  void operator()(unsigned int offset)
+  {
+    grid_[offset] = 0;
+  }
+
+private:
+  std::vector<unsigned char> & grid_;
+};
+
+}  // namespace
+
+TEST(CellMasks, parallel_raytraces_match_serial_ones)
+{
+  RaytracingCostmap costmap(300, 200, 0.05, 0.0, 0.0);
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<unsigned int> x(0, 299), y(0, 199);
+  std::vector<Line> lines;
+  for (int i = 0; i < 2000; ++i) {
+    lines.push_back(Line{x(rng), y(rng), x(rng), y(rng)});
+  }
+
+  std::vector<unsigned char> expected(300 * 200, 100);
+  for (const Line & line : lines) {
+    costmap.raytraceLine(SetValue(expected), line.x0, line.y0, line.x1, line.y1, 80);
+  }
+
+  ThreadPool pool(4);
+  CellMasks masks;
+  masks.resize(pool.size(), expected.size());
+  ASSERT_EQ(masks.size(), 4u);
+  pool.parallelFor(
+    masks.size(), [&](unsigned int mask) {
+      for (size_t i = mask; i < lines.size(); i += masks.size()) {
+        const Line & line = lines[i];
+        costmap.raytraceLine(masks.setCell(mask), line.x0, line.y0, line.x1, line.y1, 80);
+      }
+    });
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(masks.isSet(i), expected[i] == 0) << i;
+  }
+
+  std::vector<unsigned char> actual(300 * 200, 100);
+  masks.apply(actual.data(), 0, &pool);
+  EXPECT_EQ(actual, expected);
+
+  // applying clears the masks
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_FALSE(masks.isSet(i));
+  }
+}
+
+TEST(CellMasks, resize_clears_on_change)
+{
+  CellMasks masks;
+  masks.resize(2, 100);
+  masks.setCell(1)(99);
+  masks.resize(2, 100);
+  EXPECT_TRUE(masks.isSet(99));
+  masks.resize(3, 100);
+  EXPECT_TRUE(masks.isSet(99));
+  EXPECT_EQ(masks.size(), 3u);
+  masks.resize(3, 120);
+  EXPECT_FALSE(masks.isSet(99));
+
+  // without a pool, and a size that isn't a multiple of the words
+  masks.setCell(2)(119);
+  masks.setCell(0)(0);
+  std::vector<unsigned char> grid(120, 7);
+  masks.apply(grid.data(), 1, nullptr);
+  EXPECT_EQ(grid[0], 1);
+  EXPECT_EQ(grid[119], 1);
+  EXPECT_EQ(grid[60], 7);
+}
+
+TEST(CellMasks, apply_reports_overwritten_cells)
+{
+  ThreadPool pool(4);
+  CellMasks masks;
+  // enough cells to be applied in several tasks
+  masks.resize(pool.size(), 1 << 20);
+  std::vector<unsigned char> grid(1 << 20, 5);
+  grid[3] = 0;
+  grid[(1 << 20) - 1] = 9;
+  masks.setCell(0)(3);
+  masks.setCell(1)(4);
+  masks.setCell(3)(4);
+  masks.setCell(2)((1 << 20) - 1);
+
+  std::vector<std::pair<size_t, unsigned char>> overwritten;
+  masks.apply(grid.data(), 0, &pool, &overwritten);
+  std::sort(overwritten.begin(), overwritten.end());
+  std::vector<std::pair<size_t, unsigned char>> expected{{4, 5}, {(1 << 20) - 1, 9}};
+  EXPECT_EQ(overwritten, expected);
+  EXPECT_EQ(grid[4], 0);
+  EXPECT_EQ(grid[(1 << 20) - 1], 0);
+}
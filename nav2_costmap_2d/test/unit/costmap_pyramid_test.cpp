@@ -0,0 +1,190 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/costmap_pyramid.hpp"
+
+using nav2_costmap_2d::Costmap2D;
+using nav2_costmap_2d::CostmapPyramid;
+
+namespace
+{
+
+// raytraceLine() is protected
+class RaytracingCostmap : public Costmap2D
+{
+public:
+  using Costmap2D::Costmap2D;
+  using Costmap2D::raytraceLine;
+};
+
+class MaxCost
+{
+public:
+  MaxCost(const Costmap2D & costmap, unsigned char & max_cost)
+  : costmap_(costmap), max_cost_(max_cost) {}
+  void operator()(unsigned int offset)
+  {
+    max_cost_ = std::max(max_cost_, costmap_.getCharMap()[offset]);
+  }
+
+private:
+  const Costmap2D & costmap_;
+  unsigned char & max_cost_;
+};
+
+// a few obstacles in free space, and some unknown space
+void fillCostmap(Costmap2D & costmap, std::mt19937 & rng)
+{
+  std::uniform_int_distribution<unsigned int> x(0, costmap.getSizeInCellsX() - 1);
+  std::uniform_int_distribution<unsigned int> y(0, costmap.getSizeInCellsY() - 1);
+  std::uniform_int_distribution<int> cost(1, 252);
+  costmap.resetMap(0, 0, costmap.getSizeInCellsX(), costmap.getSizeInCellsY());
+  for (int i = 0; i < 200; ++i) {
+    costmap.setCost(x(rng), y(rng), cost(rng));
+  }
+  for (int i = 0; i < 20; ++i) {
+    costmap.setCost(x(rng), y(rng), nav2_costmap_2d::LETHAL_OBSTACLE);
+  }
+  costmap.setCost(x(rng), y(rng), nav2_costmap_2d::NO_INFORMATION);
+}
+
+unsigned char bruteForceMax(
+  const Costmap2D & costmap, unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn)
+{
+  unsigned char max_cost = 0;
+  for (unsigned int y = y0; y < yn; ++y) {
+    for (unsigned int x = x0; x < xn; ++x) {
+      max_cost = std::max(max_cost, costmap.getCost(x, y));
+    }
+  }
+  return max_cost;
+}
+
+// compare random regions and lines against scanning the costmap
+void expectQueriesMatch(RaytracingCostmap & costmap, const CostmapPyramid & pyramid, int seed)
+{
+  std::mt19937 rng(seed);
+  unsigned int size_x = costmap.getSizeInCellsX(), size_y = costmap.getSizeInCellsY();
+  std::uniform_int_distribution<unsigned int> x(0, size_x - 1), y(0, size_y - 1);
+  const unsigned char costs[] = {1, 100, nav2_costmap_2d::LETHAL_OBSTACLE,
+    nav2_costmap_2d::NO_INFORMATION};
+
+  for (int i = 0; i < 500; ++i) {
+    unsigned int x0 = x(rng), xn = x(rng), y0 = y(rng), yn = y(rng);
+    if (x0 > xn) {
+      std::swap(x0, xn);
+    }
+    if (y0 > yn) {
+      std::swap(y0, yn);
+    }
+    // small regions as well as large ones
+    if (i % 2) {
+      xn = std::min(x0 + xn % 8, size_x);
+      yn = std::min(y0 + yn % 8, size_y);
+    }
+    unsigned char expected = bruteForceMax(costmap, x0, y0, xn, yn);
+    ASSERT_EQ(pyramid.getMaxCost(x0, y0, xn, yn), expected);
+    for (unsigned char cost : costs) {
+      ASSERT_EQ(pyramid.hasCostInRegion(x0, y0, xn, yn, cost), expected >= cost);
+    }
+
+    unsigned int x1 = x(rng), y1 = y(rng);
+    unsigned char line_max = 0;
+    costmap.raytraceLine(MaxCost(costmap, line_max), x0, y0, x1, y1);
+    for (unsigned char cost : costs) {
+      ASSERT_EQ(pyramid.hasCostOnLine(x0, y0, x1, y1, cost), line_max >= cost) <<
+        x0 << " " << y0 << " " << x1 << " " << y1;
+    }
+  }
+}
+
+}  // namespace
+
+TEST(CostmapPyramid, queries_match_the_costmap)
+{
+  // sizes that aren't multiples of the blocks
+  RaytracingCostmap costmap(203, 150, 0.05, 0.0, 0.0);
+  std::mt19937 rng(1);
+  fillCostmap(costmap, rng);
+
+  CostmapPyramid pyramid(costmap);
+  for (unsigned int levels : {0u, 1u, 4u, 9u}) {
+    pyramid.setLevels(levels);
+    ASSERT_EQ(pyramid.getLevels(), levels);
+    expectQueriesMatch(costmap, pyramid, levels);
+  }
+  EXPECT_EQ(pyramid.getSizeInCellsX(4), 13u);
+  EXPECT_EQ(pyramid.getSizeInCellsY(4), 10u);
+  EXPECT_EQ(pyramid.getSizeInCellsX(9), 1u);
+  EXPECT_EQ(pyramid.getCost(9, 0, 0), nav2_costmap_2d::NO_INFORMATION);
+}
+
+TEST(CostmapPyramid, incremental_updates_match_a_rebuild)
+{
+  RaytracingCostmap costmap(128, 97, 0.05, 0.0, 0.0);
+  std::mt19937 rng(2);
+  fillCostmap(costmap, rng);
+  CostmapPyramid pyramid(costmap), rebuilt(costmap);
+  pyramid.setLevels(4);
+  rebuilt.setLevels(4);
+
+  std::uniform_int_distribution<unsigned int> x(0, 127), y(0, 96);
+  for (int i = 0; i < 50; ++i) {
+    unsigned int x0 = x(rng), y0 = y(rng);
+    unsigned int xn = std::min(x0 + 1 + x(rng) % 20, 128u);
+    unsigned int yn = std::min(y0 + 1 + y(rng) % 20, 97u);
+    // lowering costs has to lower the blocks as well
+    costmap.resetMap(x0, y0, xn, yn);
+    costmap.setCost(x0, y0, (i * 37) % 256);
+    pyramid.update(x0, y0, xn, yn);
+  }
+  rebuilt.update();
+  for (unsigned int level = 1; level <= 4; ++level) {
+    for (unsigned int by = 0; by < rebuilt.getSizeInCellsY(level); ++by) {
+      for (unsigned int bx = 0; bx < rebuilt.getSizeInCellsX(level); ++bx) {
+        ASSERT_EQ(pyramid.getCost(level, bx, by), rebuilt.getCost(level, bx, by));
+      }
+    }
+  }
+  expectQueriesMatch(costmap, pyramid, 3);
+
+  // following a resize
+  costmap.resizeMap(40, 30, 0.05, 0.0, 0.0);
+  costmap.setCost(39, 29, nav2_costmap_2d::LETHAL_OBSTACLE);
+  pyramid.update(39, 29, 40, 30);
+  EXPECT_EQ(pyramid.getSizeInCellsX(1), 20u);
+  EXPECT_TRUE(pyramid.hasCostInRegion(32, 16, 40, 30, nav2_costmap_2d::LETHAL_OBSTACLE));
+  EXPECT_FALSE(pyramid.hasCostInRegion(0, 0, 39, 30, 1));
+}
+
+TEST(CostmapPyramid, toroidal_costmap)
+{
+  RaytracingCostmap costmap(100, 80, 1.0, 0.0, 0.0);
+  costmap.setToroidal(true);
+  costmap.updateOrigin(37.0, 21.0);
+  std::mt19937 rng(4);
+  fillCostmap(costmap, rng);
+
+  CostmapPyramid pyramid(costmap);
+  pyramid.setLevels(3);
+  expectQueriesMatch(costmap, pyramid, 5);
+}
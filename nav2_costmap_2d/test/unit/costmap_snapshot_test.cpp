@@ -0,0 +1,147 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_snapshot.hpp"
+
+using nav2_costmap_2d::Costmap2D;
+using nav2_costmap_2d::CostmapSnapshot;
+using nav2_costmap_2d::CostmapSnapshotHeader;
+
+namespace
+{
+
+const char snapshot_path[] = "costmap_snapshot_test.costmap";
+
+void fillCostmap(Costmap2D & costmap)
+{
+  for (unsigned int y = 0; y < costmap.getSizeInCellsY(); ++y) {
+    for (unsigned int x = 0; x < costmap.getSizeInCellsX(); ++x) {
+      costmap.setCost(x, y, static_cast<unsigned char>(x * 7 + y * 13));
+    }
+  }
+}
+
+void expectSameCostmap(const Costmap2D & expected, const Costmap2D & actual)
+{
+  ASSERT_EQ(expected.getSizeInCellsX(), actual.getSizeInCellsX());
+  ASSERT_EQ(expected.getSizeInCellsY(), actual.getSizeInCellsY());
+  EXPECT_EQ(expected.getResolution(), actual.getResolution());
+  EXPECT_EQ(expected.getOriginX(), actual.getOriginX());
+  EXPECT_EQ(expected.getOriginY(), actual.getOriginY());
+  for (unsigned int y = 0; y < expected.getSizeInCellsY(); ++y) {
+    for (unsigned int x = 0; x < expected.getSizeInCellsX(); ++x) {
+      ASSERT_EQ(expected.getCost(x, y), actual.getCost(x, y)) << x << ", " << y;
+    }
+  }
+}
+
+}  // namespace
+
+TEST(CostmapSnapshot, round_trip)
+{
+  Costmap2D costmap(23, 17, 0.05, -1.5, 2.25);
+  fillCostmap(costmap);
+  ASSERT_TRUE(costmap.saveSnapshot(snapshot_path, "static_layer", "map"));
+
+  {
+    CostmapSnapshot snapshot(snapshot_path);
+    const CostmapSnapshotHeader & header = snapshot.getHeader();
+    EXPECT_EQ(header.size_x, 23u);
+    EXPECT_EQ(header.size_y, 17u);
+    EXPECT_EQ(header.num_planes, 1u);
+    EXPECT_EQ(snapshot.getName(), "static_layer");
+    EXPECT_EQ(snapshot.getFrame(), "map");
+    EXPECT_EQ(snapshot.getPlane(0)[5 * 23 + 4], costmap.getCost(4, 5));
+    EXPECT_THROW(snapshot.getPlane(1), std::out_of_range);
+  }
+
+  Costmap2D loaded(4, 4, 0.1, 0.0, 0.0);
+  ASSERT_TRUE(loaded.loadSnapshot(snapshot_path, "static_layer"));
+  expectSameCostmap(costmap, loaded);
+  ASSERT_TRUE(loaded.loadSnapshot(snapshot_path, ""));
+
+  // a snapshot of another layer leaves the costmap alone
+  Costmap2D other(4, 4, 0.1, 0.0, 0.0);
+  EXPECT_FALSE(other.loadSnapshot(snapshot_path, "obstacle_layer"));
+  EXPECT_EQ(other.getSizeInCellsX(), 4u);
+
+  // a bare costmap doesn't know the frame of its costs
+  ASSERT_TRUE(costmap.saveSnapshot(snapshot_path, "static_layer"));
+  EXPECT_EQ(CostmapSnapshot(snapshot_path).getFrame(), "");
+  std::remove(snapshot_path);
+}
+
+TEST(CostmapSnapshot, toroidal)
+{
+  Costmap2D costmap(20, 10, 0.1, 0.0, 0.0);
+  costmap.setToroidal(true);
+  fillCostmap(costmap);
+  // scroll so that the rows of the char map wrap around
+  costmap.updateOrigin(0.75, 0.35);
+  fillCostmap(costmap);
+  ASSERT_TRUE(costmap.saveSnapshot(snapshot_path, "master"));
+
+  Costmap2D loaded;
+  ASSERT_TRUE(loaded.loadSnapshot(snapshot_path, "master"));
+  expectSameCostmap(costmap, loaded);
+
+  Costmap2D toroidal(20, 10, 0.1, 0.0, 0.0);
+  toroidal.setToroidal(true);
+  toroidal.updateOrigin(0.35, 0.55);
+  ASSERT_TRUE(toroidal.loadSnapshot(snapshot_path, "master"));
+  expectSameCostmap(costmap, toroidal);
+  std::remove(snapshot_path);
+}
+
+TEST(CostmapSnapshot, invalid_files)
+{
+  Costmap2D costmap(8, 8, 0.1, 0.0, 0.0);
+  fillCostmap(costmap);
+  EXPECT_FALSE(costmap.saveSnapshot(snapshot_path, std::string(100, 'x')));
+  EXPECT_FALSE(costmap.saveSnapshot(snapshot_path, "master", std::string(100, 'x')));
+  EXPECT_FALSE(costmap.loadSnapshot(snapshot_path, ""));
+
+  ASSERT_TRUE(costmap.saveSnapshot(snapshot_path, "master"));
+  FILE * fp = fopen(snapshot_path, "r+b");
+  ASSERT_NE(fp, nullptr);
+  // an unknown version
+  uint32_t version = CostmapSnapshotHeader::VERSION + 1;
+  fseek(fp, 8, SEEK_SET);
+  fwrite(&version, sizeof(version), 1, fp);
+  fclose(fp);
+  EXPECT_THROW(CostmapSnapshot snapshot(snapshot_path), std::runtime_error);
+
+  // missing cells
+  ASSERT_TRUE(costmap.saveSnapshot(snapshot_path, "master"));
+  ASSERT_EQ(truncate(snapshot_path, sizeof(CostmapSnapshotHeader) + 63), 0);
+  EXPECT_THROW(CostmapSnapshot snapshot(snapshot_path), std::runtime_error);
+
+  // not a snapshot at all
+  costmap.saveMap(snapshot_path);
+  EXPECT_THROW(CostmapSnapshot snapshot(snapshot_path), std::runtime_error);
+
+  Costmap2D loaded(4, 4, 0.1, 0.0, 0.0);
+  EXPECT_FALSE(loaded.loadSnapshot(snapshot_path, ""));
+  EXPECT_EQ(loaded.getSizeInCellsX(), 4u);
+  std::remove(snapshot_path);
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/decaying_voxel_grid.hpp"
+
+using nav2_costmap_2d::DecayingVoxelGrid;
+using nav2_costmap_2d::Frustum;
+
+namespace
+{
+
+geometry_msgs::msg::Quaternion yawQuaternion(double yaw)
+{
+  geometry_msgs::msg::Quaternion q;
+  q.x = q.y = 0.0;
+  q.z = std::sin(yaw / 2.0);
+  q.w = std::cos(yaw / 2.0);
+  return q;
+}
+
+}  // namespace
+
+TEST(DecayingVoxelGrid, markKeepsLatestExpiry)
+{
+  DecayingVoxelGrid grid;
+  grid.mark(3, -4, 2, 10.0);
+  grid.mark(3, -4, 2, 5.0);
+  grid.mark(3, -4, 7, 5.0);
+  EXPECT_EQ(grid.size(), 2u);
+  EXPECT_EQ(grid.getCount(3, -4), 2u);
+  EXPECT_EQ(grid.getCount(-4, 3), 0u);
+
+  grid.removeExpired(5.0);
+  EXPECT_EQ(grid.getCount(3, -4), 1u);
+  grid.removeExpired(10.0);
+  EXPECT_EQ(grid.getCount(3, -4), 0u);
+  EXPECT_EQ(grid.size(), 0u);
+}
+
+TEST(DecayingVoxelGrid, decayOnlyBringsExpiryForward)
+{
+  DecayingVoxelGrid grid;
+  grid.mark(0, 0, 0, 10.0);
+  grid.mark(1, 0, 0, 2.0);
+  grid.mark(-1, 0, 0, 10.0);
+
+  // the voxels with a positive x decay, without extending the one that expires sooner
+  grid.decay([](int x, int, unsigned int) {return x >= 0;}, 3.0);
+  grid.removeExpired(2.5);
+  EXPECT_EQ(grid.getCount(1, 0), 0u);
+  grid.removeExpired(3.0);
+  EXPECT_EQ(grid.getCount(0, 0), 0u);
+  EXPECT_EQ(grid.getCount(-1, 0), 1u);
+}
+
+TEST(DecayingVoxelGrid, changedColumns)
+{
+  DecayingVoxelGrid grid;
+  std::vector<DecayingVoxelGrid::Column> columns;
+  grid.mark(-8388608, 8388607, 65535, 1.0);
+  grid.mark(-8388608, 8388607, 0, 2.0);
+  grid.mark(5, 6, 1, 2.0);
+
+  grid.takeChangedColumns(columns);
+  ASSERT_EQ(columns.size(), 2u);
+  for (const auto & column : columns) {
+    if (column.x == 5) {
+      EXPECT_EQ(column.y, 6);
+      EXPECT_EQ(column.count, 1u);
+    } else {
+      EXPECT_EQ(column.x, -8388608);
+      EXPECT_EQ(column.y, 8388607);
+      EXPECT_EQ(column.count, 2u);
+    }
+  }
+
+  // marking a voxel again doesn't change its column
+  grid.mark(5, 6, 1, 3.0);
+  grid.takeChangedColumns(columns);
+  EXPECT_TRUE(columns.empty());
+
+  grid.removeExpired(2.0);
+  grid.takeChangedColumns(columns);
+  ASSERT_EQ(columns.size(), 1u);
+  EXPECT_EQ(columns[0].x, -8388608);
+  EXPECT_EQ(columns[0].count, 0u);
+
+  grid.remove([](int, int, unsigned int z) {return z == 1;});
+  grid.takeChangedColumns(columns);
+  ASSERT_EQ(columns.size(), 1u);
+  EXPECT_EQ(columns[0].x, 5);
+  EXPECT_EQ(columns[0].count, 0u);
+
+  grid.getColumns(columns);
+  EXPECT_TRUE(columns.empty());
+}
+
+TEST(Frustum, narrowFieldOfView)
+{
+  geometry_msgs::msg::Point origin;
+  origin.x = 1.0;
+  origin.y = 1.0;
+  origin.z = 0.5;
+
+  // looking along y, 90 degrees wide and 60 degrees high
+  Frustum frustum(origin, yawQuaternion(M_PI / 2.0), M_PI / 2.0, M_PI / 3.0, 4.0);
+  EXPECT_TRUE(frustum.contains(1.0, 3.0, 0.5));
+  EXPECT_TRUE(frustum.contains(2.9, 3.0, 0.5));
+  EXPECT_FALSE(frustum.contains(3.1, 3.0, 0.5));
+  EXPECT_FALSE(frustum.contains(1.0, -1.0, 0.5));
+  EXPECT_TRUE(frustum.contains(1.0, 3.0, 1.6));
+  EXPECT_FALSE(frustum.contains(1.0, 3.0, 1.7));
+  EXPECT_FALSE(frustum.contains(1.0, 5.1, 0.5));
+}
+
+TEST(Frustum, wideFieldOfView)
+{
+  geometry_msgs::msg::Point origin;
+
+  // 270 degrees around the x axis, every height
+  Frustum frustum(origin, yawQuaternion(0.0), 1.5 * M_PI, M_PI, 2.0);
+  EXPECT_TRUE(frustum.contains(-1.0, 1.1, 1.0));
+  EXPECT_FALSE(frustum.contains(-1.0, 0.9, 1.0));
+  EXPECT_TRUE(frustum.contains(0.0, 0.0, 1.9));
+
+  Frustum all_around(origin, yawQuaternion(0.0), 2.0 * M_PI, M_PI, 2.0);
+  EXPECT_TRUE(all_around.contains(-1.0, 0.0, 0.0));
+  EXPECT_FALSE(all_around.contains(-2.1, 0.0, 0.0));
+}
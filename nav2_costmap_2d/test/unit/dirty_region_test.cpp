@@ -0,0 +1,111 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/dirty_region.hpp"
+
+using nav2_costmap_2d::CellRegion;
+using nav2_costmap_2d::WorldRegion;
+
+namespace
+{
+
+bool covers(const CellRegion & region, unsigned int x, unsigned int y)
+{
+  for (const CellRegion::Rect & r : region.getRectangles()) {
+    if (r.min_x <= x && x <= r.max_x && r.min_y <= y && y <= r.max_y) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+TEST(dirty_region, ignores_empty_rectangles)
+{
+  WorldRegion region;
+  region.add(1e30, 1e30, -1e30, -1e30);
+  region.add(2.0, 0.0, 1.0, 1.0);
+  EXPECT_TRUE(region.empty());
+
+  double min_x = 5.0, min_y = 5.0, max_x = 5.0, max_y = 5.0;
+  EXPECT_FALSE(region.getBounds(min_x, min_y, max_x, max_y));
+  EXPECT_EQ(5.0, min_x);
+  EXPECT_EQ(5.0, max_y);
+}
+
+TEST(dirty_region, keeps_distant_rectangles_apart)
+{
+  WorldRegion region;
+  region.add(0.0, 0.0, 1.0, 1.0);
+  region.add(10.0, 10.0, 11.0, 11.0);
+  ASSERT_EQ(2u, region.getRectangles().size());
+
+  double min_x, min_y, max_x, max_y;
+  ASSERT_TRUE(region.getBounds(min_x, min_y, max_x, max_y));
+  EXPECT_EQ(0.0, min_x);
+  EXPECT_EQ(0.0, min_y);
+  EXPECT_EQ(11.0, max_x);
+  EXPECT_EQ(11.0, max_y);
+}
+
+TEST(dirty_region, merges_overlapping_rectangles)
+{
+  WorldRegion region;
+  region.add(0.0, 0.0, 1.0, 1.0);
+  region.add(4.0, 0.0, 5.0, 1.0);
+  // bridges the two, and the result must absorb both
+  region.add(0.5, 0.5, 4.5, 0.6);
+  ASSERT_EQ(1u, region.getRectangles().size());
+
+  const WorldRegion::Rect & r = region.getRectangles().front();
+  EXPECT_EQ(0.0, r.min_x);
+  EXPECT_EQ(0.0, r.min_y);
+  EXPECT_EQ(5.0, r.max_x);
+  EXPECT_EQ(1.0, r.max_y);
+}
+
+TEST(dirty_region, stays_disjoint_and_bounded)
+{
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<unsigned int> pos(0, 200);
+  std::uniform_int_distribution<unsigned int> size(0, 10);
+
+  CellRegion region(4);
+  std::vector<CellRegion::Rect> added;
+  for (int i = 0; i < 500; ++i) {
+    unsigned int x = pos(rng), y = pos(rng);
+    CellRegion::Rect rect{x, y, x + size(rng), y + size(rng)};
+    region.add(rect);
+    added.push_back(rect);
+
+    const std::vector<CellRegion::Rect> & rects = region.getRectangles();
+    ASSERT_LE(rects.size(), 4u);
+    for (size_t a = 0; a < rects.size(); ++a) {
+      for (size_t b = a + 1; b < rects.size(); ++b) {
+        EXPECT_FALSE(rects[a].overlaps(rects[b]));
+      }
+    }
+  }
+
+  // nothing that was added is lost
+  for (const CellRegion::Rect & rect : added) {
+    EXPECT_TRUE(covers(region, rect.min_x, rect.min_y));
+    EXPECT_TRUE(covers(region, rect.max_x, rect.max_y));
+  }
+}
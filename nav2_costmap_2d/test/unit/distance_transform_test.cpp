@@ -0,0 +1,116 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "nav2_costmap_2d/distance_transform.hpp"
+
+using nav2_costmap_2d::DistanceTransform;
+using nav2_costmap_2d::LETHAL_OBSTACLE;
+using nav2_costmap_2d::ThreadPool;
+
+namespace
+{
+
+std::vector<unsigned char> randomGrid(
+  unsigned int size_x, unsigned int size_y, unsigned int obstacles, unsigned int seed)
+{
+  std::mt19937 rng(seed);
+  std::vector<unsigned char> grid(size_x * size_y, 0);
+  for (unsigned int k = 0; k < obstacles; ++k) {
+    grid[rng() % grid.size()] = LETHAL_OBSTACLE;
+  }
+  return grid;
+}
+
+// Checks every cell of a window against the nearest obstacle found by brute force
+void expectExact(
+  const std::vector<unsigned char> & grid, unsigned int size_x,
+  unsigned int x0, unsigned int y0, unsigned int xn, unsigned int yn,
+  unsigned int max_distance, ThreadPool * pool)
+{
+  DistanceTransform transform;
+  transform.compute(grid.data(), size_x, x0, y0, xn, yn, max_distance, pool);
+
+  unsigned int max_squared = max_distance * max_distance;
+  for (unsigned int y = y0; y < yn; ++y) {
+    for (unsigned int x = x0; x < xn; ++x) {
+      unsigned int best = UINT32_MAX;
+      for (unsigned int oy = y0; oy < yn; ++oy) {
+        for (unsigned int ox = x0; ox < xn; ++ox) {
+          if (grid[oy * size_x + ox] == LETHAL_OBSTACLE) {
+            int dx = static_cast<int>(ox) - static_cast<int>(x);
+            int dy = static_cast<int>(oy) - static_cast<int>(y);
+            best = std::min(best, static_cast<unsigned int>(dx * dx + dy * dy));
+          }
+        }
+      }
+
+      unsigned int squared = transform.getSquaredDistance(x, y);
+      if (best <= max_squared) {
+        ASSERT_EQ(squared, best) << "cell " << x << ", " << y;
+      } else {
+        ASSERT_GT(squared, max_squared) << "cell " << x << ", " << y;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(DistanceTransform, matches_brute_force)
+{
+  std::vector<unsigned char> grid = randomGrid(70, 50, 40, 1);
+  expectExact(grid, 70, 0, 0, 70, 50, 200, nullptr);
+  expectExact(grid, 70, 0, 0, 70, 50, 6, nullptr);
+}
+
+TEST(DistanceTransform, window)
+{
+  std::vector<unsigned char> grid = randomGrid(70, 50, 25, 2);
+  expectExact(grid, 70, 13, 7, 51, 40, 10, nullptr);
+  expectExact(grid, 70, 69, 0, 70, 50, 10, nullptr);
+}
+
+TEST(DistanceTransform, no_obstacles)
+{
+  std::vector<unsigned char> grid(30 * 20, 0);
+  DistanceTransform transform;
+  transform.compute(grid.data(), 30, 0, 0, 30, 20, 5, nullptr);
+  for (unsigned int y = 0; y < 20; ++y) {
+    for (unsigned int x = 0; x < 30; ++x) {
+      EXPECT_GT(transform.getSquaredDistance(x, y), 25u);
+    }
+  }
+}
+
+TEST(DistanceTransform, threads_match_serial)
+{
+  const unsigned int size_x = 600, size_y = 400;
+  std::vector<unsigned char> grid = randomGrid(size_x, size_y, 300, 3);
+
+  ThreadPool pool(4);
+  DistanceTransform serial, parallel;
+  serial.compute(grid.data(), size_x, 0, 0, size_x, size_y, 40, nullptr);
+  parallel.compute(grid.data(), size_x, 0, 0, size_x, size_y, 40, &pool);
+  for (unsigned int y = 0; y < size_y; ++y) {
+    for (unsigned int x = 0; x < size_x; ++x) {
+      ASSERT_EQ(serial.getSquaredDistance(x, y), parallel.getSquaredDistance(x, y));
+    }
+  }
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/histogram.hpp"
+#include "nav2_costmap_2d/timed_mutex.hpp"
+
+using nav2_costmap_2d::Histogram;
+using nav2_costmap_2d::TimedRecursiveMutex;
+
+TEST(Histogram, buckets_cover_every_value)
+{
+  for (uint64_t value = 0; value < 100000; ++value) {
+    unsigned int bucket = Histogram::getBucket(value);
+    ASSERT_LE(value, Histogram::getBucketMax(bucket));
+    if (bucket > 0) {
+      ASSERT_GT(value, Histogram::getBucketMax(bucket - 1));
+    }
+  }
+  EXPECT_EQ(Histogram::getBucket(~0ull), Histogram::num_buckets - 1);
+  EXPECT_EQ(Histogram::getBucketMax(Histogram::num_buckets - 1), ~0ull);
+  // within 25%
+  EXPECT_EQ(Histogram::getBucketMax(Histogram::getBucket(1000)), 1023u);
+}
+
+TEST(Histogram, summary_of_concurrent_records)
+{
+  Histogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back(
+      [&histogram]() {
+        for (uint64_t value = 1; value <= 1000; ++value) {
+          histogram.record(value);
+        }
+      });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+
+  Histogram::Summary summary = histogram.summarizeAndReset();
+  EXPECT_EQ(summary.count, 4000u);
+  EXPECT_DOUBLE_EQ(summary.mean, 500.5);
+  EXPECT_EQ(summary.max, 1000u);
+  EXPECT_GE(summary.p50, 500u);
+  EXPECT_LE(summary.p50, 625u);
+  EXPECT_GE(summary.p90, 900u);
+  EXPECT_EQ(summary.p99, 1000u);
+
+  summary = histogram.summarize();
+  EXPECT_EQ(summary.count, 0u);
+  EXPECT_EQ(summary.p50, 0u);
+
+  histogram.record(7);
+  summary = histogram.summarize();
+  EXPECT_EQ(summary.count, 1u);
+  EXPECT_EQ(summary.p50, 7u);
+  EXPECT_EQ(summary.max, 7u);
+}
+
+TEST(TimedRecursiveMutex, times_outermost_locks_of_other_threads)
+{
+  TimedRecursiveMutex mutex;
+  Histogram wait, hold;
+
+  // not timed until the histograms are set
+  {
+    std::lock_guard<TimedRecursiveMutex> lock(mutex);
+  }
+  mutex.setHistograms(&wait, &hold);
+  {
+    std::lock_guard<TimedRecursiveMutex> lock(mutex);
+    std::lock_guard<TimedRecursiveMutex> inner(mutex);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  EXPECT_EQ(wait.summarize().count, 1u);
+  Histogram::Summary held = hold.summarize();
+  EXPECT_EQ(held.count, 1u);
+  EXPECT_GE(held.max, 2000000u);
+
+  // the untimed thread isn't recorded, but the others are
+  mutex.setUntimedThread(std::this_thread::get_id());
+  {
+    std::lock_guard<TimedRecursiveMutex> lock(mutex);
+  }
+  std::thread other(
+    [&mutex]() {
+      ASSERT_TRUE(mutex.try_lock());
+      mutex.unlock();
+    });
+  other.join();
+  EXPECT_EQ(wait.summarize().count, 2u);
+  EXPECT_EQ(hold.summarize().count, 2u);
+
+  mutex.setHistograms(nullptr, nullptr);
+  mutex.setUntimedThread(std::thread::id());
+  {
+    std::lock_guard<TimedRecursiveMutex> lock(mutex);
+  }
+  EXPECT_EQ(wait.summarize().count, 2u);
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "nav2_costmap_2d/merge_kernels.hpp"
+
+using nav2_costmap_2d::NO_INFORMATION;
+using nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE;
+
+// Every pair of costs, with an odd length so the kernels also run their tails
+class MergeKernelsTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    for (unsigned int i = 0; i < 256 * 256 + 3; ++i) {
+      master_.push_back((i >> 8) & 0xff);
+      layer_.push_back(i & 0xff);
+    }
+  }
+
+  std::vector<unsigned char> master_;
+  std::vector<unsigned char> layer_;
+};
+
+TEST_F(MergeKernelsTest, max)
+{
+  std::vector<unsigned char> merged = master_;
+  nav2_costmap_2d::mergeRowMax(merged.data(), layer_.data(), merged.size());
+  for (size_t i = 0; i < merged.size(); ++i) {
+    unsigned char expected = master_[i];
+    if (layer_[i] != NO_INFORMATION &&
+      (master_[i] == NO_INFORMATION || master_[i] < layer_[i]))
+    {
+      expected = layer_[i];
+    }
+    ASSERT_EQ(expected, merged[i]) << "master " << +master_[i] << " layer " << +layer_[i];
+  }
+}
+
+TEST_F(MergeKernelsTest, overwrite)
+{
+  std::vector<unsigned char> merged = master_;
+  nav2_costmap_2d::mergeRowOverwrite(merged.data(), layer_.data(), merged.size());
+  for (size_t i = 0; i < merged.size(); ++i) {
+    unsigned char expected = layer_[i] == NO_INFORMATION ? master_[i] : layer_[i];
+    ASSERT_EQ(expected, merged[i]) << "master " << +master_[i] << " layer " << +layer_[i];
+  }
+}
+
+TEST_F(MergeKernelsTest, addition)
+{
+  std::vector<unsigned char> merged = master_;
+  nav2_costmap_2d::mergeRowAddition(merged.data(), layer_.data(), merged.size());
+  for (size_t i = 0; i < merged.size(); ++i) {
+    unsigned char expected = master_[i];
+    if (layer_[i] != NO_INFORMATION) {
+      if (master_[i] == NO_INFORMATION) {
+        expected = layer_[i];
+      } else {
+        int sum = master_[i] + layer_[i];
+        expected = std::min(sum, INSCRIBED_INFLATED_OBSTACLE - 1);
+      }
+    }
+    ASSERT_EQ(expected, merged[i]) << "master " << +master_[i] << " layer " << +layer_[i];
+  }
+}
+
+TEST(merge_kernels, row_tiles_cover_window_once)
+{
+  nav2_costmap_2d::ThreadPool pool(4);
+  for (int rows : {0, 1, 3, 100, 1000}) {
+    std::vector<int> hits(rows, 0);
+    nav2_costmap_2d::forEachRowTile(
+      &pool, 0, rows, 500, [&hits](int y0, int yn) {
+        for (int y = y0; y < yn; ++y) {
+          hits[y]++;
+        }
+      });
+    EXPECT_TRUE(std::all_of(hits.begin(), hits.end(), [](int h) {return h == 1;}));
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,253 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/cost_values.hpp"
+#include "nav2_costmap_2d/nearest_obstacle_field.hpp"
+
+using nav2_costmap_2d::LETHAL_OBSTACLE;
+using nav2_costmap_2d::NearestObstacleField;
+
+namespace
+{
+
+void expectSameField(const NearestObstacleField & a, const NearestObstacleField & b)
+{
+  for (unsigned int y = 0; y < a.getSizeInCellsY(); ++y) {
+    for (unsigned int x = 0; x < a.getSizeInCellsX(); ++x) {
+      unsigned int ax = 0, ay = 0, bx = 0, by = 0;
+      bool a_found = a.getNearest(x, y, ax, ay);
+      bool b_found = b.getNearest(x, y, bx, by);
+      ASSERT_EQ(a_found, b_found) << "cell " << x << ", " << y;
+      ASSERT_EQ(ax, bx) << "cell " << x << ", " << y;
+      ASSERT_EQ(ay, by) << "cell " << x << ", " << y;
+    }
+  }
+}
+
+/**
+ * The obstacle of each cell as InflationLayer's wavefront assigns it: cells are taken by
+ * increasing distance, in the order they were queued, and queue their four neighbors
+ */
+std::vector<unsigned int> wavefrontSources(
+  const std::vector<unsigned char> & grid, unsigned int size_x, unsigned int size_y,
+  unsigned int cell_radius)
+{
+  std::vector<unsigned int> levels;
+  unsigned int num_levels = NearestObstacleField::computeLevels(cell_radius, levels);
+  unsigned int length = cell_radius + 2;
+  struct Cell
+  {
+    unsigned int index, source;
+  };
+  std::vector<std::vector<Cell>> bins(num_levels);
+  std::vector<unsigned int> sources(size_x * size_y, UINT_MAX);
+  std::vector<bool> seen(size_x * size_y, false);
+
+  for (unsigned int index = 0; index < grid.size(); ++index) {
+    if (grid[index] == LETHAL_OBSTACLE) {
+      bins[0].push_back({index, index});
+    }
+  }
+  auto enqueue = [&](unsigned int index, unsigned int source) {
+      if (seen[index]) {
+        return;
+      }
+      unsigned int dx = std::abs(
+        static_cast<int>(index % size_x) - static_cast<int>(source % size_x));
+      unsigned int dy = std::abs(
+        static_cast<int>(index / size_x) - static_cast<int>(source / size_x));
+      unsigned int level = dx < length && dy < length ? levels[dx * length + dy] : num_levels;
+      if (level < num_levels) {
+        bins[level].push_back({index, source});
+      }
+    };
+  for (std::vector<Cell> & bin : bins) {
+    for (size_t i = 0; i < bin.size(); ++i) {
+      Cell cell = bin[i];
+      if (seen[cell.index]) {
+        continue;
+      }
+      seen[cell.index] = true;
+      sources[cell.index] = cell.source;
+      unsigned int mx = cell.index % size_x, my = cell.index / size_x;
+      if (mx > 0) {
+        enqueue(cell.index - 1, cell.source);
+      }
+      if (my > 0) {
+        enqueue(cell.index - size_x, cell.source);
+      }
+      if (mx < size_x - 1) {
+        enqueue(cell.index + 1, cell.source);
+      }
+      if (my < size_y - 1) {
+        enqueue(cell.index + size_x, cell.source);
+      }
+    }
+  }
+  return sources;
+}
+
+void expectWavefrontField(
+  const NearestObstacleField & field, const std::vector<unsigned char> & grid)
+{
+  unsigned int size_x = field.getSizeInCellsX();
+  std::vector<unsigned int> sources =
+    wavefrontSources(grid, size_x, field.getSizeInCellsY(), field.getCellRadius());
+  for (unsigned int index = 0; index < sources.size(); ++index) {
+    unsigned int x = index % size_x, y = index / size_x;
+    unsigned int sx = 0, sy = 0;
+    bool found = field.getNearest(x, y, sx, sy);
+    ASSERT_EQ(sources[index] != UINT_MAX, found) << "cell " << x << ", " << y;
+    if (found) {
+      ASSERT_EQ(sources[index], sy * size_x + sx) << "cell " << x << ", " << y;
+    }
+  }
+}
+
+}  // namespace
+
+TEST(nearest_obstacle_field, levels_follow_distance)
+{
+  std::vector<unsigned int> levels;
+  unsigned int count = NearestObstacleField::computeLevels(3, levels);
+  // 0, 1, sqrt(2), 2, sqrt(5), sqrt(8), 3
+  EXPECT_EQ(7u, count);
+  ASSERT_EQ(25u, levels.size());
+  EXPECT_EQ(0u, levels[0]);
+  EXPECT_EQ(1u, levels[1]);
+  EXPECT_EQ(1u, levels[5]);
+  EXPECT_EQ(3u, levels[2 * 5]);
+  EXPECT_EQ(levels[1 * 5 + 2], levels[2 * 5 + 1]);
+  EXPECT_EQ(6u, levels[3 * 5]);
+  // sqrt(10) is beyond the radius
+  EXPECT_EQ(count, levels[3 * 5 + 1]);
+}
+
+TEST(nearest_obstacle_field, single_obstacle)
+{
+  NearestObstacleField field;
+  field.setRadius(2);
+  field.resize(10, 10);
+
+  std::vector<unsigned char> grid(100, 0);
+  grid[5 * 10 + 5] = LETHAL_OBSTACLE;
+  field.update(grid.data(), 0, 0, 10, 10);
+
+  unsigned int sx, sy;
+  ASSERT_TRUE(field.getNearest(5, 5, sx, sy));
+  EXPECT_EQ(5u, sx);
+  EXPECT_EQ(5u, sy);
+  ASSERT_TRUE(field.getNearest(7, 5, sx, sy));
+  EXPECT_TRUE(field.getNearest(6, 6, sx, sy));
+  EXPECT_FALSE(field.getNearest(7, 6, sx, sy));
+  EXPECT_FALSE(field.getNearest(0, 0, sx, sy));
+
+  grid[5 * 10 + 5] = 0;
+  field.update(grid.data(), 4, 4, 7, 7);
+  EXPECT_FALSE(field.getNearest(5, 5, sx, sy));
+  EXPECT_FALSE(field.getNearest(7, 5, sx, sy));
+}
+
+TEST(nearest_obstacle_field, incremental_matches_rebuild)
+{
+  const unsigned int size_x = 80, size_y = 60;
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<unsigned int> x_dist(0, size_x - 1);
+  std::uniform_int_distribution<unsigned int> y_dist(0, size_y - 1);
+
+  std::vector<unsigned char> grid(size_x * size_y, 0);
+  NearestObstacleField incremental;
+  incremental.setRadius(7);
+  incremental.resize(size_x, size_y);
+
+  for (int round = 0; round < 60; ++round) {
+    // change the obstacles within a random window, as a layer update would
+    unsigned int x0 = x_dist(rng), y0 = y_dist(rng);
+    unsigned int xn = std::min(size_x, x0 + 1 + x_dist(rng) / 3);
+    unsigned int yn = std::min(size_y, y0 + 1 + y_dist(rng) / 3);
+    for (unsigned int y = y0; y < yn; ++y) {
+      for (unsigned int x = x0; x < xn; ++x) {
+        unsigned char & cell = grid[y * size_x + x];
+        if (rng() % 8 == 0) {
+          cell = cell == LETHAL_OBSTACLE ? 0 : LETHAL_OBSTACLE;
+        }
+      }
+    }
+    incremental.update(grid.data(), x0, y0, xn, yn);
+
+    NearestObstacleField rebuilt;
+    rebuilt.setRadius(7);
+    rebuilt.resize(size_x, size_y);
+    rebuilt.update(grid.data(), 0, 0, size_x, size_y);
+
+    expectSameField(incremental, rebuilt);
+  }
+}
+
+TEST(nearest_obstacle_field, ties_match_wavefront)
+{
+  const unsigned int size_x = 300, size_y = 300;
+  std::mt19937 rng(7);
+  std::vector<unsigned char> grid(size_x * size_y);
+  for (int round = 0; round < 5; ++round) {
+    for (unsigned char & cell : grid) {
+      cell = rng() % 100 == 0 ? LETHAL_OBSTACLE : 0;
+    }
+    NearestObstacleField field;
+    field.setRadius(12);
+    field.resize(size_x, size_y);
+    field.update(grid.data(), 0, 0, size_x, size_y);
+    expectWavefrontField(field, grid);
+  }
+}
+
+TEST(nearest_obstacle_field, incremental_matches_wavefront)
+{
+  const unsigned int size_x = 120, size_y = 90;
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<unsigned int> x_dist(0, size_x - 1);
+  std::uniform_int_distribution<unsigned int> y_dist(0, size_y - 1);
+
+  std::vector<unsigned char> grid(size_x * size_y, 0);
+  for (unsigned char & cell : grid) {
+    cell = rng() % 50 == 0 ? LETHAL_OBSTACLE : 0;
+  }
+  NearestObstacleField field;
+  field.setRadius(9);
+  field.resize(size_x, size_y);
+  field.update(grid.data(), 0, 0, size_x, size_y);
+
+  for (int round = 0; round < 40; ++round) {
+    unsigned int x0 = x_dist(rng), y0 = y_dist(rng);
+    unsigned int xn = std::min(size_x, x0 + 1 + x_dist(rng) / 4);
+    unsigned int yn = std::min(size_y, y0 + 1 + y_dist(rng) / 4);
+    for (unsigned int y = y0; y < yn; ++y) {
+      for (unsigned int x = x0; x < xn; ++x) {
+        unsigned char & cell = grid[y * size_x + x];
+        if (rng() % 16 == 0) {
+          cell = cell == LETHAL_OBSTACLE ? 0 : LETHAL_OBSTACLE;
+        }
+      }
+    }
+    field.update(grid.data(), x0, y0, xn, yn);
+    expectWavefrontField(field, grid);
+  }
+}
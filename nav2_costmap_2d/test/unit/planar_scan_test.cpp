@@ -0,0 +1,92 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/planar_scan.hpp"
+
+using nav2_costmap_2d::BeamTable;
+using nav2_costmap_2d::PlanarScan;
+
+TEST(PlanarScan, beam_table)
+{
+  BeamTable beams(-1.5f, 0.25f, 13);
+  ASSERT_EQ(beams.cos_.size(), 13u);
+  ASSERT_EQ(beams.sin_.size(), 13u);
+  for (size_t i = 0; i < 13; ++i) {
+    EXPECT_NEAR(beams.cos_[i], std::cos(-1.5 + 0.25 * i), 1e-12);
+    EXPECT_NEAR(beams.sin_[i], std::sin(-1.5 + 0.25 * i), 1e-12);
+  }
+  EXPECT_TRUE(beams.matches(-1.5f, 0.25f, 13));
+  EXPECT_FALSE(beams.matches(-1.5f, 0.25f, 14));
+  EXPECT_FALSE(beams.matches(-1.4f, 0.25f, 13));
+  EXPECT_FALSE(beams.matches(-1.5f, 0.2f, 13));
+}
+
+TEST(PlanarScan, points_in_global_frame)
+{
+  const float angle_min = -2.0f, angle_increment = 0.01f;
+  const double yaw = 2.5, tx = 3.0, ty = -1.0;
+
+  PlanarScan scan;
+  scan.x_ = tx;
+  scan.y_ = ty;
+  scan.z_ = 0.3;
+  scan.cos_yaw_ = std::cos(yaw);
+  scan.sin_yaw_ = std::sin(yaw);
+  scan.range_min_ = 0.1f;
+  scan.range_max_ = 10.0f;
+  for (int i = 0; i < 400; ++i) {
+    scan.ranges_.push_back(0.05f * i);
+  }
+  scan.ranges_[7] = std::numeric_limits<float>::quiet_NaN();
+  scan.ranges_[8] = std::numeric_limits<float>::infinity();
+  scan.beams_ = std::make_shared<BeamTable>(angle_min, angle_increment, scan.ranges_.size());
+
+  std::vector<float> expected;
+  for (size_t i = 0; i < scan.size(); ++i) {
+    double wx = 0.0, wy = 0.0;
+    float r = scan.ranges_[i];
+    bool valid = r >= 0.1f && r < 10.0f;
+    ASSERT_EQ(scan.getPoint(i, wx, wy), valid) << i;
+    if (!valid) {
+      continue;
+    }
+    double angle = yaw + angle_min + static_cast<double>(i) * angle_increment;
+    EXPECT_NEAR(wx, tx + r * std::cos(angle), 1e-6);
+    EXPECT_NEAR(wy, ty + r * std::sin(angle), 1e-6);
+    expected.push_back(wx);
+    expected.push_back(wy);
+    expected.push_back(0.3);
+  }
+  // ranges 0.0 and 0.05 are below range_min, 10.0 and up are past range_max
+  EXPECT_EQ(expected.size(), 3u * (200 - 2 - 2));
+
+  sensor_msgs::msg::PointCloud2 cloud;
+  scan.toCloud("map", cloud);
+  EXPECT_EQ(cloud.header.frame_id, "map");
+  EXPECT_EQ(cloud.point_step, 12u);
+  ASSERT_EQ(cloud.width * 3, expected.size());
+  ASSERT_EQ(cloud.data.size(), expected.size() * sizeof(float));
+  std::vector<float> actual(expected.size());
+  std::memcpy(actual.data(), cloud.data.data(), cloud.data.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    EXPECT_FLOAT_EQ(actual[i], expected[i]);
+  }
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/point_cloud_filter.hpp"
+
+using nav2_costmap_2d::PointCloudFilter;
+using sensor_msgs::msg::PointCloud2;
+using sensor_msgs::msg::PointField;
+
+namespace
+{
+
+// A cloud of x, y, z and intensity, with x stored after the others to check offsets are used
+PointCloud2 makeCloud(const std::vector<float> & xyz)
+{
+  PointCloud2 cloud;
+  const char * names[4] = {"intensity", "y", "z", "x"};
+  for (unsigned int i = 0; i < 4; ++i) {
+    PointField field;
+    field.name = names[i];
+    field.offset = i * 4;
+    field.datatype = PointField::FLOAT32;
+    field.count = 1;
+    cloud.fields.push_back(field);
+  }
+  cloud.point_step = 16;
+  cloud.height = 1;
+  cloud.width = xyz.size() / 3;
+  cloud.row_step = cloud.width * cloud.point_step;
+  cloud.data.resize(cloud.row_step);
+  for (unsigned int i = 0; i < cloud.width; ++i) {
+    float point[4] = {42.0f, xyz[3 * i + 1], xyz[3 * i + 2], xyz[3 * i]};
+    std::memcpy(&cloud.data[i * 16], point, sizeof(point));
+  }
+  return cloud;
+}
+
+std::vector<float> points(const PointCloud2 & cloud)
+{
+  EXPECT_EQ(cloud.point_step, 12u);
+  EXPECT_EQ(cloud.fields.size(), 3u);
+  std::vector<float> xyz(cloud.data.size() / sizeof(float));
+  std::memcpy(xyz.data(), cloud.data.data(), cloud.data.size());
+  return xyz;
+}
+
+geometry_msgs::msg::Transform yawTransform(double yaw, double tx, double ty, double tz)
+{
+  geometry_msgs::msg::Transform transform;
+  transform.rotation.z = std::sin(yaw / 2);
+  transform.rotation.w = std::cos(yaw / 2);
+  transform.translation.x = tx;
+  transform.translation.y = ty;
+  transform.translation.z = tz;
+  return transform;
+}
+
+}  // namespace
+
+TEST(PointCloudFilter, transforms_and_filters_heights)
+{
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> coordinate(-3.0f, 3.0f);
+  std::vector<float> xyz;
+  for (int i = 0; i < 103; ++i) {
+    xyz.push_back(coordinate(rng));
+    xyz.push_back(coordinate(rng));
+    xyz.push_back(coordinate(rng));
+  }
+  xyz[5] = std::numeric_limits<float>::quiet_NaN();
+
+  const double yaw = 0.7, tx = 1.0, ty = -2.0, tz = 0.5;
+  PointCloudFilter filter(0.0, 2.0, 0.0);
+  PointCloud2 output;
+  ASSERT_TRUE(filter.filter(makeCloud(xyz), yawTransform(yaw, tx, ty, tz), "map", output));
+  EXPECT_EQ(output.header.frame_id, "map");
+
+  std::vector<float> expected;
+  for (size_t i = 0; i < xyz.size(); i += 3) {
+    double z = xyz[i + 2] + tz;
+    if (z >= 0.0 && z <= 2.0) {
+      expected.push_back(std::cos(yaw) * xyz[i] - std::sin(yaw) * xyz[i + 1] + tx);
+      expected.push_back(std::sin(yaw) * xyz[i] + std::cos(yaw) * xyz[i + 1] + ty);
+      expected.push_back(z);
+    }
+  }
+
+  std::vector<float> actual = points(output);
+  ASSERT_EQ(actual.size(), expected.size());
+  EXPECT_EQ(output.width * 3, actual.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    EXPECT_NEAR(actual[i], expected[i], 1e-5);
+  }
+}
+
+TEST(PointCloudFilter, downsamples_to_voxels)
+{
+  std::vector<float> xyz = {
+    0.01f, 0.01f, 0.01f,
+    0.04f, 0.02f, 0.03f,   // same 5cm voxel as the first one
+    0.06f, 0.01f, 0.01f,
+    -0.01f, 0.01f, 0.01f,
+    0.02f, 0.02f, 0.07f};
+  PointCloudFilter filter(-1.0, 1.0, 0.05);
+  PointCloud2 output;
+  ASSERT_TRUE(filter.filter(makeCloud(xyz), yawTransform(0.0, 0.0, 0.0, 0.0), "map", output));
+  EXPECT_EQ(output.width, 4u);
+
+  // voxels are forgotten between clouds
+  ASSERT_TRUE(filter.filter(makeCloud(xyz), yawTransform(0.0, 0.0, 0.0, 0.0), "map", output));
+  EXPECT_EQ(output.width, 4u);
+}
+
+TEST(PointCloudFilter, needs_coordinates)
+{
+  PointCloud2 cloud = makeCloud({1.0f, 2.0f, 3.0f});
+  cloud.fields.pop_back();
+  PointCloudFilter filter(-10.0, 10.0, 0.0);
+  PointCloud2 output;
+  EXPECT_FALSE(filter.filter(cloud, yawTransform(0.0, 0.0, 0.0, 0.0), "map", output));
+  EXPECT_EQ(output.width, 0u);
+}
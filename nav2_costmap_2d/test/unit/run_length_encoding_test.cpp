@@ -0,0 +1,65 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/run_length_encoding.hpp"
+
+using nav2_costmap_2d::decodeRunLength;
+using nav2_costmap_2d::encodeRunLength;
+
+TEST(run_length_encoding, round_trips)
+{
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> value(0, 3);
+  std::uniform_int_distribution<int> run(1, 600);
+
+  for (int round = 0; round < 50; ++round) {
+    std::vector<uint8_t> data;
+    while (data.size() < 5000) {
+      data.insert(data.end(), run(rng), static_cast<uint8_t>(value(rng) * 85));
+    }
+
+    std::vector<uint8_t> encoded;
+    encodeRunLength(data.data(), data.size(), encoded);
+    std::vector<uint8_t> decoded(data.size());
+    ASSERT_TRUE(decodeRunLength(encoded, decoded.data(), decoded.size()));
+    EXPECT_EQ(data, decoded);
+  }
+}
+
+TEST(run_length_encoding, splits_long_runs)
+{
+  std::vector<uint8_t> data(600, 254);
+  std::vector<uint8_t> encoded;
+  encodeRunLength(data.data(), data.size(), encoded);
+  std::vector<uint8_t> expected{255, 254, 255, 254, 90, 254};
+  EXPECT_EQ(expected, encoded);
+
+  encodeRunLength(data.data(), 0, encoded);
+  EXPECT_TRUE(encoded.empty());
+}
+
+TEST(run_length_encoding, rejects_malformed_input)
+{
+  std::vector<uint8_t> data(10);
+  EXPECT_FALSE(decodeRunLength({5, 1, 4}, data.data(), data.size()));
+  EXPECT_FALSE(decodeRunLength({0, 1, 10, 1}, data.data(), data.size()));
+  EXPECT_FALSE(decodeRunLength({5, 1, 6, 1}, data.data(), data.size()));
+  EXPECT_FALSE(decodeRunLength({5, 1, 4, 1}, data.data(), data.size()));
+  EXPECT_TRUE(decodeRunLength({5, 1, 5, 2}, data.data(), data.size()));
+  EXPECT_EQ(2, data[9]);
+}
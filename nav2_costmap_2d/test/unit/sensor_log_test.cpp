@@ -0,0 +1,206 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/sensor_log.hpp"
+
+using nav2_costmap_2d::Costmap2D;
+using nav2_costmap_2d::Observation;
+using nav2_costmap_2d::SensorLogCycle;
+using nav2_costmap_2d::SensorLogReader;
+using nav2_costmap_2d::SensorLogWriter;
+
+namespace
+{
+
+const char log_path[] = "sensor_log_test.log";
+
+Observation makeCloudObservation(double x, uint8_t fill)
+{
+  sensor_msgs::msg::PointCloud2 cloud;
+  cloud.header.frame_id = "map";
+  cloud.header.stamp.sec = 12;
+  cloud.header.stamp.nanosec = 34;
+  cloud.height = 1;
+  cloud.width = 2;
+  sensor_msgs::msg::PointField field;
+  field.name = "x";
+  field.datatype = sensor_msgs::msg::PointField::FLOAT32;
+  field.count = 1;
+  cloud.fields.push_back(field);
+  cloud.point_step = 4;
+  cloud.row_step = 8;
+  cloud.data.assign(8, fill);
+  geometry_msgs::msg::Point origin;
+  origin.x = x;
+  Observation observation(origin, cloud, 2.5, 3.0);
+  observation.raytrace_mode_ = Observation::RAYTRACE_ANGULAR_BINS;
+  observation.raytrace_angular_resolution_ = 0.01;
+  return observation;
+}
+
+Observation makeScanObservation()
+{
+  auto scan = std::make_shared<nav2_costmap_2d::PlanarScan>();
+  scan->x_ = 1.0;
+  scan->cos_yaw_ = 0.0;
+  scan->sin_yaw_ = 1.0;
+  scan->range_min_ = 0.1f;
+  scan->range_max_ = 10.0f;
+  scan->ranges_ = {1.0f, 2.0f, 3.0f};
+  scan->beams_ = std::make_shared<const nav2_costmap_2d::BeamTable>(-0.5f, 0.5f, 3);
+  Observation observation;
+  observation.scan_ = scan;
+  observation.horizontal_fov_ = 1.0;
+  return observation;
+}
+
+std::vector<geometry_msgs::msg::Point> makeFootprint()
+{
+  std::vector<geometry_msgs::msg::Point> footprint(3);
+  footprint[0].x = 1.0;
+  footprint[1].y = 1.0;
+  footprint[2].x = -1.0;
+  return footprint;
+}
+
+void writeLog()
+{
+  std::vector<rclcpp::Parameter> parameters;
+  parameters.emplace_back("resolution", 0.05);
+  parameters.emplace_back("rolling_window", true);
+  parameters.emplace_back("plugin_names", std::vector<std::string>{"obstacles", "inflation"});
+
+  SensorLogWriter writer(log_path, parameters);
+  Costmap2D master(10, 10, 0.1, 0.0, 0.0);
+  Observation cloud = makeCloudObservation(1.0, 7), scan = makeScanObservation();
+
+  writer.beginCycle(100, 1.0, 2.0, 0.5, makeFootprint(), master);
+  writer.addObservations("obstacles", {cloud}, {cloud, scan});
+  writer.endCycle();
+
+  // the cloud is kept from the last cycle, and the map grew
+  master.resizeMap(20, 10, 0.1, -1.0, 0.0);
+  writer.beginCycle(200, 1.5, 2.0, 0.5, makeFootprint(), master);
+  writer.addObservations("obstacles", {makeCloudObservation(2.0, 9), cloud}, {});
+  writer.endCycle();
+
+  // nothing is written outside of a cycle
+  writer.addObservations("obstacles", {cloud}, {cloud});
+}
+
+}  // namespace
+
+TEST(SensorLog, round_trip)
+{
+  writeLog();
+  SensorLogReader reader(log_path);
+
+  const std::vector<rclcpp::Parameter> & parameters = reader.getParameters();
+  ASSERT_EQ(parameters.size(), 3u);
+  EXPECT_EQ(parameters[0].get_name(), "resolution");
+  EXPECT_EQ(parameters[0].as_double(), 0.05);
+  EXPECT_TRUE(parameters[1].as_bool());
+  EXPECT_EQ(parameters[2].as_string_array()[1], "inflation");
+
+  SensorLogCycle cycle;
+  ASSERT_TRUE(reader.readCycle(cycle));
+  EXPECT_EQ(cycle.stamp, 100);
+  EXPECT_EQ(cycle.robot_y, 2.0);
+  ASSERT_TRUE(cycle.has_footprint);
+  EXPECT_EQ(cycle.footprint.size(), 3u);
+  EXPECT_EQ(cycle.footprint[2].x, -1.0);
+  ASSERT_TRUE(cycle.has_geometry);
+  EXPECT_EQ(cycle.size_x, 10u);
+  EXPECT_EQ(cycle.resolution, 0.1);
+
+  ASSERT_EQ(cycle.layers.size(), 1u);
+  const nav2_costmap_2d::SensorLogObservations & observations = cycle.layers["obstacles"];
+  ASSERT_EQ(observations.marking.size(), 1u);
+  ASSERT_EQ(observations.clearing.size(), 2u);
+  const Observation & cloud = observations.marking[0];
+  // written once for marking and clearing
+  EXPECT_EQ(observations.clearing[0].cloud_, cloud.cloud_);
+  EXPECT_EQ(cloud.origin_.x, 1.0);
+  EXPECT_EQ(cloud.obstacle_range_, 2.5);
+  EXPECT_EQ(cloud.raytrace_mode_, Observation::RAYTRACE_ANGULAR_BINS);
+  EXPECT_EQ(cloud.raytrace_angular_resolution_, 0.01);
+  EXPECT_EQ(cloud.cloud_->header.frame_id, "map");
+  EXPECT_EQ(cloud.cloud_->header.stamp.nanosec, 34u);
+  EXPECT_EQ(cloud.cloud_->fields[0].name, "x");
+  EXPECT_EQ(cloud.cloud_->row_step, 8u);
+  EXPECT_EQ(cloud.cloud_->data, std::vector<uint8_t>(8, 7));
+
+  const Observation & scan = observations.clearing[1];
+  ASSERT_TRUE(scan.scan_ != nullptr);
+  EXPECT_EQ(scan.horizontal_fov_, 1.0);
+  EXPECT_EQ(scan.scan_->sin_yaw_, 1.0);
+  EXPECT_EQ(scan.scan_->ranges_, (std::vector<float>{1.0f, 2.0f, 3.0f}));
+  double wx, wy;
+  ASSERT_TRUE(scan.scan_->getPoint(1, wx, wy));
+  EXPECT_NEAR(wx, 1.0, 1e-6);
+  EXPECT_NEAR(wy, 2.0, 1e-6);
+  const Observation::CloudConstPtr first_cloud = cloud.cloud_;
+
+  ASSERT_TRUE(reader.readCycle(cycle));
+  EXPECT_EQ(cycle.stamp, 200);
+  EXPECT_FALSE(cycle.has_footprint);
+  ASSERT_TRUE(cycle.has_geometry);
+  EXPECT_EQ(cycle.size_x, 20u);
+  EXPECT_EQ(cycle.origin_x, -1.0);
+  const nav2_costmap_2d::SensorLogObservations & second = cycle.layers["obstacles"];
+  ASSERT_EQ(second.marking.size(), 2u);
+  EXPECT_TRUE(second.clearing.empty());
+  EXPECT_EQ(second.marking[0].cloud_->data, std::vector<uint8_t>(8, 9));
+  // the kept observation is read back from the last cycle
+  EXPECT_EQ(second.marking[1].cloud_, first_cloud);
+
+  EXPECT_FALSE(reader.readCycle(cycle));
+  std::remove(log_path);
+}
+
+TEST(SensorLog, truncated_log)
+{
+  writeLog();
+  FILE * file = fopen(log_path, "rb");
+  std::vector<char> data(1 << 16);
+  data.resize(fread(data.data(), 1, data.size(), file));
+  fclose(file);
+
+  // a recording stopped in the middle of the second cycle
+  file = fopen(log_path, "wb");
+  fwrite(data.data(), 1, data.size() - 10, file);
+  fclose(file);
+  {
+    SensorLogReader reader(log_path);
+    SensorLogCycle cycle;
+    EXPECT_TRUE(reader.readCycle(cycle));
+    EXPECT_FALSE(reader.readCycle(cycle));
+  }
+
+  // not a log
+  file = fopen(log_path, "wb");
+  fwrite("P5\n", 1, 3, file);
+  fclose(file);
+  EXPECT_THROW(SensorLogReader reader(log_path), std::runtime_error);
+  std::remove(log_path);
+  EXPECT_THROW(SensorLogReader reader(log_path), std::runtime_error);
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/thread_pool.hpp"
+
+TEST(thread_pool, runs_every_task_once)
+{
+  nav2_costmap_2d::ThreadPool pool(4);
+  EXPECT_EQ(4u, pool.size());
+
+  for (int round = 0; round < 100; ++round) {
+    std::vector<int> hits(37, 0);
+    pool.parallelFor(37, [&hits](unsigned int i) {hits[i]++;});
+    for (int h : hits) {
+      EXPECT_EQ(1, h);
+    }
+  }
+}
+
+TEST(thread_pool, nested_calls_run_serially)
+{
+  nav2_costmap_2d::ThreadPool pool(3);
+  std::atomic<int> count(0);
+  pool.parallelFor(
+    8, [&](unsigned int) {
+      pool.parallelFor(5, [&count](unsigned int) {count++;});
+    });
+  EXPECT_EQ(40, count);
+}
+
+TEST(thread_pool, rethrows_task_errors)
+{
+  nav2_costmap_2d::ThreadPool pool(2);
+  std::atomic<int> count(0);
+  EXPECT_THROW(
+    pool.parallelFor(
+      10, [&count](unsigned int i) {
+        count++;
+        if (i == 3) {
+          throw std::runtime_error("task failed");
+        }
+      }), std::runtime_error);
+  EXPECT_EQ(10, count);
+}
+
+TEST(thread_pool, single_thread)
+{
+  nav2_costmap_2d::ThreadPool pool(1);
+  EXPECT_EQ(1u, pool.size());
+  int sum = 0;
+  pool.parallelFor(4, [&sum](unsigned int i) {sum += i;});
+  EXPECT_EQ(6, sum);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
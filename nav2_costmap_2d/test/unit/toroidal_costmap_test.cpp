@@ -0,0 +1,131 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gtest/gtest.h"
+#include "nav2_costmap_2d/costmap_2d.hpp"
+
+using nav2_costmap_2d::Costmap2D;
+
+namespace
+{
+
+void fillCostmap(Costmap2D & costmap, unsigned char offset)
+{
+  for (unsigned int y = 0; y < costmap.getSizeInCellsY(); ++y) {
+    for (unsigned int x = 0; x < costmap.getSizeInCellsX(); ++x) {
+      costmap.setCost(x, y, static_cast<unsigned char>(offset + x * 7 + y * 13));
+    }
+  }
+}
+
+void expectSameCosts(const Costmap2D & expected, const Costmap2D & actual)
+{
+  ASSERT_EQ(expected.getSizeInCellsX(), actual.getSizeInCellsX());
+  ASSERT_EQ(expected.getSizeInCellsY(), actual.getSizeInCellsY());
+  EXPECT_EQ(expected.getOriginX(), actual.getOriginX());
+  EXPECT_EQ(expected.getOriginY(), actual.getOriginY());
+  for (unsigned int y = 0; y < expected.getSizeInCellsY(); ++y) {
+    for (unsigned int x = 0; x < expected.getSizeInCellsX(); ++x) {
+      ASSERT_EQ(expected.getCost(x, y), actual.getCost(x, y)) << x << ", " << y;
+    }
+  }
+}
+
+/**
+ * A row-major and a toroidal costmap moved through the same origins, with the costs of the
+ * row-major one, except for the cells the last move exposed
+ */
+void moveCostmaps(Costmap2D & row_major, Costmap2D & toroidal)
+{
+  const double moves[][2] = {{3.0, 2.0}, {-5.0, 4.0}, {11.0, -7.0}, {-2.0, -1.0}};
+  unsigned char offset = 0;
+  for (const auto & move : moves) {
+    row_major.updateOrigin(row_major.getOriginX() + move[0], row_major.getOriginY() + move[1]);
+    toroidal.updateOrigin(toroidal.getOriginX() + move[0], toroidal.getOriginY() + move[1]);
+    expectSameCosts(row_major, toroidal);
+
+    fillCostmap(row_major, offset);
+    fillCostmap(toroidal, offset);
+    offset += 5;
+  }
+  row_major.updateOrigin(row_major.getOriginX() + 4.0, row_major.getOriginY() - 3.0);
+  toroidal.updateOrigin(toroidal.getOriginX() + 4.0, toroidal.getOriginY() - 3.0);
+}
+
+}  // namespace
+
+TEST(ToroidalCostmap, update_origin)
+{
+  Costmap2D row_major(19, 13, 1.0, 0.0, 0.0);
+  Costmap2D toroidal(19, 13, 1.0, 0.0, 0.0);
+  toroidal.setToroidal(true);
+  moveCostmaps(row_major, toroidal);
+  expectSameCosts(row_major, toroidal);
+
+  // the index of each cell maps back to it across the storage seam
+  for (unsigned int y = 0; y < toroidal.getSizeInCellsY(); ++y) {
+    for (unsigned int x = 0; x < toroidal.getSizeInCellsX(); ++x) {
+      unsigned int mx, my;
+      toroidal.indexToCells(toroidal.getIndex(x, y), mx, my);
+      EXPECT_EQ(mx, x);
+      EXPECT_EQ(my, y);
+    }
+  }
+
+  // moving farther than the size of the costmap clears it all
+  row_major.updateOrigin(row_major.getOriginX() + 40.0, row_major.getOriginY());
+  toroidal.updateOrigin(toroidal.getOriginX() + 40.0, toroidal.getOriginY());
+  expectSameCosts(row_major, toroidal);
+}
+
+TEST(ToroidalCostmap, reset_map)
+{
+  Costmap2D row_major(19, 13, 1.0, 0.0, 0.0);
+  Costmap2D toroidal(19, 13, 1.0, 0.0, 0.0);
+  toroidal.setToroidal(true);
+  moveCostmaps(row_major, toroidal);
+
+  row_major.resetMapToValue(2, 1, 17, 12, 77);
+  toroidal.resetMapToValue(2, 1, 17, 12, 77);
+  expectSameCosts(row_major, toroidal);
+}
+
+TEST(ToroidalCostmap, copy_window)
+{
+  Costmap2D row_major(19, 13, 1.0, 0.0, 0.0);
+  Costmap2D toroidal(19, 13, 1.0, 0.0, 0.0);
+  toroidal.setToroidal(true);
+  moveCostmaps(row_major, toroidal);
+  double window_x = row_major.getOriginX() + 2.0;
+  double window_y = row_major.getOriginY() + 3.0;
+
+  Costmap2D expected;
+  ASSERT_TRUE(expected.copyCostmapWindow(row_major, window_x, window_y, 10.0, 7.0));
+  ASSERT_EQ(expected.getSizeInCellsX(), 10u);
+  ASSERT_EQ(expected.getSizeInCellsY(), 7u);
+
+  Costmap2D window;
+  ASSERT_TRUE(window.copyCostmapWindow(toroidal, window_x, window_y, 10.0, 7.0));
+  expectSameCosts(expected, window);
+
+  // a toroidal window whose storage was offset before takes the costs all the same
+  Costmap2D toroidal_window(5, 5, 1.0, 0.0, 0.0);
+  toroidal_window.setToroidal(true);
+  toroidal_window.updateOrigin(2.0, 3.0);
+  ASSERT_TRUE(toroidal_window.copyCostmapWindow(toroidal, window_x, window_y, 10.0, 7.0));
+  expectSameCosts(expected, toroidal_window);
+
+  // the window must fit in the costmap
+  EXPECT_FALSE(window.copyCostmapWindow(toroidal, window_x, window_y, 20.0, 7.0));
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_VOXEL_GRID__HASHED_COLUMNS_HPP_
+#define NAV2_VOXEL_GRID__HASHED_COLUMNS_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace nav2_voxel_grid
+{
+
+/**
+ * @class VoxelKey
+ * @brief The 64 bit key of a voxel, or of a block of voxels, for hashed grids.
+ *        The key of a column is the key of any of its voxels shifted right by Z_BITS.
+ */
+class VoxelKey
+{
+public:
+  /** @brief The x, y and z coordinates are limited to this many bits, x and y being signed */
+  static const unsigned int XY_BITS = 24;
+  static const unsigned int Z_BITS = 16;
+
+  static uint64_t key(int x, int y, unsigned int z)
+  {
+    return (column(x, y) << Z_BITS) | (z & ((1 << Z_BITS) - 1));
+  }
+
+  static uint64_t column(int x, int y)
+  {
+    const uint64_t xy_mask = (static_cast<uint64_t>(1) << XY_BITS) - 1;
+    return ((static_cast<uint64_t>(static_cast<uint32_t>(x)) & xy_mask) << XY_BITS) |
+           (static_cast<uint64_t>(static_cast<uint32_t>(y)) & xy_mask);
+  }
+
+  static void columnCoordinates(uint64_t column, int & x, int & y)
+  {
+    // shifting the sign bit of each coordinate to the top and back sign extends it
+    const unsigned int spare = 64 - XY_BITS;
+    x = static_cast<int>(static_cast<int64_t>(column << (spare - XY_BITS)) >> spare);
+    y = static_cast<int>(static_cast<int64_t>(column << spare) >> spare);
+  }
+
+  static void coordinates(uint64_t key, int & x, int & y, unsigned int & z)
+  {
+    columnCoordinates(key >> Z_BITS, x, y);
+    z = key & ((1 << Z_BITS) - 1);
+  }
+};
+
+/**
+ * @class ColumnCounts
+ * @brief The counts of voxels of the columns of a hashed grid, keyed with VoxelKey::column().
+ *        The columns whose counts change are remembered until takeChanged(), so a 2D map
+ *        can be kept up to date without going over the grid.
+ */
+template<class CountT>
+class ColumnCounts
+{
+public:
+  /**
+   * @brief  The counts of a column, to be changed, which start value initialized
+   * @param column The key of the column
+   */
+  CountT & change(uint64_t column)
+  {
+    changed_.insert(column);
+    return counts_[column];
+  }
+
+  /** @brief The counts of a column, or NULL if it has none */
+  const CountT * find(uint64_t column) const
+  {
+    auto it = counts_.find(column);
+    return it == counts_.end() ? NULL : &it->second;
+  }
+
+  /** @brief Remove the counts of a column, which changes it */
+  void erase(uint64_t column)
+  {
+    changed_.insert(column);
+    counts_.erase(column);
+  }
+
+  /** @brief Remove the counts of every column, which changes them */
+  void clear()
+  {
+    for (const auto & count : counts_) {
+      changed_.insert(count.first);
+    }
+    counts_.clear();
+  }
+
+  /** @brief Forget every column and every change, for a grid that starts over */
+  void forget()
+  {
+    counts_.clear();
+    changed_.clear();
+  }
+
+  /**
+   * @brief  Forget the columns passing a test, and their changes, for columns leaving a grid
+   * @param test Called with the x and y coordinates of each column
+   */
+  template<class Test>
+  void forget(Test test)
+  {
+    int x, y;
+    for (auto it = counts_.begin(); it != counts_.end(); ) {
+      VoxelKey::columnCoordinates(it->first, x, y);
+      it = test(x, y) ? counts_.erase(it) : std::next(it);
+    }
+    for (auto it = changed_.begin(); it != changed_.end(); ) {
+      VoxelKey::columnCoordinates(*it, x, y);
+      it = test(x, y) ? changed_.erase(it) : std::next(it);
+    }
+  }
+
+  /**
+   * @brief  Go over the columns changed since the last call, and forget the changes
+   * @param action Called with the x and y coordinates of each column and its counts,
+   *        which are NULL for a column that was erased
+   */
+  template<class Action>
+  void takeChanged(Action action)
+  {
+    int x, y;
+    for (uint64_t column : changed_) {
+      VoxelKey::columnCoordinates(column, x, y);
+      action(x, y, find(column));
+    }
+    changed_.clear();
+  }
+
+  /**
+   * @brief  Go over every column with counts
+   * @param action Called with the x and y coordinates of each column and its counts
+   */
+  template<class Action>
+  void forEach(Action action) const
+  {
+    int x, y;
+    for (const auto & count : counts_) {
+      VoxelKey::columnCoordinates(count.first, x, y);
+      action(x, y, count.second);
+    }
+  }
+
+  /** @brief Number of columns with counts */
+  size_t size() const {return counts_.size();}
+
+  /** @brief Number of columns changed since the last takeChanged() */
+  size_t numChanged() const {return changed_.size();}
+
+private:
+  std::unordered_map<uint64_t, CountT> counts_;
+  std::unordered_set<uint64_t> changed_;
+};
+
+}  // namespace nav2_voxel_grid
+
+#endif  // NAV2_VOXEL_GRID__HASHED_COLUMNS_HPP_
@@ -0,0 +1,217 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NAV2_VOXEL_GRID__SPARSE_VOXEL_GRID_HPP_
+#define NAV2_VOXEL_GRID__SPARSE_VOXEL_GRID_HPP_
+
+#include <stdint.h>
+#include <limits.h>
+#include <unordered_map>
+#include <vector>
+
+#include "rclcpp/rclcpp.hpp"
+#include "nav2_voxel_grid/hashed_columns.hpp"
+#include "nav2_voxel_grid/voxel_grid.hpp"
+
+namespace nav2_voxel_grid
+{
+
+/**
+ * @class SparseVoxelGrid
+ * @brief A 3D grid with the marking and clearing interface of VoxelGrid, that only
+ *        allocates memory for the blocks of 8x8x8 voxels that were observed.
+ *
+ * The blocks are hashed by their coordinates with VoxelKey, so the grid can be up to
+ * 2^19 voxels high and a large window costs nothing where there are no observations.
+ * Voxels never marked or cleared are unknown. The marked and known voxels of every column
+ * are counted in ColumnCounts as voxels change, and the columns whose counts changed are
+ * remembered until takeChangedColumns(), so a 2D map can be kept up to date without going
+ * over the grid.
+ *
+ * Unlike VoxelGrid, the unknown voxels of a column are counted over the size_z
+ * voxels of the grid rather than over 16.
+ */
+class SparseVoxelGrid
+{
+public:
+  /** @brief The edge of a block in voxels */
+  static const unsigned int BLOCK_SIZE = 8;
+
+  /** @brief A column of the grid */
+  struct Column
+  {
+    unsigned int x, y;
+  };
+
+  /**
+   * @brief  Constructor for a sparse voxel grid
+   * @param size_x The x size of the grid
+   * @param size_y The y size of the grid
+   * @param size_z The z size of the grid
+   */
+  SparseVoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z);
+
+  /**
+   * @brief  Resizes a voxel grid to the desired size, which resets it
+   * @param size_x The x size of the grid
+   * @param size_y The y size of the grid
+   * @param size_z The z size of the grid
+   */
+  void resize(unsigned int size_x, unsigned int size_y, unsigned int size_z);
+
+  /** @brief Make every voxel unknown, releasing the blocks */
+  void reset();
+
+  /**
+   * @brief  Switch the layout of getIndex() between row-major and toroidal order,
+   *         to match a costmap. Switching modes resets the grid.
+   * @param toroidal Whether to use toroidal order
+   */
+  void setToroidal(bool toroidal);
+  bool isToroidal() const {return toroidal_;}
+
+  /**
+   * @brief  Move the origin of the grid, keeping the voxels that stay in it. The voxels that
+   *         scrolled into view are unknown. Both layouts keep the voxels, unlike VoxelGrid
+   *         which resets a row-major grid.
+   * @param cell_ox The number of cells the origin moves along x
+   * @param cell_oy The number of cells the origin moves along y
+   */
+  void updateOrigin(int cell_ox, int cell_oy);
+
+  /**
+   * @brief  Index of cell (x, y) in a 2D map of the size of the grid, laid out like a
+   *         costmap with the same toroidal mode
+   */
+  inline unsigned int getIndex(unsigned int x, unsigned int y) const
+  {
+    if (toroidal_) {
+      unsigned int sx = x + wrap_x_;
+      unsigned int sy = y + wrap_y_;
+      return (sy >= size_y_ ? sy - size_y_ : sy) * size_x_ + (sx >= size_x_ ? sx - size_x_ : sx);
+    }
+    return y * size_x_ + x;
+  }
+
+  void markVoxel(unsigned int x, unsigned int y, unsigned int z);
+
+  /**
+   * @brief  Mark a voxel
+   * @return Whether the column of the voxel has more marked voxels than the threshold
+   */
+  bool markVoxelInMap(
+    unsigned int x, unsigned int y, unsigned int z, unsigned int marked_threshold);
+
+  void clearVoxel(unsigned int x, unsigned int y, unsigned int z);
+
+  /** @brief Make every voxel of a column unknown */
+  void clearVoxelColumn(unsigned int x, unsigned int y);
+
+  void markVoxelLine(
+    double x0, double y0, double z0, double x1, double y1, double z1,
+    unsigned int max_length = UINT_MAX);
+  void clearVoxelLine(
+    double x0, double y0, double z0, double x1, double y1, double z1,
+    unsigned int max_length = UINT_MAX);
+
+  /**
+   * @brief  Clear the voxels along a line, like VoxelGrid::clearVoxelLineInMap(). The cells
+   *         of map_2d are found with getIndex().
+   */
+  void clearVoxelLineInMap(
+    double x0, double y0, double z0, double x1, double y1, double z1, unsigned char * map_2d,
+    unsigned int unknown_threshold, unsigned int mark_threshold,
+    unsigned char free_cost = 0, unsigned char unknown_cost = 255,
+    unsigned int max_length = UINT_MAX);
+
+  VoxelStatus getVoxel(unsigned int x, unsigned int y, unsigned int z);
+
+  // Are there any obstacles at that (x, y) location in the grid?
+  VoxelStatus getVoxelColumn(
+    unsigned int x, unsigned int y,
+    unsigned int unknown_threshold = 0, unsigned int marked_threshold = 0);
+
+  /**
+   * @brief  Get the columns whose voxels changed since the last call, and forget them
+   * @param columns Set to the columns, in no particular order
+   */
+  void takeChangedColumns(std::vector<Column> & columns);
+
+  /** @brief Number of blocks allocated */
+  size_t numBlocks() const {return blocks_.size();}
+
+  unsigned int sizeX() const {return size_x_;}
+  unsigned int sizeY() const {return size_y_;}
+  unsigned int sizeZ() const {return size_z_;}
+
+private:
+  /** @brief The marked and known voxels of a block, one byte per column and one bit per z */
+  struct Block
+  {
+    uint8_t marked[BLOCK_SIZE * BLOCK_SIZE];
+    uint8_t known[BLOCK_SIZE * BLOCK_SIZE];
+  };
+
+  /** @brief The number of marked and known voxels of a column */
+  struct ColumnCount
+  {
+    unsigned int marked, known;
+  };
+
+  /**
+   * @brief  Find the block holding a voxel of the grid
+   * @param create Whether to allocate the block when there is none
+   * @return The block, or NULL
+   */
+  Block * getBlock(unsigned int x, unsigned int y, unsigned int z, bool create);
+
+  /** @brief The key of the column of a cell of the grid */
+  uint64_t columnKey(unsigned int x, unsigned int y) const
+  {
+    return VoxelKey::column(origin_x_ + static_cast<int>(x), origin_y_ + static_cast<int>(y));
+  }
+
+  /**
+   * @brief  Set a voxel to marked or free, updating the counts of its column
+   * @return The counts of the column
+   */
+  const ColumnCount & setVoxel(unsigned int x, unsigned int y, unsigned int z, bool marked);
+
+  /**
+   * @brief  Call an action on the voxels along a line with the same traversal as VoxelGrid
+   * @param at Called with the x, y and z of each voxel
+   */
+  template<class ActionType>
+  void raytraceLine(
+    ActionType at, double x0, double y0, double z0,
+    double x1, double y1, double z1, unsigned int max_length);
+
+  bool inBounds(double x0, double y0, double z0, double x1, double y1, double z1) const;
+
+  unsigned int size_x_, size_y_, size_z_;
+  /// @brief The cell of origin (0, 0) that is cell (0, 0) of the grid
+  int origin_x_, origin_y_;
+  bool toroidal_;
+  unsigned int wrap_x_, wrap_y_;
+  std::unordered_map<uint64_t, Block> blocks_;
+  ColumnCounts<ColumnCount> columns_;
+  /// @brief The block found last, as voxels along a line mostly fall in the same block
+  uint64_t last_block_key_;
+  Block * last_block_;
+  rclcpp::Logger logger;
+};
+
+}  // namespace nav2_voxel_grid
+
+#endif  // NAV2_VOXEL_GRID__SPARSE_VOXEL_GRID_HPP_
@@ -46,12 +46,6 @@
 #include <algorithm>
 #include "rclcpp/rclcpp.hpp"
 
-/**
- * @class VoxelGrid
- * @brief A 3D grid structure that stores points as an integer array.
- *        X and Y index the array and Z selects which bit of the integer
- *        is used giving a limit of 16 vertical cells.
- */
 namespace nav2_voxel_grid
 {
 
@@ -62,29 +56,101 @@ enum VoxelStatus
   MARKED = 2,
 };
 
-class VoxelGrid
+/**
+ * @class BasicVoxelGrid
+ * @brief A 3D grid structure that stores points as an integer array.
+ *        X and Y index the array and Z selects which bit of the integer
+ *        is used. The upper half of the bits of a column are its marked voxels,
+ *        which gives a limit of 16 vertical cells with uint32_t columns and 32
+ *        with uint64_t columns.
+ */
+template<class ColumnT>
+class BasicVoxelGrid
 {
 public:
+  /** @brief The number of vertical cells a column holds */
+  static const unsigned int LEVELS = sizeof(ColumnT) * CHAR_BIT / 2;
+
   /**
    * @brief  Constructor for a voxel grid
    * @param size_x The x size of the grid
    * @param size_y The y size of the grid
-   * @param size_z The z size of the grid, only sizes <= 16 are supported
+   * @param size_z The z size of the grid, only sizes <= LEVELS are supported
    */
-  VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z);
+  BasicVoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z);
 
-  ~VoxelGrid();
+  ~BasicVoxelGrid();
 
   /**
    * @brief  Resizes a voxel grid to the desired size
    * @param size_x The x size of the grid
    * @param size_y The y size of the grid
-   * @param size_z The z size of the grid, only sizes <= 16 are supported
+   * @param size_z The z size of the grid, only sizes <= LEVELS are supported
    */
   void resize(unsigned int size_x, unsigned int size_y, unsigned int size_z);
 
   void reset();
-  uint32_t * getData() {return data_;}
+  ColumnT * getData() {return data_;}
+
+  /**
+   * @brief  Switch the storage of the grid between row-major and toroidal (wrap-around) order
+   *
+   * In toroidal mode, updateOrigin() only moves the storage offset and resets the columns
+   * that scrolled into view, so getData() is no longer laid out row by row from cell (0, 0).
+   * Use getIndex() to find the column of a cell. Switching modes resets the grid.
+   * @param toroidal Whether to use toroidal storage
+   */
+  void setToroidal(bool toroidal);
+  bool isToroidal() const {return toroidal_;}
+
+  /**
+   * @brief  Move the origin of a toroidal grid, resetting the columns that scrolled into view.
+   *         A row-major grid is simply reset
+   * @param cell_ox The number of cells the origin moves along x
+   * @param cell_oy The number of cells the origin moves along y
+   */
+  void updateOrigin(int cell_ox, int cell_oy);
+
+  /**
+   * @brief  Index of the column of cell (x, y) in the data returned by getData()
+   */
+  inline unsigned int getIndex(unsigned int x, unsigned int y) const
+  {
+    if (toroidal_) {
+      unsigned int sx = x + wrap_x_;
+      unsigned int sy = y + wrap_y_;
+      return (sy >= size_y_ ? sy - size_y_ : sy) * size_x_ + (sx >= size_x_ ? sx - size_x_ : sx);
+    }
+    return y * size_x_ + x;
+  }
+
+  /** @brief The mask of voxel z, which sets both its marked and its known bit */
+  static inline ColumnT voxelMask(unsigned int z)
+  {
+    return ((ColumnT)1 << z << LEVELS) | ((ColumnT)1 << z);
+  }
+
+  /**
+   * @brief The marked voxels of a column, one bit per voxel. They are the upper half of the
+   *        column, shifted down so that bit z is voxel z. The lower half has the bit of each
+   *        voxel that is marked or unknown.
+   */
+  static inline ColumnT markedBits(ColumnT col)
+  {
+    return col >> LEVELS;
+  }
+
+  /** @brief The unknown voxels of a column, one bit per voxel */
+  static inline ColumnT unknownBits(ColumnT col)
+  {
+    return (col >> LEVELS) ^ (col & LOW_MASK);
+  }
+
+  /** @brief A column of unknown voxels */
+  static inline ColumnT unknownColumn()
+  {
+    return LOW_MASK;
+  }
 
   inline void markVoxel(unsigned int x, unsigned int y, unsigned int z)
   {
@@ -92,8 +158,7 @@ public:
       RCLCPP_DEBUG(logger, "Error, voxel out of bounds.\n");
       return;
     }
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    data_[y * size_x_ + x] |= full_mask;  // clear unknown and mark cell
+    data_[getIndex(x, y)] |= voxelMask(z);  // clear unknown and mark cell
   }
 
   inline bool markVoxelInMap(
@@ -105,15 +170,12 @@ public:
       return false;
     }
 
-    int index = y * size_x_ + x;
-    uint32_t * col = &data_[index];
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    *col |= full_mask;  // clear unknown and mark cell
-
-    unsigned int marked_bits = *col >> 16;
+    int index = getIndex(x, y);
+    ColumnT * col = &data_[index];
+    *col |= voxelMask(z);  // clear unknown and mark cell
 
     // make sure the number of bits in each is below our thesholds
-    return !bitsBelowThreshold(marked_bits, marked_threshold);
+    return !bitsBelowThreshold(markedBits(*col), marked_threshold);
   }
 
   inline void clearVoxel(unsigned int x, unsigned int y, unsigned int z)
@@ -122,8 +184,7 @@ public:
       RCLCPP_DEBUG(logger, "Error, voxel out of bounds.\n");
       return;
     }
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    data_[y * size_x_ + x] &= ~(full_mask);  // clear unknown and clear cell
+    data_[getIndex(x, y)] &= ~voxelMask(z);  // clear unknown and clear cell
   }
 
   inline void clearVoxelColumn(unsigned int index)
@@ -138,51 +199,40 @@ public:
       RCLCPP_DEBUG(logger, "Error, voxel out of bounds.\n");
       return;
     }
-    int index = y * size_x_ + x;
-    uint32_t * col = &data_[index];
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    *col &= ~(full_mask);  // clear unknown and clear cell
-
-    unsigned int unknown_bits = uint16_t(*col >> 16) ^ uint16_t(*col);
-    unsigned int marked_bits = *col >> 16;
+    int index = getIndex(x, y);
+    ColumnT * col = &data_[index];
+    *col &= ~voxelMask(z);  // clear unknown and clear cell
 
     // make sure the number of bits in each is below our thesholds
-    if (bitsBelowThreshold(unknown_bits, 1) && bitsBelowThreshold(marked_bits, 1)) {
+    if (bitsBelowThreshold(unknownBits(*col), 1) && bitsBelowThreshold(markedBits(*col), 1)) {
       costmap[index] = 0;
     }
   }
 
-  inline bool bitsBelowThreshold(unsigned int n, unsigned int bit_threshold)
+  static inline bool bitsBelowThreshold(ColumnT n, unsigned int bit_threshold)
   {
-    unsigned int bit_count;
-    for (bit_count = 0; n; ) {
-      ++bit_count;
-      if (bit_count > bit_threshold) {
-        return false;
-      }
-      n &= n - 1;  // clear the least significant bit set
-    }
-    return true;
+    return numBits(n) <= bit_threshold;
   }
 
-  static inline unsigned int numBits(unsigned int n)
+  /** @brief The number of bits set, which is a single instruction on targets with one */
+  static inline unsigned int numBits(uint32_t n)
   {
-    unsigned int bit_count;
-    for (bit_count = 0; n; ++bit_count) {
-      n &= n - 1;  // clear the least significant bit set
-    }
-    return bit_count;
+    return __builtin_popcount(n);
+  }
+
+  static inline unsigned int numBits(uint64_t n)
+  {
+    return __builtin_popcountll(n);
   }
 
   static VoxelStatus getVoxel(
     unsigned int x, unsigned int y, unsigned int z,
-    unsigned int size_x, unsigned int size_y, unsigned int size_z, const uint32_t * data)
+    unsigned int size_x, unsigned int size_y, unsigned int size_z, const ColumnT * data)
   {
     if (x >= size_x || y >= size_y || z >= size_z) {
       return UNKNOWN;
     }
-    uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-    uint32_t result = data[y * size_x + x] & full_mask;
+    ColumnT result = data[y * size_x + x] & voxelMask(z);
     unsigned int bits = numBits(result);
 
     // known marked: 11 = 2 bits, unknown: 01 = 1 bit, known free: 00 = 0 bits
@@ -195,6 +245,26 @@ public:
     return MARKED;
   }
 
+  /**
+   * @brief  Get the status of a voxel from columns packed in 32 bit words, least significant
+   *         word first, as in the data of a nav2_msgs VoxelGrid message
+   */
+  static VoxelStatus getVoxelFromWords(
+    unsigned int x, unsigned int y, unsigned int z,
+    unsigned int size_x, unsigned int size_y, unsigned int size_z, const uint32_t * words)
+  {
+    if (x >= size_x || y >= size_y || z >= size_z) {
+      return UNKNOWN;
+    }
+    const unsigned int num_words = sizeof(ColumnT) / sizeof(uint32_t);
+    const uint32_t * column_words = &words[(y * size_x + x) * num_words];
+    ColumnT column = 0;
+    for (unsigned int w = 0; w < num_words; ++w) {
+      column |= static_cast<ColumnT>(column_words[w]) << (32 * w);
+    }
+    return getVoxel(0, 0, z, 1, 1, size_z, &column);
+  }
+
   void markVoxelLine(
     double x0, double y0, double z0, double x1, double y1, double z1,
     unsigned int max_length = UINT_MAX);
@@ -207,6 +277,33 @@ public:
     unsigned char free_cost = 0, unsigned char unknown_cost = 255,
     unsigned int max_length = UINT_MAX);
 
+  /**
+   * @brief  Same as clearVoxelLineInMap(), but setting the cost of each column the line
+   *         clears through set_cost(index, cost) instead of writing it into a 2D map
+   */
+  template<class CostAction>
+  inline void clearVoxelLineWithCosts(
+    double x0, double y0, double z0, double x1, double y1, double z1, CostAction set_cost,
+    unsigned int unknown_threshold, unsigned int mark_threshold,
+    unsigned char free_cost = 0, unsigned char unknown_cost = 255,
+    unsigned int max_length = UINT_MAX)
+  {
+    if (x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_ || x1 >= size_x_ || y1 >= size_y_ ||
+      z1 >= size_z_)
+    {
+      RCLCPP_DEBUG(
+        logger,
+        "Error, line endpoint out of bounds. "
+        "(%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)",
+        x0, y0, z0, x1, y1, z1, size_x_, size_y_, size_z_);
+      return;
+    }
+
+    ClearVoxelInMap<CostAction> cvm(
+      data_, set_cost, unknown_threshold, mark_threshold, free_cost, unknown_cost);
+    raytraceLine(cvm, x0, y0, z0, x1, y1, z1, max_length);
+  }
+
   VoxelStatus getVoxel(unsigned int x, unsigned int y, unsigned int z);
 
   // Are there any obstacles at that (x, y) location in the grid?
@@ -237,8 +334,8 @@ public:
     int offset_dy = sign(dy) * size_x_;
     int offset_dz = sign(dz);
 
-    unsigned int z_mask = ((1 << 16) | 1) << (unsigned int)z0;
-    unsigned int offset = (unsigned int)y0 * size_x_ + (unsigned int)x0;
+    ColumnT z_mask = voxelMask((unsigned int)z0);
+    unsigned int offset = getIndex((unsigned int)x0, (unsigned int)y0);
 
     GridOffset grid_off(offset);
     ZOffset z_off(z_mask);
@@ -248,6 +345,42 @@ public:
     double dist = sqrt((x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1) + (z0 - z1) * (z0 - z1));
     double scale = std::min(1.0, max_length / dist);
 
+    // with toroidal storage, rows and columns wrap at the storage seam
+    if (toroidal_) {
+      unsigned int col = offset % size_x_;
+      unsigned int row = offset / size_x_;
+      ToroidalXOffset x_off(offset, col, size_x_);
+      ToroidalYOffset y_off(offset, row, size_x_, size_y_);
+
+      if (abs_dx >= max(abs_dy, abs_dz)) {
+        int error_y = abs_dx / 2;
+        int error_z = abs_dx / 2;
+
+        bresenham3D(
+          at, x_off, y_off, z_off, abs_dx, abs_dy, abs_dz, error_y, error_z,
+          offset_dx, sign(dy), offset_dz, offset, z_mask, (unsigned int)(scale * abs_dx));
+        return;
+      }
+
+      if (abs_dy >= abs_dz) {
+        int error_x = abs_dy / 2;
+        int error_z = abs_dy / 2;
+
+        bresenham3D(
+          at, y_off, x_off, z_off, abs_dy, abs_dx, abs_dz, error_x, error_z,
+          sign(dy), offset_dx, offset_dz, offset, z_mask, (unsigned int)(scale * abs_dy));
+        return;
+      }
+
+      int error_x = abs_dz / 2;
+      int error_y = abs_dz / 2;
+
+      bresenham3D(
+        at, z_off, x_off, y_off, abs_dz, abs_dx, abs_dy, error_x, error_y, offset_dz,
+        offset_dx, sign(dy), offset, z_mask, (unsigned int)(scale * abs_dz));
+      return;
+    }
+
     // is x dominant
     if (abs_dx >= max(abs_dy, abs_dz)) {
       int error_y = abs_dx / 2;
@@ -286,7 +419,7 @@ private:
     ActionType at, OffA off_a, OffB off_b, OffC off_c,
     unsigned int abs_da, unsigned int abs_db, unsigned int abs_dc,
     int error_b, int error_c, int offset_a, int offset_b, int offset_c, unsigned int & offset,
-    unsigned int & z_mask, unsigned int max_length = UINT_MAX)
+    ColumnT & z_mask, unsigned int max_length = UINT_MAX)
   {
     unsigned int end = std::min(max_length, abs_da);
     for (unsigned int i = 0; i < end; ++i) {
@@ -316,8 +449,14 @@ private:
     return x > y ? x : y;
   }
 
+  /// @brief The known bits of a column, which are set for unknown voxels
+  static const ColumnT LOW_MASK = ~(ColumnT)0 >> LEVELS;
+
   unsigned int size_x_, size_y_, size_z_;
-  uint32_t * data_;
+  ColumnT * data_;
+  // toroidal storage: the column and row of data_ holding cell (0, 0)
+  bool toroidal_;
+  unsigned int wrap_x_, wrap_y_;
   unsigned char * costmap;
   rclcpp::Logger logger;
 
@@ -326,79 +465,79 @@ private:
   class MarkVoxel
   {
 public:
-    explicit MarkVoxel(uint32_t * data)
+    explicit MarkVoxel(ColumnT * data)
     : data_(data) {}
-    inline void operator()(unsigned int offset, unsigned int z_mask)
+    inline void operator()(unsigned int offset, ColumnT z_mask)
     {
       data_[offset] |= z_mask;  // clear unknown and mark cell
     }
 
 private:
-    uint32_t * data_;
+    ColumnT * data_;
   };
 
   class ClearVoxel
   {
 public:
-    explicit ClearVoxel(uint32_t * data)
+    explicit ClearVoxel(ColumnT * data)
     : data_(data) {}
-    inline void operator()(unsigned int offset, unsigned int z_mask)
+    inline void operator()(unsigned int offset, ColumnT z_mask)
     {
       data_[offset] &= ~(z_mask);  // clear unknown and clear cell
     }
 
 private:
-    uint32_t * data_;
+    ColumnT * data_;
   };
 
+  /** @brief Writes costs into a 2D map laid out like the grid */
+  class WriteCost
+  {
+public:
+    explicit WriteCost(unsigned char * costmap)
+    : costmap_(costmap) {}
+    inline void operator()(unsigned int offset, unsigned char cost)
+    {
+      costmap_[offset] = cost;
+    }
+
+private:
+    unsigned char * costmap_;
+  };
+
+  template<class CostAction>
   class ClearVoxelInMap
   {
 public:
     ClearVoxelInMap(
-      uint32_t * data, unsigned char * costmap,
+      ColumnT * data, CostAction set_cost,
       unsigned int unknown_clear_threshold, unsigned int marked_clear_threshold,
       unsigned char free_cost = 0, unsigned char unknown_cost = 255)
-    : data_(data), costmap_(costmap),
+    : data_(data), set_cost_(set_cost),
       unknown_clear_threshold_(unknown_clear_threshold), marked_clear_threshold_(
         marked_clear_threshold),
       free_cost_(free_cost), unknown_cost_(unknown_cost)
     {
     }
 
-    inline void operator()(unsigned int offset, unsigned int z_mask)
+    inline void operator()(unsigned int offset, ColumnT z_mask)
     {
-      uint32_t * col = &data_[offset];
+      ColumnT * col = &data_[offset];
       *col &= ~(z_mask);  // clear unknown and clear cell
 
-      unsigned int unknown_bits = uint16_t(*col >> 16) ^ uint16_t(*col);
-      unsigned int marked_bits = *col >> 16;
-
       // make sure the number of bits in each is below our thesholds
-      if (bitsBelowThreshold(marked_bits, marked_clear_threshold_)) {
-        if (bitsBelowThreshold(unknown_bits, unknown_clear_threshold_)) {
-          costmap_[offset] = free_cost_;
+      if (bitsBelowThreshold(markedBits(*col), marked_clear_threshold_)) {
+        if (bitsBelowThreshold(unknownBits(*col), unknown_clear_threshold_)) {
+          set_cost_(offset, free_cost_);
         } else {
-          costmap_[offset] = unknown_cost_;
+          set_cost_(offset, unknown_cost_);
         }
       }
     }
 
 private:
-    inline bool bitsBelowThreshold(unsigned int n, unsigned int bit_threshold)
-    {
-      unsigned int bit_count;
-      for (bit_count = 0; n; ) {
-        ++bit_count;
-        if (bit_count > bit_threshold) {
-          return false;
-        }
-        n &= n - 1;  // clear the least significant bit set
-      }
-      return true;
-    }
-
-    uint32_t * data_;
-    unsigned char * costmap_;
+    ColumnT * data_;
+    CostAction set_cost_;
     unsigned int unknown_clear_threshold_, marked_clear_threshold_;
     unsigned char free_cost_, unknown_cost_;
   };
@@ -420,7 +559,7 @@ private:
   class ZOffset
   {
 public:
-    explicit ZOffset(unsigned int & z_mask)
+    explicit ZOffset(ColumnT & z_mask)
     : z_mask_(z_mask) {}
     inline void operator()(int offset_val)
     {
@@ -428,10 +567,78 @@ public:
     }
 
 private:
-    unsigned int & z_mask_;
+    ColumnT & z_mask_;
+  };
+
+  class ToroidalXOffset
+  {
+public:
+    ToroidalXOffset(unsigned int & offset, unsigned int & col, unsigned int size_x)
+    : offset_(offset), col_(col), size_x_(size_x) {}
+    inline void operator()(int offset_val)
+    {
+      if (offset_val > 0) {
+        if (++col_ == size_x_) {
+          col_ = 0;
+          offset_ -= size_x_ - 1;
+        } else {
+          ++offset_;
+        }
+      } else if (col_ == 0) {
+        col_ = size_x_ - 1;
+        offset_ += size_x_ - 1;
+      } else {
+        --col_;
+        --offset_;
+      }
+    }
+
+private:
+    unsigned int & offset_;
+    unsigned int & col_;
+    unsigned int size_x_;
+  };
+
+  class ToroidalYOffset
+  {
+public:
+    ToroidalYOffset(
+      unsigned int & offset, unsigned int & row, unsigned int size_x,
+      unsigned int size_y)
+    : offset_(offset), row_(row), size_x_(size_x), size_y_(size_y) {}
+    inline void operator()(int offset_val)
+    {
+      if (offset_val > 0) {
+        if (++row_ == size_y_) {
+          row_ = 0;
+          offset_ -= (size_y_ - 1) * size_x_;
+        } else {
+          offset_ += size_x_;
+        }
+      } else if (row_ == 0) {
+        row_ = size_y_ - 1;
+        offset_ += (size_y_ - 1) * size_x_;
+      } else {
+        --row_;
+        offset_ -= size_x_;
+      }
+    }
+
+private:
+    unsigned int & offset_;
+    unsigned int & row_;
+    unsigned int size_x_, size_y_;
   };
 };
 
+/** @brief A grid of up to 16 levels */
+typedef BasicVoxelGrid<uint32_t> VoxelGrid;
+/** @brief A grid of up to 32 levels */
+typedef BasicVoxelGrid<uint64_t> VoxelGrid64;
+
+extern template class BasicVoxelGrid<uint32_t>;
+extern template class BasicVoxelGrid<uint64_t>;
+
 }  // namespace nav2_voxel_grid
 
 #endif  // NAV2_VOXEL_GRID__VOXEL_GRID_HPP_
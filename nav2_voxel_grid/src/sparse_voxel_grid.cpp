@@ -0,0 +1,405 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nav2_voxel_grid/sparse_voxel_grid.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace nav2_voxel_grid
+{
+
+namespace
+{
+
+const int BLOCK_MASK = SparseVoxelGrid::BLOCK_SIZE - 1;
+
+// the block of a coordinate, rounding down for negative coordinates
+inline int blockOf(int a)
+{
+  return (a - (a & BLOCK_MASK)) / static_cast<int>(SparseVoxelGrid::BLOCK_SIZE);
+}
+
+// the column of a voxel in its block
+inline unsigned int columnInBlock(int x, int y)
+{
+  return (x & BLOCK_MASK) + (y & BLOCK_MASK) * SparseVoxelGrid::BLOCK_SIZE;
+}
+
+}  // namespace
+
+SparseVoxelGrid::SparseVoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+: size_x_(size_x), size_y_(size_y), size_z_(size_z), origin_x_(0), origin_y_(0),
+  toroidal_(false), wrap_x_(0), wrap_y_(0), last_block_key_(0), last_block_(NULL),
+  logger(rclcpp::get_logger("voxel_grid"))
+{
+}
+
+void SparseVoxelGrid::resize(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+{
+  size_x_ = size_x;
+  size_y_ = size_y;
+  size_z_ = size_z;
+  reset();
+}
+
+void SparseVoxelGrid::reset()
+{
+  // a reset grid is projected as a whole, so no column is left changed
+  blocks_.clear();
+  columns_.forget();
+  last_block_ = NULL;
+  origin_x_ = origin_y_ = 0;
+  wrap_x_ = wrap_y_ = 0;
+}
+
+void SparseVoxelGrid::setToroidal(bool toroidal)
+{
+  if (toroidal == toroidal_) {
+    return;
+  }
+  toroidal_ = toroidal;
+  reset();
+}
+
+void SparseVoxelGrid::updateOrigin(int cell_ox, int cell_oy)
+{
+  int size_x = size_x_;
+  int size_y = size_y_;
+
+  if (std::abs(cell_ox) >= size_x || std::abs(cell_oy) >= size_y) {
+    reset();
+    return;
+  }
+
+  // cell (cell_ox, cell_oy) becomes the new (0, 0)
+  origin_x_ += cell_ox;
+  origin_y_ += cell_oy;
+  if (toroidal_) {
+    wrap_x_ = (wrap_x_ + cell_ox + size_x) % size_x;
+    wrap_y_ = (wrap_y_ + cell_oy + size_y) % size_y;
+  }
+
+  auto outside = [&](int ax, int ay) {
+      return ax < origin_x_ || ax >= origin_x_ + size_x ||
+             ay < origin_y_ || ay >= origin_y_ + size_y;
+    };
+
+  // forget the voxels that left the grid, so they are unknown should they come back
+  for (auto it = blocks_.begin(); it != blocks_.end(); ) {
+    int bx, by;
+    unsigned int bz;
+    VoxelKey::coordinates(it->first, bx, by, bz);
+    bx *= BLOCK_SIZE;
+    by *= BLOCK_SIZE;
+    if (bx + BLOCK_MASK < origin_x_ || bx >= origin_x_ + size_x ||
+      by + BLOCK_MASK < origin_y_ || by >= origin_y_ + size_y)
+    {
+      it = blocks_.erase(it);
+      continue;
+    }
+    if (outside(bx, by) || outside(bx + BLOCK_MASK, by + BLOCK_MASK)) {
+      for (unsigned int i = 0; i < BLOCK_SIZE * BLOCK_SIZE; ++i) {
+        if (outside(bx + (i & BLOCK_MASK), by + i / BLOCK_SIZE)) {
+          it->second.marked[i] = it->second.known[i] = 0;
+        }
+      }
+    }
+    ++it;
+  }
+  columns_.forget(outside);
+  last_block_ = NULL;
+}
+
+SparseVoxelGrid::Block * SparseVoxelGrid::getBlock(
+  unsigned int x, unsigned int y, unsigned int z, bool create)
+{
+  uint64_t block_key = VoxelKey::key(
+    blockOf(origin_x_ + static_cast<int>(x)), blockOf(origin_y_ + static_cast<int>(y)),
+    z / BLOCK_SIZE);
+  if (last_block_ && block_key == last_block_key_) {
+    return last_block_;
+  }
+
+  Block * block = NULL;
+  auto it = blocks_.find(block_key);
+  if (it != blocks_.end()) {
+    block = &it->second;
+  } else if (create) {
+    block = &blocks_[block_key];
+    memset(block, 0, sizeof(Block));
+  } else {
+    return NULL;
+  }
+
+  // the blocks are never moved by a rehash, so the pointer stays valid until one is erased
+  last_block_key_ = block_key;
+  last_block_ = block;
+  return block;
+}
+
+const SparseVoxelGrid::ColumnCount & SparseVoxelGrid::setVoxel(
+  unsigned int x, unsigned int y, unsigned int z, bool marked)
+{
+  Block * block = getBlock(x, y, z, true);
+  unsigned int i = columnInBlock(origin_x_ + static_cast<int>(x), origin_y_ + static_cast<int>(y));
+  uint8_t bit = 1 << (z % BLOCK_SIZE);
+  bool was_marked = block->marked[i] & bit;
+  bool was_known = block->known[i] & bit;
+  if (was_known && was_marked == marked) {
+    // a known voxel has a column
+    return *columns_.find(columnKey(x, y));
+  }
+
+  ColumnCount & count = columns_.change(columnKey(x, y));
+  if (!was_known) {
+    block->known[i] |= bit;
+    ++count.known;
+  }
+  if (marked && !was_marked) {
+    block->marked[i] |= bit;
+    ++count.marked;
+  } else if (!marked && was_marked) {
+    block->marked[i] &= ~bit;
+    --count.marked;
+  }
+  return count;
+}
+
+void SparseVoxelGrid::markVoxel(unsigned int x, unsigned int y, unsigned int z)
+{
+  if (x >= size_x_ || y >= size_y_ || z >= size_z_) {
+    RCLCPP_DEBUG(logger, "Error, voxel out of bounds.\n");
+    return;
+  }
+  setVoxel(x, y, z, true);
+}
+
+bool SparseVoxelGrid::markVoxelInMap(
+  unsigned int x, unsigned int y, unsigned int z, unsigned int marked_threshold)
+{
+  if (x >= size_x_ || y >= size_y_ || z >= size_z_) {
+    RCLCPP_DEBUG(logger, "Error, voxel out of bounds.\n");
+    return false;
+  }
+  return setVoxel(x, y, z, true).marked > marked_threshold;
+}
+
+void SparseVoxelGrid::clearVoxel(unsigned int x, unsigned int y, unsigned int z)
+{
+  if (x >= size_x_ || y >= size_y_ || z >= size_z_) {
+    RCLCPP_DEBUG(logger, "Error, voxel out of bounds.\n");
+    return;
+  }
+  setVoxel(x, y, z, false);
+}
+
+void SparseVoxelGrid::clearVoxelColumn(unsigned int x, unsigned int y)
+{
+  if (x >= size_x_ || y >= size_y_) {
+    RCLCPP_DEBUG(logger, "Error, voxel out of bounds.\n");
+    return;
+  }
+  unsigned int i = columnInBlock(origin_x_ + static_cast<int>(x), origin_y_ + static_cast<int>(y));
+  for (unsigned int z = 0; z < size_z_; z += BLOCK_SIZE) {
+    Block * block = getBlock(x, y, z, false);
+    if (block) {
+      block->marked[i] = block->known[i] = 0;
+    }
+  }
+  ColumnCount & count = columns_.change(columnKey(x, y));
+  count.marked = count.known = 0;
+}
+
+template<class ActionType>
+void SparseVoxelGrid::raytraceLine(
+  ActionType at, double x0, double y0, double z0,
+  double x1, double y1, double z1, unsigned int max_length)
+{
+  int dx = int(x1) - int(x0);  // NOLINT
+  int dy = int(y1) - int(y0);  // NOLINT
+  int dz = int(z1) - int(z0);  // NOLINT
+
+  unsigned int abs_d[3] = {
+    static_cast<unsigned int>(abs(dx)), static_cast<unsigned int>(abs(dy)),
+    static_cast<unsigned int>(abs(dz))};
+  int step[3] = {dx > 0 ? 1 : -1, dy > 0 ? 1 : -1, dz > 0 ? 1 : -1};
+  int voxel[3] = {int(x0), int(y0), int(z0)};  // NOLINT
+
+  // the dominant axis is x, then y, then z on ties, like VoxelGrid
+  unsigned int a = 0, b = 1, c = 2;
+  if (abs_d[0] < std::max(abs_d[1], abs_d[2])) {
+    if (abs_d[1] >= abs_d[2]) {
+      a = 1;
+      b = 0;
+    } else {
+      a = 2;
+      b = 0;
+      c = 1;
+    }
+  }
+
+  double dist = sqrt((x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1) + (z0 - z1) * (z0 - z1));
+  double scale = std::min(1.0, max_length / dist);
+  unsigned int end = std::min(
+    static_cast<unsigned int>(scale * abs_d[a]), abs_d[a]);
+
+  int error_b = abs_d[a] / 2;
+  int error_c = abs_d[a] / 2;
+  for (unsigned int i = 0; i < end; ++i) {
+    at(voxel[0], voxel[1], voxel[2]);
+    voxel[a] += step[a];
+    error_b += abs_d[b];
+    error_c += abs_d[c];
+    if (static_cast<unsigned int>(error_b) >= abs_d[a]) {
+      voxel[b] += step[b];
+      error_b -= abs_d[a];
+    }
+    if (static_cast<unsigned int>(error_c) >= abs_d[a]) {
+      voxel[c] += step[c];
+      error_c -= abs_d[a];
+    }
+  }
+  at(voxel[0], voxel[1], voxel[2]);
+}
+
+bool SparseVoxelGrid::inBounds(
+  double x0, double y0, double z0, double x1, double y1, double z1) const
+{
+  if (x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_ || x1 >= size_x_ || y1 >= size_y_ ||
+    z1 >= size_z_)
+  {
+    RCLCPP_DEBUG(
+      logger,
+      "Error, line endpoint out of bounds. "
+      "(%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)",
+      x0, y0, z0, x1, y1, z1, size_x_, size_y_, size_z_);
+    return false;
+  }
+  return true;
+}
+
+void SparseVoxelGrid::markVoxelLine(
+  double x0, double y0, double z0, double x1, double y1, double z1,
+  unsigned int max_length)
+{
+  if (!inBounds(x0, y0, z0, x1, y1, z1)) {
+    return;
+  }
+  raytraceLine(
+    [this](int x, int y, int z) {
+      setVoxel(x, y, z, true);
+    }, x0, y0, z0, x1, y1, z1, max_length);
+}
+
+void SparseVoxelGrid::clearVoxelLine(
+  double x0, double y0, double z0, double x1, double y1, double z1,
+  unsigned int max_length)
+{
+  if (!inBounds(x0, y0, z0, x1, y1, z1)) {
+    return;
+  }
+  raytraceLine(
+    [this](int x, int y, int z) {
+      setVoxel(x, y, z, false);
+    }, x0, y0, z0, x1, y1, z1, max_length);
+}
+
+void SparseVoxelGrid::clearVoxelLineInMap(
+  double x0, double y0, double z0, double x1, double y1, double z1, unsigned char * map_2d,
+  unsigned int unknown_threshold, unsigned int mark_threshold, unsigned char free_cost,
+  unsigned char unknown_cost, unsigned int max_length)
+{
+  if (map_2d == NULL) {
+    clearVoxelLine(x0, y0, z0, x1, y1, z1, max_length);
+    return;
+  }
+  if (!inBounds(x0, y0, z0, x1, y1, z1)) {
+    return;
+  }
+  raytraceLine(
+    [&](int x, int y, int z) {
+      const ColumnCount & count = setVoxel(x, y, z, false);
+
+      // make sure the number of voxels in each is below our thresholds
+      if (count.marked <= mark_threshold) {
+        map_2d[getIndex(x, y)] =
+          size_z_ - count.known <= unknown_threshold ? free_cost : unknown_cost;
+      }
+    }, x0, y0, z0, x1, y1, z1, max_length);
+}
+
+VoxelStatus SparseVoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z)
+{
+  if (x >= size_x_ || y >= size_y_ || z >= size_z_) {
+    RCLCPP_DEBUG(logger, "Error, voxel out of bounds. (%d, %d, %d)\n", x, y, z);
+    return UNKNOWN;
+  }
+  Block * block = getBlock(x, y, z, false);
+  if (!block) {
+    return UNKNOWN;
+  }
+  unsigned int i = columnInBlock(origin_x_ + static_cast<int>(x), origin_y_ + static_cast<int>(y));
+  uint8_t bit = 1 << (z % BLOCK_SIZE);
+  if (block->marked[i] & bit) {
+    return MARKED;
+  }
+  return block->known[i] & bit ? FREE : UNKNOWN;
+}
+
+VoxelStatus SparseVoxelGrid::getVoxelColumn(
+  unsigned int x, unsigned int y,
+  unsigned int unknown_threshold, unsigned int marked_threshold)
+{
+  if (x >= size_x_ || y >= size_y_) {
+    RCLCPP_DEBUG(logger, "Error, voxel out of bounds. (%d, %d)\n", x, y);
+    return UNKNOWN;
+  }
+
+  unsigned int marked = 0, known = 0;
+  const ColumnCount * column = columns_.find(columnKey(x, y));
+  if (column) {
+    marked = column->marked;
+    known = column->known;
+  }
+
+  // check if the number of marked voxels qualifies the col as marked
+  if (marked > marked_threshold) {
+    return MARKED;
+  }
+
+  // check if the number of unknown voxels qualifies the col as unknown
+  if (size_z_ - known > unknown_threshold) {
+    return UNKNOWN;
+  }
+
+  return FREE;
+}
+
+void SparseVoxelGrid::takeChangedColumns(std::vector<Column> & columns)
+{
+  columns.clear();
+  columns.reserve(columns_.numChanged());
+  columns_.takeChanged(
+    [&](int x, int y, const ColumnCount *) {
+      Column column;
+      column.x = x - origin_x_;
+      column.y = y - origin_y_;
+      columns.push_back(column);
+    });
+}
+
+}  // namespace nav2_voxel_grid
@@ -39,30 +39,32 @@
 
 namespace nav2_voxel_grid
 {
-VoxelGrid::VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z)
-: logger(rclcpp::get_logger("voxel_grid"))
+template<class ColumnT>
+BasicVoxelGrid<ColumnT>::BasicVoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+: toroidal_(false), wrap_x_(0), wrap_y_(0), logger(rclcpp::get_logger("voxel_grid"))
 {
   size_x_ = size_x;
   size_y_ = size_y;
   size_z_ = size_z;
 
-  if (size_z_ > 16) {
+  if (size_z_ > LEVELS) {
     RCLCPP_INFO(
-      logger, "Error, this implementation can only support up to 16 z values (%d)",
-      size_z_);
-    size_z_ = 16;
+      logger, "Error, this implementation can only support up to %u z values (%d)",
+      LEVELS, size_z_);
+    size_z_ = LEVELS;
   }
 
-  data_ = new uint32_t[size_x_ * size_y_];
-  uint32_t unknown_col = ~((uint32_t)0) >> 16;
-  uint32_t * col = data_;
+  data_ = new ColumnT[size_x_ * size_y_];
+  ColumnT unknown_col = unknownColumn();
+  ColumnT * col = data_;
   for (unsigned int i = 0; i < size_x_ * size_y_; ++i) {
     *col = unknown_col;
     ++col;
   }
 }
 
-void VoxelGrid::resize(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+template<class ColumnT>
+void BasicVoxelGrid<ColumnT>::resize(unsigned int size_x, unsigned int size_y, unsigned int size_z)
 {
   // if we're not actually changing the size, we can just reset things
   if (size_x == size_x_ && size_y == size_y_ && size_z == size_z_) {
@@ -74,39 +76,87 @@ void VoxelGrid::resize(unsigned int size_x, unsigned int size_y, unsigned int si
   size_x_ = size_x;
   size_y_ = size_y;
   size_z_ = size_z;
+  wrap_x_ = 0;
+  wrap_y_ = 0;
 
-  if (size_z_ > 16) {
+  if (size_z_ > LEVELS) {
     RCLCPP_INFO(
-      logger, "Error, this implementation can only support up to 16 z values (%d)",
-      size_z);
-    size_z_ = 16;
+      logger, "Error, this implementation can only support up to %u z values (%d)",
+      LEVELS, size_z);
+    size_z_ = LEVELS;
   }
 
-  data_ = new uint32_t[size_x_ * size_y_];
-  uint32_t unknown_col = ~((uint32_t)0) >> 16;
-  uint32_t * col = data_;
+  data_ = new ColumnT[size_x_ * size_y_];
+  ColumnT unknown_col = unknownColumn();
+  ColumnT * col = data_;
   for (unsigned int i = 0; i < size_x_ * size_y_; ++i) {
     *col = unknown_col;
     ++col;
   }
 }
 
-VoxelGrid::~VoxelGrid()
+template<class ColumnT>
+BasicVoxelGrid<ColumnT>::~BasicVoxelGrid()
 {
   delete[] data_;
 }
 
-void VoxelGrid::reset()
+template<class ColumnT>
+void BasicVoxelGrid<ColumnT>::reset()
 {
-  uint32_t unknown_col = ~((uint32_t)0) >> 16;
-  uint32_t * col = data_;
+  ColumnT unknown_col = unknownColumn();
+  ColumnT * col = data_;
   for (unsigned int i = 0; i < size_x_ * size_y_; ++i) {
     *col = unknown_col;
     ++col;
   }
+  wrap_x_ = 0;
+  wrap_y_ = 0;
 }
 
-void VoxelGrid::markVoxelLine(
+template<class ColumnT>
+void BasicVoxelGrid<ColumnT>::setToroidal(bool toroidal)
+{
+  if (toroidal == toroidal_) {
+    return;
+  }
+  toroidal_ = toroidal;
+  reset();
+}
+
+template<class ColumnT>
+void BasicVoxelGrid<ColumnT>::updateOrigin(int cell_ox, int cell_oy)
+{
+  int size_x = size_x_;
+  int size_y = size_y_;
+
+  if (!toroidal_ || std::abs(cell_ox) >= size_x || std::abs(cell_oy) >= size_y) {
+    reset();
+    return;
+  }
+
+  // cell (cell_ox, cell_oy) becomes the new (0, 0)
+  wrap_x_ = (wrap_x_ + cell_ox + size_x) % size_x;
+  wrap_y_ = (wrap_y_ + cell_oy + size_y) % size_y;
+
+  // reset the columns that scrolled into view to unknown
+  ColumnT unknown_col = unknownColumn();
+  unsigned int x0 = cell_ox > 0 ? size_x - cell_ox : 0;
+  unsigned int xn = cell_ox > 0 ? size_x : -cell_ox;
+  unsigned int y0 = cell_oy > 0 ? size_y - cell_oy : 0;
+  unsigned int yn = cell_oy > 0 ? size_y : -cell_oy;
+  for (unsigned int y = 0; y < size_y_; ++y) {
+    bool new_row = y >= y0 && y < yn;
+    for (unsigned int x = 0; x < size_x_; ++x) {
+      if (new_row || (x >= x0 && x < xn)) {
+        data_[getIndex(x, y)] = unknown_col;
+      }
+    }
+  }
+}
+
+template<class ColumnT>
+void BasicVoxelGrid<ColumnT>::markVoxelLine(
   double x0, double y0, double z0, double x1, double y1, double z1,
   unsigned int max_length)
 {
@@ -125,7 +175,8 @@ void VoxelGrid::markVoxelLine(
   raytraceLine(mv, x0, y0, z0, x1, y1, z1, max_length);
 }
 
-void VoxelGrid::clearVoxelLine(
+template<class ColumnT>
+void BasicVoxelGrid<ColumnT>::clearVoxelLine(
   double x0, double y0, double z0, double x1, double y1, double z1,
   unsigned int max_length)
 {
@@ -144,7 +195,8 @@ void VoxelGrid::clearVoxelLine(
   raytraceLine(cv, x0, y0, z0, x1, y1, z1, max_length);
 }
 
-void VoxelGrid::clearVoxelLineInMap(
+template<class ColumnT>
+void BasicVoxelGrid<ColumnT>::clearVoxelLineInMap(
   double x0, double y0, double z0, double x1, double y1, double z1, unsigned char * map_2d,
   unsigned int unknown_threshold, unsigned int mark_threshold, unsigned char free_cost,
   unsigned char unknown_cost, unsigned int max_length)
@@ -155,29 +207,19 @@ void VoxelGrid::clearVoxelLineInMap(
     return;
   }
 
-  if (x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_ || x1 >= size_x_ || y1 >= size_y_ ||
-    z1 >= size_z_)
-  {
-    RCLCPP_DEBUG(
-      logger,
-      "Error, line endpoint out of bounds. "
-      "(%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)",
-      x0, y0, z0, x1, y1, z1, size_x_, size_y_, size_z_);
-    return;
-  }
-
-  ClearVoxelInMap cvm(data_, costmap, unknown_threshold, mark_threshold, free_cost, unknown_cost);
-  raytraceLine(cvm, x0, y0, z0, x1, y1, z1, max_length);
+  clearVoxelLineWithCosts(
+    x0, y0, z0, x1, y1, z1, WriteCost(costmap), unknown_threshold, mark_threshold, free_cost,
+    unknown_cost, max_length);
 }
 
-VoxelStatus VoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z)
+template<class ColumnT>
+VoxelStatus BasicVoxelGrid<ColumnT>::getVoxel(unsigned int x, unsigned int y, unsigned int z)
 {
   if (x >= size_x_ || y >= size_y_ || z >= size_z_) {
     RCLCPP_DEBUG(logger, "Error, voxel out of bounds. (%d, %d, %d)\n", x, y, z);
     return UNKNOWN;
   }
-  uint32_t full_mask = ((uint32_t)1 << z << 16) | (1 << z);
-  uint32_t result = data_[y * size_x_ + x] & full_mask;
+  ColumnT result = data_[getIndex(x, y)] & voxelMask(z);
   unsigned int bits = numBits(result);
 
   // known marked: 11 = 2 bits, unknown: 01 = 1 bit, known free: 00 = 0 bits
@@ -192,7 +234,8 @@ VoxelStatus VoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z)
   return MARKED;
 }
 
-VoxelStatus VoxelGrid::getVoxelColumn(
+template<class ColumnT>
+VoxelStatus BasicVoxelGrid<ColumnT>::getVoxelColumn(
   unsigned int x, unsigned int y,
   unsigned int unknown_threshold, unsigned int marked_threshold)
 {
@@ -201,10 +244,10 @@ VoxelStatus VoxelGrid::getVoxelColumn(
     return UNKNOWN;
   }
 
-  uint32_t * col = &data_[y * size_x_ + x];
+  ColumnT * col = &data_[getIndex(x, y)];
 
-  unsigned int unknown_bits = uint16_t(*col >> 16) ^ uint16_t(*col);
-  unsigned int marked_bits = *col >> 16;
+  ColumnT unknown_bits = unknownBits(*col);
+  ColumnT marked_bits = markedBits(*col);
 
   // check if the number of marked bits qualifies the col as marked
   if (!bitsBelowThreshold(marked_bits, marked_threshold)) {
@@ -219,22 +262,26 @@ VoxelStatus VoxelGrid::getVoxelColumn(
   return FREE;
 }
 
-unsigned int VoxelGrid::sizeX()
+template<class ColumnT>
+unsigned int BasicVoxelGrid<ColumnT>::sizeX()
 {
   return size_x_;
 }
 
-unsigned int VoxelGrid::sizeY()
+template<class ColumnT>
+unsigned int BasicVoxelGrid<ColumnT>::sizeY()
 {
   return size_y_;
 }
 
-unsigned int VoxelGrid::sizeZ()
+template<class ColumnT>
+unsigned int BasicVoxelGrid<ColumnT>::sizeZ()
 {
   return size_z_;
 }
 
-void VoxelGrid::printVoxelGrid()
+template<class ColumnT>
+void BasicVoxelGrid<ColumnT>::printVoxelGrid()
 {
   for (unsigned int z = 0; z < size_z_; z++) {
     printf("Layer z = %u:\n", z);
@@ -247,14 +294,20 @@ void VoxelGrid::printVoxelGrid()
   }
 }
 
-void VoxelGrid::printColumnGrid()
+template<class ColumnT>
+void BasicVoxelGrid<ColumnT>::printColumnGrid()
 {
   printf("Column view:\n");
   for (unsigned int y = 0; y < size_y_; y++) {
     for (unsigned int x = 0; x < size_x_; x++) {
-      printf((getVoxelColumn(x, y, 16, 0) == nav2_voxel_grid::MARKED) ? "#" : " ");
+      printf((getVoxelColumn(x, y, LEVELS, 0) == nav2_voxel_grid::MARKED) ? "#" : " ");
     }
     printf("|\n");
   }
 }
+
+// the two widths of column, built once here
+template class BasicVoxelGrid<uint32_t>;
+template class BasicVoxelGrid<uint64_t>;
+
 }  // namespace nav2_voxel_grid
@@ -0,0 +1,197 @@
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "nav2_voxel_grid/hashed_columns.hpp"
+#include "nav2_voxel_grid/sparse_voxel_grid.hpp"
+#include "nav2_voxel_grid/voxel_grid.hpp"
+
+using nav2_voxel_grid::SparseVoxelGrid;
+using nav2_voxel_grid::VoxelGrid;
+
+namespace
+{
+
+// with 16 levels, the sparse grid has the same voxels and columns as the dense one
+void expectSameGrids(VoxelGrid & dense, SparseVoxelGrid & sparse)
+{
+  for (unsigned int y = 0; y < dense.sizeY(); ++y) {
+    for (unsigned int x = 0; x < dense.sizeX(); ++x) {
+      for (unsigned int z = 0; z < dense.sizeZ(); ++z) {
+        ASSERT_EQ(dense.getVoxel(x, y, z), sparse.getVoxel(x, y, z)) << x << " " << y << " " << z;
+      }
+      for (unsigned int threshold = 0; threshold < 3; ++threshold) {
+        ASSERT_EQ(
+          dense.getVoxelColumn(x, y, threshold, threshold),
+          sparse.getVoxelColumn(x, y, threshold, threshold));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(sparse_voxel_grid, matchesVoxelGrid) {
+  unsigned int size_x = 40, size_y = 30, size_z = 16;
+  VoxelGrid dense(size_x, size_y, size_z);
+  SparseVoxelGrid sparse(size_x, size_y, size_z);
+  dense.setToroidal(true);
+  sparse.setToroidal(true);
+  std::vector<unsigned char> dense_map(size_x * size_y, 100), sparse_map(size_x * size_y, 100);
+
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> rx(0, size_x - 0.01), ry(0, size_y - 0.01);
+  std::uniform_real_distribution<double> rz(0, size_z - 0.01);
+  for (int round = 0; round < 4; ++round) {
+    for (int i = 0; i < 60; ++i) {
+      double x0 = rx(rng), y0 = ry(rng), z0 = rz(rng), x1 = rx(rng), y1 = ry(rng), z1 = rz(rng);
+      if (i % 3 == 0) {
+        dense.markVoxelLine(x0, y0, z0, x1, y1, z1);
+        sparse.markVoxelLine(x0, y0, z0, x1, y1, z1);
+      } else if (i % 3 == 1) {
+        dense.clearVoxelLineInMap(x0, y0, z0, x1, y1, z1, &dense_map[0], 2, 1, 0, 255, 12);
+        sparse.clearVoxelLineInMap(x0, y0, z0, x1, y1, z1, &sparse_map[0], 2, 1, 0, 255, 12);
+      } else {
+        dense.markVoxelInMap(x0, y0, z0, 0);
+        EXPECT_EQ(
+          sparse.markVoxelInMap(x0, y0, z0, 1),
+          dense.getVoxelColumn(x0, y0, 16, 1) == nav2_voxel_grid::MARKED);
+      }
+    }
+    expectSameGrids(dense, sparse);
+    ASSERT_EQ(dense_map, sparse_map);
+
+    // the storage of both follows the origin the same way
+    int ox = round % 2 ? -7 : 11, oy = round % 2 ? 5 : -9;
+    dense.updateOrigin(ox, oy);
+    sparse.updateOrigin(ox, oy);
+    expectSameGrids(dense, sparse);
+    for (unsigned int y = 0; y < size_y; ++y) {
+      for (unsigned int x = 0; x < size_x; ++x) {
+        ASSERT_EQ(dense.getIndex(x, y), sparse.getIndex(x, y));
+      }
+    }
+  }
+}
+
+TEST(sparse_voxel_grid, tallAndSparse) {
+  SparseVoxelGrid grid(1000, 1000, 200);
+  EXPECT_EQ(grid.getVoxelColumn(500, 500, 200, 0), nav2_voxel_grid::FREE);
+  EXPECT_EQ(grid.getVoxelColumn(500, 500, 199, 0), nav2_voxel_grid::UNKNOWN);
+
+  grid.markVoxelLine(500, 500, 0, 500, 500, 199);
+  EXPECT_EQ(grid.getVoxel(500, 500, 199), nav2_voxel_grid::MARKED);
+  EXPECT_TRUE(grid.markVoxelInMap(500, 500, 150, 199));
+  EXPECT_FALSE(grid.markVoxelInMap(500, 500, 150, 200));
+
+  // one block per 8 levels, and nothing anywhere else
+  EXPECT_EQ(grid.numBlocks(), 25u);
+  EXPECT_EQ(grid.getVoxel(501, 500, 150), nav2_voxel_grid::UNKNOWN);
+
+  grid.clearVoxelLine(500, 500, 199, 500, 500, 100);
+  EXPECT_EQ(grid.getVoxelColumn(500, 500, 0, 99), nav2_voxel_grid::MARKED);
+  EXPECT_EQ(grid.getVoxelColumn(500, 500, 0, 100), nav2_voxel_grid::FREE);
+
+  grid.clearVoxelColumn(500, 500);
+  EXPECT_EQ(grid.getVoxel(500, 500, 0), nav2_voxel_grid::UNKNOWN);
+  EXPECT_EQ(grid.getVoxelColumn(500, 500, 200, 0), nav2_voxel_grid::FREE);
+}
+
+TEST(sparse_voxel_grid, changedColumns) {
+  SparseVoxelGrid grid(20, 20, 30);
+  std::vector<SparseVoxelGrid::Column> columns;
+
+  grid.markVoxel(3, 4, 20);
+  grid.markVoxel(3, 4, 2);
+  grid.clearVoxel(15, 16, 29);
+  grid.takeChangedColumns(columns);
+  ASSERT_EQ(columns.size(), 2u);
+  for (const auto & column : columns) {
+    EXPECT_TRUE((column.x == 3 && column.y == 4) || (column.x == 15 && column.y == 16));
+  }
+
+  // setting voxels to what they are doesn't change their columns
+  grid.markVoxel(3, 4, 20);
+  grid.clearVoxel(15, 16, 29);
+  grid.takeChangedColumns(columns);
+  EXPECT_TRUE(columns.empty());
+
+  // the columns keep their place in the world when the origin moves
+  grid.markVoxel(19, 19, 0);
+  grid.updateOrigin(10, 10);
+  grid.takeChangedColumns(columns);
+  ASSERT_EQ(columns.size(), 1u);
+  EXPECT_EQ(columns[0].x, 9u);
+  EXPECT_EQ(columns[0].y, 9u);
+  EXPECT_EQ(grid.getVoxel(5, 6, 29), nav2_voxel_grid::FREE);
+  EXPECT_EQ(grid.getVoxelColumn(9, 9, 29, 0), nav2_voxel_grid::MARKED);
+
+  // and the voxels that left the grid are unknown when they come back
+  grid.updateOrigin(-10, -10);
+  EXPECT_EQ(grid.getVoxel(3, 4, 20), nav2_voxel_grid::UNKNOWN);
+  EXPECT_EQ(grid.getVoxel(15, 16, 29), nav2_voxel_grid::FREE);
+}
+
+TEST(hashed_columns, keysAndChanges) {
+  using nav2_voxel_grid::VoxelKey;
+
+  // negative coordinates come back sign extended, and a voxel is in its column
+  int x, y;
+  unsigned int z;
+  VoxelKey::coordinates(VoxelKey::key(-5, 7, 300), x, y, z);
+  EXPECT_EQ(x, -5);
+  EXPECT_EQ(y, 7);
+  EXPECT_EQ(z, 300u);
+  EXPECT_EQ(VoxelKey::key(-5, 7, 300) >> VoxelKey::Z_BITS, VoxelKey::column(-5, 7));
+
+  nav2_voxel_grid::ColumnCounts<unsigned int> counts;
+  ++counts.change(VoxelKey::column(-5, 7));
+  ++counts.change(VoxelKey::column(3, -2));
+  ASSERT_NE(counts.find(VoxelKey::column(-5, 7)), nullptr);
+  EXPECT_EQ(*counts.find(VoxelKey::column(-5, 7)), 1u);
+  EXPECT_EQ(counts.find(VoxelKey::column(0, 0)), nullptr);
+
+  // erased columns are still taken, without counts
+  counts.takeChanged([](int, int, const unsigned int *) {});
+  counts.erase(VoxelKey::column(3, -2));
+  int taken = 0;
+  counts.takeChanged(
+    [&](int cx, int cy, const unsigned int * count) {
+      EXPECT_EQ(cx, 3);
+      EXPECT_EQ(cy, -2);
+      EXPECT_EQ(count, nullptr);
+      ++taken;
+    });
+  EXPECT_EQ(taken, 1);
+  EXPECT_EQ(counts.size(), 1u);
+
+  // forgetting a column drops it and its change
+  ++counts.change(VoxelKey::column(4, 4));
+  counts.forget([](int cx, int) {return cx < 0;});
+  EXPECT_EQ(counts.size(), 1u);
+  EXPECT_EQ(counts.numChanged(), 1u);
+  counts.clear();
+  EXPECT_EQ(counts.size(), 0u);
+  EXPECT_EQ(counts.numChanged(), 1u);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
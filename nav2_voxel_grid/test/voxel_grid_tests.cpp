@@ -37,6 +37,9 @@
 #include <nav2_voxel_grid/voxel_grid.hpp>
 #include <gtest/gtest.h>
 
+#include <random>
+#include <vector>
+
 TEST(voxel_grid, basicMarkingAndClearing) {
   int size_x = 50, size_y = 10, size_z = 16;
   nav2_voxel_grid::VoxelGrid vg(size_x, size_y, size_z);
@@ -147,6 +150,96 @@ TEST(voxel_grid, InvalidSize) {
   EXPECT_TRUE(vg.getVoxelColumn(50, 11, 0, 0) == nav2_voxel_grid::VoxelStatus::UNKNOWN);
 }
 
+TEST(voxel_grid, toroidalShift) {
+  int size_x = 20, size_y = 10, size_z = 16;
+  nav2_voxel_grid::VoxelGrid vg(size_x, size_y, size_z);
+  vg.setToroidal(true);
+
+  // a line that crosses the storage seam once the origin has moved
+  vg.updateOrigin(7, 3);
+  vg.markVoxelLine(2, 8, 4, 18, 8, 4);
+  for (int x = 2; x <= 18; ++x) {
+    ASSERT_EQ(nav2_voxel_grid::MARKED, vg.getVoxel(x, 8, 4));
+  }
+
+  // moving the origin keeps the cells that are still in the window
+  vg.updateOrigin(-5, 2);
+  for (int x = 7; x <= 19; ++x) {
+    ASSERT_EQ(nav2_voxel_grid::MARKED, vg.getVoxel(x, 6, 4));
+  }
+
+  // and resets the ones that scrolled into view to unknown
+  for (int x = 0; x < 5; ++x) {
+    for (int y = 0; y < size_y; ++y) {
+      ASSERT_EQ(nav2_voxel_grid::UNKNOWN, vg.getVoxelColumn(x, y, 0, 0));
+    }
+  }
+  for (int x = 0; x < size_x; ++x) {
+    ASSERT_EQ(nav2_voxel_grid::UNKNOWN, vg.getVoxelColumn(x, 8, 0, 0));
+    ASSERT_EQ(nav2_voxel_grid::UNKNOWN, vg.getVoxelColumn(x, 9, 0, 0));
+  }
+
+  vg.clearVoxelLine(7, 6, 4, 19, 6, 4);
+  for (int x = 7; x <= 19; ++x) {
+    ASSERT_EQ(nav2_voxel_grid::FREE, vg.getVoxel(x, 6, 4));
+  }
+}
+
+TEST(voxel_grid, wideColumns) {
+  int size_x = 30, size_y = 20;
+  nav2_voxel_grid::VoxelGrid64 vg(size_x, size_y, 33);
+  ASSERT_EQ(vg.sizeZ(), 32u);
+
+  // a wall from the floor to the top level
+  vg.markVoxelLine(4, 5, 0, 4, 5, 31);
+  for (int z = 0; z < 32; ++z) {
+    ASSERT_EQ(nav2_voxel_grid::MARKED, vg.getVoxel(4, 5, z));
+  }
+  EXPECT_EQ(nav2_voxel_grid::MARKED, vg.getVoxelColumn(4, 5, 0, 31));
+  EXPECT_EQ(nav2_voxel_grid::FREE, vg.getVoxelColumn(4, 5, 0, 32));
+  EXPECT_TRUE(vg.markVoxelInMap(4, 5, 31, 31));
+
+  // clearing the top half leaves the column known
+  vg.clearVoxelLine(4, 5, 31, 4, 5, 16);
+  EXPECT_EQ(nav2_voxel_grid::FREE, vg.getVoxel(4, 5, 31));
+  EXPECT_EQ(nav2_voxel_grid::MARKED, vg.getVoxel(4, 5, 15));
+  EXPECT_EQ(nav2_voxel_grid::FREE, vg.getVoxelColumn(4, 5, 0, 16));
+  EXPECT_EQ(nav2_voxel_grid::UNKNOWN, vg.getVoxelColumn(3, 5, 31, 0));
+  EXPECT_EQ(nav2_voxel_grid::FREE, vg.getVoxelColumn(3, 5, 32, 0));
+}
+
+TEST(voxel_grid, wideColumnsMatchNarrowOnes) {
+  int size_x = 30, size_y = 20, size_z = 16;
+  nav2_voxel_grid::VoxelGrid narrow(size_x, size_y, size_z);
+  nav2_voxel_grid::VoxelGrid64 wide(size_x, size_y, size_z);
+  std::vector<unsigned char> narrow_map(size_x * size_y, 100), wide_map(size_x * size_y, 100);
+
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<double> rx(0, size_x - 0.01), ry(0, size_y - 0.01);
+  std::uniform_real_distribution<double> rz(0, size_z - 0.01);
+  for (int i = 0; i < 200; ++i) {
+    double x0 = rx(rng), y0 = ry(rng), z0 = rz(rng), x1 = rx(rng), y1 = ry(rng), z1 = rz(rng);
+    if (i % 2) {
+      narrow.markVoxelLine(x0, y0, z0, x1, y1, z1);
+      wide.markVoxelLine(x0, y0, z0, x1, y1, z1);
+    } else {
+      narrow.clearVoxelLineInMap(x0, y0, z0, x1, y1, z1, &narrow_map[0], 2, 1);
+      wide.clearVoxelLineInMap(x0, y0, z0, x1, y1, z1, &wide_map[0], 2, 1);
+    }
+  }
+
+  // the upper 16 levels of the wide columns are unknown, like the missing ones of the narrow
+  ASSERT_EQ(narrow_map, wide_map);
+  for (int y = 0; y < size_y; ++y) {
+    for (int x = 0; x < size_x; ++x) {
+      for (int z = 0; z < size_z; ++z) {
+        ASSERT_EQ(narrow.getVoxel(x, y, z), wide.getVoxel(x, y, z));
+      }
+      ASSERT_EQ(narrow.getVoxelColumn(x, y, 1, 1), wide.getVoxelColumn(x, y, 17, 1));
+    }
+  }
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);